@@ -56,13 +56,14 @@
 #include <optional>
 #include <array>
 #include <algorithm>
-#include <charconv>
+#include <limits>
 #include <cctype>
 #include <utility>
 #include <tuple>
 #include <type_traits>
 #include <cstring>
 #include <cstdint>
+#include <memory>
 
 // This header only library can be compiled in a TU and shared between TUs
 // to minimize compilation time, by defining the APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY preprocessor directive.
@@ -138,26 +139,177 @@
 #define APRS_ROUTER_MAX_ROUTER_ADDRESSES 16
 #endif
 
+// APRS_ROUTER_MAX_PATH_ADDRESSES
+//
+// Maximum number of packet path addresses stored in route_state and packet_path_view.
+// APRS packets have at most 8 path addresses, and packets with a longer path are not routed.
+// A smaller capacity reduces the size of route_state, ex: on a microcontroller, and a larger
+// capacity allows routing oversized paths, ex: when processing packets from APRS-IS.
+
+#ifndef APRS_ROUTER_MAX_PATH_ADDRESSES
+#define APRS_ROUTER_MAX_PATH_ADDRESSES 8
+#endif
+
+// APRS_ROUTER_MAX_ADDRESS_LENGTH
+//
+// Maximum length of a packet path address, including the used flag, ex: N0CALL-15*
+// Packets with a longer path address are not routed. AX.25 addresses are at most 10 characters long.
+
+#ifndef APRS_ROUTER_MAX_ADDRESS_LENGTH
+#define APRS_ROUTER_MAX_ADDRESS_LENGTH 10
+#endif
+
+// APRS_ROUTER_MAX_DATA_LENGTH
+//
+// Maximum length of the data stored in a fixed_packet. The APRS information field is at most 256 characters long.
+// Packets with longer data can not be decoded into a fixed_packet, the other packet types are not limited.
+
+#ifndef APRS_ROUTER_MAX_DATA_LENGTH
+#define APRS_ROUTER_MAX_DATA_LENGTH 256
+#endif
+
+static_assert(APRS_ROUTER_MAX_PATH_ADDRESSES > 0, "APRS_ROUTER_MAX_PATH_ADDRESSES must be at least 1");
+static_assert(APRS_ROUTER_MAX_ADDRESS_LENGTH >= 10, "APRS_ROUTER_MAX_ADDRESS_LENGTH must fit an AX.25 address, ex: N0CALL-15*");
+
+// APRS_ROUTER_PREFETCH
+//
+// Hint used by the batch routing functions to prefetch the address text of the next packet
+// while the current packet is routed. Define as empty to disable prefetching.
+
+#ifndef APRS_ROUTER_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define APRS_ROUTER_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define APRS_ROUTER_PREFETCH(address) ((void)(address))
+#endif
+#endif
+
+// APRS_ROUTER_ENABLE_SIMD
+//
+// Compare a packet address key against all the router's address keys using
+// SSE2 (x86) or NEON (AArch64) when available. Define as false to always use
+// the portable scalar loop.
+
+#ifndef APRS_ROUTER_ENABLE_SIMD
+#define APRS_ROUTER_ENABLE_SIMD true
+#endif
+
+// APRS_ROUTER_ENABLE_ADDRESS_TABLE
+//
+// Look up the router's explicit and n-N addresses in a hash table of packed address keys,
+// instead of comparing every address. Intended for routers with a large number of aliases,
+// and always enabled when APRS_ROUTER_MAX_ROUTER_ADDRESSES exceeds 64.
+
+#ifndef APRS_ROUTER_ENABLE_ADDRESS_TABLE
+#define APRS_ROUTER_ENABLE_ADDRESS_TABLE (APRS_ROUTER_MAX_ROUTER_ADDRESSES > 64)
+#endif
+
+// APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+//
+// Enables reloadable_router, a router which can be reconfigured while other threads are routing packets.
+// Requires std::atomic and std::thread, define as false on platforms without threads.
+
+#ifndef APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+#define APRS_ROUTER_ENABLE_RELOADABLE_ROUTER true
+#endif
+
+// APRS_ROUTER_USE_PMR
+//
+// Use std::pmr containers for the strings and vectors of packet, routing_result and router_settings,
+// and for the internal_vector_t and internal_string_t aliases. The packets and results of a batch
+// can then be allocated from a std::pmr::monotonic_buffer_resource, and released all at once.
+// Requires C++17 and <memory_resource>.
+
+#ifndef APRS_ROUTER_USE_PMR
+#define APRS_ROUTER_USE_PMR false
+#endif
+
+#if !APRS_ROUTER_ENABLE_ADDRESS_TABLE && APRS_ROUTER_MAX_ROUTER_ADDRESSES > 64
+#error "APRS_ROUTER_ENABLE_ADDRESS_TABLE is required for more than 64 router addresses"
+#endif
+
+#if APRS_ROUTER_ENABLE_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define APRS_ROUTER_SIMD_SSE2
+#include <emmintrin.h>
+#elif APRS_ROUTER_ENABLE_SIMD && (defined(__aarch64__) || defined(_M_ARM64))
+#define APRS_ROUTER_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+#include <atomic>
+#include <thread>
+#endif
+
+#if APRS_ROUTER_USE_PMR
+#include <memory_resource>
+#endif
+
 APRS_ROUTER_NAMESPACE_BEGIN
 
 APRS_ROUTER_DETAIL_NAMESPACE_BEGIN
 
 #ifndef APRS_ROUTER_DEFINE_CUSTOM_TYPES
 
+#if APRS_ROUTER_USE_PMR
+
+template<class T>
+using internal_vector_t = std::pmr::vector<T>;
+
+template<class T>
+using internal_string_t = std::pmr::basic_string<T>;
+
+#else
+
 template<class T>
 using internal_vector_t = std::vector<T>;
 
 template<class T>
 using internal_string_t = std::basic_string<T>;
 
+#endif // APRS_ROUTER_USE_PMR
+
 #endif // APRS_ROUTER_DEFINE_CUSTOM_TYPES
 
+// Strings and vectors of the public types: packet, routing_result and router_settings, see APRS_ROUTER_USE_PMR
+
+#if APRS_ROUTER_USE_PMR
+
+template<class T>
+using public_vector_t = std::pmr::vector<T>;
+
+using public_string_t = std::pmr::string;
+
+#else
+
+template<class T>
+using public_vector_t = std::vector<T>;
+
+using public_string_t = std::string;
+
+#endif // APRS_ROUTER_USE_PMR
+
 template<typename T, typename = void>
 struct has_data_and_size : std::false_type {};
 
 template<typename T>
 struct has_data_and_size<T, std::void_t<decltype(std::declval<T>().data()), decltype(std::declval<T>().size())>> : std::true_type {};
 
+template<typename T, typename = void>
+struct output_iterator_string
+{
+    using type = std::string;
+};
+
+template<typename T>
+struct output_iterator_string<T, std::void_t<typename T::container_type>>
+{
+    using type = typename T::container_type::value_type; // ex: back_insert_iterator
+};
+
+template<typename T>
+using output_iterator_string_t = typename output_iterator_string<T>::type;
+
 template<typename T>
 struct is_std_array_of_char : std::false_type {};
 
@@ -167,6 +319,13 @@ struct is_std_array_of_char<std::array<char, N>> : std::true_type {};
 template<typename T>
 inline constexpr bool is_std_array_of_char_v = is_std_array_of_char<T>::value;
 
+// Capacities of the fixed size buffers, see APRS_ROUTER_MAX_PATH_ADDRESSES and APRS_ROUTER_MAX_ADDRESS_LENGTH
+
+inline constexpr size_t path_addresses_max = APRS_ROUTER_MAX_PATH_ADDRESSES; // number of addresses in a packet path
+inline constexpr size_t address_text_max = APRS_ROUTER_MAX_ADDRESS_LENGTH; // length of a packet path address, ex: N0CALL-15*
+inline constexpr size_t routed_address_text_max = APRS_ROUTER_MAX_ADDRESS_LENGTH + 5; // length of a formatted routed address
+inline constexpr size_t packet_data_max = APRS_ROUTER_MAX_DATA_LENGTH; // length of the data of a fixed_packet
+
 APRS_ROUTER_NAMESPACE_END
 
 APRS_ROUTER_NAMESPACE_END
@@ -208,16 +367,21 @@ struct packet
 {
     packet() = default;
     packet(const packet& other) = default;
+    packet(packet&& other) noexcept = default;
     packet& operator=(const packet& other) = default;
-    packet(const std::string& from, const std::string& to, const std::vector<std::string>& path, const std::string& data);
+    packet& operator=(packet&& other) noexcept = default;
+    packet(const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t& from, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t& to, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t>& path, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t& data);
     packet(const char* packet_string);
     packet(const std::string& packet_string);
+#if APRS_ROUTER_USE_PMR
+    explicit packet(std::pmr::memory_resource* resource);
+#endif
     operator std::string() const;
 
-    std::string from;
-    std::string to;
-    std::vector<std::string> path;
-    std::string data;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t from;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t to;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t> path;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t data;
 };
 
 #endif
@@ -228,6 +392,135 @@ APRS_ROUTER_PACKET_NAMESPACE_END
 
 APRS_ROUTER_NAMESPACE_BEGIN
 
+// Packet view:
+//
+// A non-owning packet, with all the fields referencing the original packet string.
+// The path is stored inline, and a packet view can hold up to 8 path addresses, see APRS_ROUTER_MAX_PATH_ADDRESSES.
+//
+// A packet view is decoded using try_decode_packet, and routed using try_route_packet,
+// without making any heap allocations. The packet string must outlive the packet view.
+//
+// Example:
+//
+// std::string_view packet_string = "N0CALL>APRS,WIDE1-1:data";
+//
+// packet_view p;
+// try_decode_packet(packet_string, p);
+
+struct packet_path_view
+{
+    static constexpr size_t max_size = APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE path_addresses_max;
+
+    const std::string_view* begin() const;
+    const std::string_view* end() const;
+    const std::string_view* data() const;
+    size_t size() const;
+    bool empty() const;
+    const std::string_view& operator[](size_t index) const;
+    bool try_push_back(std::string_view address);
+    void clear();
+
+    std::array<std::string_view, max_size> addresses = {};
+    size_t addresses_size = 0;
+};
+
+struct packet_view
+{
+    std::string_view from;
+    std::string_view to;
+    packet_path_view path;
+    std::string_view data;
+};
+
+// Packet table:
+//
+// Newline delimited packets in the TNC2 format, for bulk ingest of APRS-IS feeds or log replays.
+// The packets are decoded by try_decode_packets, which finds the separators of every line 64 characters
+// at a time with SSE2 or NEON when available, see APRS_ROUTER_ENABLE_SIMD.
+//
+// The packets are stored as offsets into the buffer, one array per field. Packet i is read back as a
+// packet view, and routed with the packet view overloads of try_route_packet. The buffer must outlive the table.
+//
+// Example:
+//
+// std::string_view buffer = "N0CALL>APRS,WIDE1-1:data\nN0CALL>APRS,CALL*,WIDE2-1:data\n";
+//
+// packet_table packets;
+// try_decode_packets(buffer, packets);
+//
+// for (size_t i = 0; i < packets.size(); i++)
+// {
+//     packet_view p = packets[i];
+// }
+
+struct packet_table
+{
+    size_t size() const;
+    bool empty() const;
+    packet_view operator[](size_t index) const;
+    void clear();
+
+    std::string_view buffer;
+
+    // Packet fields: N0CALL>APRS,CALL*,WIDE2-1:data
+    //                ~~~~~~ ~~~~ ~~~~~~~~~~~~~ ~~~~
+    //                from   to   path          data
+
+    std::vector<uint32_t> from_begin;
+    std::vector<uint32_t> from_end;
+    std::vector<uint32_t> to_begin;
+    std::vector<uint32_t> to_end;
+    std::vector<uint32_t> data_begin;
+    std::vector<uint32_t> data_end;
+    std::vector<uint32_t> path_begin; // index of the first path address of the packet in the address arrays
+    std::vector<uint32_t> path_size;
+
+    // Path addresses of all the packets: CALL*,WIDE2-1
+    //                                    ~~~~~ ~~~~~~~
+
+    std::vector<uint32_t> address_begin;
+    std::vector<uint32_t> address_end;
+    std::vector<uint8_t> address_used; // 1 if the address is marked as used with '*'
+};
+
+// Fixed capacity packet:
+//
+// An owning packet, with all the fields stored inline in fixed size arrays. A fixed packet holds up to 8 path addresses,
+// see APRS_ROUTER_MAX_PATH_ADDRESSES, and up to 256 characters of data, see APRS_ROUTER_MAX_DATA_LENGTH.
+//
+// Unlike packet, a fixed packet never allocates, and can be decoded, copied and routed without using the heap.
+// Packets which do not fit the capacities fail to decode.
+//
+// Example:
+//
+// fixed_packet p;
+// try_decode_packet("N0CALL>APRS,WIDE1-1:data", p);
+//
+// fixed_routing_result result;
+// try_route_packet(p, digi, result);
+
+struct fixed_packet
+{
+    static constexpr size_t address_max_size = APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address_text_max;
+    static constexpr size_t path_address_max_size = APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE routed_address_text_max; // fits a routed address
+    static constexpr size_t path_max_size = APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE path_addresses_max;
+    static constexpr size_t data_max_size = APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE packet_data_max;
+
+    packet_view view() const;
+    bool try_assign(const packet_view& packet);
+    void clear();
+
+    std::array<char, address_max_size> from = {};
+    size_t from_size = 0;
+    std::array<char, address_max_size> to = {};
+    size_t to_size = 0;
+    std::array<std::array<char, path_address_max_size>, path_max_size> path = {};
+    std::array<size_t, path_max_size> path_address_sizes = {};
+    size_t path_size = 0;
+    std::array<char, data_max_size> data = {};
+    size_t data_size = 0;
+};
+
 // Routing options:
 //
 // ----------
@@ -436,11 +729,12 @@ enum class routing_option : int
 
 struct router_settings
 {
-    std::string address;
-    std::vector<std::string> explicit_addresses;
-    std::vector<std::string> n_N_addresses;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t address;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t> explicit_addresses;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t> n_N_addresses;
     routing_option options = routing_option::none;
     bool enable_diagnostics = false;
+    size_t cache_size = 0; // number of cached routing decisions, see routing_cache, 0 disables the cache
 };
 
 enum class routing_state
@@ -494,7 +788,7 @@ struct routing_diagnostic
     size_t start = 0; // Address index within the packet string
     size_t end = 0;   // Address index within the packet string
     routing_action type = routing_action::none;
-    std::array<char, 15> address = {};
+    std::array<char, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE routed_address_text_max> address = {};
     size_t address_size = 0;
     enum message_type message_type = message_type::none;
 };
@@ -511,14 +805,61 @@ struct routing_diagnostic_display
     std::vector<routing_diagnostic_display_entry> entries;
 };
 
+// A routing result owns its packets and diagnostics, and can be moved, ex: into a queue, without copying them.
+// If APRS_ROUTER_USE_PMR is enabled, a routing result can be constructed with a memory resource,
+// and its packets and diagnostics are then allocated from the memory resource.
+
 struct routing_result
 {
+#if APRS_ROUTER_USE_PMR
+    routing_result() = default;
+    explicit routing_result(std::pmr::memory_resource* resource);
+#endif
+
     bool routed = false;
     bool success = false;
     APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet original_packet;
     APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet routed_packet;
     routing_state state;
-    std::vector<routing_diagnostic> actions;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<routing_diagnostic> actions;
+};
+
+// Routing result of a fixed capacity packet, routing into it never allocates.
+// The routing diagnostics are not recorded, use the iterator overloads of try_route_packet to collect them.
+
+struct fixed_routing_result
+{
+    bool routed = false;
+    bool success = false;
+    fixed_packet original_packet;
+    fixed_packet routed_packet;
+    routing_state state = routing_state::not_routed;
+};
+
+// Routed packet segments:
+//
+// A routed packet, split into a newly rendered header and the unchanged packet data.
+// The data is a view into the original packet string, and is never copied.
+//
+// N0CALL>APRS,DIGI,WIDE1*,WIDE2-2:data
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~
+// header                           data
+//
+// The segments can be written using scatter/gather I/O, ex: writev, without first
+// concatenating the packet string.
+
+struct routed_packet_segments
+{
+    // FROM> and TO: plus ,ADDRESS for every routed path address, 150 for the default capacities
+    static constexpr size_t header_max_size = 2 * (APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address_text_max + 1) + APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE path_addresses_max * (APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE routed_address_text_max + 1);
+
+    std::string_view header_view() const;
+    std::array<std::string_view, 2> segments() const;
+    size_t size() const;
+
+    std::array<char, header_max_size> header = {};
+    size_t header_size = 0;
+    std::string_view data;
 };
 
 APRS_ROUTER_NAMESPACE_END
@@ -539,6 +880,7 @@ bool operator==(const packet& lhs, const packet& rhs);
 bool operator!=(const packet& lhs, const packet& rhs);
 size_t hash(const packet& p);
 std::string to_string(const packet& p);
+size_t format_packet_to(const packet& p, char* out, size_t capacity);
 bool try_decode_packet(std::string_view packet_string, packet& result);
 
 #endif
@@ -547,7 +889,35 @@ APRS_ROUTER_PACKET_NAMESPACE_END
 
 APRS_ROUTER_NAMESPACE_BEGIN
 
+struct router_config;
+struct route_scratch;
 struct route_state;
+struct router;
+struct router_set;
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+struct reloadable_router;
+#endif
+
+bool operator==(const packet_view& lhs, const packet_view& rhs);
+bool operator!=(const packet_view& lhs, const packet_view& rhs);
+std::string to_string(const packet_view& p);
+size_t format_packet_to(const packet_view& p, char* out, size_t capacity);
+size_t format_packet_to(const routing_result& result, char* out, size_t capacity);
+size_t format_packet_to(const route_scratch& state, std::string_view data, char* out, size_t capacity);
+bool try_format_packet_segments(const route_scratch& state, std::string_view data, routed_packet_segments& result);
+bool try_replay_routing_actions(const routing_result& routing_result, char* out, size_t capacity, size_t& size);
+bool try_decode_packet(std::string_view packet_string, packet_view& result);
+bool try_decode_packets(std::string_view buffer, packet_table& result);
+bool operator==(const fixed_packet& lhs, const fixed_packet& rhs);
+bool operator!=(const fixed_packet& lhs, const fixed_packet& rhs);
+std::string to_string(const fixed_packet& p);
+size_t format_packet_to(const fixed_packet& p, char* out, size_t capacity);
+bool try_decode_packet(std::string_view packet_string, fixed_packet& result);
+
+template<class OutputIterator>
+OutputIterator format_packet_to(const packet_view& p, OutputIterator out);
+template<class OutputIterator>
+OutputIterator format_packet_to(const routing_result& result, OutputIterator out);
 
 routing_option operator|(routing_option lhs, routing_option rhs);
 bool try_parse_routing_option(std::string_view str, routing_option& result);
@@ -559,10 +929,25 @@ std::string to_string(message_type type);
 routing_diagnostic_display format(const routing_result& result);
 
 template<class InputIterator1, class InputIterator2>
-void init_router(std::string_view router_address, InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, routing_option options, route_state& state);
+constexpr void init_router(std::string_view router_address, InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, routing_option options, router_config& config);
+template<class InputIterator1, class InputIterator2>
+constexpr bool try_init_router(std::string_view router_address, InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, routing_option options, router_config& config);
+void init_router(const router_settings& settings, struct router& router);
 
 bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, const router_settings& settings, routing_result& result);
-bool try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, const std::vector<std::string>& original_packet_path, const router_settings& settings, std::vector<std::string>& routed_packet_path, enum routing_state& routing_state, std::vector<routing_diagnostic>& routing_actions);
+bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct router& router, routing_result& result);
+bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, const struct router& router, route_scratch& scratch, routing_result& result);
+bool try_route_packet(const fixed_packet& packet, struct router& router, fixed_routing_result& result);
+bool try_route_packet(const fixed_packet& packet, const struct router& router, route_scratch& scratch, fixed_routing_result& result);
+void init_router_set(const std::vector<router_settings>& settings, struct router_set& set);
+bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct router_set& set, std::vector<routing_result>& results);
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+void reload_router(const router_settings& settings, struct reloadable_router& router);
+bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct reloadable_router& router, route_scratch& scratch, routing_result& result);
+#endif
+template<routing_option Options>
+bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct router& router, routing_result& result);
+bool try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t>& original_packet_path, const router_settings& settings, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t>& routed_packet_path, enum routing_state& routing_state, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<routing_diagnostic>& routing_actions);
 
 template<class InputIterator, class OutputIterator1, class OutputIterator2>
 std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator1 routed_packet_path_out, enum routing_state& routing_state, OutputIterator2 routing_actions_out);
@@ -579,12 +964,22 @@ std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_pa
 template<class InputIterator, class OutputIterator1, class OutputIterator2, class OutputIterator3>
 std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, route_state& state);
 
+template<class InputIterator, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& scratch);
+
 template<class InputIterator, class OutputIterator1, class OutputIterator2>
 std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state);
 
 template<class InputIterator1, class InputIterator2, class InputIterator3, class OutputIterator1, class OutputIterator2>
 std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, std::string_view router_address, InputIterator2 router_explicit_addresses_begin, InputIterator2 router_explicit_addresses_end, InputIterator3 router_n_N_addresses_begin, InputIterator3 router_n_N_addresses_end, routing_option options, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state);
 
+template<class OutputIterator1, class OutputIterator2>
+std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(const packet_view& packet, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state);
+bool try_route_packet(const packet_view& packet, routed_packet_segments& result, enum routing_state& routing_state, route_state& state);
+
+template<class InputIterator, class OutputIterator1, class OutputIterator2, class OutputIterator3, class OutputIterator4>
+std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, OutputIterator4, size_t> try_route_packets(InputIterator packets_begin, InputIterator packets_end, OutputIterator1 routed_packet_paths_out, OutputIterator2 routed_packet_paths_address_sizes_out, OutputIterator3 routed_packet_path_sizes_out, OutputIterator4 routing_states_out, route_state& state);
+
 APRS_ROUTER_NAMESPACE_END
 
 // **************************************************************** //
@@ -599,7 +994,7 @@ APRS_ROUTER_NAMESPACE_BEGIN
 
 APRS_ROUTER_DETAIL_NAMESPACE_BEGIN
 
-enum class q_construct
+enum class q_construct : uint8_t
 {
     none,
     qAC, // Server: Verified login via bidirectional port.
@@ -614,7 +1009,7 @@ enum class q_construct
     qAI  // Client: Trace packet.
 };
 
-enum class address_kind
+enum class address_kind : uint8_t
 {
     other,
     trace,     // TRACE
@@ -635,17 +1030,25 @@ enum class address_kind
 
 struct address
 {
-    std::array<char, 10> text = {};
+    std::array<char, address_text_max> text = {};
     size_t text_size = 0;
-    int n = 0; // the n component of a n_N address, ex: WIDE1-2, n=1
-    int N = 0; // the N component of a n_N address, ex: WIDE1-2, N=2
-    int ssid = 0; // the ssid component of an address, ex: CALL-1, ssid=1
+    int8_t n = 0; // the n component of a n_N address, ex: WIDE1-2, n=1
+    int8_t N = 0; // the N component of a n_N address, ex: WIDE1-2, N=2
+    int8_t ssid = 0; // the ssid component of an address, ex: CALL-1, ssid=1
     bool mark = false; // whether the address is marked as used, ex: 'CALL*' used, 'CALL' unused
     address_kind kind = address_kind::other;
     q_construct q = q_construct::none;
-    size_t index = 0;  // index inside the packet path
-    size_t offset = 0; // string offset within the packet
-    size_t length = 0; // the string length of the address
+    uint16_t index = 0;  // index inside the packet path
+    uint16_t length = 0; // the string length of the address
+    uint32_t offset = 0; // string offset within the packet, the packet header is limited to 4 GiB, see try_init_packet_path
+};
+
+// A routed path address, produced by applying routing actions to an original path
+// The text references either an original path address, or an address stored in a routing action
+struct routed_address_slot
+{
+    std::string_view text;
+    size_t marks = 0; // number of '*' marks appended to the text
 };
 
 APRS_ROUTER_NAMESPACE_END
@@ -671,156 +1074,583 @@ struct discard_output_iterator
     discard_output_iterator operator++(int) { return *this; }
 };
 
+// Open addressed hash table of packed address keys, used to look up the router's addresses.
+//
+// Every bucket holds a key, and the lowest router address index with that key.
+// Router addresses with the same key are chained in ascending index order using 'next'.
+// Router addresses without a key (zero) are listed in 'unpacked' and compared one by one.
+template <size_t Size>
+struct address_key_table
+{
+    static constexpr size_t get_buckets_size()
+    {
+        // At most half of the buckets are used, keeping the probe sequences short
+        size_t buckets_size = 2;
+        while (buckets_size < Size * 2)
+        {
+            buckets_size *= 2;
+        }
+        return buckets_size;
+    }
+
+    static constexpr size_t buckets_size = get_buckets_size();
+
+    std::array<uint64_t, buckets_size> bucket_keys = {};
+    std::array<size_t, buckets_size> bucket_first = {};
+    std::array<size_t, buckets_size> bucket_last = {};
+    std::array<size_t, Size> next = {};
+    std::array<size_t, Size> unpacked = {};
+    size_t unpacked_size = 0;
+};
+
+// Quick reject filter over the raw packet path, built from the router's addresses.
+//
+// Records the first two characters of every router address (ex: "WI" for WIDE1-1),
+// addresses one character long only record their first character.
+// A packet whose path has no address starting with a recorded prefix cannot be routed by us.
+struct address_prefilter
+{
+    std::array<uint64_t, 4> first_chars = {}; // bitmap of the first character of single character router addresses
+    std::array<uint64_t, 8> prefixes = {};    // hashed bitmap of the first two characters of the other router addresses
+    bool enabled = false;
+};
+
+// The path addresses of a packet parsed with every address parser.
+// The routers of a router_set share the parses of a packet, every router picks the parse matching its addresses.
+struct packet_address_parses
+{
+    std::array<address, path_addresses_max> explicit_addresses; // parsed with try_parse_address_with_ssid
+    std::array<address, path_addresses_max> n_N_addresses;      // parsed with try_parse_n_N_address
+    std::array<address, path_addresses_max> addresses;          // parsed with try_parse_address
+    std::array<bool, path_addresses_max> explicit_address_results = {};
+    std::array<bool, path_addresses_max> n_N_address_results = {};
+    std::array<bool, path_addresses_max> address_results = {};
+    size_t size = 0;
+};
+
+// Keywords recognized in packet addresses, the address kinds and the q constructs.
+//
+// The keywords are looked up in a perfect hash table, hashed by their length, first and last character.
+// Every keyword has a distinct hash, an address is classified with one table load and one compare.
+struct address_keyword
+{
+    std::string_view text;
+    address_kind kind = address_kind::other;
+    q_construct q = q_construct::none;
+};
+
+inline constexpr std::array<address_keyword, 23> address_keywords = {{
+    { "ECHO", address_kind::echo, q_construct::none },
+    { "GATE", address_kind::gate, q_construct::none },
+    { "IGATECALL", address_kind::igatecall, q_construct::none },
+    { "NOGATE", address_kind::nogate, q_construct::none },
+    { "OPNTRC", address_kind::opntrc, q_construct::none },
+    { "OPNTRK", address_kind::opntrk, q_construct::none },
+    { "RELAY", address_kind::relay, q_construct::none },
+    { "RFONLY", address_kind::rfonly, q_construct::none },
+    { "TEMP", address_kind::temp, q_construct::none },
+    { "TRACE", address_kind::trace, q_construct::none },
+    { "TCPIP", address_kind::tcpip, q_construct::none },
+    { "TCPXX", address_kind::tcpxx, q_construct::none },
+    { "WIDE", address_kind::wide, q_construct::none },
+    { "qAC", address_kind::other, q_construct::qAC },
+    { "qAI", address_kind::other, q_construct::qAI },
+    { "qAO", address_kind::other, q_construct::qAO },
+    { "qAR", address_kind::other, q_construct::qAR },
+    { "qAS", address_kind::other, q_construct::qAS },
+    { "qAU", address_kind::other, q_construct::qAU },
+    { "qAX", address_kind::other, q_construct::qAX },
+    { "qAZ", address_kind::other, q_construct::qAZ },
+    { "qAo", address_kind::other, q_construct::qAo },
+    { "qAr", address_kind::other, q_construct::qAr }
+}};
+
+inline constexpr size_t address_keyword_slots_bits = 6; // 64 slots, the table fits in one cache line
+
+constexpr size_t get_address_keyword_slot(std::string_view text, uint64_t multiplier)
+{
+    assert(!text.empty());
+
+    uint64_t key = (static_cast<uint64_t>(text.size()) << 16) |
+        (static_cast<uint64_t>(static_cast<unsigned char>(text.front())) << 8) |
+        static_cast<uint64_t>(static_cast<unsigned char>(text.back()));
+
+    return static_cast<size_t>((key * multiplier) >> (64 - address_keyword_slots_bits));
+}
+
+constexpr uint64_t find_address_keyword_multiplier()
+{
+    // Search for a multiplier which maps every keyword to a distinct slot,
+    // the candidates are odd numbers from the splitmix64 sequence
+    // Returns zero if none is found
+
+    for (uint64_t i = 1; i <= 1000; i++)
+    {
+        uint64_t multiplier = i * 0x9E3779B97F4A7C15ull;
+        multiplier = (multiplier ^ (multiplier >> 30)) * 0xBF58476D1CE4E5B9ull;
+        multiplier = (multiplier ^ (multiplier >> 27)) * 0x94D049BB133111EBull;
+        multiplier = (multiplier ^ (multiplier >> 31)) | 1;
+
+        std::array<bool, size_t(1) << address_keyword_slots_bits> used = {};
+        bool perfect = true;
+
+        for (const auto& keyword : address_keywords)
+        {
+            size_t slot = get_address_keyword_slot(keyword.text, multiplier);
+            if (used[slot])
+            {
+                perfect = false;
+                break;
+            }
+            used[slot] = true;
+        }
+
+        if (perfect)
+        {
+            return multiplier;
+        }
+    }
+
+    return 0;
+}
+
+inline constexpr uint64_t address_keyword_multiplier = find_address_keyword_multiplier();
+
+static_assert(address_keyword_multiplier != 0, "no perfect hash found for the address keywords");
+
+constexpr std::array<uint8_t, size_t(1) << address_keyword_slots_bits> make_address_keyword_slots()
+{
+    // Every slot holds the index of its keyword plus one, or zero if the slot is empty
+
+    std::array<uint8_t, size_t(1) << address_keyword_slots_bits> slots = {};
+
+    for (size_t i = 0; i < address_keywords.size(); i++)
+    {
+        slots[get_address_keyword_slot(address_keywords[i].text, address_keyword_multiplier)] = static_cast<uint8_t>(i + 1);
+    }
+
+    return slots;
+}
+
+inline constexpr std::array<uint8_t, size_t(1) << address_keyword_slots_bits> address_keyword_slots = make_address_keyword_slots();
+
+// Keys of the router's addresses, either searched all at once, or looked up in a hash table.
+#if APRS_ROUTER_ENABLE_ADDRESS_TABLE
+template <size_t Size> using address_keys = address_key_table<Size>;
+#else
+template <size_t Size> using address_keys = std::array<uint64_t, Size>;
+#endif
+
+// Routing options policies, used to read the routing options while routing a packet.
+// runtime_routing_options reads the options from the router_config,
+// static_routing_options fixes the options at compile time, which lets the compiler drop the option checks.
+struct runtime_routing_options
+{
+};
+
+template <routing_option Value>
+struct static_routing_options
+{
+    static constexpr routing_option value = Value;
+};
+
 APRS_ROUTER_NAMESPACE_END
 
 APRS_ROUTER_NAMESPACE_END
 
 APRS_ROUTER_NAMESPACE_BEGIN
 
-struct route_state
+// Route state:
+//
+// The state is split in two parts, an immutable router_config, and a small per packet route_scratch.
+//
+// router_config: the router's address, the explicit and n-N addresses, and the keys and prefilter
+//                built from them by init_router. It is only read while routing packets,
+//                and can be shared by any number of threads.
+//
+// route_scratch: the addresses of the packet being routed, overwritten by every routed packet.
+//                Every thread routing packets needs its own route_scratch.
+//
+// Both are aligned to a cache line, so that a thread writing its route_scratch does not
+// invalidate the cache line of a shared router_config, or of another thread's route_scratch.
+//
+// route_state combines the two, for single threaded routing.
+
+struct alignas(64) router_config
 {
     static constexpr size_t router_addresses_max = APRS_ROUTER_MAX_ROUTER_ADDRESSES;
 
-    std::string_view packet_from_address;
-    std::string_view packet_to_address;
-    std::array<std::array<char, 10>, 8> packet_path = {};
-    size_t packet_path_size = 0;
-    std::array<size_t, 8> packet_path_address_sizes = {};
-    size_t original_packet_path_size = 0;
     std::string_view router_address_string;
     routing_option options = routing_option::none;
-    std::array<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address, 8> packet_addresses;
-    size_t packet_addresses_size = 0;
-    std::optional<size_t> maybe_last_used_address_index;
-    std::optional<size_t> maybe_router_address_index;
     APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address router_address;
+    uint64_t router_address_key = 0; // packed key of the router address, see get_address_key
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address_keys<router_addresses_max> router_explicit_address_keys = {}; // packed keys of the explicit addresses, searched before router_explicit_addresses
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address_keys<router_addresses_max> router_n_N_address_keys = {}; // packed keys of the n-N addresses, see get_n_N_address_key
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address_prefilter router_prefilter; // rejects packets which do not mention any router address
     std::array<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address, router_addresses_max> router_n_N_addresses = {};
     size_t router_n_N_addresses_size = 0;
     std::array<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address, router_addresses_max> router_explicit_addresses = {};
     size_t router_explicit_addresses_size = 0;
+    bool initialized = false;
+};
+
+struct alignas(64) route_scratch
+{
+    std::string_view packet_from_address;
+    std::string_view packet_to_address;
+    std::array<std::array<char, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address_text_max>, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE path_addresses_max> packet_path = {};
+    size_t packet_path_size = 0;
+    std::array<size_t, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE path_addresses_max> packet_path_address_sizes = {};
+    size_t original_packet_path_size = 0;
+    std::array<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE address, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE path_addresses_max> packet_addresses;
+    size_t packet_addresses_size = 0;
+    std::optional<size_t> maybe_last_used_address_index;
+    std::optional<size_t> maybe_router_address_index;
     bool is_path_based_routing = false;
     size_t unused_address_index = 0;
-    bool initialized = false;
 };
 
-APRS_ROUTER_NAMESPACE_END
+struct route_state : router_config, route_scratch
+{
+};
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// PRIVATE FORWARD DECLARATIONS                                     //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
+// Routing cache:
+//
+// An optional cache of routing decisions, keyed by the packet header: the 'from', 'to' and 'path' addresses.
+// Beacons from the same station are routed with an identical header every few minutes,
+// a cached decision is returned without parsing the packet again.
+//
+// Routing cache: N0CALL>APRS,WIDE1-1,WIDE2-1 -> routed, N0CALL>APRS,DIGI*,WIDE1*,WIDE2-1
+//                N0CALL>APRS,CALLA,CALLB     -> not_routed
+//
+// The cache is enabled with router_settings.cache_size, and is only used if diagnostics are disabled.
+// Entries are grouped in sets of routing_cache_ways, the entries of a set are replaced using the CLOCK
+// (second chance) algorithm. The number of sets is rounded up to a power of two.
+//
+// The cache is cleared when the router is recompiled with init_router.
 
-APRS_ROUTER_NAMESPACE_BEGIN
+inline constexpr size_t routing_cache_ways = 4;
 
-APRS_ROUTER_DETAIL_NAMESPACE_BEGIN
+struct routing_cache_entry
+{
+    uint64_t hash = 0;
+    std::string from;
+    std::string to;
+    std::vector<std::string> path;
+    std::vector<std::string> routed_path;
+    routing_state state = routing_state::not_routed;
+    bool valid = false;
+    bool referenced = false; // set on every hit, entries which have not been referenced are replaced first
+};
 
-template <class OutputIterator> std::pair<OutputIterator, bool> try_explicit_or_n_N_route(route_state& state, bool enable_diagnostics, routing_state& result, OutputIterator routing_actions_out);
-bool is_explicit_routing(bool is_routing_self, std::optional<size_t> maybe_router_address_index, routing_option options);
-bool is_explicit_routing(bool is_routing_self, const route_state& state);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_explicit_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_explicit_basic_route(route_state& state, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_preempt_explicit_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_preempt_transform_explicit_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_n_N_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_n_N_route_no_trap(route_state& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_complete_n_N_route(route_state& state, address& n_N_address, bool substitute_zero_hops, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_insert_n_N_route(route_state& state, size_t& packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_trap_n_N_route(route_state& state, address& packet_n_N_address, const address& router_n_N_address, bool enable_diagnostics, OutputIterator routing_actions_out);
+struct routing_cache
+{
+    std::vector<routing_cache_entry> entries;
+    std::vector<size_t> hands; // the CLOCK hand of every set
+    size_t hits = 0;
+    size_t misses = 0;
+};
 
-bool try_route_packet_by_index(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result);
-bool try_route_packet_by_start_end(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result);
+// Router:
+//
+// A router compiles a router_settings once, parsing the router's address,
+// the explicit addresses and the n-N addresses, and caches the result in its route_state.
+// The same router can then be used to route any number of packets, without re-parsing the settings.
+//
+// Example:
+//
+// router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" } });
+//
+// routing_result result;
+// try_route_packet(packet, digi, result);
+//
+// The settings should not be modified directly after the router has been compiled,
+// use init_router to recompile the router with new settings.
+//
+// The route_state is also used as scratch space for every routed packet,
+// a router instance should not be shared between threads, unless every thread
+// routes packets with its own route_scratch:
+//
+// route_scratch scratch;
+// try_route_packet(packet, digi, scratch, result);
 
-void init_routing_result(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, routing_result& result);
-template <class OutputIterator> std::pair<OutputIterator, bool> create_routing_ended_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out);
-bool create_routing_ended_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions);
-template <class OutputIterator> std::pair<OutputIterator, bool> create_routed_by_us_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out);
-bool create_routed_by_us_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions);
-template <class OutputIterator1, class OutputIterator2, class OutputIterator3> std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> create_routed_routing(route_state& state, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out);
-bool create_routed_routing(route_state& state, bool enable_diagnostics, std::array<std::array<char, 15>, 8>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, 8>& routed_packet_path_address_sizes, internal_vector_t<routing_diagnostic>& routing_actions);
-bool create_routed_routing(route_state& state, bool enable_diagnostics, std::array<std::array<char, 15>, 8>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, 8>& routed_packet_path_address_sizes);
+struct router
+{
+    router() = default;
+    router(const router_settings& settings);
+    router(const router& other);
+    router& operator=(const router& other);
+
+    router_settings settings;
+    route_state state;
+    routing_cache cache;
+};
+
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+
+// Reloadable router:
+//
+// A router which can be reconfigured while other threads are routing packets through it.
+//
+// The new router is compiled by reload_router before it is published, away from the routing path.
+// It is then published by swapping the router pointer, packets being routed finish with the
+// previous router, and packets routed after the swap use the new router.
+//
+// Routing never takes a lock. Every routed packet is counted in one of two reader counts,
+// selected by the current epoch. After the swap, reload_router advances the epoch twice,
+// and waits for the readers counted in each of the previous epochs to finish, only then
+// the previous router is deleted. Reloads are serialized, and only block other reloads.
+//
+// Example:
+//
+// reloadable_router digi(router_settings{ "DIGI", {}, { "WIDE1" } });
+//
+// // routing threads
+// route_scratch scratch;
+// try_route_packet(packet, digi, scratch, result);
+//
+// // configuration thread
+// reload_router(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" } }, digi);
+
+struct reloadable_router
+{
+    reloadable_router();
+    reloadable_router(const router_settings& settings);
+    reloadable_router(const reloadable_router& other) = delete;
+    reloadable_router& operator=(const reloadable_router& other) = delete;
+    ~reloadable_router();
+
+    alignas(64) std::atomic<const router*> current { nullptr };
+    std::atomic<size_t> epoch { 0 };
+    std::atomic<bool> reloading { false };
+    alignas(64) std::atomic<size_t> readers[2] = { 0, 0 }; // number of packets being routed in each epoch, kept away from the router pointer
+};
+
+#endif // APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+
+// Router set:
+//
+// A set of routers routing the same packets, ex: several virtual digipeaters sharing one RF channel,
+// each with its own address and aliases.
+//
+// A packet is copied, and its path addresses are parsed only once, the parses are shared by all the routers.
+// The routers are found using an inverted index, from the first two characters of every router address
+// to the routers using that address. Routers which cannot match any of the packet's addresses are not evaluated,
+// and their result is not_routed, the same as if the packet was routed with each router separately.
+//
+// Example:
+//
+// router_set digis({ router_settings{ "DIGI1", {}, { "WIDE1" } }, router_settings{ "DIGI2", {}, { "WIDE2" } } });
+//
+// std::vector<routing_result> results;
+// try_route_packet(packet, digis, results);
+//
+// results[0] is the routing result of DIGI1, and results[1] the routing result of DIGI2
+//
+// The router set holds the scratch space for the routed packet, and should not be shared between threads.
+
+struct router_set
+{
+    router_set() = default;
+    router_set(const std::vector<router_settings>& settings);
+
+    std::vector<router> routers;
+    std::vector<std::pair<uint64_t, size_t>> index; // address prefix keys and router ids, sorted by key
+    std::vector<size_t> unindexed;                  // routers evaluated for every packet, ex: routers with diagnostics enabled
+    std::vector<bool> candidates;                   // routers which could route the current packet
+    route_scratch scratch;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE packet_address_parses parses;
+};
+
+APRS_ROUTER_NAMESPACE_END
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// PRIVATE FORWARD DECLARATIONS                                     //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_NAMESPACE_BEGIN
+
+APRS_ROUTER_DETAIL_NAMESPACE_BEGIN
+
+routing_option get_routing_options(runtime_routing_options, const router_config& config);
+template <routing_option Value> constexpr routing_option get_routing_options(static_routing_options<Value>, const router_config& config);
+constexpr bool may_have_routing_option(runtime_routing_options, routing_option flag);
+template <routing_option Value> constexpr bool may_have_routing_option(static_routing_options<Value>, routing_option flag);
+template <class Options, class InputIterator1, class OutputIterator1, class OutputIterator2, class OutputIterator3> std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet_with_options(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& state);
+template <class Options, class InputIterator, class OutputIterator1, class OutputIterator2, class OutputIterator3, class OutputIterator4> std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, OutputIterator4, size_t> try_route_packets_with_options(InputIterator packets_begin, InputIterator packets_end, OutputIterator1 routed_packet_paths_out, OutputIterator2 routed_packet_paths_address_sizes_out, OutputIterator3 routed_packet_path_sizes_out, OutputIterator4 routing_states_out, const router_config& config, route_scratch& state);
+template <class InputIterator> void prefetch_packet_addresses(std::string_view packet_from_address, InputIterator packet_path_begin, InputIterator packet_path_end);
+template <class InputIterator> bool try_init_packet_path(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, route_scratch& state);
+template <class Options, class OutputIterator1, class OutputIterator2, class OutputIterator3> std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet_path_with_options(bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& state, const packet_address_parses* parses);
+template <class Options, class OutputIterator1, class OutputIterator2, class OutputIterator3> std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_general_packet_path_with_options(bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& state, const packet_address_parses* parses);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_explicit_or_n_N_route(const router_config& config, route_scratch& state, bool enable_diagnostics, routing_state& result, OutputIterator routing_actions_out);
+bool is_explicit_routing(bool is_routing_self, std::optional<size_t> maybe_router_address_index, routing_option options);
+template <class Options> bool is_explicit_routing(bool is_routing_self, const router_config& config, const route_scratch& state);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_explicit_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_explicit_basic_route(const router_config& config, route_scratch& state, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_preempt_explicit_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_preempt_transform_explicit_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_n_N_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_n_N_route_no_trap(const router_config& config, route_scratch& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> std::pair<OutputIterator, bool> try_complete_n_N_route(route_scratch& state, address& n_N_address, bool substitute_zero_hops, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_insert_n_N_route(const router_config& config, route_scratch& state, size_t& packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options, class OutputIterator> std::pair<OutputIterator, bool> try_trap_n_N_route(const router_config& config, route_scratch& state, address& packet_n_N_address, const address& router_n_N_address, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class Options> bool try_canonical_n_N_route(const router_config& config, route_scratch& state);
+
+bool try_route_packet_by_index(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result);
+template <class InputIterator1, class InputIterator2, size_t Size> bool try_apply_routing_actions(InputIterator1 original_path_begin, InputIterator1 original_path_end, InputIterator2 actions_begin, InputIterator2 actions_end, std::array<routed_address_slot, Size>& slots, size_t& slots_size);
+bool try_route_packet_by_start_end(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result);
+
+void init_routing_cache(size_t size, routing_cache& cache);
+uint64_t get_routing_cache_hash(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet);
+bool equal_routing_cache_header(const routing_cache_entry& entry, const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet);
+bool try_find_routing_cache_entry(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, uint64_t hash, routing_result& result, routing_cache& cache);
+void insert_routing_cache_entry(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, uint64_t hash, const routing_result& result, routing_cache& cache);
+
+uint64_t get_address_prefix_key(unsigned char c0, unsigned char c1);
+uint64_t get_address_prefix_key(const address& address);
+void add_router_set_index(const router_config& config, size_t router_id, router_set& set);
+void find_router_set_candidates(const route_scratch& state, router_set& set);
+
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+size_t enter_reloadable_router(reloadable_router& router);
+void leave_reloadable_router(size_t epoch, reloadable_router& router);
+void wait_for_reloadable_router_readers(reloadable_router& router);
+#endif
+
+void init_routing_result(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, routing_result& result);
+template <class OutputIterator> std::pair<OutputIterator, bool> create_routing_ended_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out);
+bool create_routing_ended_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions);
+template <class OutputIterator> std::pair<OutputIterator, bool> create_routed_by_us_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out);
+bool create_routed_by_us_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions);
+template <class OutputIterator1, class OutputIterator2, class OutputIterator3> std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> create_routed_routing(route_scratch& state, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out);
+bool create_routed_routing(route_scratch& state, bool enable_diagnostics, std::array<std::array<char, routed_address_text_max>, path_addresses_max>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, path_addresses_max>& routed_packet_path_address_sizes, internal_vector_t<routing_diagnostic>& routing_actions);
+bool create_routed_routing(route_scratch& state, bool enable_diagnostics, std::array<std::array<char, routed_address_text_max>, path_addresses_max>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, path_addresses_max>& routed_packet_path_address_sizes);
 
 template <class OutputIterator> OutputIterator push_routing_ended_diagnostic(const address& address, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator push_routed_by_us_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator push_address_set_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator push_address_unset_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator push_address_replaced_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, std::string_view new_address, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> OutputIterator push_routed_by_us_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> OutputIterator push_address_set_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> OutputIterator push_address_unset_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> OutputIterator push_address_replaced_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, std::string_view new_address, bool enable_diagnostics, OutputIterator routing_actions_out);
 template <class OutputIterator> OutputIterator push_address_decremented_diagnostic(address& address, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator push_address_inserted_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t insert_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator push_address_removed_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t remove_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> OutputIterator create_address_move_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end);
-template <class OutputIterator> OutputIterator create_truncate_address_range_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end);
+template <class OutputIterator> OutputIterator push_address_inserted_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t insert_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> OutputIterator push_address_removed_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t remove_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> OutputIterator create_address_move_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end);
+template <class OutputIterator> OutputIterator create_truncate_address_range_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end);
 
 std::string create_display_name_diagnostic(const routing_diagnostic_display_entry& line);
 routing_diagnostic_display_entry create_diagnostic_print_line(const routing_diagnostic& diag, const APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& routed_packet);
 
 bool operator==(const address& lhs, const address& rhs);
 bool operator!=(const address& lhs, const address& rhs);
-void to_string(const struct address& address, std::array<char, 15>& result, size_t& result_size);
+void to_string(const struct address& address, std::array<char, routed_address_text_max>& result, size_t& result_size);
 internal_string_t<char> to_string(const struct address& address);
 bool equal_address_text(const struct address& lhs, const struct address& rhs);
 bool equal_addresses_ignore_mark(const struct address& lhs, const struct address& rhs);
+constexpr uint64_t get_address_key(const struct address& address);
+constexpr uint64_t get_n_N_address_key(const struct address& address);
+bool equal_addresses_ignore_mark(const struct address& lhs, uint64_t lhs_key, const struct address& rhs, uint64_t rhs_key);
 address canonicalize(const struct address& address);
-q_construct parse_q_construct(std::string_view input);
-address_kind parse_address_kind(std::string_view text);
-bool try_parse_address(std::string_view address_string, address& result);
+constexpr address_keyword find_address_keyword(std::string_view text);
+constexpr q_construct parse_q_construct(std::string_view input);
+constexpr address_kind parse_address_kind(std::string_view text);
+constexpr bool try_parse_address(std::string_view address_string, address& result);
 bool try_parse_address(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid);
-bool try_parse_address(std::string_view address, std::array<char, 10>& address_no_ssid, size_t& address_no_ssid_size, int& ssid);
-bool try_parse_n_N_address(std::string_view address_string, struct address& address);
-bool try_parse_n_N_address(std::string_view address_string, std::array<char, 10>& address_text, size_t& address_text_size, int& n, int& N, bool& mark, size_t& length, address_kind& kind);
-bool try_parse_address_with_ssid(std::string_view address_string, struct address& address);
+constexpr bool try_parse_address(std::string_view address, std::array<char, address_text_max>& address_no_ssid, size_t& address_no_ssid_size, int& ssid);
+constexpr bool try_parse_n_N_address(std::string_view address_string, struct address& address);
+constexpr bool try_parse_n_N_address(std::string_view address_string, std::array<char, address_text_max>& address_text, size_t& address_text_size, int& n, int& N, bool& mark, size_t& length, address_kind& kind);
+constexpr bool try_parse_address_with_ssid(std::string_view address_string, struct address& address);
 bool try_parse_address_with_used_flag(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid);
 bool try_parse_address_with_used_flag(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid, bool& mark);
-bool try_parse_address_with_used_flag(std::string_view address, std::array<char, 10>& address_no_ssid, size_t& address_no_ssid_size, int& ssid);
-bool try_parse_address_with_used_flag(std::string_view address, std::array<char, 10>& address_no_ssid, size_t& address_no_ssid_size, int& ssid, bool& mark);
-bool try_parse_int(std::string_view str, int& result);
-
-void init_addresses(route_state& state);
-template <class InputIterator1, class InputIterator2> void init_router_addresses(InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, route_state& state);
-void unset_all_used_addresses(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count);
-void unset_all_used_addresses(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count, std::optional<size_t> maybe_ignore_index);
-void set_address_as_used(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t index);
-void set_address_as_used(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, address& address);
-void update_addresses_index(std::array<address, 8>& addresses, size_t addresses_size);
-void set_addresses_offset(std::string_view packet_from_address, std::string_view packet_to_address, std::array<address, 8>& addresses, size_t addresses_size);
-void update_addresses_offset(std::array<address, 8>& addresses, size_t addresses_size, size_t initial_offset);
-void update_addresses_offset(std::array<address, 8>& addresses, size_t addresses_size);
-bool try_insert_address(std::array<address, 8>& packet_addresses, size_t& packet_addresses_size, size_t index, std::string_view inserted_address_string);
+constexpr bool try_parse_address_with_used_flag(std::string_view address, std::array<char, address_text_max>& address_no_ssid, size_t& address_no_ssid_size, int& ssid);
+constexpr bool try_parse_address_with_used_flag(std::string_view address, std::array<char, address_text_max>& address_no_ssid, size_t& address_no_ssid_size, int& ssid, bool& mark);
+constexpr bool try_parse_int(std::string_view str, int& result);
+constexpr bool is_digit(char c);
+constexpr bool is_upper(char c);
+
+void init_addresses(const router_config& config, route_scratch& state);
+bool try_parse_packet_address(const router_config& config, std::string_view packet_address_text, struct address& address);
+template <class Options> bool try_init_last_used_address(const router_config& config, route_scratch& state);
+void init_addresses(const router_config& config, const packet_address_parses& parses, route_scratch& state);
+void parse_packet_addresses(const route_scratch& state, packet_address_parses& parses);
+bool try_init_canonical_addresses(const router_config& config, route_scratch& state);
+constexpr void clear_address_prefilter(address_prefilter& prefilter);
+constexpr size_t get_address_prefilter_prefix_index(unsigned char c0, unsigned char c1);
+constexpr void add_address_prefilter(address_prefilter& prefilter, const address& address);
+bool test_address_prefilter(const address_prefilter& prefilter, std::string_view address);
+template <class InputIterator> bool might_route_packet(const router_config& config, std::string_view packet_from_address, std::string_view packet_to_address, InputIterator packet_path_begin, InputIterator packet_path_end);
+template <class InputIterator1, class InputIterator2> constexpr void init_router_addresses(InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, router_config& config);
+void unset_all_used_addresses(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count);
+void unset_all_used_addresses(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count, std::optional<size_t> maybe_ignore_index);
+void set_address_as_used(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t index);
+void set_address_as_used(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, address& address);
+void update_addresses_index(std::array<address, path_addresses_max>& addresses, size_t addresses_size);
+void set_addresses_offset(std::string_view packet_from_address, std::string_view packet_to_address, std::array<address, path_addresses_max>& addresses, size_t addresses_size);
+void update_addresses_offset(std::array<address, path_addresses_max>& addresses, size_t addresses_size, size_t initial_offset);
+void update_addresses_offset(std::array<address, path_addresses_max>& addresses, size_t addresses_size);
+bool try_insert_address(std::array<address, path_addresses_max>& packet_addresses, size_t& packet_addresses_size, size_t index, std::string_view inserted_address_string);
 void replace_address_with_router_address(struct address& address, const struct address& router_address);
-bool try_move_address_to_position(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index);
-bool try_truncate_address_range(std::array<address, 8>& packet_addresses, size_t& packet_addresses_size, size_t from_index, size_t to_index);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_truncate_empty_addresses(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out);
-template <class OutputIterator> std::pair<OutputIterator, bool> try_substitute_complete_n_N_address(route_state& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
+bool try_move_address_to_position(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index);
+bool try_truncate_address_range(std::array<address, path_addresses_max>& packet_addresses, size_t& packet_addresses_size, size_t from_index, size_t to_index);
+template <class OutputIterator> std::pair<OutputIterator, bool> try_truncate_empty_addresses(route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out);
+template <class OutputIterator> std::pair<OutputIterator, bool> try_substitute_complete_n_N_address(const router_config& config, route_scratch& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out);
 bool try_decrement_n_N_address(address& s);
-bool try_decrement_n_N_address(route_state& state, address& s);
-
-template <size_t Size> std::optional<std::pair<size_t, size_t>> find_first_unused_n_N_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_addresses, size_t router_addresses_size, routing_option options);
-template <size_t Size> std::optional<size_t> find_last_used_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, size_t router_n_N_addresses_size, routing_option options);
-template <size_t Size> std::optional<size_t> find_router_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t offset, const address& router_address, const std::array<address, Size>& router_addresses, size_t router_addresses_size);
-template <size_t Size> std::optional<size_t> find_unused_router_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address, const std::array<address, Size>& router_explicit_addresses, size_t router_explicit_addresses_size);
-void find_used_addresses(route_state& state);
-bool has_address(const std::array<address, 8>& addresses, size_t addresses_size, size_t offset, struct address address);
-
-bool is_packet_valid(std::string_view packet_from_address, std::string_view packet_to_address, const std::array<std::array<char, 10>, 8>& packet_path, size_t packet_path_size, const std::array<size_t, 8>& packet_path_address_sizes, size_t original_packet_path_size, routing_option options);
-bool is_packet_valid(const route_state& state);
-bool is_valid_router_address_and_packet(const route_state& state);
+bool try_decrement_n_N_address(route_scratch& state, address& s);
+
+size_t count_trailing_zeros(uint64_t value);
+void find_packet_separators(const char* text, size_t text_size, uint64_t& from_ends, uint64_t& commas, uint64_t& colons);
+bool try_decode_packet_line_from_separators(std::string_view buffer, size_t line_begin, size_t line_end, packet_table& table, size_t& packets_size, size_t& addresses_size);
+bool try_decode_packet_line(std::string_view buffer, size_t line_begin, size_t line_end, packet_view& packet, packet_table& table, size_t& packets_size, size_t& addresses_size);
+void grow_packet_table(size_t packets_size, size_t addresses_size, packet_table& table);
+void resize_packet_table(size_t size, packet_table& table);
+void resize_packet_table_addresses(size_t size, packet_table& table);
+template <size_t Size> uint64_t match_address_keys(uint64_t key, const std::array<uint64_t, Size>& keys, size_t keys_size);
+template <size_t Size> uint64_t find_matching_addresses(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_addresses, const std::array<uint64_t, Size>& router_address_keys, size_t router_addresses_size);
+template <size_t Size> uint64_t find_matching_n_N_addresses(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_n_N_addresses, const std::array<uint64_t, Size>& router_n_N_address_keys, size_t router_n_N_addresses_size);
+template <size_t Size> constexpr void clear_address_keys(std::array<uint64_t, Size>& keys);
+template <size_t Size> constexpr void clear_address_keys(address_key_table<Size>& table);
+template <size_t Size> constexpr void set_address_key(std::array<uint64_t, Size>& keys, size_t index, uint64_t key);
+template <size_t Size> constexpr void set_address_key(address_key_table<Size>& table, size_t index, uint64_t key);
+template <size_t Size> size_t find_address_key(const address_key_table<Size>& table, uint64_t key);
+template <size_t Size> bool has_matching_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_addresses, const std::array<uint64_t, Size>& router_address_keys, size_t router_addresses_size);
+template <size_t Size> bool has_matching_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_addresses, const address_key_table<Size>& router_address_keys, size_t router_addresses_size);
+template <size_t Size> size_t find_next_matching_n_N_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_n_N_addresses, const std::array<uint64_t, Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, size_t offset);
+template <size_t Size> size_t find_next_matching_n_N_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_n_N_addresses, const address_key_table<Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, size_t offset);
+template <size_t Size> std::optional<std::pair<size_t, size_t>> find_first_unused_n_N_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, const address_keys<Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, routing_option options);
+template <size_t Size> std::optional<size_t> find_last_used_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, const address_keys<Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, routing_option options);
+template <size_t Size> std::optional<size_t> find_router_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t offset, const address& router_address, uint64_t router_address_key, const std::array<address, Size>& router_explicit_addresses, const address_keys<Size>& router_explicit_address_keys, size_t router_explicit_addresses_size);
+template <size_t Size> std::optional<size_t> find_unused_router_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address, uint64_t router_address_key, const std::array<address, Size>& router_explicit_addresses, const address_keys<Size>& router_explicit_address_keys, size_t router_explicit_addresses_size);
+template <class Options> void find_used_addresses(const router_config& config, route_scratch& state);
+bool has_address(const std::array<address, path_addresses_max>& addresses, size_t addresses_size, size_t offset, struct address address);
+
+void find_address_characters(const std::array<char, 16>& text, uint32_t& alphanumerics, uint32_t& digits, uint32_t& separators);
+bool is_address_valid(std::string_view address);
+bool is_packet_valid(std::string_view packet_from_address, std::string_view packet_to_address, const std::array<std::array<char, address_text_max>, path_addresses_max>& packet_path, size_t packet_path_size, const std::array<size_t, path_addresses_max>& packet_path_address_sizes, size_t original_packet_path_size, routing_option options);
+template <class Options> bool is_packet_valid(const router_config& config, const route_scratch& state);
+template <class Options> bool is_valid_router_address_and_packet(const router_config& config, const route_scratch& state);
 bool is_packet_from_us(std::string_view packet_from_address, std::string_view router_address);
-bool is_packet_from_us(const route_state& state);
+bool is_packet_from_us(const router_config& config, const route_scratch& state);
 bool is_packet_sent_to_us(std::string_view packet_to_address, std::string_view router_address);
-bool is_packet_sent_to_us(const route_state& state);
-bool has_packet_routing_ended(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index);
-bool has_packet_routing_ended(const route_state& state);
-bool has_packet_been_routed_by_us(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address);
-bool has_packet_been_routed_by_us(route_state& state);
+bool is_packet_sent_to_us(const router_config& config, const route_scratch& state);
+bool has_packet_routing_ended(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index);
+bool has_packet_routing_ended(const route_scratch& state);
+bool has_packet_been_routed_by_us(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address);
+bool has_packet_been_routed_by_us(const router_config& config, route_scratch& state);
+
+void format_routed_path(const route_scratch& state, std::array<std::array<char, routed_address_text_max>, path_addresses_max>& path, std::array<std::string_view, path_addresses_max>& path_views, size_t& path_size);
+template <class InputIterator, class Data> size_t get_packet_string_size(std::string_view from, std::string_view to, InputIterator path_begin, InputIterator path_end, const Data& data);
+template <class InputIterator, class Data, class OutputIterator> OutputIterator format_packet(std::string_view from, std::string_view to, InputIterator path_begin, InputIterator path_end, const Data& data, OutputIterator out);
+template <class InputIterator, class Data> size_t format_packet(std::string_view from, std::string_view to, InputIterator path_begin, InputIterator path_end, const Data& data, char* out, size_t capacity);
 
 template<typename T, size_t Size> void array_erase(std::array<T, Size>& array, size_t& size, size_t index);
 template<typename T, size_t Size> void array_erase_n(std::array<T, Size>& array, size_t& size, size_t start_index, size_t count);
 template<typename T, size_t Size, typename U> void array_insert(std::array<T, Size>& array, size_t& size, size_t index, U&& value);
 template<typename T, size_t Size, typename U> void array_push_back(std::array<T, Size>& array, size_t& size, U&& value);
 template<size_t Extent, size_t Size, class InputIterator> void array_push_back(std::array<std::array<char, Extent>, Size>& array, size_t& size, std::array<size_t, Size>& extents, InputIterator first, InputIterator last);
-template<size_t Size, class InputIterator> void array_assign(std::array<char, Size>& array, size_t& size, InputIterator first, InputIterator last);
+template<size_t Size, class InputIterator> constexpr void array_assign(std::array<char, Size>& array, size_t& size, InputIterator first, InputIterator last);
 
 APRS_ROUTER_NAMESPACE_END
 
@@ -852,7 +1682,7 @@ APRS_ROUTER_PACKET_NAMESPACE_BEGIN
 
 #ifndef APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
 
-APRS_ROUTER_INLINE packet::packet(const std::string& from, const std::string& to, const std::vector<std::string>& path, const std::string& data) : from(from), to(to), path(path), data(data)
+APRS_ROUTER_INLINE packet::packet(const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t& from, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t& to, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t>& path, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t& data) : from(from), to(to), path(path), data(data)
 {
 }
 
@@ -870,6 +1700,14 @@ APRS_ROUTER_INLINE packet::packet(const std::string& packet_string)
     assert(result);
 }
 
+#if APRS_ROUTER_USE_PMR
+
+APRS_ROUTER_INLINE packet::packet(std::pmr::memory_resource* resource) : from(resource), to(resource), path(resource), data(resource)
+{
+}
+
+#endif
+
 APRS_ROUTER_INLINE packet::operator std::string() const
 {
     return to_string(*this);
@@ -878,9 +1716,9 @@ APRS_ROUTER_INLINE packet::operator std::string() const
 APRS_ROUTER_INLINE size_t hash(const struct packet& packet)
 {
     size_t result = 17; // Start with a prime number
-    result = result * 31 + std::hash<std::string>()(packet.from);
-    result = result * 31 + std::hash<std::string>()(packet.to);
-    result = result * 31 + std::hash<std::string>()(packet.data);
+    result = result * 31 + std::hash<std::string_view>()(packet.from);
+    result = result * 31 + std::hash<std::string_view>()(packet.to);
+    result = result * 31 + std::hash<std::string_view>()(packet.data);
     return result;
 }
 
@@ -888,22 +1726,26 @@ APRS_ROUTER_INLINE std::string to_string(const struct packet& packet)
 {
     // Does not guarantee formatting a correct packet string
     // if the input packet is invalid ex: missing path
+    //
+    // The string is allocated once, with the exact size of the packet
 
-    std::string result = packet.from + ">" + packet.to;
-
-    if (!packet.path.empty())
-    {
-        for (const auto& address : packet.path)
-        {
-            result += "," + address;
-        }
-    }
+    std::string result(APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE get_packet_string_size(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data), '\0');
 
-    result += ":" + packet.data;
+    APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, result.begin());
 
     return result;
 }
 
+APRS_ROUTER_INLINE size_t format_packet_to(const struct packet& packet, char* out, size_t capacity)
+{
+    // Formats the packet into a caller provided buffer, without any heap allocations
+    //
+    // Returns the size of the packet string. If the size is larger than the capacity,
+    // nothing is written to the buffer. The packet string is not null terminated.
+
+    return APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, out, capacity);
+}
+
 APRS_ROUTER_INLINE bool operator==(const packet& lhs, const packet& rhs)
 {
     return lhs.from == rhs.from &&
@@ -1026,3163 +1868,6209 @@ APRS_ROUTER_INLINE bool try_decode_packet(std::string_view packet_string, packet
 
 #endif // APRS_ROUTER_ENABLE_PACKET_SUPPORT
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// OPERATORS, ENUM, FORMATTING                                      //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
-
 APRS_ROUTER_PACKET_NAMESPACE_END
 
 APRS_ROUTER_NAMESPACE_BEGIN
 
 #ifndef APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
 
-APRS_ROUTER_INLINE routing_option operator|(routing_option lhs, routing_option rhs)
+APRS_ROUTER_INLINE const std::string_view* packet_path_view::begin() const
 {
-    return static_cast<routing_option>(static_cast<int>(lhs) | static_cast<int>(rhs));
+    return addresses.data();
 }
 
-APRS_ROUTER_INLINE bool try_parse_routing_option(std::string_view text, routing_option& result)
+APRS_ROUTER_INLINE const std::string_view* packet_path_view::end() const
 {
-    if (text == "none")
-    {
-        result = routing_option::none;
-    }
-    else if (text == "route_self")
-    {
-        result = routing_option::route_self;
-    }
-    else if (text == "preempt_front")
-    {
-        result = routing_option::preempt_front;
-    }
-    else if (text == "preempt_truncate")
-    {
-        result = routing_option::preempt_truncate;
-    }
-    else if (text == "preempt_drop")
-    {
-        result = routing_option::preempt_drop;
-    }
-    else if (text == "preempt_mark")
-    {
-        result = routing_option::preempt_mark;
-    }
-    else if (text == "substitute_complete_n_N_address")
-    {
-        result = routing_option::substitute_complete_n_N_address;
-    }
-    else if (text == "substitute_explicit_address")
-    {
-        result = routing_option::substitute_explicit_address;
-    }
-    else if (text == "trap_limit_exceeding_n_N_address")
-    {
-        result = routing_option::trap_limit_exceeding_n_N_address;
-    }
-    else if (text == "reject_limit_exceeding_n_N_address")
-    {
-        result = routing_option::reject_limit_exceeding_n_N_address;
-    }
-    else if (text == "skip_complete_n_N_address")
-    {
-        result = routing_option::skip_complete_n_N_address;
-    }
-    else if (text == "preempt_n_N")
-    {
-        result = routing_option::preempt_n_N;
-    }
-    else if (text == "strict")
-    {
-        result = routing_option::strict;
-    }
-    else if (text == "traceless_n_N_route")
-    {
-        result = routing_option::traceless_n_N_route;
-    }
-    else if (text == "recommended")
-    {
-        result = routing_option::recommended;
-    }
-    else
+    return addresses.data() + addresses_size;
+}
+
+APRS_ROUTER_INLINE const std::string_view* packet_path_view::data() const
+{
+    return addresses.data();
+}
+
+APRS_ROUTER_INLINE size_t packet_path_view::size() const
+{
+    return addresses_size;
+}
+
+APRS_ROUTER_INLINE bool packet_path_view::empty() const
+{
+    return addresses_size == 0;
+}
+
+APRS_ROUTER_INLINE const std::string_view& packet_path_view::operator[](size_t index) const
+{
+    assert(index < addresses_size);
+    return addresses[index];
+}
+
+APRS_ROUTER_INLINE bool packet_path_view::try_push_back(std::string_view address)
+{
+    if (addresses_size >= max_size)
     {
-        assert(false);
         return false;
     }
-
+    addresses[addresses_size] = address;
+    addresses_size++;
     return true;
 }
 
-APRS_ROUTER_INLINE bool enum_has_flag(routing_option value, routing_option flag)
+APRS_ROUTER_INLINE void packet_path_view::clear()
 {
-    return (static_cast<int>(value) & static_cast<int>(flag)) != 0;
+    addresses_size = 0;
 }
 
-APRS_ROUTER_INLINE std::string to_string(const routing_result& result)
+APRS_ROUTER_INLINE bool operator==(const packet_view& lhs, const packet_view& rhs)
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+    return lhs.from == rhs.from &&
+           lhs.to == rhs.to &&
+           std::equal(lhs.path.begin(), lhs.path.end(), rhs.path.begin(), rhs.path.end()) &&
+           lhs.data == rhs.data;
+}
 
-    routing_diagnostic_display diag = format(result);
+APRS_ROUTER_INLINE bool operator!=(const packet_view& lhs, const packet_view& rhs)
+{
+    return !(lhs == rhs);
+}
 
-    std::string diag_string;
+APRS_ROUTER_INLINE std::string to_string(const packet_view& packet)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
 
-    for (const auto& e : diag.entries)
-    {
-        diag_string += create_display_name_diagnostic(e);
-    }
+    std::string result(get_packet_string_size(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data), '\0');
 
-    return diag_string;
+    format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, result.begin());
+
+    return result;
 }
 
-APRS_ROUTER_INLINE std::string to_string(routing_action action)
+APRS_ROUTER_INLINE size_t format_packet_to(const packet_view& packet, char* out, size_t capacity)
 {
-    switch (action)
-    {
-        case routing_action::none: return "none";
-        case routing_action::insert: return "insert";
-        case routing_action::remove: return "remove";
-        case routing_action::replace: return "replace";
-        case routing_action::unset: return "unset";
-        case routing_action::set: return "set";
-        case routing_action::decrement: return "decrement";
-        case routing_action::error: return "error";
-        case routing_action::warn: return "warn";
-        case routing_action::message: return "message";
-    }
-
-    assert(false);
+APRS_ROUTER_DETAIL_NAMESPACE_USE
 
-    return "";
+    return format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, out, capacity);
 }
 
-APRS_ROUTER_INLINE std::string to_string(applies_to target)
+APRS_ROUTER_INLINE bool try_decode_packet(std::string_view packet_string, packet_view& result)
 {
-    switch (target)
+    // Parse a packet into a packet view: N0CALL>APRS,CALLA,CALLB*,CALLC:data
+    //                                    ~~~~~~ ~~~~ ~~~~~~~~~~~~~~~~~~ ~~~~
+    //                                    from   to   path               data
+    //
+    // Same parsing rules as the try_decode_packet packet overload, but all the fields
+    // are views into the packet string, and nothing is copied.
+    //
+    // Fails if the packet has more path addresses than the packet view can hold.
+
+    result.path.clear();
+
+    size_t from_end_pos = packet_string.find('>');
+
+    if (from_end_pos == std::string_view::npos)
     {
-        case applies_to::none: return "none";
-        case applies_to::from: return "from";
-        case applies_to::to: return "to";
-        case applies_to::path: return "path";
-        case applies_to::data: return "data";
+        return false;
     }
 
-    assert(false);
-
-    return "";
-}
+    size_t colon_pos = packet_string.find(':', from_end_pos);
 
-APRS_ROUTER_INLINE std::string to_string(message_type type)
-{
-    switch (type)
+    if (colon_pos == std::string_view::npos)
     {
-        case message_type::none:              return "";
-        case message_type::routing_ended:     return "Packet has finished routing";
-        case message_type::already_routed:    return "Packet has already been routed";
-        case message_type::address_set:       return "Packet address marked as 'set'";
-        case message_type::address_unset:     return "Packet address marked as 'unset'";
-        case message_type::address_replaced:  return "Packet address replaced";
-        case message_type::address_decremented: return "Packet address decremented";
-        case message_type::address_inserted:  return "Packet address inserted";
-        case message_type::address_removed:   return "Packet address removed";
+        return false;
     }
 
-    assert(false);
-    return "";
-}
+    result.from = packet_string.substr(0, from_end_pos);
 
-APRS_ROUTER_INLINE routing_diagnostic_display format(const routing_result& result)
-{
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+    std::string_view to_and_path = packet_string.substr(from_end_pos + 1, colon_pos - from_end_pos - 1);
 
-    routing_diagnostic_display diag_format;
+    size_t comma_pos = to_and_path.find(',');
 
-    packet routed_packet = result.original_packet;
+    result.to = to_and_path.substr(0, comma_pos);
 
-    for (const auto& a : result.actions)
+    if (comma_pos != std::string_view::npos)
     {
-        if (a.type == routing_action::remove)
+        std::string_view path = to_and_path.substr(comma_pos + 1);
+
+        while (!path.empty())
         {
-            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
-            routed_packet.path.erase(routed_packet.path.begin() + a.index);
-        }
-        else if (a.type == routing_action::insert)
-        {
-            routed_packet.path.emplace(routed_packet.path.begin() + a.index, a.address.data(), a.address_size);
-            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
-        }
-        else if (a.type == routing_action::set)
-        {
-            routed_packet.path[a.index].append("*");
-            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
-        }
-        else if (a.type == routing_action::unset)
-        {
-            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
-            routed_packet.path[a.index].assign(a.address.data(), a.address_size);
-        }
-        else if (a.type == routing_action::replace || a.type == routing_action::decrement)
-        {
-            routed_packet.path[a.index].assign(a.address.data(), a.address_size);
-            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
+            comma_pos = path.find(',');
+
+            if (!result.path.try_push_back(path.substr(0, comma_pos)))
+            {
+                return false;
+            }
+
+            if (comma_pos == std::string_view::npos)
+            {
+                break;
+            }
+
+            path.remove_prefix(comma_pos + 1);
         }
     }
 
-    return diag_format;
-}
+    result.data = packet_string.substr(colon_pos + 1);
 
-#endif // APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
+    return true;
+}
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// ROUTING                                                          //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
+APRS_ROUTER_INLINE packet_view fixed_packet::view() const
+{
+    // View of the packet fields, the view is valid as long as the fixed packet is not modified
 
-#ifndef APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
+    packet_view result;
 
-template<class InputIterator1, class InputIterator2>
-APRS_ROUTER_INLINE_NO_DISABLE void init_router(std::string_view router_address, InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, routing_option options, route_state& state)
-{
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+    result.from = std::string_view(from.data(), from_size);
+    result.to = std::string_view(to.data(), to_size);
+    result.data = std::string_view(data.data(), data_size);
 
-    state.router_address_string = router_address;
-    state.options = options;
-    state.initialized = false;
+    for (size_t i = 0; i < path_size; i++)
+    {
+        result.path.try_push_back(std::string_view(path[i].data(), path_address_sizes[i]));
+    }
 
-    init_router_addresses(router_explicit_addresses_begin, router_explicit_addresses_end, router_n_N_addresses_begin, router_n_N_addresses_end, state);
+    return result;
 }
 
-APRS_ROUTER_INLINE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, const router_settings& settings, routing_result& result)
+APRS_ROUTER_INLINE bool fixed_packet::try_assign(const packet_view& packet)
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+    // Copy the fields of a packet view into the fixed packet
+    //
+    // Fails if any of the fields is longer than its capacity,
+    // the path addresses are limited to the length of a packet path address, see APRS_ROUTER_MAX_ADDRESS_LENGTH
 
-    init_routing_result(packet, result);
+    clear();
 
-    try_route_packet(packet.from, packet.to, packet.path, settings, result.routed_packet.path, result.state, result.actions);
+    if (packet.from.size() > from.size() || packet.to.size() > to.size() ||
+        packet.path.size() > path.size() || packet.data.size() > data.size())
+    {
+        return false;
+    }
 
-    result.routed = (result.state == routing_state::routed);
+    for (std::string_view address : packet.path)
+    {
+        if (address.size() > address_max_size)
+        {
+            return false;
+        }
+    }
 
-    if (!result.routed)
+    std::copy(packet.from.begin(), packet.from.end(), from.begin());
+    from_size = packet.from.size();
+
+    std::copy(packet.to.begin(), packet.to.end(), to.begin());
+    to_size = packet.to.size();
+
+    for (std::string_view address : packet.path)
     {
-        result.routed_packet.path = packet.path;
+        std::copy(address.begin(), address.end(), path[path_size].begin());
+        path_address_sizes[path_size] = address.size();
+        path_size++;
     }
 
-    return result.routed;
+    std::copy(packet.data.begin(), packet.data.end(), data.begin());
+    data_size = packet.data.size();
+
+    return true;
 }
 
-APRS_ROUTER_INLINE bool try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, const std::vector<std::string>& original_packet_path, const router_settings& settings, std::vector<std::string>& routed_packet_path, enum routing_state& routing_state, std::vector<routing_diagnostic>& routing_actions)
+APRS_ROUTER_INLINE void fixed_packet::clear()
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
-
-    route_state state;
-    auto [routed_packet_path_out, routing_actions_out, result] = try_route_packet(original_packet_from, original_packet_to, original_packet_path.begin(), original_packet_path.end(), settings, std::back_inserter(routed_packet_path), routing_state, std::back_inserter(routing_actions), state);
-    (void)routed_packet_path_out;
-    (void)routing_actions_out;
-    return result;
+    from_size = 0;
+    to_size = 0;
+    path_size = 0;
+    data_size = 0;
 }
 
-#endif // APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
-
-template<class InputIterator, class OutputIterator1, class OutputIterator2>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator1 routed_packet_path_out, enum routing_state& routing_state, OutputIterator2 routing_actions_out)
+APRS_ROUTER_INLINE bool operator==(const fixed_packet& lhs, const fixed_packet& rhs)
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
-
-    route_state state;
-    return try_route_packet(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, settings, routed_packet_path_out, routing_state, routing_actions_out, state);
+    return lhs.view() == rhs.view();
 }
 
-template<class InputIterator, class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator routed_packet_path_out, enum routing_state& routing_state, route_state& state)
+APRS_ROUTER_INLINE bool operator!=(const fixed_packet& lhs, const fixed_packet& rhs)
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
-
-    auto [routed_path_end, routed_actions_end, result] = try_route_packet(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, settings, routed_packet_path_out, routing_state, discard_output_iterator{}, state);
+    return !(lhs == rhs);
+}
 
-    (void)routed_actions_end;
+APRS_ROUTER_INLINE std::string to_string(const fixed_packet& packet)
+{
+    return to_string(packet.view());
+}
 
-    return { routed_path_end, result };
+APRS_ROUTER_INLINE size_t format_packet_to(const fixed_packet& packet, char* out, size_t capacity)
+{
+    return format_packet_to(packet.view(), out, capacity);
 }
 
-template<class InputIterator, class OutputIterator1, class OutputIterator2>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator1 routed_packet_path_out, enum routing_state& routing_state, OutputIterator2 routing_actions_out, route_state& state)
+APRS_ROUTER_INLINE bool try_decode_packet(std::string_view packet_string, fixed_packet& result)
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+    // Parse a packet into a fixed capacity packet
+    //
+    // Same parsing rules as the try_decode_packet packet overload.
+    // Fails if the packet does not fit the capacities of the fixed packet.
 
-    auto [routed_path_end, routed_sizes_end, routed_actions_end, result] = try_route_packet(
-        original_packet_from, original_packet_to,
-        original_packet_path_begin, original_packet_path_end,
-        settings.address,
-        settings.explicit_addresses.begin(), settings.explicit_addresses.end(),
-        settings.n_N_addresses.begin(), settings.n_N_addresses.end(),
-        settings.options,
-        settings.enable_diagnostics,
-        routed_packet_path_out, discard_output_iterator{}, routing_actions_out,
-        routing_state, state);
+    packet_view packet;
 
-    (void)routed_sizes_end;
+    if (!try_decode_packet(packet_string, packet))
+    {
+        result.clear();
+        return false;
+    }
 
-    return { routed_path_end, routed_actions_end, result };
+    return result.try_assign(packet);
 }
 
-template<class InputIterator1, class InputIterator2, class InputIterator3, class OutputIterator1, class OutputIterator2>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, std::string_view router_address, InputIterator2 router_explicit_addresses_begin, InputIterator2 router_explicit_addresses_end, InputIterator3 router_n_N_addresses_begin, InputIterator3 router_n_N_addresses_end, routing_option options, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state)
+APRS_ROUTER_INLINE size_t packet_table::size() const
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
-
-    auto [routed_path_end, routed_sizes_end, routed_actions_end, result] = try_route_packet(
-        original_packet_from, original_packet_to,
-        original_packet_path_begin, original_packet_path_end,
-        router_address,
-        router_explicit_addresses_begin, router_explicit_addresses_end,
-        router_n_N_addresses_begin, router_n_N_addresses_end,
-        options, false,
-        routed_packet_path_out, routed_packet_path_address_sizes_out, discard_output_iterator{},
-        routing_state, state);
-
-    (void)routed_actions_end;
+    return from_begin.size();
+}
 
-    return { routed_path_end, routed_sizes_end, result };
+APRS_ROUTER_INLINE bool packet_table::empty() const
+{
+    return from_begin.empty();
 }
 
-template<class InputIterator1, class OutputIterator1, class OutputIterator2, class OutputIterator3>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, route_state& state)
+APRS_ROUTER_INLINE packet_view packet_table::operator[](size_t index) const
 {
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+    assert(index < size());
 
-    state.packet_from_address = original_packet_from;
-    state.packet_to_address = original_packet_to;
-    state.original_packet_path_size = static_cast<size_t>(std::distance(original_packet_path_begin, original_packet_path_end));
+    packet_view result;
 
-    // Clear the packet path
-    state.packet_path_size = 0;
+    result.from = buffer.substr(from_begin[index], from_end[index] - from_begin[index]);
+    result.to = buffer.substr(to_begin[index], to_end[index] - to_begin[index]);
+    result.data = buffer.substr(data_begin[index], data_end[index] - data_begin[index]);
 
-    for (auto it = original_packet_path_begin; it != original_packet_path_end && state.packet_path_size < 8; ++it)
+    for (size_t i = path_begin[index]; i < path_begin[index] + path_size[index]; i++)
     {
-        using value_type = typename std::iterator_traits<InputIterator1>::value_type;
-        if constexpr (has_data_and_size<value_type>::value)
-        {
-            if (it->size() > 10)
-            {
-                routing_state = routing_state::not_routed;
-                return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
-            }
-            array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, it->data(), it->data() + it->size());
-        }
-        else
-        {
-            size_t address_size = std::strlen(*it);
-            if (address_size > 10)
-            {
-                routing_state = routing_state::not_routed;
-                return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
-            }
-            array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, *it, *it + address_size);
-        }
+        result.path.try_push_back(buffer.substr(address_begin[i], address_end[i] - address_begin[i]));
     }
 
-    init_addresses(state);
+    return result;
+}
 
-    if (is_valid_router_address_and_packet(state))
-    {
-        routing_state = routing_state::not_routed;
-        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
-    }
+APRS_ROUTER_INLINE void packet_table::clear()
+{
+    buffer = {};
+    from_begin.clear();
+    from_end.clear();
+    to_begin.clear();
+    to_end.clear();
+    data_begin.clear();
+    data_end.clear();
+    path_begin.clear();
+    path_size.clear();
+    address_begin.clear();
+    address_end.clear();
+    address_used.clear();
+}
 
-    find_used_addresses(state);
+APRS_ROUTER_INLINE bool try_decode_packets(std::string_view buffer, packet_table& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
 
-    // Packet has finished routing: N0CALL>APRS,CALL,WIDE1,DIGI*:data
-    //                                                     ~~~~~
-    if (has_packet_routing_ended(state))
-    {
-        bool result;
-        std::tie(routing_actions_out, result) = create_routing_ended_routing(state, enable_diagnostics, routing_state, routing_actions_out);
-        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, result };
-    }
+    // Decode newline delimited packets: N0CALL>APRS,CALL*,WIDE2-1:data\nN0CALL>APRS,WIDE1-1:data\n
+    //                                   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  ~~~~~~~~~~~~~~~~~~~~~~~~
+    //
+    // Every line is decoded with the same rules as try_decode_packet, and with the same packet view limits.
+    // The separators of a line are found 64 characters at a time with SSE2 or NEON when available,
+    // see find_packet_separators. Lines with a packet header longer than 64 characters are decoded with try_decode_packet.
+    // Without SIMD, every line is decoded with try_decode_packet, which is faster than comparing the characters one at a time.
+    // Lines which can not be decoded are skipped, and the function returns false. Empty lines are ignored.
+    // Lines can end with "\n" or "\r\n", the last line does not need a line ending.
+    //
+    // The buffer must not be larger than 4 GiB, the offsets are 32 bit.
 
-    // Packet has already been routing by us: N0CALL>APRS,CALL,DIGI*,WIDE1-1,WIDE2-2:data
-    //                                                         ~~~~~
-    if (has_packet_been_routed_by_us(state))
-    {
-        bool result;
-        std::tie(routing_actions_out, result) = create_routed_by_us_routing(state, enable_diagnostics, routing_state, routing_actions_out);
-        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, result };
-    }
+    result.clear();
+    result.buffer = buffer;
 
-    // Packet has been sent to us: N0CALL>DIGI,CALL,WIDE1-1,WIDE2-2:data
-    //                                    ~~~~
-    if (is_packet_sent_to_us(state))
+    if (buffer.size() > (std::numeric_limits<uint32_t>::max)())
     {
-        routing_state = routing_state::already_routed;
-        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+        return false;
     }
 
-    bool result;
-    std::tie(routing_actions_out, result) = try_explicit_or_n_N_route(state, enable_diagnostics, routing_state, routing_actions_out);
-    if (result)
+    packet_view packet;
+    size_t packets_size = 0;
+    size_t addresses_size = 0;
+    bool success = true;
+    size_t line_begin = 0;
+
+    while (line_begin < buffer.size())
     {
-        return create_routed_routing(state, enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out);
-    }
+        size_t line_end = buffer.find('\n', line_begin);
 
-    return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
-}
+        if (line_end == std::string_view::npos)
+        {
+            line_end = buffer.size();
+        }
 
-template<class InputIterator, class OutputIterator1, class OutputIterator2>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state)
-{
-APRS_ROUTER_DETAIL_NAMESPACE_USE
+#if defined(APRS_ROUTER_SIMD_SSE2) || defined(APRS_ROUTER_SIMD_NEON)
+        if (!try_decode_packet_line_from_separators(buffer, line_begin, line_end, result, packets_size, addresses_size))
+#endif
+        {
+            success &= try_decode_packet_line(buffer, line_begin, line_end, packet, result, packets_size, addresses_size);
+        }
 
-    auto [routed_path_end, routed_sizes_end, routed_actions_end, result] = try_route_packet(
-        original_packet_from, original_packet_to,
-        original_packet_path_begin, original_packet_path_end,
-        false,
-        routed_packet_path_out, routed_packet_path_address_sizes_out,
-        discard_output_iterator{},
-        routing_state, state);
+        line_begin = line_end + 1;
+    }
 
-    (void)routed_actions_end;
+    resize_packet_table(packets_size, result);
+    resize_packet_table_addresses(addresses_size, result);
 
-    return { routed_path_end, routed_sizes_end, result };
+    return success;
 }
 
-template<class InputIterator1, class InputIterator2, class InputIterator3, class OutputIterator1, class OutputIterator2, class OutputIterator3>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, std::string_view router_address, InputIterator2 router_explicit_addresses_begin, InputIterator2 router_explicit_addresses_end, InputIterator3 router_n_N_addresses_begin, InputIterator3 router_n_N_addresses_end, routing_option options, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, route_state& state)
-{
-APRS_ROUTER_DETAIL_NAMESPACE_USE
-
-    state.router_address_string = router_address;
-    state.options = options;
-
-    init_router_addresses(router_explicit_addresses_begin, router_explicit_addresses_end, router_n_N_addresses_begin, router_n_N_addresses_end, state);
-
-    return try_route_packet(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, routing_state, state);
-}
+#endif // APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
 
 APRS_ROUTER_NAMESPACE_END
 
 // **************************************************************** //
 //                                                                  //
 //                                                                  //
-//                                                                  //
-//                                                                  //
-// PRIVATE DEFINITIONS                                              //
-//                                                                  //
-//                                                                  //
+// OPERATORS, ENUM, FORMATTING                                      //
 //                                                                  //
 //                                                                  //
 // **************************************************************** //
 
 APRS_ROUTER_NAMESPACE_BEGIN
 
-APRS_ROUTER_DETAIL_NAMESPACE_BEGIN
-
 #ifndef APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// ROUTING                                                          //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
-
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_explicit_or_n_N_route(route_state& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE routing_option operator|(routing_option lhs, routing_option rhs)
 {
-    routing_state = routing_state::not_routed;
+    return static_cast<routing_option>(static_cast<int>(lhs) | static_cast<int>(rhs));
+}
 
-    // Packet has ben sent by us: DIGI>APRS,CALL,WIDE1-1,WIDE2-2:data
-    //                            ~~~~
-    bool is_routing_self = is_packet_from_us(state);
-
-    if (is_explicit_routing(is_routing_self, state))
+APRS_ROUTER_INLINE bool try_parse_routing_option(std::string_view text, routing_option& result)
+{
+    if (text == "none")
     {
-        bool result;
-        std::tie(routing_actions_out, result) = try_explicit_route(state, enable_diagnostics, routing_actions_out);
-        if (result)
-        {
-            routing_state = routing_state::routed;
-            return { routing_actions_out, true };
-        }
-        else
-        {
-            routing_state = routing_state::not_routed;
-            return { routing_actions_out, false };
-        }
+        result = routing_option::none;
     }
-
-    // Self routing is only allowed in explicit routing mode
-    if (is_routing_self)
+    else if (text == "route_self")
     {
-        routing_state = routing_state::cannot_route_self;
-        return { routing_actions_out, false };
+        result = routing_option::route_self;
     }
-
-    bool result;
-    std::tie(routing_actions_out, result) = try_n_N_route(state, enable_diagnostics, routing_actions_out);
-    if (result)
+    else if (text == "preempt_front")
     {
-        routing_state = routing_state::routed;
-        return { routing_actions_out, true };
+        result = routing_option::preempt_front;
+    }
+    else if (text == "preempt_truncate")
+    {
+        result = routing_option::preempt_truncate;
+    }
+    else if (text == "preempt_drop")
+    {
+        result = routing_option::preempt_drop;
+    }
+    else if (text == "preempt_mark")
+    {
+        result = routing_option::preempt_mark;
+    }
+    else if (text == "substitute_complete_n_N_address")
+    {
+        result = routing_option::substitute_complete_n_N_address;
+    }
+    else if (text == "substitute_explicit_address")
+    {
+        result = routing_option::substitute_explicit_address;
+    }
+    else if (text == "trap_limit_exceeding_n_N_address")
+    {
+        result = routing_option::trap_limit_exceeding_n_N_address;
+    }
+    else if (text == "reject_limit_exceeding_n_N_address")
+    {
+        result = routing_option::reject_limit_exceeding_n_N_address;
+    }
+    else if (text == "skip_complete_n_N_address")
+    {
+        result = routing_option::skip_complete_n_N_address;
+    }
+    else if (text == "preempt_n_N")
+    {
+        result = routing_option::preempt_n_N;
+    }
+    else if (text == "strict")
+    {
+        result = routing_option::strict;
+    }
+    else if (text == "traceless_n_N_route")
+    {
+        result = routing_option::traceless_n_N_route;
+    }
+    else if (text == "recommended")
+    {
+        result = routing_option::recommended;
+    }
+    else
+    {
+        assert(false);
+        return false;
     }
 
-    return { routing_actions_out, false };
+    return true;
 }
 
-APRS_ROUTER_INLINE bool is_explicit_routing(bool is_routing_self, std::optional<size_t> maybe_router_address_index, routing_option options)
+APRS_ROUTER_INLINE bool enum_has_flag(routing_option value, routing_option flag)
 {
-    // Explicit routing is enabled if the packet has the router's address
-    //
-    // Example:
-    //
-    // Router's address: DIGI
-    //
-    // Packet: N0CALL>APRS,CALLA,CALLB*,DIGI,CALLC:data
-    //                                  ~~~~
+    return (static_cast<int>(value) & static_cast<int>(flag)) != 0;
+}
 
-    if (maybe_router_address_index)
+#if APRS_ROUTER_USE_PMR
+
+APRS_ROUTER_INLINE routing_result::routing_result(std::pmr::memory_resource* resource) : original_packet(resource), routed_packet(resource), actions(resource)
+{
+}
+
+#endif
+
+APRS_ROUTER_INLINE std::string to_string(const routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    routing_diagnostic_display diag = format(result);
+
+    std::string diag_string;
+
+    for (const auto& e : diag.entries)
     {
-        return (!is_routing_self || enum_has_flag(options, routing_option::route_self));
+        diag_string += create_display_name_diagnostic(e);
     }
 
-    return false;
+    return diag_string;
 }
 
-APRS_ROUTER_INLINE bool is_explicit_routing(bool is_routing_self, const route_state& state)
+APRS_ROUTER_INLINE std::string to_string(routing_action action)
 {
-    return is_explicit_routing(is_routing_self, state.maybe_router_address_index, state.options);
+    switch (action)
+    {
+        case routing_action::none: return "none";
+        case routing_action::insert: return "insert";
+        case routing_action::remove: return "remove";
+        case routing_action::replace: return "replace";
+        case routing_action::unset: return "unset";
+        case routing_action::set: return "set";
+        case routing_action::decrement: return "decrement";
+        case routing_action::error: return "error";
+        case routing_action::warn: return "warn";
+        case routing_action::message: return "message";
+    }
+
+    assert(false);
+
+    return "";
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_explicit_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE std::string to_string(applies_to target)
 {
-    // If explicitly routing a packet through the router
-    // find the router's address in the packet and mark it as used (*)
-    // Also unmark all the previously used addresses.
-    //
-    // preemptive routing allows us to ignore other packets in front of
-    // us and proceed on the routing. There are two strategies that
-    // can be used with preemptive routing, one which prioritizes our address
-    // and what that eliminates unused addresses from the packet.
+    switch (target)
+    {
+        case applies_to::none: return "none";
+        case applies_to::from: return "from";
+        case applies_to::to: return "to";
+        case applies_to::path: return "path";
+        case applies_to::data: return "data";
+    }
 
-    const std::optional<size_t> maybe_router_address_index = state.maybe_router_address_index;
-#ifndef NDEBUG
-    const size_t packet_addresses_size = state.packet_addresses_size;
-#endif
-    const size_t unused_address_index = state.unused_address_index;
-    const routing_option options = state.options;
+    assert(false);
 
-    if (!maybe_router_address_index)
+    return "";
+}
+
+APRS_ROUTER_INLINE std::string to_string(message_type type)
+{
+    switch (type)
     {
-        // We did not find router's address or a explicit router address in the packet path
-        return { routing_actions_out, false };
+        case message_type::none:              return "";
+        case message_type::routing_ended:     return "Packet has finished routing";
+        case message_type::already_routed:    return "Packet has already been routed";
+        case message_type::address_set:       return "Packet address marked as 'set'";
+        case message_type::address_unset:     return "Packet address marked as 'unset'";
+        case message_type::address_replaced:  return "Packet address replaced";
+        case message_type::address_decremented: return "Packet address decremented";
+        case message_type::address_inserted:  return "Packet address inserted";
+        case message_type::address_removed:   return "Packet address removed";
     }
 
-    size_t router_address_index = maybe_router_address_index.value();
-
-    assert(router_address_index < packet_addresses_size);
-    assert(unused_address_index < packet_addresses_size);
+    assert(false);
+    return "";
+}
 
-    // is_path_based_routing - this means that the matching address is not the router's address, and comes from the router's path
-    //
-    // Example:
-    //
-    // Router's address: DIGI
-    //
-    // Router's path:    WIDE1,CALLA,CALLB
-    //
-    // A packet matching the router's address: N0CALL>APRS,DIGI:data
-    //                                                     ~~~~
-    //                                                     is_path_based_routing=false
-    //
-    // A packet matching the router's path: N0CALL>APRS,CALLA:data
-    //                                                  ~~~~~
-    //                                                  is_path_based_routing=true
+APRS_ROUTER_INLINE routing_diagnostic_display format(const routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
 
-    bool have_other_unused_addresses_ahead = router_address_index != unused_address_index;
+    routing_diagnostic_display diag_format;
 
-    bool preempt_drop = enum_has_flag(options, routing_option::preempt_drop);
+    packet routed_packet = result.original_packet;
 
-    // If we don't have any unused addresses ahead of us, then proceed
-    // If preempt_drop mode is enabled, different processing of the packet is required
-    if (!have_other_unused_addresses_ahead && !preempt_drop)
+    for (const auto& a : result.actions)
     {
-        return try_explicit_basic_route(state, router_address_index, enable_diagnostics, routing_actions_out);
+        if (a.type == routing_action::remove)
+        {
+            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
+            routed_packet.path.erase(routed_packet.path.begin() + a.index);
+        }
+        else if (a.type == routing_action::insert)
+        {
+            routed_packet.path.emplace(routed_packet.path.begin() + a.index, a.address.data(), a.address_size);
+            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
+        }
+        else if (a.type == routing_action::set)
+        {
+            routed_packet.path[a.index].append("*");
+            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
+        }
+        else if (a.type == routing_action::unset)
+        {
+            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
+            routed_packet.path[a.index].assign(a.address.data(), a.address_size);
+        }
+        else if (a.type == routing_action::replace || a.type == routing_action::decrement)
+        {
+            routed_packet.path[a.index].assign(a.address.data(), a.address_size);
+            diag_format.entries.push_back(create_diagnostic_print_line(a, routed_packet));
+        }
     }
 
-    bool result;
-    std::tie(routing_actions_out, result) = try_preempt_explicit_route(state, enable_diagnostics, routing_actions_out);
-    if (result)
-    {
-        return { routing_actions_out, true };
-    }
+    return diag_format;
+}
 
-    return { routing_actions_out, false };
+APRS_ROUTER_INLINE size_t format_packet_to(const routing_result& result, char* out, size_t capacity)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Formats the routed packet into a caller provided buffer
+    //
+    // Returns the size of the packet string. If the size is larger than the capacity,
+    // nothing is written to the buffer. The packet string is not null terminated.
+
+    const auto& packet = result.routed_packet;
+
+    return format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, out, capacity);
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_explicit_basic_route(route_state& state, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE size_t format_packet_to(const route_scratch& state, std::string_view data, char* out, size_t capacity)
 {
-    // Route a packet using non-preemptive explicit routing.
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Formats the packet last routed with the route_scratch into a caller provided buffer
     //
-    // In the simplest case, find a matching address and set it as 'used'.
+    // The addresses are formatted straight from the route_scratch, no routed path buffers are needed.
+    // The route_scratch references the packet's from and to addresses, which must still be valid.
+    // The data is not stored in the route_scratch, and is passed separately.
     //
-    //   1) Unmark any 'used' addresses in front of the matched address:
+    // This function should be used after a packet was successfully routed.
+
+    std::array<std::array<char, routed_address_text_max>, path_addresses_max> path = {};
+    std::array<std::string_view, path_addresses_max> path_views = {};
+    size_t path_size = 0;
+
+    format_routed_path(state, path, path_views, path_size);
+
+    return format_packet(state.packet_from_address, state.packet_to_address, path_views.begin(), path_views.begin() + path_size, data, out, capacity);
+}
+
+APRS_ROUTER_INLINE std::string_view routed_packet_segments::header_view() const
+{
+    return std::string_view(header.data(), header_size);
+}
+
+APRS_ROUTER_INLINE std::array<std::string_view, 2> routed_packet_segments::segments() const
+{
+    return { header_view(), data };
+}
+
+APRS_ROUTER_INLINE size_t routed_packet_segments::size() const
+{
+    return header_size + data.size();
+}
+
+APRS_ROUTER_INLINE bool try_format_packet_segments(const route_scratch& state, std::string_view data, routed_packet_segments& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Renders the header of the packet last routed with the route_scratch: N0CALL>APRS,DIGI,WIDE1*:data
+    //                                                                     ~~~~~~~~~~~~~~~~~~~~~~~
+    // The data is not copied, the data segment references the original packet data.
     //
-    //      Input: N0CALL>APRS,CALL*,DIGI:data
-    //                               ~~~~
-    //                               matched address based on router's address
+    // Fails if the header does not fit in the header buffer.
+
+    // The header is formatted straight from the route_scratch, every routed address is formatted once
+    // Removed addresses are empty, and are skipped
+
+    result.header_size = 0;
+    result.data = {};
+
+    auto append = [&result](std::string_view text)
+    {
+        if (result.header_size + text.size() > result.header.size())
+        {
+            return false;
+        }
+        std::memcpy(result.header.data() + result.header_size, text.data(), text.size());
+        result.header_size += text.size();
+        return true;
+    };
+
+    bool appended = append(state.packet_from_address) && append(">") && append(state.packet_to_address);
+
+    for (size_t i = 0; appended && i < state.packet_addresses_size; i++)
+    {
+        const auto& address = state.packet_addresses[i];
+        if (address.text_size != 0)
+        {
+            std::array<char, routed_address_text_max> address_string;
+            size_t address_string_size = 0;
+            to_string(address, address_string, address_string_size);
+            appended = append(",") && append(std::string_view(address_string.data(), address_string_size));
+        }
+    }
+
+    if (!appended || !append(":"))
+    {
+        result.header_size = 0;
+        return false;
+    }
+
+    result.data = data;
+
+    return true;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const packet_view& packet, routed_packet_segments& result, enum routing_state& routing_state, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet view, and output the routed packet as segments
     //
-    //      Output: N0CALL>APRS,CALL,DIGI*:data
-    //                          ~~~~ ~~~~~
-    //                          ^    matched address marked as 'used' 
-    //                          |
-    //                          address marked as unused
+    // No heap allocations are made, and the packet data is not copied.
+    // The segments are only set if the packet was routed.
+
+    // The routed path is not written, the header is formatted once from the route_scratch
+
+    auto [routed_path_end, routed_sizes_end, routed] = try_route_packet(packet, discard_output_iterator{}, discard_output_iterator{}, routing_state, state);
+
+    (void)routed_path_end;
+    (void)routed_sizes_end;
+
+    if (!routed)
+    {
+        return false;
+    }
+
+    return try_format_packet_segments(state, packet.data, result);
+}
+
+APRS_ROUTER_INLINE bool try_replay_routing_actions(const routing_result& routing_result, char* out, size_t capacity, size_t& size)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Replays the routing actions of a routing result on the original packet,
+    // and formats the routed packet into a caller provided buffer, without any heap allocations
     //
-    //   2) Path based matching.
-    //   
-    //      If the address matched is not the router's address, but matches the router's path addresses
-    //      we also need to insert the router's address in front:
+    // The actions are applied on a small array of address slots, and the routed packet
+    // is rendered in a single pass. Useful to rebuild routed packets from stored routing diagnostics.
     //
-    //      2.a) Simplest case:
+    // Returns false if the packet was not routed, if the actions cannot be applied,
+    // or if the buffer is too small. The size is set to the required capacity.
+
+    size = 0;
+
+    if (routing_result.state != routing_state::routed)
+    {
+        return false;
+    }
+
+    const auto& original_packet = routing_result.original_packet;
+
+    std::array<routed_address_slot, 2 * path_addresses_max> slots;
+    size_t slots_size = 0;
+
+    if (!try_apply_routing_actions(original_packet.path.begin(), original_packet.path.end(), routing_result.actions.begin(), routing_result.actions.end(), slots, slots_size))
+    {
+        return false;
+    }
+
+    std::string_view from = original_packet.from;
+    std::string_view to = original_packet.to;
+
+    size = from.size() + 1 + to.size() + 1 + std::size(original_packet.data);
+
+    for (size_t i = 0; i < slots_size; i++)
+    {
+        size += 1 + slots[i].text.size() + slots[i].marks;
+    }
+
+    if (size > capacity || out == nullptr)
+    {
+        return false;
+    }
+
+    out = std::copy(from.begin(), from.end(), out);
+    *out++ = '>';
+    out = std::copy(to.begin(), to.end(), out);
+
+    for (size_t i = 0; i < slots_size; i++)
+    {
+        *out++ = ',';
+        out = std::copy(slots[i].text.begin(), slots[i].text.end(), out);
+        out = std::fill_n(out, slots[i].marks, '*');
+    }
+
+    *out++ = ':';
+    std::copy(std::begin(original_packet.data), std::end(original_packet.data), out);
+
+    return true;
+}
+
+#endif // APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
+
+template<class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator format_packet_to(const packet_view& packet, OutputIterator out)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    return format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, out);
+}
+
+template<class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator format_packet_to(const routing_result& result, OutputIterator out)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    const auto& packet = result.routed_packet;
+
+    return format_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), packet.data, out);
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTING                                                          //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+#ifndef APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
+
+template<class InputIterator1, class InputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void init_router(std::string_view router_address, InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, routing_option options, router_config& config)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    config.router_address_string = router_address;
+    config.options = options;
+    config.initialized = false;
+
+    init_router_addresses(router_explicit_addresses_begin, router_explicit_addresses_end, router_n_N_addresses_begin, router_n_N_addresses_end, config);
+}
+
+template<class InputIterator1, class InputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr bool try_init_router(std::string_view router_address, InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, routing_option options, router_config& config)
+{
+    // Initialize the router_config like init_router, and validate the router's configuration
     //
-    //           Router's address: DIGI
+    // Returns false if the router's address, or any of the explicit or n-N addresses could not be parsed,
+    // or if there are more addresses than the router_config can hold.
     //
-    //           Router's path: CALLB
+    // Both functions are constexpr, a router configuration known at compile time
+    // can be parsed and validated during compilation, and embedded as read-only data:
     //
-    //           Input: N0CALL>APRS,CALLA*,CALLB:data
-    //                                     ~~~~~
-    //                                     matched address based on path
+    // constexpr std::array<std::string_view, 1> explicit_addresses = { "CALLA" };
+    // constexpr std::array<std::string_view, 2> n_N_addresses = { "WIDE1", "WIDE2" };
     //
-    //           Output: N0CALL>APRS,CALLA,DIGI,CALLB*:data
-    //                               ~~~~~ ~~~~ ~~~~~~
-    //                               ^     ^    matched address marked as 'used' 
-    //                               |     inserted router address
-    //                               address marked as unused
+    // constexpr route_state digi = [] {
+    //     route_state state;
+    //     init_router("DIGI", explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), routing_option::recommended, state);
+    //     return state;
+    // }();
     //
-    //      2.b) If we cannot insert an address because the packet has 8 addresses in the path
-    //           then replace the matched address with the router's address:
+    // A copy of the route_state can then be used to route packets without parsing the configuration.
+
+    init_router(router_address, router_explicit_addresses_begin, router_explicit_addresses_end, router_n_N_addresses_begin, router_n_N_addresses_end, options, config);
+
+    return config.router_address.text_size > 0 &&
+        config.router_explicit_addresses_size == static_cast<size_t>(std::distance(router_explicit_addresses_begin, router_explicit_addresses_end)) &&
+        config.router_n_N_addresses_size == static_cast<size_t>(std::distance(router_n_N_addresses_begin, router_n_N_addresses_end));
+}
+
+APRS_ROUTER_INLINE router::router(const router_settings& settings)
+{
+    init_router(settings, *this);
+}
+
+APRS_ROUTER_INLINE router::router(const router& other) : settings(other.settings), state(other.state), cache(other.cache)
+{
+    // The cached router address is a view into the settings, point it to our own copy
+    state.router_address_string = settings.address;
+}
+
+APRS_ROUTER_INLINE router& router::operator=(const router& other)
+{
+    if (this != &other)
+    {
+        settings = other.settings;
+        state = other.state;
+        state.router_address_string = settings.address;
+        cache = other.cache;
+    }
+    return *this;
+}
+
+APRS_ROUTER_INLINE void init_router(const router_settings& settings, struct router& router)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Compile the router settings into the router's route_state
     //
-    //           Router's address: DIGI
+    // The route_state keeps views into the router's own copy of the settings,
+    // so the settings passed in do not have to outlive the router
+
+    if (&router.settings != &settings)
+    {
+        router.settings = settings;
+    }
+
+    init_router(router.settings.address,
+        router.settings.explicit_addresses.begin(), router.settings.explicit_addresses.end(),
+        router.settings.n_N_addresses.begin(), router.settings.n_N_addresses.end(),
+        router.settings.options,
+        router.state);
+
+    // Cached routing decisions were made with the previous settings
+    init_routing_cache(router.settings.cache_size, router.cache);
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct router& router, routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet using the router's cached settings
     //
-    //           Router's path: CALLB
+    // Unlike the router_settings overload, the router's address, explicit addresses
+    // and n-N addresses are not parsed again for every packet
+
+    init_routing_result(packet, result);
+
+    // Packets with a header routed before are routed from the cache, without parsing the packet
+    const bool use_cache = !router.settings.enable_diagnostics && !router.cache.entries.empty();
+    const uint64_t hash = use_cache ? get_routing_cache_hash(packet) : 0;
+
+    if (use_cache && try_find_routing_cache_entry(packet, hash, result, router.cache))
+    {
+        return result.routed;
+    }
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, routed] = try_route_packet(
+        packet.from, packet.to,
+        packet.path.begin(), packet.path.end(),
+        router.settings.enable_diagnostics,
+        std::back_inserter(result.routed_packet.path), discard_output_iterator{}, std::back_inserter(result.actions),
+        result.state, router.state, router.state);
+
+    (void)routed_path_end;
+    (void)routed_sizes_end;
+    (void)routed_actions_end;
+    (void)routed;
+
+    result.routed = (result.state == routing_state::routed);
+
+    if (!result.routed)
+    {
+        result.routed_packet.path = packet.path;
+    }
+
+    if (use_cache)
+    {
+        insert_routing_cache_entry(packet, hash, result, router.cache);
+    }
+
+    return result.routed;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, const struct router& router, route_scratch& scratch, routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet using a router shared between threads
     //
-    //           Input: N0CALL>APRS,A,B,C,D,E,F,G*,CALLB:data
-    //                                             ~~~~~
-    //                                             matched address based on path
+    // The router's route_state is only read, the packet is routed in the caller's route_scratch.
+    // Every thread needs its own route_scratch, and the router must not be reinitialized while in use.
     //
-    //           Output: N0CALL>APRS,A,B,C,D,E,F,G,DIGI*:data
-    //                                           ~ ~~~~~
-    //                                           ^ address replaced with router's address and marked as 'used' 
-    //                                           |
-    //                                           address marked as unused
+    // The routing cache is not used, as looking up a routing decision updates the cache.
     //
-    //   3) A variation of 2.b when substitute_explicit_address is set. 
-    //      The matched address will be replaced by the route's address
-    //      even if we have space to insert the address
+    // Example:
     //
-    //      Router's address: DIGI
+    // const router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" } });
     //
-    //      Router's path: CALLB
+    // std::thread worker([&] {
+    //     route_scratch scratch;
+    //     routing_result result;
+    //     try_route_packet(packet, digi, scratch, result);
+    // });
+
+    init_routing_result(packet, result);
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, routed] = try_route_packet(
+        packet.from, packet.to,
+        packet.path.begin(), packet.path.end(),
+        router.settings.enable_diagnostics,
+        std::back_inserter(result.routed_packet.path), discard_output_iterator{}, std::back_inserter(result.actions),
+        result.state, router.state, scratch);
+
+    (void)routed_path_end;
+    (void)routed_sizes_end;
+    (void)routed_actions_end;
+    (void)routed;
+
+    result.routed = (result.state == routing_state::routed);
+
+    if (!result.routed)
+    {
+        result.routed_packet.path = packet.path;
+    }
+
+    return result.routed;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const fixed_packet& packet, struct router& router, fixed_routing_result& result)
+{
+    // Route a fixed capacity packet using the router's cached settings
     //
-    //      Input: N0CALL>APRS,CALLA*,CALLB:data
-    //                                ~~~~~
-    //                                matched address based on path
+    // The routing cache is not used, and the routing diagnostics are not recorded.
+
+    return try_route_packet(packet, static_cast<const struct router&>(router), router.state, result);
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const fixed_packet& packet, const struct router& router, route_scratch& scratch, fixed_routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a fixed capacity packet, without any heap allocations
     //
-    //      Output: N0CALL>APRS,CALLA,DIGI*:data
-    //                          ~~~~~ ~~~~~
-    //                          ^     address replaced with router's address and marked as 'used' 
-    //                          |
-    //                          address marked as unused
+    // The routed path is written directly into the routed packet's fixed size path.
+    // Every thread needs its own route_scratch, see the routing_result overload.
+
+    assert(&packet != &result.routed_packet);
+
+    result.routed = false;
+    result.success = true;
+    result.original_packet = packet;
+    result.routed_packet = packet;
+
+    const packet_view view = packet.view();
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, routed] = try_route_packet(
+        view.from, view.to,
+        view.path.begin(), view.path.end(),
+        false,
+        result.routed_packet.path.begin(), result.routed_packet.path_address_sizes.begin(), discard_output_iterator{},
+        result.state, router.state, scratch);
+
+    (void)routed_path_end;
+    (void)routed_actions_end;
+    (void)routed;
+
+    result.routed = (result.state == routing_state::routed);
+
+    if (result.routed)
+    {
+        result.routed_packet.path_size = static_cast<size_t>(std::distance(result.routed_packet.path_address_sizes.begin(), routed_sizes_end));
+    }
+    else
+    {
+        result.routed_packet.path = packet.path;
+        result.routed_packet.path_address_sizes = packet.path_address_sizes;
+    }
+
+    return result.routed;
+}
+
+APRS_ROUTER_INLINE router_set::router_set(const std::vector<router_settings>& settings)
+{
+    init_router_set(settings, *this);
+}
+
+APRS_ROUTER_INLINE void init_router_set(const std::vector<router_settings>& settings, struct router_set& set)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Compile every router's settings, and index the routers by the first characters of their addresses
+    //
+    // Routers with diagnostics enabled report a routing diagnostic for every packet,
+    // they are not indexed and are evaluated for every packet.
+
+    set.routers.clear();
+    set.routers.reserve(settings.size());
+
+    for (const auto& router_settings : settings)
+    {
+        set.routers.emplace_back(router_settings);
+    }
+
+    set.index.clear();
+    set.unindexed.clear();
+
+    for (size_t router_id = 0; router_id < set.routers.size(); router_id++)
+    {
+        const struct router& router = set.routers[router_id];
+
+        if (router.settings.enable_diagnostics || !router.state.router_prefilter.enabled)
+        {
+            set.unindexed.push_back(router_id);
+            continue;
+        }
+
+        add_router_set_index(router.state, router_id, set);
+    }
+
+    std::sort(set.index.begin(), set.index.end());
+    set.index.erase(std::unique(set.index.begin(), set.index.end()), set.index.end());
+
+    set.candidates.assign(set.routers.size(), false);
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct router_set& set, std::vector<routing_result>& results)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet with every router of the set
+    //
+    // The results are in the same order as the routers, one result per router.
+    // Returns true if the packet was routed by at least one router.
+
+    results.resize(set.routers.size());
+
+    // Copy and parse the packet once, for all the routers
+
+    const bool valid_path = try_init_packet_path(packet.from, packet.to, packet.path.begin(), packet.path.end(), set.scratch);
+
+    if (valid_path)
+    {
+        parse_packet_addresses(set.scratch, set.parses);
+        find_router_set_candidates(set.scratch, set);
+    }
+
+    bool routed = false;
+
+    for (size_t router_id = 0; router_id < set.routers.size(); router_id++)
+    {
+        const struct router& router = set.routers[router_id];
+        routing_result& result = results[router_id];
+
+        init_routing_result(packet, result);
+
+        result.state = routing_state::not_routed;
+
+        if (valid_path && set.candidates[router_id])
+        {
+            auto [routed_path_end, routed_sizes_end, routed_actions_end, router_routed] = try_route_packet_path_with_options<runtime_routing_options>(
+                router.settings.enable_diagnostics,
+                std::back_inserter(result.routed_packet.path), discard_output_iterator{}, std::back_inserter(result.actions),
+                result.state, router.state, set.scratch, &set.parses);
+
+            (void)routed_path_end;
+            (void)routed_sizes_end;
+            (void)routed_actions_end;
+            (void)router_routed;
+        }
+
+        result.routed = (result.state == routing_state::routed);
+
+        if (!result.routed)
+        {
+            result.routed_packet.path = packet.path;
+        }
+
+        routed = routed || result.routed;
+    }
+
+    return routed;
+}
+
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+
+APRS_ROUTER_INLINE reloadable_router::reloadable_router() : current(new router())
+{
+}
+
+APRS_ROUTER_INLINE reloadable_router::reloadable_router(const router_settings& settings) : current(new router(settings))
+{
+}
+
+APRS_ROUTER_INLINE reloadable_router::~reloadable_router()
+{
+    // No packets can be routed while the router is destroyed
+    delete current.load();
+}
+
+APRS_ROUTER_INLINE void reload_router(const router_settings& settings, struct reloadable_router& router)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Compile the new settings into a new router, and publish it
+    //
+    // The previous router is deleted once all the packets which could still be using it have been routed.
+    // Packets are routed without waiting for the reload, only concurrent reloads wait for each other.
+
+    const struct router* next = new struct router(settings);
+
+    while (router.reloading.exchange(true, std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+
+    const struct router* previous = router.current.exchange(next);
+
+    wait_for_reloadable_router_readers(router);
+
+    router.reloading.store(false, std::memory_order_release);
+
+    delete previous;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct reloadable_router& router, route_scratch& scratch, routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet using the current router of a reloadable router
+    //
+    // The router is read once, a concurrent reload does not affect a packet which is already being routed.
+    // Every thread needs its own route_scratch.
+
+    const size_t epoch = enter_reloadable_router(router);
+
+    bool routed = try_route_packet(packet, *router.current.load(), scratch, result);
+
+    leave_reloadable_router(epoch, router);
+
+    return routed;
+}
+
+#endif // APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+
+APRS_ROUTER_INLINE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, const router_settings& settings, routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    init_routing_result(packet, result);
+
+    try_route_packet(packet.from, packet.to, packet.path, settings, result.routed_packet.path, result.state, result.actions);
+
+    result.routed = (result.state == routing_state::routed);
+
+    if (!result.routed)
+    {
+        result.routed_packet.path = packet.path;
+    }
+
+    return result.routed;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, const APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t>& original_packet_path, const router_settings& settings, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_string_t>& routed_packet_path, enum routing_state& routing_state, APRS_ROUTER_APRS_DETAIL_NAMESPACE_REFERENCE public_vector_t<routing_diagnostic>& routing_actions)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    route_state state;
+    auto [routed_packet_path_out, routing_actions_out, result] = try_route_packet(original_packet_from, original_packet_to, original_packet_path.begin(), original_packet_path.end(), settings, std::back_inserter(routed_packet_path), routing_state, std::back_inserter(routing_actions), state);
+    (void)routed_packet_path_out;
+    (void)routing_actions_out;
+    return result;
+}
+
+#endif // APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
+
+template<class InputIterator, class OutputIterator1, class OutputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator1 routed_packet_path_out, enum routing_state& routing_state, OutputIterator2 routing_actions_out)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    route_state state;
+    return try_route_packet(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, settings, routed_packet_path_out, routing_state, routing_actions_out, state);
+}
+
+template<class InputIterator, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator routed_packet_path_out, enum routing_state& routing_state, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    auto [routed_path_end, routed_actions_end, result] = try_route_packet(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, settings, routed_packet_path_out, routing_state, discard_output_iterator{}, state);
+
+    (void)routed_actions_end;
+
+    return { routed_path_end, result };
+}
+
+template<class InputIterator, class OutputIterator1, class OutputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, const router_settings& settings, OutputIterator1 routed_packet_path_out, enum routing_state& routing_state, OutputIterator2 routing_actions_out, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, result] = try_route_packet(
+        original_packet_from, original_packet_to,
+        original_packet_path_begin, original_packet_path_end,
+        settings.address,
+        settings.explicit_addresses.begin(), settings.explicit_addresses.end(),
+        settings.n_N_addresses.begin(), settings.n_N_addresses.end(),
+        settings.options,
+        settings.enable_diagnostics,
+        routed_packet_path_out, discard_output_iterator{}, routing_actions_out,
+        routing_state, state);
+
+    (void)routed_sizes_end;
+
+    return { routed_path_end, routed_actions_end, result };
+}
+
+template<class InputIterator1, class InputIterator2, class InputIterator3, class OutputIterator1, class OutputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, std::string_view router_address, InputIterator2 router_explicit_addresses_begin, InputIterator2 router_explicit_addresses_end, InputIterator3 router_n_N_addresses_begin, InputIterator3 router_n_N_addresses_end, routing_option options, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, result] = try_route_packet(
+        original_packet_from, original_packet_to,
+        original_packet_path_begin, original_packet_path_end,
+        router_address,
+        router_explicit_addresses_begin, router_explicit_addresses_end,
+        router_n_N_addresses_begin, router_n_N_addresses_end,
+        options, false,
+        routed_packet_path_out, routed_packet_path_address_sizes_out, discard_output_iterator{},
+        routing_state, state);
+
+    (void)routed_actions_end;
+
+    return { routed_path_end, routed_sizes_end, result };
+}
+
+template<class InputIterator1, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, route_state& state)
+{
+    return try_route_packet(
+        original_packet_from, original_packet_to,
+        original_packet_path_begin, original_packet_path_end,
+        enable_diagnostics,
+        routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out,
+        routing_state, state, state);
+}
+
+template<class InputIterator1, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& scratch)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet with a router_config which can be shared between threads
+    //
+    // The router_config is only read, everything written while routing the packet goes into the route_scratch
+
+    return try_route_packet_with_options<runtime_routing_options>(
+        original_packet_from, original_packet_to,
+        original_packet_path_begin, original_packet_path_end,
+        enable_diagnostics,
+        routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out,
+        routing_state, config, scratch);
+}
+
+template<routing_option Options>
+APRS_ROUTER_INLINE_NO_DISABLE bool try_route_packet(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, struct router& router, routing_result& result)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a packet using the router's cached settings, with the routing options fixed at compile time
+    //
+    // The options should be the same as the router's options,
+    // the option checks are then constants and the compiler can drop the branches which are not taken
+    //
+    // If the options are different, the packet is routed with the router's options instead,
+    // a routing decision made with the wrong options is never returned or stored in the routing cache
+    //
+    // Example:
+    //
+    // router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::recommended });
+    //
+    // routing_result result;
+    // try_route_packet<routing_option::recommended>(packet, digi, result);
+
+    if (router.state.options != Options)
+    {
+        return try_route_packet(packet, router, result);
+    }
+
+    init_routing_result(packet, result);
+
+    const bool use_cache = !router.settings.enable_diagnostics && !router.cache.entries.empty();
+    const uint64_t hash = use_cache ? get_routing_cache_hash(packet) : 0;
+
+    if (use_cache && try_find_routing_cache_entry(packet, hash, result, router.cache))
+    {
+        return result.routed;
+    }
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, routed] = try_route_packet_with_options<static_routing_options<Options>>(
+        packet.from, packet.to,
+        packet.path.begin(), packet.path.end(),
+        router.settings.enable_diagnostics,
+        std::back_inserter(result.routed_packet.path), discard_output_iterator{}, std::back_inserter(result.actions),
+        result.state, router.state, router.state);
+
+    (void)routed_path_end;
+    (void)routed_sizes_end;
+    (void)routed_actions_end;
+    (void)routed;
+
+    result.routed = (result.state == routing_state::routed);
+
+    if (!result.routed)
+    {
+        result.routed_packet.path = packet.path;
+    }
+
+    if (use_cache)
+    {
+        insert_routing_cache_entry(packet, hash, result, router.cache);
+    }
+
+    return result.routed;
+}
+
+template<class InputIterator, class OutputIterator1, class OutputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    auto [routed_path_end, routed_sizes_end, routed_actions_end, result] = try_route_packet(
+        original_packet_from, original_packet_to,
+        original_packet_path_begin, original_packet_path_end,
+        false,
+        routed_packet_path_out, routed_packet_path_address_sizes_out,
+        discard_output_iterator{},
+        routing_state, state);
+
+    (void)routed_actions_end;
+
+    return { routed_path_end, routed_sizes_end, result };
+}
+
+template<class InputIterator1, class InputIterator2, class InputIterator3, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, std::string_view router_address, InputIterator2 router_explicit_addresses_begin, InputIterator2 router_explicit_addresses_end, InputIterator3 router_n_N_addresses_begin, InputIterator3 router_n_N_addresses_end, routing_option options, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    state.router_address_string = router_address;
+    state.options = options;
+
+    init_router_addresses(router_explicit_addresses_begin, router_explicit_addresses_end, router_n_N_addresses_begin, router_n_N_addresses_end, state);
+
+    return try_route_packet(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, routing_state, state);
+}
+
+template<class OutputIterator1, class OutputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, bool> try_route_packet(const packet_view& packet, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, enum routing_state& routing_state, route_state& state)
+{
+    // Route a packet view using an initialized route_state
+    //
+    // No heap allocations are made, the routed path is written into the output iterators
+
+    return try_route_packet(packet.from, packet.to, packet.path.begin(), packet.path.end(), routed_packet_path_out, routed_packet_path_address_sizes_out, routing_state, state);
+}
+
+template<class InputIterator, class OutputIterator1, class OutputIterator2, class OutputIterator3, class OutputIterator4>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, OutputIterator4, size_t> try_route_packets(InputIterator packets_begin, InputIterator packets_end, OutputIterator1 routed_packet_paths_out, OutputIterator2 routed_packet_paths_address_sizes_out, OutputIterator3 routed_packet_path_sizes_out, OutputIterator4 routing_states_out, route_state& state)
+{
+APRS_ROUTER_DETAIL_NAMESPACE_USE
+
+    // Route a batch of packets using an initialized route_state
+    //
+    // The packets can be of any type which has from, to and path members,
+    // ex: packet, or a user defined struct of string_views
+    //
+    // The outputs are written into caller provided arrays, one element per packet:
+    //
+    //   - routed_packet_paths_out: std::array<std::array<char, address_text_max>, path_addresses_max>, the routed path addresses
+    //   - routed_packet_paths_address_sizes_out: std::array<size_t, path_addresses_max>, the size of every routed path address
+    //   - routed_packet_path_sizes_out: size_t, the number of routed path addresses, 0 if not routed
+    //   - routing_states_out: routing_state
+    //
+    // The routed paths are written in place, routed_packet_paths_out and
+    // routed_packet_paths_address_sizes_out should be forward iterators, ex: std::array or std::vector iterators
+    //
+    // Returns the end iterators, and the number of routed packets
+
+    assert(state.initialized);
+
+    return try_route_packets_with_options<runtime_routing_options>(packets_begin, packets_end, routed_packet_paths_out, routed_packet_paths_address_sizes_out, routed_packet_path_sizes_out, routing_states_out, state, state);
+}
+
+APRS_ROUTER_NAMESPACE_END
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// PRIVATE DEFINITIONS                                              //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_NAMESPACE_BEGIN
+
+APRS_ROUTER_DETAIL_NAMESPACE_BEGIN
+
+#ifndef APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTING                                                          //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE routing_option get_routing_options(runtime_routing_options, const router_config& config)
+{
+    return config.options;
+}
+
+template <routing_option Value>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr routing_option get_routing_options(static_routing_options<Value>, const router_config& config)
+{
+    (void)config;
+    return Value;
+}
+
+APRS_ROUTER_INLINE_NO_DISABLE constexpr bool may_have_routing_option(runtime_routing_options, routing_option flag)
+{
+    // The runtime options are only known from the router_config
+    (void)flag;
+    return true;
+}
+
+template <routing_option Value>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr bool may_have_routing_option(static_routing_options<Value>, routing_option flag)
+{
+    // Used with 'if constexpr', branches for options which are not set are not instantiated
+    return (static_cast<int>(Value) & static_cast<int>(flag)) != 0;
+}
+
+template <class Options, class InputIterator1, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet_with_options(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator1 original_packet_path_begin, InputIterator1 original_packet_path_end, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& state)
+{
+    // Route a packet using an initialized router_config, the packet is parsed into the route_scratch
+    //
+    // The routing options are read using the Options policy:
+    //
+    //   - runtime_routing_options: the options are read from config.options for every check
+    //   - static_routing_options<Options>: the options are fixed at compile time, and every check is a constant
+
+    // Most packets do not mention any of our addresses, reject them before parsing the path.
+    // Rejected packets produce no diagnostics, so the prefilter is only used if diagnostics are disabled.
+
+    if (!enable_diagnostics && !might_route_packet(config, original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end))
+    {
+        routing_state = routing_state::not_routed;
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+    }
+
+    if (!try_init_packet_path(original_packet_from, original_packet_to, original_packet_path_begin, original_packet_path_end, state))
+    {
+        routing_state = routing_state::not_routed;
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+    }
+
+    return try_route_packet_path_with_options<Options>(enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, routing_state, config, state, nullptr);
+}
+
+template <class Options, class InputIterator, class OutputIterator1, class OutputIterator2, class OutputIterator3, class OutputIterator4>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, OutputIterator4, size_t> try_route_packets_with_options(InputIterator packets_begin, InputIterator packets_end, OutputIterator1 routed_packet_paths_out, OutputIterator2 routed_packet_paths_address_sizes_out, OutputIterator3 routed_packet_path_sizes_out, OutputIterator4 routing_states_out, const router_config& config, route_scratch& state)
+{
+    // Route a batch of packets, see try_route_packets
+    //
+    // The address text of the next packet is prefetched while the current packet is routed
+
+    size_t routed_packets_count = 0;
+
+    for (auto it = packets_begin; it != packets_end; ++it)
+    {
+        auto next_it = std::next(it);
+        if (next_it != packets_end)
+        {
+            prefetch_packet_addresses(next_it->from, std::begin(next_it->path), std::end(next_it->path));
+        }
+
+        auto& routed_packet_path = *routed_packet_paths_out;
+        auto& routed_packet_path_address_sizes = *routed_packet_paths_address_sizes_out;
+
+        enum routing_state routing_state = routing_state::not_routed;
+
+        auto [routed_path_end, routed_sizes_end, routed_actions_end, routed] = try_route_packet_with_options<Options>(
+            it->from, it->to,
+            std::begin(it->path), std::end(it->path),
+            false,
+            std::begin(routed_packet_path), std::begin(routed_packet_path_address_sizes),
+            discard_output_iterator{},
+            routing_state, config, state);
+
+        (void)routed_sizes_end;
+        (void)routed_actions_end;
+
+        if (routed)
+        {
+            routed_packets_count++;
+        }
+
+        *routed_packet_path_sizes_out = routed ? static_cast<size_t>(std::distance(std::begin(routed_packet_path), routed_path_end)) : 0;
+        *routing_states_out = routing_state;
+
+        ++routed_packet_paths_out;
+        ++routed_packet_paths_address_sizes_out;
+        ++routed_packet_path_sizes_out;
+        ++routing_states_out;
+    }
+
+    return { routed_packet_paths_out, routed_packet_paths_address_sizes_out, routed_packet_path_sizes_out, routing_states_out, routed_packets_count };
+}
+
+template <class InputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE void prefetch_packet_addresses(std::string_view packet_from_address, InputIterator packet_path_begin, InputIterator packet_path_end)
+{
+    // Prefetch the address text of a packet, the 'from' address and the path addresses
+    //
+    // The addresses are usually stored apart from the packet, ex: string_views into a receive buffer
+
+    APRS_ROUTER_PREFETCH(packet_from_address.data());
+
+    for (auto it = packet_path_begin; it != packet_path_end; ++it)
+    {
+        using value_type = typename std::iterator_traits<InputIterator>::value_type;
+        if constexpr (has_data_and_size<value_type>::value)
+        {
+            APRS_ROUTER_PREFETCH(it->data());
+        }
+        else
+        {
+            APRS_ROUTER_PREFETCH(*it);
+        }
+    }
+}
+
+template <class InputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE bool try_init_packet_path(std::string_view original_packet_from, std::string_view original_packet_to, InputIterator original_packet_path_begin, InputIterator original_packet_path_end, route_scratch& state)
+{
+    // Copy the packet's addresses into the route_scratch
+    //
+    // Fails if any of the path addresses is longer than address_text_max, such a packet is not routed.
+    //
+    // The address offsets are 32 bit, see address::offset. The header of a routed packet must fit them,
+    // packets with longer 'from' and 'to' addresses are not routed.
+
+    constexpr size_t header_addresses_size_max = (std::numeric_limits<uint32_t>::max)() - path_addresses_max * (routed_address_text_max + 1) - 2;
+
+    if (original_packet_from.size() > header_addresses_size_max || original_packet_to.size() > header_addresses_size_max - original_packet_from.size())
+    {
+        return false;
+    }
+
+    state.packet_from_address = original_packet_from;
+    state.packet_to_address = original_packet_to;
+    state.original_packet_path_size = static_cast<size_t>(std::distance(original_packet_path_begin, original_packet_path_end));
+
+    // Clear the packet path
+    state.packet_path_size = 0;
+
+    for (auto it = original_packet_path_begin; it != original_packet_path_end && state.packet_path_size < path_addresses_max; ++it)
+    {
+        using value_type = typename std::iterator_traits<InputIterator>::value_type;
+        if constexpr (has_data_and_size<value_type>::value)
+        {
+            if (it->size() > address_text_max)
+            {
+                return false;
+            }
+            array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, it->data(), it->data() + it->size());
+        }
+        else
+        {
+            size_t address_size = std::strlen(*it);
+            if (address_size > address_text_max)
+            {
+                return false;
+            }
+            array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, *it, *it + address_size);
+        }
+    }
+
+    return true;
+}
+
+template <class Options, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_packet_path_with_options(bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& state, const packet_address_parses* parses)
+{
+    // Route a packet which has already been copied into the route_scratch by try_init_packet_path
+
+    // Fast path for canonical n-N paths: N0CALL>APRS,WIDE1-1,WIDE2-1:data
+    //
+    // The addresses and the used addresses are initialized directly, the packet can only be n-N routed.
+    // Without diagnostics the unused n-N address is routed directly by try_canonical_n_N_route,
+    // with diagnostics the packet is routed by try_n_N_route, which records the routing actions.
+    // Any other path is routed by the general path, the routing result is identical for both.
+
+    if (try_init_canonical_addresses(config, state))
+    {
+        routing_state = routing_state::not_routed;
+
+        // The router's address and the path size are checked by try_init_canonical_addresses
+        if (state.packet_from_address.empty() || state.packet_to_address.empty())
+        {
+            return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+        }
+
+        if constexpr (may_have_routing_option(Options{}, routing_option::strict))
+        {
+            if (enum_has_flag(get_routing_options(Options{}, config), routing_option::strict) && !is_packet_valid<Options>(config, state))
+            {
+                return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+            }
+        }
+
+        bool result;
+        if (!enable_diagnostics)
+        {
+            result = try_canonical_n_N_route<Options>(config, state);
+        }
+        else
+        {
+            std::tie(routing_actions_out, result) = try_n_N_route<Options>(config, state, enable_diagnostics, routing_actions_out);
+        }
+
+        if (result)
+        {
+            routing_state = routing_state::routed;
+            return create_routed_routing(state, enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out);
+        }
+
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+    }
+
+    return try_route_general_packet_path_with_options<Options>(enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, routing_state, config, state, parses);
+}
+
+template <class Options, class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> try_route_general_packet_path_with_options(bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out, enum routing_state& routing_state, const router_config& config, route_scratch& state, const packet_address_parses* parses)
+{
+    // Route a packet which has already been copied into the route_scratch, without the canonical n-N fast path
+    //
+    // The path addresses are parsed for this router by init_addresses,
+    // or picked from the parses shared by all the routers of a router_set.
+
+    if (is_valid_router_address_and_packet<Options>(config, state))
+    {
+        routing_state = routing_state::not_routed;
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+    }
+
+    // Packets which have finished routing, or have already been routed by us, are decided by the last used address
+    // Only the last used address is parsed for these packets, the whole path is parsed for all the other packets
+
+    if (!try_init_last_used_address<Options>(config, state))
+    {
+        if (parses != nullptr)
+        {
+            init_addresses(config, *parses, state);
+        }
+        else
+        {
+            init_addresses(config, state);
+        }
+
+        find_used_addresses<Options>(config, state);
+    }
+
+    // Packet has finished routing: N0CALL>APRS,CALL,WIDE1,DIGI*:data
+    //                                                     ~~~~~
+    if (has_packet_routing_ended(state))
+    {
+        bool result;
+        std::tie(routing_actions_out, result) = create_routing_ended_routing(state, enable_diagnostics, routing_state, routing_actions_out);
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, result };
+    }
+
+    // Packet has already been routing by us: N0CALL>APRS,CALL,DIGI*,WIDE1-1,WIDE2-2:data
+    //                                                         ~~~~~
+    if (has_packet_been_routed_by_us(config, state))
+    {
+        bool result;
+        std::tie(routing_actions_out, result) = create_routed_by_us_routing(state, enable_diagnostics, routing_state, routing_actions_out);
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, result };
+    }
+
+    // Packet has been sent to us: N0CALL>DIGI,CALL,WIDE1-1,WIDE2-2:data
+    //                                    ~~~~
+    if (is_packet_sent_to_us(config, state))
+    {
+        routing_state = routing_state::already_routed;
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+    }
+
+    bool result;
+    std::tie(routing_actions_out, result) = try_explicit_or_n_N_route<Options>(config, state, enable_diagnostics, routing_state, routing_actions_out);
+    if (result)
+    {
+        return create_routed_routing(state, enable_diagnostics, routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out);
+    }
+
+    return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, false };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_explicit_or_n_N_route(const router_config& config, route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out)
+{
+    routing_state = routing_state::not_routed;
+
+    // Packet has ben sent by us: DIGI>APRS,CALL,WIDE1-1,WIDE2-2:data
+    //                            ~~~~
+    bool is_routing_self = is_packet_from_us(config, state);
+
+    if (is_explicit_routing<Options>(is_routing_self, config, state))
+    {
+        bool result;
+        std::tie(routing_actions_out, result) = try_explicit_route<Options>(config, state, enable_diagnostics, routing_actions_out);
+        if (result)
+        {
+            routing_state = routing_state::routed;
+            return { routing_actions_out, true };
+        }
+        else
+        {
+            routing_state = routing_state::not_routed;
+            return { routing_actions_out, false };
+        }
+    }
+
+    // Self routing is only allowed in explicit routing mode
+    if (is_routing_self)
+    {
+        routing_state = routing_state::cannot_route_self;
+        return { routing_actions_out, false };
+    }
+
+    bool result;
+    std::tie(routing_actions_out, result) = try_n_N_route<Options>(config, state, enable_diagnostics, routing_actions_out);
+    if (result)
+    {
+        routing_state = routing_state::routed;
+        return { routing_actions_out, true };
+    }
+
+    return { routing_actions_out, false };
+}
+
+APRS_ROUTER_INLINE bool is_explicit_routing(bool is_routing_self, std::optional<size_t> maybe_router_address_index, routing_option options)
+{
+    // Explicit routing is enabled if the packet has the router's address
+    //
+    // Example:
+    //
+    // Router's address: DIGI
+    //
+    // Packet: N0CALL>APRS,CALLA,CALLB*,DIGI,CALLC:data
+    //                                  ~~~~
+
+    if (maybe_router_address_index)
+    {
+        return (!is_routing_self || enum_has_flag(options, routing_option::route_self));
+    }
+
+    return false;
+}
+
+template <class Options>
+APRS_ROUTER_INLINE_NO_DISABLE bool is_explicit_routing(bool is_routing_self, const router_config& config, const route_scratch& state)
+{
+    return is_explicit_routing(is_routing_self, state.maybe_router_address_index, get_routing_options(Options{}, config));
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_explicit_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // If explicitly routing a packet through the router
+    // find the router's address in the packet and mark it as used (*)
+    // Also unmark all the previously used addresses.
+    //
+    // preemptive routing allows us to ignore other packets in front of
+    // us and proceed on the routing. There are two strategies that
+    // can be used with preemptive routing, one which prioritizes our address
+    // and what that eliminates unused addresses from the packet.
+
+    const std::optional<size_t> maybe_router_address_index = state.maybe_router_address_index;
+#ifndef NDEBUG
+    const size_t packet_addresses_size = state.packet_addresses_size;
+#endif
+    const size_t unused_address_index = state.unused_address_index;
+    const routing_option options = get_routing_options(Options{}, config);
+
+    if (!maybe_router_address_index)
+    {
+        // We did not find router's address or a explicit router address in the packet path
+        return { routing_actions_out, false };
+    }
+
+    size_t router_address_index = maybe_router_address_index.value();
+
+    assert(router_address_index < packet_addresses_size);
+    assert(unused_address_index < packet_addresses_size);
+
+    // is_path_based_routing - this means that the matching address is not the router's address, and comes from the router's path
+    //
+    // Example:
+    //
+    // Router's address: DIGI
+    //
+    // Router's path:    WIDE1,CALLA,CALLB
+    //
+    // A packet matching the router's address: N0CALL>APRS,DIGI:data
+    //                                                     ~~~~
+    //                                                     is_path_based_routing=false
+    //
+    // A packet matching the router's path: N0CALL>APRS,CALLA:data
+    //                                                  ~~~~~
+    //                                                  is_path_based_routing=true
+
+    bool have_other_unused_addresses_ahead = router_address_index != unused_address_index;
+
+    bool preempt_drop = enum_has_flag(options, routing_option::preempt_drop);
+
+    // If we don't have any unused addresses ahead of us, then proceed
+    // If preempt_drop mode is enabled, different processing of the packet is required
+    if (!have_other_unused_addresses_ahead && !preempt_drop)
+    {
+        return try_explicit_basic_route<Options>(config, state, router_address_index, enable_diagnostics, routing_actions_out);
+    }
+
+    // Without any of the preempt options the packet cannot be preempted
+    if constexpr (may_have_routing_option(Options{}, routing_option::preempt_front) ||
+                  may_have_routing_option(Options{}, routing_option::preempt_truncate) ||
+                  may_have_routing_option(Options{}, routing_option::preempt_drop) ||
+                  may_have_routing_option(Options{}, routing_option::preempt_mark))
+    {
+        bool result;
+        std::tie(routing_actions_out, result) = try_preempt_explicit_route<Options>(config, state, enable_diagnostics, routing_actions_out);
+        if (result)
+        {
+            return { routing_actions_out, true };
+        }
+    }
+
+    return { routing_actions_out, false };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_explicit_basic_route(const router_config& config, route_scratch& state, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // Route a packet using non-preemptive explicit routing.
+    //
+    // In the simplest case, find a matching address and set it as 'used'.
+    //
+    //   1) Unmark any 'used' addresses in front of the matched address:
+    //
+    //      Input: N0CALL>APRS,CALL*,DIGI:data
+    //                               ~~~~
+    //                               matched address based on router's address
+    //
+    //      Output: N0CALL>APRS,CALL,DIGI*:data
+    //                          ~~~~ ~~~~~
+    //                          ^    matched address marked as 'used' 
+    //                          |
+    //                          address marked as unused
+    //
+    //   2) Path based matching.
+    //   
+    //      If the address matched is not the router's address, but matches the router's path addresses
+    //      we also need to insert the router's address in front:
+    //
+    //      2.a) Simplest case:
+    //
+    //           Router's address: DIGI
+    //
+    //           Router's path: CALLB
+    //
+    //           Input: N0CALL>APRS,CALLA*,CALLB:data
+    //                                     ~~~~~
+    //                                     matched address based on path
+    //
+    //           Output: N0CALL>APRS,CALLA,DIGI,CALLB*:data
+    //                               ~~~~~ ~~~~ ~~~~~~
+    //                               ^     ^    matched address marked as 'used' 
+    //                               |     inserted router address
+    //                               address marked as unused
+    //
+    //      2.b) If we cannot insert an address because the packet has 8 addresses in the path
+    //           then replace the matched address with the router's address:
+    //
+    //           Router's address: DIGI
+    //
+    //           Router's path: CALLB
+    //
+    //           Input: N0CALL>APRS,A,B,C,D,E,F,G*,CALLB:data
+    //                                             ~~~~~
+    //                                             matched address based on path
+    //
+    //           Output: N0CALL>APRS,A,B,C,D,E,F,G,DIGI*:data
+    //                                           ~ ~~~~~
+    //                                           ^ address replaced with router's address and marked as 'used' 
+    //                                           |
+    //                                           address marked as unused
+    //
+    //   3) A variation of 2.b when substitute_explicit_address is set. 
+    //      The matched address will be replaced by the route's address
+    //      even if we have space to insert the address
+    //
+    //      Router's address: DIGI
+    //
+    //      Router's path: CALLB
+    //
+    //      Input: N0CALL>APRS,CALLA*,CALLB:data
+    //                                ~~~~~
+    //                                matched address based on path
+    //
+    //      Output: N0CALL>APRS,CALLA,DIGI*:data
+    //                          ~~~~~ ~~~~~
+    //                          ^     address replaced with router's address and marked as 'used' 
+    //                          |
+    //                          address marked as unused
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
+    const bool is_path_based_routing = state.is_path_based_routing;
+    const size_t unused_address_index = state.unused_address_index;
+    const address& router_address = config.router_address;
+    const std::string_view router_address_string = config.router_address_string;
+    const routing_option options = get_routing_options(Options{}, config);
+    assert(set_address_index < packet_addresses_size);
+    assert(unused_address_index < packet_addresses_size);
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::substitute_explicit_address))
+    {
+        bool substitute_explicit_address = enum_has_flag(options, routing_option::substitute_explicit_address);
+
+        if (substitute_explicit_address)
+        {
+            routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, set_address_index, router_address_string, enable_diagnostics, routing_actions_out);
+            replace_address_with_router_address(packet_addresses[set_address_index], router_address);
+            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+            set_address_as_used(packet_addresses, packet_addresses_size, set_address_index);
+            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+            return { routing_actions_out, true };
+        }
+    }
+
+    if (is_path_based_routing)
+    {
+        if (try_insert_address(packet_addresses, packet_addresses_size, unused_address_index, router_address_string))
+        {
+            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+            set_address_as_used(packet_addresses, packet_addresses_size, set_address_index + 1);
+            routing_actions_out = push_address_inserted_diagnostic(packet_addresses, packet_addresses_size, unused_address_index, enable_diagnostics, routing_actions_out);
+            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index + 1, enable_diagnostics, routing_actions_out);
+        }
+        else
+        {
+            routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, set_address_index, router_address_string, enable_diagnostics, routing_actions_out);
+            replace_address_with_router_address(packet_addresses[set_address_index], router_address);
+            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+            set_address_as_used(packet_addresses, packet_addresses_size, set_address_index);
+            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+        }
+    }
+    else
+    {
+        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+        set_address_as_used(packet_addresses, packet_addresses_size, set_address_index);
+        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+    }
+
+    return { routing_actions_out, true };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_preempt_explicit_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    bool result;
+    std::tie(routing_actions_out, result) = try_preempt_transform_explicit_route<Options>(config, state, enable_diagnostics, routing_actions_out);
+    if (result)
+    {
+        return try_explicit_basic_route<Options>(config, state, state.unused_address_index, enable_diagnostics, routing_actions_out);
+    }
+    return { routing_actions_out, false };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_preempt_transform_explicit_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // We cannot reach here if the router's address is not found
+    assert(state.maybe_router_address_index.has_value());
+
+    const routing_option options = get_routing_options(Options{}, config);
+    const size_t router_address_index = state.maybe_router_address_index.value();
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
+    size_t& unused_address_index = state.unused_address_index;
+
+    assert(router_address_index < packet_addresses_size);
+    assert(unused_address_index < packet_addresses_size);
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::preempt_front))
+    {
+        if (enum_has_flag(options, routing_option::preempt_front))
+        {
+            // Diagnostics are calculated before the move.
+            // Store diagnostics in a temporary array, and if the move is not successful
+            // then we will not add the diagnostics to the actions.
+            // Sized for the worst case: create_address_move_diagnostic emits exactly 2 entries.
+            std::array<routing_diagnostic, 8> routing_actions_temp{};
+            auto routing_actions_temp_end = create_address_move_diagnostic(packet_addresses, packet_addresses_size, router_address_index, unused_address_index, enable_diagnostics, routing_actions_temp.begin(), routing_actions_temp.end());
+            if (try_move_address_to_position(packet_addresses, packet_addresses_size, router_address_index, unused_address_index))
+            {
+                routing_actions_out = std::copy(routing_actions_temp.begin(), routing_actions_temp_end, routing_actions_out);
+            }
+            return { routing_actions_out, true };
+        }
+    }
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::preempt_truncate))
+    {
+        if (enum_has_flag(options, routing_option::preempt_truncate))
+        {
+            // Diagnostics are calculated before the move.
+            // Store diagnostics in a temporary array, and if the move is not successful
+            // then we will not add the diagnostics to the actions.
+            // Sized for the worst case: create_truncate_address_range_diagnostic emits at most (packet_addresses_size - 1) entries,
+            // with packet_addresses_size capped at 8.
+            std::array<routing_diagnostic, 8> routing_actions_temp{};
+            auto routing_actions_temp_end = create_truncate_address_range_diagnostic(packet_addresses, packet_addresses_size, unused_address_index, router_address_index, enable_diagnostics, routing_actions_temp.begin(), routing_actions_temp.end());
+            if (try_truncate_address_range(packet_addresses, packet_addresses_size, unused_address_index, router_address_index))
+            {
+                routing_actions_out = std::copy(routing_actions_temp.begin(), routing_actions_temp_end, routing_actions_out);
+            }
+            return { routing_actions_out, true };
+        }
+    }
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::preempt_drop))
+    {
+        if (enum_has_flag(options, routing_option::preempt_drop))
+        {
+            // Diagnostics are calculated before the move.
+            // Store diagnostics in a temporary array, and if the move is not successful
+            // then we will not add the diagnostics to the actions.
+            // Sized for the worst case: create_truncate_address_range_diagnostic emits at most (packet_addresses_size - 1) entries,
+            // with packet_addresses_size capped at 8.
+            std::array<routing_diagnostic, 8> routing_actions_temp{};
+            auto routing_actions_temp_end = create_truncate_address_range_diagnostic(packet_addresses, packet_addresses_size, 0, router_address_index, enable_diagnostics, routing_actions_temp.begin(), routing_actions_temp.end());
+            if (try_truncate_address_range(packet_addresses, packet_addresses_size, 0, router_address_index))
+            {
+                routing_actions_out = std::copy(routing_actions_temp.begin(), routing_actions_temp_end, routing_actions_out);
+            }
+
+            // Reset the unused address index to 0 as we are dropping all the addresses
+            // in front of the router's matched address
+            //
+            // Example:
+            //
+            // Router address: DIGI
+            // Router path: E
+            //
+            // Original packet: N0CALL>APRS,A,B*,C,D,E,F:data
+            //                                   ~
+            //                                   unused_address_index = 2
+            // 
+            // Truncated packet: N0CALL>APRS,E,F:data
+            //                               ~
+            //                               unused_address_index = 0
+
+            unused_address_index = 0;
+
+            return { routing_actions_out, true };
+        }
+    }
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::preempt_mark))
+    {
+        if (enum_has_flag(options, routing_option::preempt_mark))
+        {
+            // Reset the unused address index to the index of the router's matched address
+            //
+            // Example:
+            //
+            // Router address: DIGI
+            // Router path: E
+            //
+            // Original packet: N0CALL>APRS,A,B*,C,D,E,F:data
+            //                                   ~
+            //                                   unused_address_index = 2
+            // 
+            // Original packet: N0CALL>APRS,A,B*,C,D,E,F:data
+            //                                       ~
+            //                                       unused_address_index = 4
+
+            unused_address_index = router_address_index;
+
+            return { routing_actions_out, true };
+        }
+    }
+
+    return { routing_actions_out, false };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_n_N_route(const router_config& config, route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // n-N routing function. Routes a packet using the n-N routing algorithm.
+    //
+    // If the first unused address in the packet is an n-N address, apply the n-N routing algorithm:
+    //
+    // Example:
+    //
+    //   Router address: DIGI
+    //
+    //   Router path: WIDE2-2,WIDE1-2
+    //
+    //   Packet: N0CALL>APRS,CALL*,WIDE1-2,WIDE2-2:data
+    //                           ~ ~~~~~~~
+    //
+    //   Routed Packet: N0CALL>APRS,CALL,DIGI*,WIDE1-1,WIDE2-2:data
+    //                                 ~ ~~~~~~~~~~~~~
+    //
+    // If an n-N packet address exceeds the maximum number of hops, trap it if "trap_limit_exceeding_n_N_address" is set:
+    //
+    // Example:
+    // 
+    //   Router path: WIDE2-2
+    //
+    //   Packet: N0CALL>APRS,CALL*,WIDE2-3:data
+    //                             ~~~~~~~
+    //
+    //   Routed Packet: N0CALL>APRS,CALL,DIGI*:data
+    //                                   ~~~~~
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    const size_t packet_addresses_size = state.packet_addresses_size;
+    const auto& router_n_N_addresses = config.router_n_N_addresses;
+    const size_t router_n_N_addresses_size = config.router_n_N_addresses_size;
+    const routing_option options = get_routing_options(Options{}, config);
+    const size_t unused_address_index = state.unused_address_index;
+    const address& unused_address = state.packet_addresses[unused_address_index];
+
+    auto unused_address_index_pair = find_first_unused_n_N_address_index(packet_addresses, packet_addresses_size, router_n_N_addresses, config.router_n_N_address_keys, router_n_N_addresses_size, options);
+
+    if (!unused_address_index_pair)
+    {
+        return { routing_actions_out, false };
+    }
+
+    auto [address_n_N_index, router_n_N_index] = unused_address_index_pair.value();
+
+    // We should not route the packet if we have other unused addresses in front of us.
+    // If we have unused addresses, then we should stop the routing process:
+    //
+    // N0CALL>APRS,CALL,WIDE1-1,WIDE2-1:data
+    //             ~~~~
+    //             unused address
+    //
+    //  But we should still allow empty addresses to be routed so they can be removed
+
+    if (address_n_N_index > unused_address_index)
+    {
+        if (unused_address.text_size != 0)
+        {
+            return { routing_actions_out, false };
+        }
+    }
+
+    assert(address_n_N_index < packet_addresses_size);
+    assert(router_n_N_index < router_n_N_addresses_size);
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::trap_limit_exceeding_n_N_address))
+    {
+        bool result;
+        std::tie(routing_actions_out, result) = try_trap_n_N_route<Options>(config, state, packet_addresses[address_n_N_index], router_n_N_addresses[router_n_N_index], enable_diagnostics, routing_actions_out);
+        if (result)
+        {
+            return { routing_actions_out, true };
+        }
+    }
+
+    return try_n_N_route_no_trap<Options>(config, state, address_n_N_index, enable_diagnostics, routing_actions_out);
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_n_N_route_no_trap(const router_config& config, route_scratch& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // Route an ADDRESSn-N address.
+    //
+    // Route a packet through a routing "path" that matches an address with the n-N format (e.g., WIDE2-1).
+    //
+    // Pick the very first matching n-N address among the packet's addresses:
+    //
+    //   1. Decrement the 'N' part of the ADDRESSn-N address to indicate one less hop remaining.
+    //
+    //   2. Insert the router's address in front of the matched address to mark it as the next hop.
+    //
+    //      2.a. Mark the router's address as "used" with an asterix (*), if N > 0
+    //
+    //   3. If the N part of the ADDRESSn-N is decremented to 0, then:
+    //
+    //      3.a. If "substitute_complete_n_N_address" is set, remove the ADDRESSn-N where N is 0
+    //
+    //      3.b. If "substitute_complete_n_N_address" is not set, mark the ADDRESSn-N as "used"
+    //
+    //   4. Create and update the routing result to reflect these changes.
+    //
+    // Example:
+    //
+    //   Router address:  DIGI
+    //
+    //   Router path:     WIDE1-1,WIDE2-1
+    //                    ~~~~~~~~~~~~~~~
+    //                    router_n_N_addresses
+    //
+    //   Original packet: N0CALL>APRS,CALL*,WIDE1-1,WIDE2-1:data
+    //                                ~~~~~~~~~~~~~~~~~~~~~
+    //                                packet_addresses
+    //
+    //   After step 1:    N0CALL>APRS,CALL*,WIDE1,WIDE2-1:data
+    //   After step 2:    N0CALL>APRS,CALL*,DIGI,WIDE1,WIDE2-1:data
+    //   After step 2.a:  N0CALL>APRS,CALL*,DIGI,WIDE1,WIDE2-1:data
+    //   After step 3.a:  N0CALL>APRS,CALL,DIGI*,WIDE2-1:data
+    //   After step 3.b:  N0CALL>APRS,CALL,DIGI,WIDE1*,WIDE2-1:data
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    const size_t packet_addresses_size = state.packet_addresses_size;
+    const routing_option options = get_routing_options(Options{}, config);
+
+    assert(packet_n_N_address_index < packet_addresses_size);
+
+    bool substitute_zero_hops = enum_has_flag(options, routing_option::substitute_complete_n_N_address);
+    bool traceless_n_N = enum_has_flag(options, routing_option::traceless_n_N_route);
+
+    address& n_N_address = packet_addresses[packet_n_N_address_index];
+
+    assert(n_N_address.n > 0);
+
+    if (try_decrement_n_N_address(state, n_N_address))
+    {
+        routing_actions_out = push_address_decremented_diagnostic(n_N_address, enable_diagnostics, routing_actions_out);
+    }
+
+    // If we are in a position which will require us to insert more than 8 addresses
+    // just return, the only thing we can do is increment the counter
+
+    bool result;
+    std::tie(routing_actions_out, result) = try_complete_n_N_route(state, n_N_address, substitute_zero_hops, enable_diagnostics, routing_actions_out);
+    if (result)
+    {
+        return { routing_actions_out, true };
+    }
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::substitute_complete_n_N_address))
+    {
+        if (substitute_zero_hops && !traceless_n_N && n_N_address.N == 0)
+        {
+            std::tie(routing_actions_out, result) = try_substitute_complete_n_N_address(config, state, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
+            (void)result;
+            return { routing_actions_out, true };
+        }
+    }
+
+    return try_insert_n_N_route<Options>(config, state, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_complete_n_N_route(route_scratch& state, address& n_N_address, bool substitute_zero_hops, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // If we are in a position which will require us to insert more than 8 addresses
+    // just return, the only thing we can do is increment the n-N counter
+    //
+    // Example:
+    //
+    // Input: FROM>TO,A,B,C,D,E,F,G,WIDE2-2:data
+    //                ~ ~ ~ ~ ~ ~ ~ ~~~~~~~
+    //
+    // Output: FROM>TO,A,B,C,D,E,F,G,WIDE2-1:data
+    //                               ~~~~~~~
+    //
+    // There are a few circumstances where we can still continue with the 
+    // insertion even when the address count is 8. For example if we will
+    // shortly shrink the packet path (substitute_complete_n_N_address)
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    const size_t packet_addresses_size = state.packet_addresses_size;
+
+    if (packet_addresses_size >= path_addresses_max)
+    {
+        // The n-N address has no remaining hops, but we cannot substitute it
+        // with our router's address because "substitute_zero_hops" is unset
+        // we also have more than 8 addresses, so just mark the completed address as "set"
+        if (!substitute_zero_hops && n_N_address.N == 0)
+        {
+            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
+            set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
+            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
+
+            return { routing_actions_out, true };
+        }
+
+        // The n-N address has remaining hops, and we have more than 8 addresses
+        // We've decremented it earlier (above), don't change any used flag,
+        // just exit as we are done
+        if (!substitute_zero_hops || n_N_address.N > 0)
+        {
+            return { routing_actions_out, true };
+        }
+    }
+
+    return { routing_actions_out, false };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_insert_n_N_route(const router_config& config, route_scratch& state, size_t& packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // Insert the router's address in front of the n-N address:
+    //
+    // Example:
+    //
+    // Input:  FROM>TO,CALL,WIDE2-1:data
+    //                      ~~~~~~~
+    //
+    // Output: FROM>TO,CALL,DIGI*,WIDE2-1:data
+    //                      ~~~~~
+    //                      Insert and mark the router's address as used
+    //                      n-N address is left unchanged by this function
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
+    const std::string_view router_address = config.router_address_string;
+    const bool substitute_zero_hops = enum_has_flag(get_routing_options(Options{}, config), routing_option::substitute_complete_n_N_address);
+    const bool traceless_n_N = enum_has_flag(get_routing_options(Options{}, config), routing_option::traceless_n_N_route);
+
+    assert(packet_n_N_address_index < packet_addresses_size);
+
+    struct address& n_N_address = packet_addresses[packet_n_N_address_index];
+
+    struct address new_address;
+    array_assign(new_address.text, new_address.text_size, router_address.begin(), router_address.end());
+    new_address.kind = address_kind::other;
+    new_address.length = static_cast<uint16_t>(router_address.size());
+
+    bool set_new_address_as_used = false;
+
+    if ((substitute_zero_hops && !traceless_n_N) || n_N_address.N > 0)
+    {
+        set_new_address_as_used = true;
+    }
+    else
+    {
+        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
+        set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
+        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
+    }
+
+    if (traceless_n_N)
+    {
+        return { routing_actions_out, true };
+    }
+
+    // A full path only reaches here with traceless_n_N, see try_complete_n_N_route
+    assert(packet_addresses_size < path_addresses_max);
+
+    size_t initial_offset = packet_addresses[0].offset;
+
+    array_insert(packet_addresses, packet_addresses_size, packet_n_N_address_index, new_address);
+
+    update_addresses_index(packet_addresses, packet_addresses_size);
+    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+
+    routing_actions_out = push_address_inserted_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
+
+    if (set_new_address_as_used)
+    {
+        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, std::nullopt, enable_diagnostics, routing_actions_out);
+        set_address_as_used(packet_addresses, packet_addresses_size, packet_n_N_address_index);
+        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
+    }
+
+    packet_n_N_address_index++;
+
+    return { routing_actions_out, true };
+}
+
+template <class Options, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_trap_n_N_route(const router_config& config, route_scratch& state, address& packet_n_N_address, const address& router_n_N_address, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // Replace an excessive hop with the router's address
+    // to stop the packet from harming the network
+    //
+    // packet_n_N_address - is the address inside the packet's path
+    // router_n_N_address - is the address inside the router's path, matching the packet address
+    //
+    // Example:
+    //
+    // Router path: WIDE2-2,WIDE7-2
+    //                      ~~~~~~~
+    //                      router_n_N_address
+    //                             7 2
+    //
+    // Input:  FROM>TO,WIDE7-7:data
+    //                 ~~~~~~~
+    //                 packet_n_N_address
+    //
+    // Output: FROM>TO,DIGI*:data
+    //                 ~~~~~
+    //                 router_address
+    //
+    // Returns 'true' if the route is trapped, 'false' otherwise
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
+    const std::string_view router_address = config.router_address_string;
+    const routing_option options = get_routing_options(Options{}, config);
+
+    bool trap_limit_exceeding_n_N_address = enum_has_flag(options, routing_option::trap_limit_exceeding_n_N_address);
+    bool traceless_n_N = enum_has_flag(options, routing_option::traceless_n_N_route);
+
+    if (trap_limit_exceeding_n_N_address)
+    {
+        if (router_n_N_address.N > 0 && packet_n_N_address.N > router_n_N_address.N)
+        {
+            if (!traceless_n_N)
+            {
+                routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address.index, router_address, enable_diagnostics, routing_actions_out);
+
+                array_assign(packet_n_N_address.text, packet_n_N_address.text_size, router_address.begin(), router_address.end());
+                packet_n_N_address.length = static_cast<uint16_t>(router_address.size());
+                packet_n_N_address.n = 0;
+                packet_n_N_address.N = 0;
+            }
+
+            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address.index, enable_diagnostics, routing_actions_out);
+            set_address_as_used(packet_addresses, packet_addresses_size, packet_n_N_address);
+            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address.index, enable_diagnostics, routing_actions_out);
+
+            return { routing_actions_out, true };
+        }
+    }
+
+    return { routing_actions_out, false };
+}
+
+template <class Options>
+APRS_ROUTER_INLINE_NO_DISABLE bool try_canonical_n_N_route(const router_config& config, route_scratch& state)
+{
+    // n-N route a packet initialized by try_init_canonical_addresses, without diagnostics
+    //
+    // Example:
+    //
+    //   Router address: DIGI
+    //
+    //   Router path: WIDE1,WIDE2
+    //
+    //   Packet: N0CALL>APRS,CALL*,WIDE2-2:data
+    //                             ~~~~~~~
+    //
+    //   Routed Packet: N0CALL>APRS,CALL,DIGI*,WIDE2-1:data
+    //                                   ~~~~~~~~~~~~~
+    //
+    // The unused address is the first n-N address, and the only one which can be routed,
+    // it is routed directly instead of searching the path with try_n_N_route.
+    // The steps and the result are the same as try_trap_n_N_route, try_complete_n_N_route,
+    // try_substitute_complete_n_N_address and try_insert_n_N_route, without the diagnostics.
+
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
+    const auto& router_n_N_addresses = config.router_n_N_addresses;
+    const size_t router_n_N_addresses_size = config.router_n_N_addresses_size;
+    const std::string_view router_address = config.router_address_string;
+    const routing_option options = get_routing_options(Options{}, config);
+    const size_t unused_address_index = state.unused_address_index;
+
+    const bool reject_limit_exceeding_n_N_address = enum_has_flag(options, routing_option::reject_limit_exceeding_n_N_address);
+    const bool trap_limit_exceeding_n_N_address = enum_has_flag(options, routing_option::trap_limit_exceeding_n_N_address);
+    const bool substitute_zero_hops = enum_has_flag(options, routing_option::substitute_complete_n_N_address);
+    const bool traceless_n_N = enum_has_flag(options, routing_option::traceless_n_N_route);
+
+    assert(unused_address_index < packet_addresses_size);
+
+    address& n_N_address = packet_addresses[unused_address_index];
+
+    assert(n_N_address.n > 0 && n_N_address.N > 0);
+
+    // Find the first router n-N address matching the unused address, see find_first_unused_n_N_address_index
+
+    const uint64_t n_N_address_key = get_n_N_address_key(n_N_address);
+
+    size_t router_n_N_index = find_next_matching_n_N_address(n_N_address, n_N_address_key, router_n_N_addresses, config.router_n_N_address_keys, router_n_N_addresses_size, 0);
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::reject_limit_exceeding_n_N_address))
+    {
+        while (reject_limit_exceeding_n_N_address && router_n_N_index < router_n_N_addresses_size &&
+               router_n_N_addresses[router_n_N_index].N > 0 && n_N_address.N > router_n_N_addresses[router_n_N_index].N)
+        {
+            router_n_N_index = find_next_matching_n_N_address(n_N_address, n_N_address_key, router_n_N_addresses, config.router_n_N_address_keys, router_n_N_addresses_size, router_n_N_index + 1);
+        }
+    }
+
+    if (router_n_N_index >= router_n_N_addresses_size)
+    {
+        return false;
+    }
+
+    // Trap an n-N address exceeding the router's hops, see try_trap_n_N_route
+
+    const address& router_n_N_address = router_n_N_addresses[router_n_N_index];
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::trap_limit_exceeding_n_N_address))
+    {
+        if (trap_limit_exceeding_n_N_address && router_n_N_address.N > 0 && n_N_address.N > router_n_N_address.N)
+        {
+            if (!traceless_n_N)
+            {
+                array_assign(n_N_address.text, n_N_address.text_size, router_address.begin(), router_address.end());
+                n_N_address.length = static_cast<uint16_t>(router_address.size());
+                n_N_address.n = 0;
+                n_N_address.N = 0;
+            }
+
+            set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
+            return true;
+        }
+    }
+
+    try_decrement_n_N_address(state, n_N_address);
+
+    // The path is full, see try_complete_n_N_route
+
+    if (packet_addresses_size >= path_addresses_max)
+    {
+        if (!substitute_zero_hops && n_N_address.N == 0)
+        {
+            set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
+            return true;
+        }
+
+        if (!substitute_zero_hops || n_N_address.N > 0)
+        {
+            return true;
+        }
+    }
+
+    if constexpr (may_have_routing_option(Options{}, routing_option::substitute_complete_n_N_address))
+    {
+        if (substitute_zero_hops && !traceless_n_N && n_N_address.N == 0)
+        {
+            try_substitute_complete_n_N_address(config, state, unused_address_index, false, discard_output_iterator{});
+            return true;
+        }
+    }
+
+    // Insert the router's address in front of the n-N address, see try_insert_n_N_route
+
+    const bool set_new_address_as_used = (substitute_zero_hops && !traceless_n_N) || n_N_address.N > 0;
+
+    if (!set_new_address_as_used)
+    {
+        set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
+    }
+
+    if (traceless_n_N)
+    {
+        return true;
+    }
+
+    struct address new_address;
+    array_assign(new_address.text, new_address.text_size, router_address.begin(), router_address.end());
+    new_address.kind = address_kind::other;
+    new_address.length = static_cast<uint16_t>(router_address.size());
+
+    size_t initial_offset = packet_addresses[0].offset;
+
+    array_insert(packet_addresses, packet_addresses_size, unused_address_index, new_address);
+
+    update_addresses_index(packet_addresses, packet_addresses_size);
+    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+
+    if (set_new_address_as_used)
+    {
+        set_address_as_used(packet_addresses, packet_addresses_size, unused_address_index);
+    }
+
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// TEST ROUTING                                                     //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+template <class InputIterator1, class InputIterator2, size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE bool try_apply_routing_actions(InputIterator1 original_path_begin, InputIterator1 original_path_end, InputIterator2 actions_begin, InputIterator2 actions_end, std::array<routed_address_slot, Size>& slots, size_t& slots_size)
+{
+    // Applies the routing actions to the original path, on a small array of address slots
+    //
+    // Every slot references its text, either in the original path or in a routing action,
+    // no text is copied. Every action is applied on the slots, and the routed packet
+    // can then be rendered in a single pass.
+    //
+    // Original path: CALLA,WIDE1-1,WIDE2-2
+    // Actions:       insert DIGI at 1, set 2
+    // Slots:         CALLA,DIGI,WIDE1-1*,WIDE2-2
+    //                      ~~~~ ~~~~~~~~
+    //                      action text, original text with one mark
+
+    slots_size = 0;
+
+    for (auto it = original_path_begin; it != original_path_end; ++it)
+    {
+        if (slots_size >= Size)
+        {
+            return false;
+        }
+        slots[slots_size++] = routed_address_slot{ std::string_view(*it), 0 };
+    }
+
+    for (auto it = actions_begin; it != actions_end; ++it)
+    {
+        const auto& a = *it;
+
+        std::string_view action_text(a.address.data(), a.address_size);
+
+        if (a.type == routing_action::remove)
+        {
+            if (a.index >= slots_size)
+            {
+                return false;
+            }
+            array_erase(slots, slots_size, a.index);
+        }
+        else if (a.type == routing_action::insert)
+        {
+            if (a.index > slots_size || slots_size >= Size)
+            {
+                return false;
+            }
+            array_insert(slots, slots_size, a.index, routed_address_slot{ action_text, 0 });
+        }
+        else if (a.type == routing_action::set)
+        {
+            if (a.index >= slots_size)
+            {
+                return false;
+            }
+            slots[a.index].marks++;
+        }
+        else if (a.type == routing_action::unset || a.type == routing_action::replace ||
+            a.type == routing_action::decrement)
+        {
+            if (a.index >= slots_size)
+            {
+                return false;
+            }
+            slots[a.index] = routed_address_slot{ action_text, 0 };
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet_by_index(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result)
+{
+    if (routing_result.state != routing_state::routed)
+    {
+        return false;
+    }
+
+    assert(routing_result.actions.size() > 0);
+
+    const auto& original_packet = routing_result.original_packet;
+
+    std::array<routed_address_slot, 2 * path_addresses_max> slots;
+    size_t slots_size = 0;
+
+    if (!try_apply_routing_actions(original_packet.path.begin(), original_packet.path.end(), routing_result.actions.begin(), routing_result.actions.end(), slots, slots_size))
+    {
+        return false;
+    }
+
+    // Build the routed path once, from the address slots
+
+    result.from = original_packet.from;
+    result.to = original_packet.to;
+    result.data = original_packet.data;
+    result.path.resize(slots_size);
+
+    for (size_t i = 0; i < slots_size; i++)
+    {
+        result.path[i].assign(slots[i].text.data(), slots[i].text.size());
+        result.path[i].append(slots[i].marks, '*');
+    }
+
+    return true;
+}
+
+APRS_ROUTER_INLINE bool try_route_packet_by_start_end(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result)
+{
+    if (routing_result.state != routing_state::routed)
+    {
+        return false;
+    }
+
+    assert(routing_result.actions.size() > 0);
+
+    // The edits use the start and end offsets, and are applied on the packet string
+    // Reserve the packet string once, for the largest possible routed packet
+
+    size_t packet_size = get_packet_string_size(routing_result.original_packet.from, routing_result.original_packet.to, routing_result.original_packet.path.begin(), routing_result.original_packet.path.end(), routing_result.original_packet.data);
+    size_t capacity = packet_size;
+
+    for (const auto& a : routing_result.actions)
+    {
+        capacity += a.address_size + 2;
+    }
+
+    std::string routed_packet;
+    routed_packet.reserve(capacity);
+    routed_packet.resize(packet_size);
+
+    format_packet(routing_result.original_packet.from, routing_result.original_packet.to, routing_result.original_packet.path.begin(), routing_result.original_packet.path.end(), routing_result.original_packet.data, routed_packet.begin());
+
+    for (const auto& a : routing_result.actions)
+    {
+        size_t start = a.start;
+        size_t end = a.end;
+        size_t count = a.end - a.start;
+
+        if (a.type == routing_action::remove)
+        {
+            if (routed_packet[end + 1] == ':' || a.index == 0)
+            {
+                count++;
+            }
+            else if (a.index != 0)
+            {
+                start--;
+                count++;
+            }
+            routed_packet.erase(start, count);
+        }
+        else if (a.type == routing_action::insert)
+        {
+            routed_packet.insert(start, a.address.data(), a.address_size);
+            if (routed_packet[end + 1] != ',' || a.index == 0)
+            {
+                routed_packet.insert(end, ",");
+            }
+        }
+        else if (a.type == routing_action::set)
+        {
+            routed_packet.insert(end, "*");
+        }
+        else if (a.type == routing_action::unset || a.type == routing_action::replace ||
+            a.type == routing_action::decrement)
+        {
+            routed_packet.erase(start, count);
+            routed_packet.insert(start, a.address.data(), a.address_size);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (!try_decode_packet(routed_packet, result))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTING RESULT                                                   //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE void init_routing_result(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, routing_result& result)
+{
+    result.routed = false;
+    result.success = true;
+    result.original_packet = packet;
+    result.routed_packet.from = packet.from;
+    result.routed_packet.to = packet.to;
+    result.routed_packet.data = packet.data;
+    result.routed_packet.path.clear();
+    result.actions.clear();
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> create_routing_ended_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out)
+{
+    routing_actions_out = push_routing_ended_diagnostic(state.packet_addresses[state.packet_addresses_size - 1], enable_diagnostics, routing_actions_out);
+    routing_state = routing_state::not_routed;
+    return { routing_actions_out, false };
+}
+
+APRS_ROUTER_INLINE bool create_routing_ended_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions)
+{
+    push_routing_ended_diagnostic(state.packet_addresses[state.packet_addresses_size - 1], enable_diagnostics, std::back_inserter(routing_actions));
+    routing_state = routing_state::not_routed;
+    return false;
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> create_routed_by_us_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out)
+{
+    routing_actions_out = push_routed_by_us_diagnostic(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, enable_diagnostics, routing_actions_out);
+    routing_state = routing_state::already_routed;
+    return { routing_actions_out, false };
+}
+
+APRS_ROUTER_INLINE bool create_routed_by_us_routing(const route_scratch& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions)
+{
+    push_routed_by_us_diagnostic(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, enable_diagnostics, std::back_inserter(routing_actions));
+    routing_state = routing_state::already_routed;
+    return false;
+}
+
+template <class OutputIterator1, class OutputIterator2, class OutputIterator3>
+APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> create_routed_routing(route_scratch& state, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out)
+{
+    bool result;
+    std::tie(routing_actions_out, result) = try_truncate_empty_addresses(state, enable_diagnostics, routing_actions_out);
+    (void)result;
+
+    if constexpr (std::is_same_v<OutputIterator1, discard_output_iterator> && std::is_same_v<OutputIterator2, discard_output_iterator>)
+    {
+        // The routed path is not needed, ex: it is formatted later from the route_scratch
+        return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, true };
+    }
+
+    using value_type = typename std::iterator_traits<OutputIterator1>::value_type;
+
+    for (size_t i = 0; i < state.packet_addresses_size; i++)
+    {
+        const auto& address = state.packet_addresses[i];
+        if (address.text_size != 0)
+        {
+            std::array<char, routed_address_text_max> routed_address = {};
+            size_t routed_address_size = 0;
+            to_string(address, routed_address, routed_address_size);
+
+            // Detect the output iterator's value_type to write each routed address
+            // into the caller's container without forcing a particular storage shape.
+
+            if constexpr (std::is_same_v<value_type, void>)
+            {
+                // Output iterator with value_type = void (e.g. back_insert_iterator).
+                *routed_packet_path_out++ = output_iterator_string_t<OutputIterator1>(routed_address.data(), routed_address_size);
+            }
+            else if constexpr (std::is_same_v<value_type, std::string>)
+            {
+                // Forward or random-access iterator into array<string,N> or vector<string>.
+                (*routed_packet_path_out).assign(routed_address.data(), routed_address_size);
+                ++routed_packet_path_out;
+            }
+            else if constexpr (is_std_array_of_char_v<value_type>)
+            {
+                // array<array<char,N>,M> + parallel sizes.
+                std::copy_n(routed_address.data(), routed_address_size, (*routed_packet_path_out).begin());
+                ++routed_packet_path_out;
+            }
+            else
+            {
+                // Generic fallback: any slot type constructible from (const char*, size_t).
+                *routed_packet_path_out++ = value_type(routed_address.data(), routed_address_size);
+            }
+
+            *routed_packet_path_address_sizes_out++ = routed_address_size;
+        }
+    }
+
+    return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, true };
+}
+
+APRS_ROUTER_INLINE bool create_routed_routing(route_scratch& state, bool enable_diagnostics, std::array<std::array<char, routed_address_text_max>, path_addresses_max>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, path_addresses_max>& routed_packet_path_address_sizes, internal_vector_t<routing_diagnostic>& routing_actions)
+{
+    auto [path_end, sizes_end, actions_end, result] = create_routed_routing(state, enable_diagnostics, routed_packet_path.begin(), routed_packet_path_address_sizes.begin(), std::back_inserter(routing_actions));
+    (void)path_end;
+    (void)actions_end;
+    routed_packet_path_size = static_cast<size_t>(std::distance(routed_packet_path_address_sizes.begin(), sizes_end));
+    return result;
+}
+
+APRS_ROUTER_INLINE bool create_routed_routing(route_scratch& state, bool enable_diagnostics, std::array<std::array<char, routed_address_text_max>, path_addresses_max>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, path_addresses_max>& routed_packet_path_address_sizes)
+{
+    internal_vector_t<routing_diagnostic> routing_actions;
+    return create_routed_routing(state, enable_diagnostics, routed_packet_path, routed_packet_path_size, routed_packet_path_address_sizes, routing_actions);
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTING CACHE                                                    //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE void init_routing_cache(size_t size, routing_cache& cache)
+{
+    // Clear the cache, and size it to hold at least "size" entries
+    //
+    // The entries are grouped in sets of routing_cache_ways entries,
+    // and the number of sets is a power of two, so a set can be selected by masking the hash
+
+    cache.entries.clear();
+    cache.hands.clear();
+    cache.hits = 0;
+    cache.misses = 0;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    size_t sets = 1;
+    while (sets * routing_cache_ways < size)
+    {
+        sets *= 2;
+    }
+
+    cache.entries.resize(sets * routing_cache_ways);
+    cache.hands.resize(sets);
+}
+
+APRS_ROUTER_INLINE uint64_t get_routing_cache_hash(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet)
+{
+    // FNV-1a hash of the packet header: N0CALL>APRS,WIDE1-1,WIDE2-1
+    //                                   ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // The separators are hashed as well, so "AB>C" and "A>BC" do not hash the same
+
+    uint64_t hash = 14695981039346656037ull;
+
+    auto hash_text = [&hash](std::string_view text, char separator)
+    {
+        for (char c : text)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        hash = (hash ^ static_cast<unsigned char>(separator)) * 1099511628211ull;
+    };
+
+    hash_text(packet.from, '>');
+    hash_text(packet.to, ',');
+
+    for (const auto& address : packet.path)
+    {
+        hash_text(address, ',');
+    }
+
+    return hash;
+}
+
+APRS_ROUTER_INLINE bool equal_routing_cache_header(const routing_cache_entry& entry, const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet)
+{
+    return entry.from == std::string_view(packet.from) &&
+        entry.to == std::string_view(packet.to) &&
+        std::equal(entry.path.begin(), entry.path.end(), packet.path.begin(), packet.path.end(),
+            [](const std::string& lhs, const auto& rhs) { return lhs == std::string_view(rhs); });
+}
+
+APRS_ROUTER_INLINE bool try_find_routing_cache_entry(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, uint64_t hash, routing_result& result, routing_cache& cache)
+{
+    // Find the routing decision of a packet with the same header, and update the routing result
+    //
+    // The hashes are compared first, and the header only if the hashes are equal
+
+    assert(!cache.entries.empty());
+
+    const size_t set = static_cast<size_t>(hash) & (cache.hands.size() - 1);
+
+    for (size_t i = set * routing_cache_ways; i < (set + 1) * routing_cache_ways; i++)
+    {
+        routing_cache_entry& entry = cache.entries[i];
+
+        if (entry.valid && entry.hash == hash && equal_routing_cache_header(entry, packet))
+        {
+            entry.referenced = true;
+            cache.hits++;
+
+            result.state = entry.state;
+            result.routed = (entry.state == routing_state::routed);
+
+            if (result.routed)
+            {
+                result.routed_packet.path.assign(entry.routed_path.begin(), entry.routed_path.end());
+            }
+            else
+            {
+                result.routed_packet.path = packet.path;
+            }
+
+            return true;
+        }
+    }
+
+    cache.misses++;
+
+    return false;
+}
+
+APRS_ROUTER_INLINE void insert_routing_cache_entry(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, uint64_t hash, const routing_result& result, routing_cache& cache)
+{
+    // Insert the routing decision of a packet into its set
+    //
+    // An empty entry is used if there is one, otherwise the CLOCK hand advances through the set,
+    // clearing the referenced flag of every entry it passes, and replaces the first entry
+    // which has not been referenced since the hand last passed it.
+
+    assert(!cache.entries.empty());
+
+    const size_t set = static_cast<size_t>(hash) & (cache.hands.size() - 1);
+    const size_t first = set * routing_cache_ways;
+
+    size_t& hand = cache.hands[set];
+    size_t victim = first + hand;
+
+    for (size_t i = first; i < first + routing_cache_ways; i++)
+    {
+        if (!cache.entries[i].valid)
+        {
+            victim = i;
+            break;
+        }
+    }
+
+    if (cache.entries[victim].valid)
+    {
+        while (cache.entries[first + hand].referenced)
+        {
+            cache.entries[first + hand].referenced = false;
+            hand = (hand + 1) % routing_cache_ways;
+        }
+        victim = first + hand;
+        hand = (hand + 1) % routing_cache_ways;
+    }
+
+    routing_cache_entry& entry = cache.entries[victim];
+
+    entry.hash = hash;
+    entry.from.assign(std::string_view(packet.from));
+    entry.to.assign(std::string_view(packet.to));
+    entry.path.resize(std::size(packet.path));
+    std::copy(std::begin(packet.path), std::end(packet.path), entry.path.begin());
+    entry.routed_path.clear();
+    if (result.routed)
+    {
+        entry.routed_path.assign(result.routed_packet.path.begin(), result.routed_packet.path.end());
+    }
+    entry.state = result.state;
+    entry.valid = true;
+    entry.referenced = false;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTER SET                                                       //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE uint64_t get_address_prefix_key(unsigned char c0, unsigned char c1)
+{
+    // Single characters and pairs of characters have distinct keys,
+    // as a pair key always has a non zero first character in the second byte
+    return c1 == 0 ? c0 : ((static_cast<uint64_t>(c0) << 8) | c1);
+}
+
+APRS_ROUTER_INLINE uint64_t get_address_prefix_key(const address& address)
+{
+    // Key of the first two characters of the canonical form of the address, see add_address_prefilter
+    //
+    // Router address:   WIDE1-1   WIDE2    A
+    // Canonical:        WIDE1     WIDE2    A
+    // Key:              WI        WI       A
+
+    unsigned char c0 = static_cast<unsigned char>(address.text[0]);
+
+    if (address.text_size == 1 && address.n == 0)
+    {
+        return get_address_prefix_key(c0, 0);
+    }
+
+    unsigned char c1 = static_cast<unsigned char>(address.text_size > 1 ? address.text[1] : '0' + address.n);
+
+    return get_address_prefix_key(c0, c1);
+}
+
+APRS_ROUTER_INLINE void add_router_set_index(const router_config& config, size_t router_id, router_set& set)
+{
+    // Index a router by the keys of its address, explicit addresses and n-N addresses
+
+    set.index.emplace_back(get_address_prefix_key(config.router_address), router_id);
+
+    for (size_t i = 0; i < config.router_explicit_addresses_size; i++)
+    {
+        if (config.router_explicit_addresses[i].text_size > 0)
+        {
+            set.index.emplace_back(get_address_prefix_key(config.router_explicit_addresses[i]), router_id);
+        }
+    }
+
+    for (size_t i = 0; i < config.router_n_N_addresses_size; i++)
+    {
+        if (config.router_n_N_addresses[i].text_size > 0)
+        {
+            set.index.emplace_back(get_address_prefix_key(config.router_n_N_addresses[i]), router_id);
+        }
+    }
+}
+
+APRS_ROUTER_INLINE void find_router_set_candidates(const route_scratch& state, router_set& set)
+{
+    // Find the routers which could route the packet, the same routers which would pass the prefilter
+    //
+    // The first one and two characters of the 'from', 'to' and path addresses are looked up in the index,
+    // a packet sent by or to a router is reported by that router as cannot_route_self or already_routed.
+    //
+    // Router set:    DIGI1 (WIDE1), DIGI2 (WIDE2), DIGI3 (CALLA)
+    // Packet:        N0CALL>APRS,WIDE2-2:data
+    //                            ~~
+    // Candidates:    DIGI1, DIGI2
+
+    std::fill(set.candidates.begin(), set.candidates.end(), false);
+
+    for (size_t router_id : set.unindexed)
+    {
+        set.candidates[router_id] = true;
+    }
+
+    if (set.index.empty())
+    {
+        return;
+    }
+
+    auto find_candidates = [&set](uint64_t key)
+    {
+        auto it = std::lower_bound(set.index.begin(), set.index.end(), std::pair<uint64_t, size_t>(key, 0));
+        for (; it != set.index.end() && it->first == key; ++it)
+        {
+            set.candidates[it->second] = true;
+        }
+    };
+
+    auto find_address_candidates = [&find_candidates](std::string_view address)
+    {
+        if (address.empty())
+        {
+            return;
+        }
+        unsigned char c0 = static_cast<unsigned char>(address[0]);
+        find_candidates(get_address_prefix_key(c0, 0));
+        if (address.size() > 1)
+        {
+            find_candidates(get_address_prefix_key(c0, static_cast<unsigned char>(address[1])));
+        }
+    };
+
+    find_address_candidates(state.packet_from_address);
+    find_address_candidates(state.packet_to_address);
+
+    for (size_t i = 0; i < state.packet_path_size; i++)
+    {
+        find_address_candidates(std::string_view(state.packet_path[i].data(), state.packet_path_address_sizes[i]));
+    }
+}
+
+#if APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// RELOADABLE ROUTER                                                //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE size_t enter_reloadable_router(reloadable_router& router)
+{
+    // Count the packet in the reader count of the current epoch
+    //
+    // The reader is counted before the router pointer is read,
+    // a reload which has already swapped the pointer may wait for this reader unnecessarily,
+    // but a reload can never miss a reader which reads the previous pointer.
+
+    const size_t epoch = router.epoch.load() & 1;
+    router.readers[epoch].fetch_add(1);
+    return epoch;
+}
+
+APRS_ROUTER_INLINE void leave_reloadable_router(size_t epoch, reloadable_router& router)
+{
+    router.readers[epoch].fetch_sub(1);
+}
+
+APRS_ROUTER_INLINE void wait_for_reloadable_router_readers(reloadable_router& router)
+{
+    // Wait for all the packets routed with the previous router
+    //
+    // The epoch is advanced before waiting, new readers are counted in the other epoch,
+    // so the wait ends even if packets are routed continuously.
+    //
+    // A reader reads the epoch before it is counted, a reader delayed across a previous reload
+    // can be counted in either epoch. The readers of both epochs are waited for, any reader
+    // counted before the pointer swap, which could have read the previous router, has then finished.
+
+    for (int i = 0; i < 2; i++)
+    {
+        const size_t epoch = router.epoch.fetch_add(1) & 1;
+        while (router.readers[epoch].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+#endif // APRS_ROUTER_ENABLE_RELOADABLE_ROUTER
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTING DIAGNOSTICS                                              //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
 
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    size_t& packet_addresses_size = state.packet_addresses_size;
-    const bool is_path_based_routing = state.is_path_based_routing;
-    const size_t unused_address_index = state.unused_address_index;
-    const address& router_address = state.router_address;
-    const std::string_view router_address_string = state.router_address_string;
-    const routing_option options = state.options;
-    assert(set_address_index < packet_addresses_size);
-    assert(unused_address_index < packet_addresses_size);
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_routing_ended_diagnostic(const address& address, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    if (enable_diagnostics)
+    {
+        routing_diagnostic diag;
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::warn;
+        diag.message_type = message_type::routing_ended;
+        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
+        diag.start = address.offset;
+        diag.end = diag.start + address.length;
+        diag.index = address.index;
 
-    bool substitute_explicit_address = enum_has_flag(options, routing_option::substitute_explicit_address);
+        *routing_actions_out++ = diag;
+    }
+    return routing_actions_out;
+}
 
-    if (substitute_explicit_address)
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_routed_by_us_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    if (enable_diagnostics && maybe_last_used_address_index)
     {
-        routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, set_address_index, router_address_string, enable_diagnostics, routing_actions_out);
-        replace_address_with_router_address(packet_addresses[set_address_index], router_address);
-        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
-        set_address_as_used(packet_addresses, packet_addresses_size, set_address_index);
-        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
-        return { routing_actions_out, true };
+        routing_diagnostic diag;
+
+        const address& address = packet_addresses[maybe_last_used_address_index.value()];
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::warn;
+        diag.message_type = message_type::already_routed;
+        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
+        diag.start = address.offset;
+        diag.end = diag.start + address.length;
+        diag.index = address.index;
+
+        *routing_actions_out++ = diag;
     }
+    return routing_actions_out;
+}
 
-    if (is_path_based_routing)
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_set_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    assert(set_address_index < packet_addresses_size); (void)packet_addresses_size;
+
+    if (enable_diagnostics)
     {
-        if (try_insert_address(packet_addresses, packet_addresses_size, unused_address_index, router_address_string))
+        routing_diagnostic diag;
+
+        const address& address = packet_addresses[set_address_index];
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::set;
+        diag.message_type = message_type::address_set;
+        to_string(address, diag.address, diag.address_size);
+        diag.start = address.offset;
+        diag.end = diag.start + address.length;
+        diag.index = set_address_index;
+
+        if (address.mark && diag.address_size > 0)
         {
-            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
-            set_address_as_used(packet_addresses, packet_addresses_size, set_address_index + 1);
-            routing_actions_out = push_address_inserted_diagnostic(packet_addresses, packet_addresses_size, unused_address_index, enable_diagnostics, routing_actions_out);
-            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index + 1, enable_diagnostics, routing_actions_out);
+            // Remove the '*' marker
+            diag.address_size--;
+            diag.end--;
         }
-        else
+
+        *routing_actions_out++ = diag;
+    }
+    return routing_actions_out;
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_unset_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    // Called before unsetting addresses, before calling 'set_address_as_used'
+
+    size_t set_address_index = maybe_set_address_index.value_or(packet_addresses_size); // intentionally out of bounds if not set
+
+    assert(!maybe_set_address_index || set_address_index < packet_addresses_size);
+    assert(packet_addresses_size > 0);
+
+    if (enable_diagnostics)
+    {
+        size_t i = 0;
+        size_t offset = packet_addresses[0].offset;
+        for (size_t address_index = 0; address_index < packet_addresses_size; address_index++)
         {
-            routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, set_address_index, router_address_string, enable_diagnostics, routing_actions_out);
-            replace_address_with_router_address(packet_addresses[set_address_index], router_address);
-            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
-            set_address_as_used(packet_addresses, packet_addresses_size, set_address_index);
-            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
+            const auto& address = packet_addresses[address_index];
+            size_t length = address.length;
+
+            if (address.mark && address.index != set_address_index)
+            {
+                routing_diagnostic diag;
+
+                diag.target = applies_to::path;
+                diag.type = routing_action::unset;
+                diag.message_type = message_type::address_unset;
+                to_string(address, diag.address, diag.address_size);
+                diag.start = offset;
+                diag.end = diag.start + length;
+                diag.index = i;
+
+                if (address.mark && diag.address_size > 0)
+                {
+                    // Remove the '*' marker
+                    diag.address_size--;
+                }
+
+                *routing_actions_out++ = diag;
+            }
+
+            if (address.mark)
+            {
+                length--;
+            }
+
+            offset += length + 1;
+
+            i++;
         }
     }
-    else
+    return routing_actions_out;
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_replaced_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, std::string_view new_address, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    assert(set_address_index < packet_addresses_size); (void)packet_addresses_size;
+
+    if (enable_diagnostics)
     {
-        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
-        set_address_as_used(packet_addresses, packet_addresses_size, set_address_index);
-        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, set_address_index, enable_diagnostics, routing_actions_out);
-    }
+        routing_diagnostic diag;
 
-    return { routing_actions_out, true };
+        const address& address = packet_addresses[set_address_index];
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::replace;
+        diag.message_type = message_type::address_replaced;
+        array_assign(diag.address, diag.address_size, new_address.begin(), new_address.end());
+        diag.start = address.offset;
+        diag.end = diag.start + address.length;
+        diag.index = set_address_index;
+
+        *routing_actions_out++ = diag;
+    }
+    return routing_actions_out;
 }
 
 template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_preempt_explicit_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_decremented_diagnostic(address& address, bool enable_diagnostics, OutputIterator routing_actions_out)
 {
-    bool result;
-    std::tie(routing_actions_out, result) = try_preempt_transform_explicit_route(state, enable_diagnostics, routing_actions_out);
-    if (result)
+    if (enable_diagnostics)
     {
-        return try_explicit_basic_route(state, state.unused_address_index, enable_diagnostics, routing_actions_out);
+        routing_diagnostic diag;
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::decrement;
+        diag.message_type = message_type::address_decremented;
+        to_string(address, diag.address, diag.address_size);
+        diag.start = address.offset;
+        diag.end = diag.start + address.length;
+        diag.index = address.index;
+
+        // +2 as push_address_decremented_diagnostic is called after the address was decremented
+        // with the length decremented by 2 if N is 0
+        if (address.N == 0)
+        {
+            diag.end += 2;
+        }
+
+        *routing_actions_out++ = diag;
     }
-    return { routing_actions_out, false };
+    return routing_actions_out;
 }
 
 template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_preempt_transform_explicit_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_inserted_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t insert_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
 {
-    // We cannot reach here if the router's address is not found
-    assert(state.maybe_router_address_index.has_value());
+    assert(insert_address_index < packet_addresses_size); (void)packet_addresses_size;
 
-    const routing_option options = state.options;
-    const size_t router_address_index = state.maybe_router_address_index.value();
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    size_t& packet_addresses_size = state.packet_addresses_size;
-    size_t& unused_address_index = state.unused_address_index;
+    if (enable_diagnostics)
+    {
+        routing_diagnostic diag;
 
-    assert(router_address_index < packet_addresses_size);
-    assert(unused_address_index < packet_addresses_size);
+        const address& address = packet_addresses[insert_address_index];
 
-    if (enum_has_flag(options, routing_option::preempt_front))
-    {
-        // Diagnostics are calculated before the move.
-        // Store diagnostics in a temporary array, and if the move is not successful
-        // then we will not add the diagnostics to the actions.
-        // Sized for the worst case: create_address_move_diagnostic emits exactly 2 entries.
-        std::array<routing_diagnostic, 8> routing_actions_temp{};
-        auto routing_actions_temp_end = create_address_move_diagnostic(packet_addresses, packet_addresses_size, router_address_index, unused_address_index, enable_diagnostics, routing_actions_temp.begin(), routing_actions_temp.end());
-        if (try_move_address_to_position(packet_addresses, packet_addresses_size, router_address_index, unused_address_index))
-        {
-            routing_actions_out = std::copy(routing_actions_temp.begin(), routing_actions_temp_end, routing_actions_out);
-        }
-        return { routing_actions_out, true };
+        diag.target = applies_to::path;
+        diag.type = routing_action::insert;
+        diag.message_type = message_type::address_inserted;
+        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
+        diag.start = address.offset;
+        diag.end = diag.start + address.text_size;
+        diag.index = insert_address_index;
+
+        *routing_actions_out++ = diag;
     }
-    else if (enum_has_flag(options, routing_option::preempt_truncate))
+    return routing_actions_out;
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_removed_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t remove_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+{
+    assert(remove_address_index < packet_addresses_size); (void)packet_addresses_size;
+
+    if (enable_diagnostics)
     {
-        // Diagnostics are calculated before the move.
-        // Store diagnostics in a temporary array, and if the move is not successful
-        // then we will not add the diagnostics to the actions.
-        // Sized for the worst case: create_truncate_address_range_diagnostic emits at most (packet_addresses_size - 1) entries,
-        // with packet_addresses_size capped at 8.
-        std::array<routing_diagnostic, 8> routing_actions_temp{};
-        auto routing_actions_temp_end = create_truncate_address_range_diagnostic(packet_addresses, packet_addresses_size, unused_address_index, router_address_index, enable_diagnostics, routing_actions_temp.begin(), routing_actions_temp.end());
-        if (try_truncate_address_range(packet_addresses, packet_addresses_size, unused_address_index, router_address_index))
-        {
-            routing_actions_out = std::copy(routing_actions_temp.begin(), routing_actions_temp_end, routing_actions_out);
-        }
-        return { routing_actions_out, true };
+        routing_diagnostic diag;
+
+        const address& address = packet_addresses[remove_address_index];
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::remove;
+        diag.message_type = message_type::address_removed;
+        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
+        diag.start = address.offset;
+        diag.end = diag.start + address.text_size;
+        diag.index = remove_address_index;
+
+        *routing_actions_out++ = diag;
     }
-    else if (enum_has_flag(options, routing_option::preempt_drop))
+    return routing_actions_out;
+}
+
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator create_address_move_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end)
+{
+    assert(from_index < packet_addresses_size);
+    assert(to_index < packet_addresses_size); (void)packet_addresses_size;
+
+    OutputIterator routing_actions_out = routing_actions_out_begin;
+
+    if (enable_diagnostics)
     {
-        // Diagnostics are calculated before the move.
-        // Store diagnostics in a temporary array, and if the move is not successful
-        // then we will not add the diagnostics to the actions.
-        // Sized for the worst case: create_truncate_address_range_diagnostic emits at most (packet_addresses_size - 1) entries,
-        // with packet_addresses_size capped at 8.
-        std::array<routing_diagnostic, 8> routing_actions_temp{};
-        auto routing_actions_temp_end = create_truncate_address_range_diagnostic(packet_addresses, packet_addresses_size, 0, router_address_index, enable_diagnostics, routing_actions_temp.begin(), routing_actions_temp.end());
-        if (try_truncate_address_range(packet_addresses, packet_addresses_size, 0, router_address_index))
+        routing_diagnostic remove_diag;
+
+        const address& removed_address = packet_addresses[from_index];
+
+        remove_diag.target = applies_to::path;
+        remove_diag.type = routing_action::remove;
+        remove_diag.message_type = message_type::address_removed;
+        to_string(removed_address, remove_diag.address, remove_diag.address_size);
+        remove_diag.start = removed_address.offset;
+        remove_diag.end = remove_diag.start + removed_address.length;
+        remove_diag.index = from_index;
+
+        assert(routing_actions_out != routing_actions_out_end);
+        if (routing_actions_out == routing_actions_out_end)
         {
-            routing_actions_out = std::copy(routing_actions_temp.begin(), routing_actions_temp_end, routing_actions_out);
+            return routing_actions_out;
         }
 
-        // Reset the unused address index to 0 as we are dropping all the addresses
-        // in front of the router's matched address
-        //
-        // Example:
-        //
-        // Router address: DIGI
-        // Router path: E
-        //
-        // Original packet: N0CALL>APRS,A,B*,C,D,E,F:data
-        //                                   ~
-        //                                   unused_address_index = 2
-        // 
-        // Truncated packet: N0CALL>APRS,E,F:data
-        //                               ~
-        //                               unused_address_index = 0
+        *routing_actions_out++ = remove_diag;
 
-        unused_address_index = 0;
+        routing_diagnostic insert_diag;
 
-        return { routing_actions_out, true };
-    }
-    else if (enum_has_flag(options, routing_option::preempt_mark))
-    {
-        // Reset the unused address index to the index of the router's matched address
-        //
-        // Example:
-        //
-        // Router address: DIGI
-        // Router path: E
-        //
-        // Original packet: N0CALL>APRS,A,B*,C,D,E,F:data
-        //                                   ~
-        //                                   unused_address_index = 2
-        // 
-        // Original packet: N0CALL>APRS,A,B*,C,D,E,F:data
-        //                                       ~
-        //                                       unused_address_index = 4
+        const address& inserted_address = packet_addresses[to_index];
+
+        insert_diag.target = applies_to::path;
+        insert_diag.type = routing_action::insert;
+        insert_diag.message_type = message_type::address_inserted;
+        to_string(removed_address, insert_diag.address, insert_diag.address_size);
+        insert_diag.start = inserted_address.offset;
+        insert_diag.end = insert_diag.start + removed_address.length;
+        insert_diag.index = to_index;
 
-        unused_address_index = router_address_index;
+        assert(routing_actions_out != routing_actions_out_end);
+        if (routing_actions_out == routing_actions_out_end)
+        {
+            return routing_actions_out;
+        }
 
-        return { routing_actions_out, true };
+        *routing_actions_out++ = insert_diag;
     }
 
-    return { routing_actions_out, false };
+    (void)routing_actions_out_end;
+
+    return routing_actions_out;
 }
 
 template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_n_N_route(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator create_truncate_address_range_diagnostic(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end)
 {
-    // n-N routing function. Routes a packet using the n-N routing algorithm.
-    //
-    // If the first unused address in the packet is an n-N address, apply the n-N routing algorithm:
-    //
-    // Example:
-    //
-    //   Router address: DIGI
-    //
-    //   Router path: WIDE2-2,WIDE1-2
-    //
-    //   Packet: N0CALL>APRS,CALL*,WIDE1-2,WIDE2-2:data
-    //                           ~ ~~~~~~~
-    //
-    //   Routed Packet: N0CALL>APRS,CALL,DIGI*,WIDE1-1,WIDE2-2:data
-    //                                 ~ ~~~~~~~~~~~~~
-    //
-    // If an n-N packet address exceeds the maximum number of hops, trap it if "trap_limit_exceeding_n_N_address" is set:
-    //
-    // Example:
-    // 
-    //   Router path: WIDE2-2
-    //
-    //   Packet: N0CALL>APRS,CALL*,WIDE2-3:data
-    //                             ~~~~~~~
-    //
-    //   Routed Packet: N0CALL>APRS,CALL,DIGI*:data
-    //                                   ~~~~~
-
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    const size_t packet_addresses_size = state.packet_addresses_size;
-    const auto& router_n_N_addresses = state.router_n_N_addresses;
-    const size_t router_n_N_addresses_size = state.router_n_N_addresses_size;
-    const routing_option options = state.options;
-    const size_t unused_address_index = state.unused_address_index;
-    const address& unused_address = state.packet_addresses[unused_address_index];
+    assert(from_index < packet_addresses_size);
+    assert(to_index < packet_addresses_size);
+    (void)packet_addresses_size;
 
-    auto unused_address_index_pair = find_first_unused_n_N_address_index(packet_addresses, packet_addresses_size, router_n_N_addresses, router_n_N_addresses_size, options);
+    OutputIterator routing_actions_out = routing_actions_out_begin;
 
-    if (!unused_address_index_pair)
+    if (!enable_diagnostics)
     {
-        return { routing_actions_out, false };
+        (void)routing_actions_out_end;
+        return routing_actions_out;
     }
 
-    auto [address_n_N_index, router_n_N_index] = unused_address_index_pair.value();
+    assert(from_index < packet_addresses_size);
 
-    // We should not route the packet if we have other unused addresses in front of us.
-    // If we have unused addresses, then we should stop the routing process:
-    //
-    // N0CALL>APRS,CALL,WIDE1-1,WIDE2-1:data
-    //             ~~~~
-    //             unused address
-    //
-    //  But we should still allow empty addresses to be routed so they can be removed
+    size_t initial_offset = packet_addresses[from_index].offset;
 
-    if (address_n_N_index > unused_address_index)
+    for (size_t i = from_index; i < packet_addresses_size && i < to_index; i++)
     {
-        if (unused_address.text_size != 0)
+        routing_diagnostic diag;
+
+        const address& address = packet_addresses[i];
+
+        diag.target = applies_to::path;
+        diag.type = routing_action::remove;
+        diag.message_type = message_type::address_removed;
+        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
+        diag.start = initial_offset;
+        diag.end = diag.start + address.length;
+        diag.index = from_index;
+
+        assert(routing_actions_out != routing_actions_out_end);
+        if (routing_actions_out == routing_actions_out_end)
         {
-            return { routing_actions_out, false };
+            return routing_actions_out;
         }
-    }
 
-    assert(address_n_N_index < packet_addresses_size);
-    assert(router_n_N_index < router_n_N_addresses_size);
-
-    bool result;
-    std::tie(routing_actions_out, result) = try_trap_n_N_route(state, packet_addresses[address_n_N_index], router_n_N_addresses[router_n_N_index], enable_diagnostics, routing_actions_out);
-    if (result)
-    {
-        return { routing_actions_out, true };
+        *routing_actions_out++ = diag;
     }
 
-    return try_n_N_route_no_trap(state, address_n_N_index, enable_diagnostics, routing_actions_out);
+    (void)routing_actions_out_end;
+
+    return routing_actions_out;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_n_N_route_no_trap(route_state& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ROUTING DIAGNOSTICS FORMAT                                       //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE std::string create_display_name_diagnostic(const routing_diagnostic_display_entry& line)
 {
-    // Route an ADDRESSn-N address.
-    //
-    // Route a packet through a routing "path" that matches an address with the n-N format (e.g., WIDE2-1).
-    //
-    // Pick the very first matching n-N address among the packet's addresses:
-    //
-    //   1. Decrement the 'N' part of the ADDRESSn-N address to indicate one less hop remaining.
-    //
-    //   2. Insert the router's address in front of the matched address to mark it as the next hop.
-    //
-    //      2.a. Mark the router's address as "used" with an asterix (*), if N > 0
-    //
-    //   3. If the N part of the ADDRESSn-N is decremented to 0, then:
-    //
-    //      3.a. If "substitute_complete_n_N_address" is set, remove the ADDRESSn-N where N is 0
-    //
-    //      3.b. If "substitute_complete_n_N_address" is not set, mark the ADDRESSn-N as "used"
-    //
-    //   4. Create and update the routing result to reflect these changes.
-    //
-    // Example:
+    // Creates a diagnostic message.
     //
-    //   Router address:  DIGI
+    // Beginning of example:
     //
-    //   Router path:     WIDE1-1,WIDE2-1
-    //                    ~~~~~~~~~~~~~~~
-    //                    router_n_N_addresses
+    // Packet address removed:
     //
-    //   Original packet: N0CALL>APRS,CALL*,WIDE1-1,WIDE2-1:data
-    //                                ~~~~~~~~~~~~~~~~~~~~~
-    //                                packet_addresses
+    // N0CALL>APRS,CALLA,CALLB,CALLC,CALLD:data
+    //                               ~~~~~
     //
-    //   After step 1:    N0CALL>APRS,CALL*,WIDE1,WIDE2-1:data
-    //   After step 2:    N0CALL>APRS,CALL*,DIGI,WIDE1,WIDE2-1:data
-    //   After step 2.a:  N0CALL>APRS,CALL*,DIGI,WIDE1,WIDE2-1:data
-    //   After step 3.a:  N0CALL>APRS,CALL,DIGI*,WIDE2-1:data
-    //   After step 3.b:  N0CALL>APRS,CALL,DIGI,WIDE1*,WIDE2-1:data
+    // End of example
 
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    const size_t packet_addresses_size = state.packet_addresses_size;
-    const routing_option options = state.options;
+    std::string diag_string;
 
-    assert(packet_n_N_address_index < packet_addresses_size);
+    diag_string.append(line.message);
+    diag_string.append(":");
+    diag_string.append("\n");
+    diag_string.append("\n");
+    diag_string.append(line.packet_string);
+    diag_string.append("\n");
+    diag_string.append(line.highlight_string);
+    diag_string.append("\n");
+    diag_string.append("\n");
 
-    bool substitute_zero_hops = enum_has_flag(options, routing_option::substitute_complete_n_N_address);
-    bool traceless_n_N = enum_has_flag(options, routing_option::traceless_n_N_route);
+    return diag_string;
+}
 
-    address& n_N_address = packet_addresses[packet_n_N_address_index];
+APRS_ROUTER_INLINE routing_diagnostic_display_entry create_diagnostic_print_line(const routing_diagnostic& diag, const APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& routed_packet)
+{
+    // Creates a diagnostic entry.
+    //
+    // Packet string    - entry.packet_string:     "N0CALL>APRS,CALLA,CALLB,CALLC,CALLD:data"
+    // Highlight string - entry.highlight_string:  "                              ~~~~~"
+    // Message          - entry.message:           "Packet address removed"
 
-    assert(n_N_address.n > 0);
+    routing_diagnostic_display_entry entry;
 
-    if (try_decrement_n_N_address(state, n_N_address))
+    entry.message = to_string(diag.message_type);
+    entry.packet_string = to_string(routed_packet);
+    entry.highlight_string.append(std::string(diag.start, ' '));
+    entry.highlight_string.append(std::string(diag.end - diag.start, '~'));
+
+    if (diag.type == routing_action::set)
     {
-        routing_actions_out = push_address_decremented_diagnostic(n_N_address, enable_diagnostics, routing_actions_out);
+        entry.highlight_string.append("~");
     }
 
-    // If we are in a position which will require us to insert more than 8 addresses
-    // just return, the only thing we can do is increment the counter
+    return entry;
+}
 
-    bool result;
-    std::tie(routing_actions_out, result) = try_complete_n_N_route(state, n_N_address, substitute_zero_hops, enable_diagnostics, routing_actions_out);
-    if (result)
-    {
-        return { routing_actions_out, true };
-    }
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// ADDRESS                                                          //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
 
-    if (substitute_zero_hops && !traceless_n_N && n_N_address.N == 0)
-    {
-        std::tie(routing_actions_out, result) = try_substitute_complete_n_N_address(state, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
-        (void)result;
-        return { routing_actions_out, true };
-    }
+APRS_ROUTER_INLINE bool operator==(const address& lhs, const address& rhs)
+{
+    return lhs.text_size == rhs.text_size &&
+           std::equal(lhs.text.begin(), lhs.text.begin() + lhs.text_size, rhs.text.begin()) &&
+           lhs.n == rhs.n &&
+           lhs.N == rhs.N &&
+           lhs.ssid == rhs.ssid &&
+           lhs.mark == rhs.mark;
+}
 
-    return try_insert_n_N_route(state, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
+APRS_ROUTER_INLINE bool operator!=(const address& lhs, const address& rhs)
+{
+    return !(lhs == rhs);
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_complete_n_N_route(route_state& state, address& n_N_address, bool substitute_zero_hops, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE void to_string(const struct address& address, std::array<char, routed_address_text_max>& result, size_t& result_size)
 {
-    // If we are in a position which will require us to insert more than 8 addresses
-    // just return, the only thing we can do is increment the n-N counter
-    //
-    // Example:
-    //
-    // Input: FROM>TO,A,B,C,D,E,F,G,WIDE2-2:data
-    //                ~ ~ ~ ~ ~ ~ ~ ~~~~~~~
-    //
-    // Output: FROM>TO,A,B,C,D,E,F,G,WIDE2-1:data
-    //                               ~~~~~~~
-    //
-    // There are a few circumstances where we can still continue with the 
-    // insertion even when the address count is 8. For example if we will
-    // shortly shrink the packet path (substitute_complete_n_N_address)
+    result_size = 0;
+
+    if (address.text_size == 0)
+    {
+        return;
+    }
+
+    array_assign(result, result_size, address.text.data(), address.text.data() + address.text_size);
+
+    if (address.n > 0)
+    {
+        result[result_size++] = char('0' + address.n);
+    }
 
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    const size_t packet_addresses_size = state.packet_addresses_size;
+    if (address.N > 0)
+    {
+        result[result_size++] = '-';
+        result[result_size++] = char('0' + address.N);
+    }
 
-    if (packet_addresses_size >= 8)
+    if (address.ssid > 0)
     {
-        // The n-N address has no remaining hops, but we cannot substitute it
-        // with our router's address because "substitute_zero_hops" is unset
-        // we also have more than 8 addresses, so just mark the completed address as "set"
-        if (!substitute_zero_hops && n_N_address.N == 0)
+        result[result_size++] = '-';
+        if (address.ssid < 10)
         {
-            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
-            set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
-            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
-
-            return { routing_actions_out, true };
+            result[result_size++] = char('0' + address.ssid);
         }
-
-        // The n-N address has remaining hops, and we have more than 8 addresses
-        // We've decremented it earlier (above), don't change any used flag,
-        // just exit as we are done
-        if (!substitute_zero_hops || n_N_address.N > 0)
+        else
         {
-            return { routing_actions_out, true };
+            // 10 .. 15 => "1" + '0'..'5'
+            result[result_size++] = '1';
+            result[result_size++] = char('0' + (address.ssid - 10));
         }
     }
 
-    return { routing_actions_out, false };
+    if (address.mark)
+    {
+        result[result_size++] = '*';
+    }
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_insert_n_N_route(route_state& state, size_t& packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE internal_string_t<char> to_string(const struct address& address)
 {
-    // Insert the router's address in front of the n-N address:
-    //
-    // Example:
-    //
-    // Input:  FROM>TO,CALL,WIDE2-1:data
-    //                      ~~~~~~~
+    std::array<char, routed_address_text_max> result = {};
+    size_t result_size = 0;
+    to_string(address, result, result_size);
+    return internal_string_t<char>(result.data(), result_size);
+}
+
+APRS_ROUTER_INLINE bool equal_address_text(const struct address& lhs, const struct address& rhs)
+{
+    return lhs.text_size == rhs.text_size &&
+        std::equal(lhs.text.begin(), lhs.text.begin() + lhs.text_size, rhs.text.begin());
+}
+
+APRS_ROUTER_INLINE bool equal_addresses_ignore_mark(const struct address& lhs, const struct address& rhs)
+{
+    // Normally we simply use to_string(lhs) == to_string(rhs) to compare addresses.
+    // But "to_string" requires us to make a copy of an address to unset the "mark" fields (we typically ignore '*' in address comparisons).
+    // Additionally, to_string allocates heap memory in debug builds.
     //
-    // Output: FROM>TO,CALL,DIGI*,WIDE2-1:data
-    //                      ~~~~~
-    //                      Insert and mark the router's address as used
-    //                      n-N address is left unchanged by this function
+    // This implementation is a fast address comparison function. This function makes no heap memory allocations, nor requires object copies.
+    // It trades a bit of speed speed for memory usage.
+    // As part of the comparison, it ignores the "mark" field of the address.
 
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    size_t& packet_addresses_size = state.packet_addresses_size;
-    const std::string_view router_address = state.router_address_string;
-    const bool substitute_zero_hops = enum_has_flag(state.options, routing_option::substitute_complete_n_N_address);
-    const bool traceless_n_N = enum_has_flag(state.options, routing_option::traceless_n_N_route);
+    // Ensure the addresses are valid.
+    // An address cannot have both the n and N fields and ssid set.
+    // If the N number is set, the n number must also be set.
 
-    assert(packet_n_N_address_index < packet_addresses_size);
-    assert(packet_addresses_size < 8);
+    assert(lhs.n >= 0 && lhs.n <= 7 && lhs.N >= 0 && lhs.N <= 7);
+    assert(rhs.n >= 0 && rhs.n <= 7 && rhs.N >= 0 && rhs.N <= 7);
+    assert(lhs.ssid >= 0 && lhs.ssid <= 15);
+    assert(rhs.ssid >= 0 && rhs.ssid <= 15);
+    assert(lhs.n == 0 || lhs.ssid == 0);
+    assert(rhs.n == 0 || rhs.ssid == 0);
+    assert(lhs.N == 0 || (lhs.N > 0 && lhs.n > 0));
+    assert(rhs.N == 0 || (rhs.N > 0 && rhs.n > 0));
 
-    struct address& n_N_address = packet_addresses[packet_n_N_address_index];
+    // Various combinations of n, N numbers and ssid can make addresses be equal to each other.
+    // 
+    //      address      address text     n     -    N   ssid
+    //  --------------------------------------------------------
+    //      WIDE1-2          WIDE         1     -    2    0
+    //      WIDE1-2          WIDE1        0     -    0    2
+    //      WIDE1            WIDE         1     -    0    0
+    //      WIDE1            WIDE1        0     -    0    0
+    //      WIDE1            WIDE         1     -    0    0
+    //      WIDE2            WIDE         2     -    0    0
+    //      WIDE1-1          WIDE         1     -    1    0
+    //      WIDE2-2          WIDE         1     -    2    0
+    //      WIDE1-1          WIDE         1     -    1    0
+    //      WIDE1-1          WIDE1        0     -    0    1
+    //      WIDE11-1         WIDE1        1     -    1    0
+    //      WIDE11-1         WIDE11       0     -    0    1
+    //      WIDE1            WIDE         1     -    0    0
+    //      WIDE1            WIDE1        0     -    0    0
 
-    struct address new_address;
-    array_assign(new_address.text, new_address.text_size, router_address.begin(), router_address.end());
-    new_address.kind = address_kind::other;
-    new_address.length = router_address.size();
+    bool equal_text = equal_address_text(lhs, rhs);
 
-    bool set_new_address_as_used = false;
+    // If all address fields are equal, then we can immediately return true.
 
-    if ((substitute_zero_hops && !traceless_n_N) || n_N_address.N > 0)
+    if (equal_text && lhs.n == rhs.n &&
+        lhs.N == rhs.N && lhs.ssid == rhs.ssid)
     {
-        set_new_address_as_used = true;
+        return true;
     }
-    else
+
+    // If all the address fields are equal, except for the the address text,
+    // we can immediately return false, as there is no way for the addresses to be equal.
+
+    if (lhs.n == rhs.n && lhs.N == rhs.N &&
+        lhs.ssid == rhs.ssid && !equal_text)
     {
-        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
-        set_address_as_used(packet_addresses, packet_addresses_size, n_N_address);
-        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, n_N_address.index, enable_diagnostics, routing_actions_out);
+        return false;
     }
 
-    if (traceless_n_N)
+    // If both addresses have an n, N number or ssid, and they are not equal,
+    // then we can immediately return false, as the addresses cannot be equal.
+    //
+    // Example:
+    //
+    // WIDE1   !=  WIDE2
+    // WIDE1-1 !=  WIDE1-2
+    // CALL-1  !=  CALL-2
+
+    if ((lhs.n > 0 && rhs.n > 0 && lhs.n != rhs.n) ||
+        (lhs.N > 0 && rhs.N > 0 && lhs.N != rhs.N) ||
+        (lhs.ssid > 0 && rhs.ssid > 0 && lhs.ssid != rhs.ssid))
     {
-        return { routing_actions_out, true };
+        return false;
     }
 
-    size_t initial_offset = packet_addresses[0].offset;
-
-    array_insert(packet_addresses, packet_addresses_size, packet_n_N_address_index, new_address);
+    // If the address text is equal, but the n, N numbers or ssid are different,
+    // we can return false, as the addresses cannot be equal.
 
-    update_addresses_index(packet_addresses, packet_addresses_size);
-    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+    if (equal_text && (lhs.n != rhs.n || lhs.N != rhs.N || lhs.ssid != rhs.ssid))
+    {
+        return false;
+    }
 
-    routing_actions_out = push_address_inserted_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
+    // Compare ADDRESSn-N with ADDRESS-SSID
+    //
+    // Example: "WIDE1-1" can be represented as either n-N (WIDE1-1) or SSID (WIDE1-1)
+    // 
+    // Check if the base text part is the same ("WIDE" == "WIDE") and the numeric parts match, numerically and by text comparison
 
-    if (set_new_address_as_used)
+    if (!equal_text && std::abs(static_cast<int>(lhs.text_size) - static_cast<int>(rhs.text_size)) == 1)
     {
-        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, std::nullopt, enable_diagnostics, routing_actions_out);
-        set_address_as_used(packet_addresses, packet_addresses_size, packet_n_N_address_index);
-        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address_index, enable_diagnostics, routing_actions_out);
-    }
+        if (lhs.n > 0)
+        {
+            if (lhs.text_size >= rhs.text_size)
+            {
+                return false;
+            }
 
-    packet_n_N_address_index++;
+            if (!std::equal(lhs.text.begin(), lhs.text.begin() + lhs.text_size, rhs.text.begin()))
+            {
+                return false;
+            }
 
-    return { routing_actions_out, true };
+            if ((rhs.text[rhs.text_size - 1] - '0') == lhs.n)
+            {
+                if (rhs.ssid > 0)
+                {
+                    return lhs.N == rhs.ssid;
+                }
+                return lhs.N == 0;
+            }
+        }
+        else if (rhs.n > 0)
+        {
+            if (rhs.text_size >= lhs.text_size)
+            {
+                return false;
+            }
+
+            if (!std::equal(rhs.text.begin(), rhs.text.begin() + rhs.text_size, lhs.text.begin()))
+            {
+                return false;
+            }
+
+            if ((lhs.text[lhs.text_size - 1] - '0') == rhs.n)
+            {
+                if (lhs.ssid > 0)
+                {
+                    return rhs.N == lhs.ssid;
+                }
+                return rhs.N == 0;
+            }
+        }
+    }
+
+    return false;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_trap_n_N_route(route_state& state, address& packet_n_N_address, const address& router_n_N_address, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE constexpr uint64_t get_address_key(const struct address& address)
 {
-    // Replace an excessive hop with the router's address
-    // to stop the packet from harming the network
+    // Pack an address into a 64 bit key, such that two addresses which compare
+    // equal with equal_addresses_ignore_mark have the same key.
     //
-    // packet_n_N_address - is the address inside the packet's path
-    // router_n_N_address - is the address inside the router's path, matching the packet address
-    //
-    // Example:
+    // The address is first brought to a canonical form, the n number is appended
+    // to the address text, and the N number is used as the ssid:
     //
-    // Router path: WIDE2-2,WIDE7-2
-    //                      ~~~~~~~
-    //                      router_n_N_address
-    //                             7 2
+    //      address      address text     n     -    N   ssid      canonical
+    //  ------------------------------------------------------------------------
+    //      WIDE1-2          WIDE         1     -    2    0        WIDE1-2
+    //      WIDE1-2          WIDE1        0     -    0    2        WIDE1-2
+    //      CALL-10          CALL         0     -    0    10       CALL-10
     //
-    // Input:  FROM>TO,WIDE7-7:data
-    //                 ~~~~~~~
-    //                 packet_n_N_address
+    // Every character of the canonical text is packed in 6 bits (0x21 to 0x5F, minus 0x20),
+    // followed by the ssid in the low 4 bits:
     //
-    // Output: FROM>TO,DIGI*:data
-    //                 ~~~~~
-    //                 router_address
+    //   bits 63..58   57..52   ...   9..4   3..0
+    //        char 0   char 1   ...   char 8 ssid
     //
-    // Returns 'true' if the route is trapped, 'false' otherwise
+    // The mark is ignored. A key of zero means the address could not be packed,
+    // ex: lowercase characters or a canonical text longer than 9 characters,
+    // and the address must be compared with equal_addresses_ignore_mark instead.
 
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    size_t& packet_addresses_size = state.packet_addresses_size;
-    const std::string_view router_address = state.router_address_string;
-    const routing_option options = state.options;
+    assert(address.n >= 0 && address.n <= 9);
+    assert(address.text_size <= address.text.size());
 
-    bool trap_limit_exceeding_n_N_address = enum_has_flag(options, routing_option::trap_limit_exceeding_n_N_address);
-    bool traceless_n_N = enum_has_flag(options, routing_option::traceless_n_N_route);
+    size_t text_size = address.text_size + (address.n > 0 ? 1 : 0);
 
-    if (trap_limit_exceeding_n_N_address)
+    if (address.text_size == 0 || text_size > 9)
     {
-        if (router_n_N_address.N > 0 && packet_n_N_address.N > router_n_N_address.N)
-        {
-            if (!traceless_n_N)
-            {
-                routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address.index, router_address, enable_diagnostics, routing_actions_out);
-
-                array_assign(packet_n_N_address.text, packet_n_N_address.text_size, router_address.begin(), router_address.end());
-                packet_n_N_address.length = router_address.size();
-                packet_n_N_address.n = 0;
-                packet_n_N_address.N = 0;
-            }
-
-            routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address.index, enable_diagnostics, routing_actions_out);
-            set_address_as_used(packet_addresses, packet_addresses_size, packet_n_N_address);
-            routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, packet_n_N_address.index, enable_diagnostics, routing_actions_out);
-
-            return { routing_actions_out, true };
-        }
+        return 0;
     }
 
-    return { routing_actions_out, false };
-}
+    uint64_t key = 0;
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// TEST ROUTING                                                     //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
+    for (size_t i = 0; i < address.text_size; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(address.text[i]);
+        if (c < 0x21 || c > 0x5F)
+        {
+            return 0;
+        }
+        key = (key << 6) | (c - 0x20);
+    }
 
-APRS_ROUTER_INLINE bool try_route_packet_by_index(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result)
-{
-    if (routing_result.state != routing_state::routed)
+    if (address.n > 0)
     {
-        return false;
+        key = (key << 6) | static_cast<uint64_t>('0' + address.n - 0x20);
     }
 
-    assert(routing_result.actions.size() > 0);
+    key <<= 6 * (9 - text_size);
 
-    result = routing_result.original_packet;
+    int ssid = address.ssid > 0 ? address.ssid : address.N;
 
-    for (const auto& a : routing_result.actions)
+    assert(ssid >= 0 && ssid <= 15);
+
+    return (key << 4) | static_cast<uint64_t>(ssid);
+}
+
+APRS_ROUTER_INLINE constexpr uint64_t get_n_N_address_key(const struct address& address)
+{
+    // Pack the text and the n number of an n-N address, ignoring the N number:
+    //
+    // WIDE2-1, WIDE2-2 and WIDE2 all have the same key.
+    //
+    // Two n-N addresses with the same key have equal texts and n numbers.
+    // Addresses which are not n-N addresses (n = 0) or cannot be packed have a key of zero.
+
+    if (address.n == 0)
     {
-        if (a.type == routing_action::remove)
-        {
-            result.path.erase(result.path.begin() + a.index);
-        }
-        else if (a.type == routing_action::insert)
-        {
-            result.path.emplace(result.path.begin() + a.index, a.address.data(), a.address_size);
-        }
-        else if (a.type == routing_action::set)
-        {
-            result.path[a.index].append("*");
-        }
-        else if (a.type == routing_action::unset || a.type == routing_action::replace ||
-            a.type == routing_action::decrement)
-        {
-            result.path[a.index].assign(a.address.data(), a.address_size);
-        }
-        else
-        {
-            return false;
-        }
+        return 0;
     }
 
-    return true;
+    assert(address.ssid == 0);
+
+    return get_address_key(address) & ~static_cast<uint64_t>(0xF);
 }
 
-APRS_ROUTER_INLINE bool try_route_packet_by_start_end(const struct routing_result& routing_result, APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& result)
+APRS_ROUTER_INLINE bool equal_addresses_ignore_mark(const struct address& lhs, uint64_t lhs_key, const struct address& rhs, uint64_t rhs_key)
 {
-    if (routing_result.state != routing_state::routed)
+    // Compare two addresses using their precomputed keys, if both addresses could be packed.
+    //
+    // The keys match equal_addresses_ignore_mark as long as at most one of the addresses
+    // is an n-N address, which is always the case when comparing with the router's addresses.
+
+    if (lhs_key != 0 && rhs_key != 0)
     {
-        return false;
+        assert(lhs.n == 0 || rhs.n == 0);
+        return lhs_key == rhs_key;
     }
 
-    assert(routing_result.actions.size() > 0);
+    return equal_addresses_ignore_mark(lhs, rhs);
+}
+
+APRS_ROUTER_INLINE address canonicalize(const struct address& address)
+{
+    // Canonicalize an address by removing n-N information and preserving only the ssid.
 
-    std::string routed_packet = to_string(routing_result.original_packet);
+    assert(address.n == 0 || address.ssid == 0);
+    assert(address.N == 0 || address.ssid == 0);
 
-    for (const auto& a : routing_result.actions)
+    struct address result = address;
+
+    if ((result.n == 0 && result.N == 0) ||
+        result.ssid > 0)
     {
-        size_t start = a.start;
-        size_t end = a.end;
-        size_t count = a.end - a.start;
+        // Already canonical
+        return result;
+    }
 
-        if (a.type == routing_action::remove)
-        {
-            if (routed_packet[end + 1] == ':' || a.index == 0)
-            {
-                count++;
-            }
-            else if (a.index != 0)
-            {
-                start--;
-                count++;
-            }
-            routed_packet.erase(start, count);
-        }
-        else if (a.type == routing_action::insert)
-        {
-            routed_packet.insert(start, a.address.data(), a.address_size);
-            if (routed_packet[end + 1] != ',' || a.index == 0)
-            {
-                routed_packet.insert(end, ",");
-            }
-        }
-        else if (a.type == routing_action::set)
-        {
-            routed_packet.insert(end, "*");
-        }
-        else if (a.type == routing_action::unset || a.type == routing_action::replace ||
-            a.type == routing_action::decrement)
+    if (result.n > 0)
+    {
+        if (result.mark)
         {
-            routed_packet.erase(start, count);
-            routed_packet.insert(start, a.address.data(), a.address_size);
+            array_insert(result.text, result.text_size, result.text_size - 1, char('0' + result.n));
         }
         else
         {
-            return false;
+            result.text[result.text_size++] = char('0' + result.n);
         }
+        result.n = 0;
     }
 
-    if (!try_decode_packet(routed_packet, result))
+    if (result.N > 0)
     {
-        return false;
+        result.ssid = result.N;
+        result.N = 0;
     }
 
-    return true;
+    return result;
 }
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// ROUTING RESULT                                                   //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
-
-APRS_ROUTER_INLINE void init_routing_result(const struct APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& packet, routing_result& result)
+APRS_ROUTER_INLINE constexpr address_keyword find_address_keyword(std::string_view text)
 {
-    result.routed = false;
-    result.success = true;
-    result.original_packet = packet;
-    result.routed_packet.from = packet.from;
-    result.routed_packet.to = packet.to;
-    result.routed_packet.data = packet.data;
-    result.routed_packet.path.clear();
-    result.actions.clear();
-}
+    // Look up the text in the perfect hash table of keywords
+    // Returns an empty keyword (address_kind::other, q_construct::none) if the text is not a keyword
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> create_routing_ended_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out)
-{
-    routing_actions_out = push_routing_ended_diagnostic(state.packet_addresses[state.packet_addresses_size - 1], enable_diagnostics, routing_actions_out);
-    routing_state = routing_state::not_routed;
-    return { routing_actions_out, false };
-}
+    if (text.size() < 3 || text.size() > 9)
+    {
+        return {};
+    }
 
-APRS_ROUTER_INLINE bool create_routing_ended_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions)
-{
-    push_routing_ended_diagnostic(state.packet_addresses[state.packet_addresses_size - 1], enable_diagnostics, std::back_inserter(routing_actions));
-    routing_state = routing_state::not_routed;
-    return false;
+    size_t slot = address_keyword_slots[get_address_keyword_slot(text, address_keyword_multiplier)];
+
+    if (slot == 0 || address_keywords[slot - 1].text != text)
+    {
+        return {};
+    }
+
+    return address_keywords[slot - 1];
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> create_routed_by_us_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE constexpr q_construct parse_q_construct(std::string_view text)
 {
-    routing_actions_out = push_routed_by_us_diagnostic(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, enable_diagnostics, routing_actions_out);
-    routing_state = routing_state::already_routed;
-    return { routing_actions_out, false };
+    // qAC, qAX, qAU, qAo, qAO, qAS, qAr, qAR, qAZ, qAI
+
+    if (text.size() != 3)
+    {
+        return q_construct::none;
+    }
+
+    return find_address_keyword(text).q;
 }
 
-APRS_ROUTER_INLINE bool create_routed_by_us_routing(const route_state& state, bool enable_diagnostics, enum routing_state& routing_state, internal_vector_t<routing_diagnostic>& routing_actions)
+APRS_ROUTER_INLINE constexpr address_kind parse_address_kind(std::string_view text)
 {
-    push_routed_by_us_diagnostic(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, enable_diagnostics, std::back_inserter(routing_actions));
-    routing_state = routing_state::already_routed;
-    return false;
+    // ECHO, GATE, IGATECALL, NOGATE, OPNTRC, OPNTRK, RELAY, RFONLY, TEMP, TRACE, TCPIP, TCPXX, WIDE
+
+    if (text.size() < 4)
+    {
+        return address_kind::other;
+    }
+
+    return find_address_keyword(text).kind;
 }
 
-template <class OutputIterator1, class OutputIterator2, class OutputIterator3>
-APRS_ROUTER_INLINE_NO_DISABLE std::tuple<OutputIterator1, OutputIterator2, OutputIterator3, bool> create_routed_routing(route_state& state, bool enable_diagnostics, OutputIterator1 routed_packet_path_out, OutputIterator2 routed_packet_path_address_sizes_out, OutputIterator3 routing_actions_out)
+APRS_ROUTER_INLINE constexpr bool try_parse_address(std::string_view address_string, struct address& address)
 {
-    bool result;
-    std::tie(routing_actions_out, result) = try_truncate_empty_addresses(state, enable_diagnostics, routing_actions_out);
-    (void)result;
+    if (address_string.size() > address_text_max)
+    {
+        return false;
+    }
 
-    using value_type = typename std::iterator_traits<OutputIterator1>::value_type;
+    std::string_view address_text = address_string;
 
-    for (size_t i = 0; i < state.packet_addresses_size; i++)
+    array_assign(address.text, address.text_size, address_text.begin(), address_text.end());
+
+    address.mark = false;
+    address.ssid = 0;
+    address.length = static_cast<uint16_t>(address_text.size());
+    address.n = 0;
+    address.N = 0;
+    address.q = parse_q_construct({address.text.data(), address.text_size});
+    address.kind = address_kind::other;
+
+    // Parse Q construct first
+    if (address.q != q_construct::none)
     {
-        const auto& address = state.packet_addresses[i];
-        if (address.text_size != 0)
-        {
-            std::array<char, 15> routed_address = {};
-            size_t routed_address_size = 0;
-            to_string(address, routed_address, routed_address_size);
+        address.kind = address_kind::q;
+        return true; // Early return for Q constructs as there is nothing else to parse
+    }
 
-            // Detect the output iterator's value_type to write each routed address
-            // into the caller's container without forcing a particular storage shape.
+    // Check to see if the address is used (ending with *)
+    if (!address_text.empty() && address_text.back() == '*')
+    {
+        address.mark = true;
+        address_text.remove_suffix(1); // remove the *
 
-            if constexpr (std::is_same_v<value_type, void>)
-            {
-                // Output iterator with value_type = void (e.g. back_insert_iterator).
-                *routed_packet_path_out++ = std::string(routed_address.data(), routed_address_size);
-            }
-            else if constexpr (std::is_same_v<value_type, std::string>)
+        array_assign(address.text, address.text_size, address_text.begin(), address_text.end()); // set the text to the address without the *
+    }
+
+    auto sep_position = address_text.find("-");
+
+    // No separator found
+    if (sep_position == std::string_view::npos)
+    {
+        if (!address_text.empty() && is_digit(address_text.back()))
+        {
+            address.n = static_cast<int8_t>(address_text.back() - '0'); // get the last character as a number
+            address_text.remove_suffix(1); // remove the digit from the address text
+
+            // Validate the n is in the range 1-7
+            if (address.n > 0 && address.n <= 7)
             {
-                // Forward or random-access iterator into array<string,N> or vector<string>.
-                (*routed_packet_path_out).assign(routed_address.data(), routed_address_size);
-                ++routed_packet_path_out;
+                array_assign(address.text, address.text_size, address_text.begin(), address_text.end());
+                address.kind = parse_address_kind({address.text.data(), address.text_size});
             }
-            else if constexpr (is_std_array_of_char_v<value_type>)
+            else
             {
-                // array<array<char,N>,M> + parallel sizes.
-                std::copy_n(routed_address.data(), routed_address_size, (*routed_packet_path_out).begin());
-                ++routed_packet_path_out;
+                address.n = 0;
             }
-            else
+        }
+        else
+        {
+            address.kind = parse_address_kind({address.text.data(), address.text_size});
+        }
+
+        return true;
+    }
+
+    // Separator found, check if we have exactly one digit on both sides of the separator, ex WIDE1-1
+    // If the address does not match the n-N format, we will treat it as a regular address ex address with SSID
+    if (sep_position != std::string_view::npos && sep_position > 0 &&
+        is_digit(address_text[sep_position - 1]) &&
+        (sep_position + 1) < address_text.size() && is_digit(address_text[sep_position + 1]) &&
+        (sep_position + 2 == address_text.size()))
+    {
+        address.n = static_cast<int8_t>(address_text[sep_position - 1] - '0');
+        address.N = static_cast<int8_t>(address_text[sep_position + 1] - '0');
+
+        if (address.N >= 0 && address.N <= 7 && address.n > 0 && address.n <= 7)
+        {
+            array_assign(address.text, address.text_size, address_text.data(), address_text.data() + sep_position - 1); // remove the separator and both digits from the address text
+            address.kind = parse_address_kind({address.text.data(), address.text_size});
+        }
+        else
+        {
+            address.n = 0;
+            address.N = 0;
+        }
+
+        return true;
+    }
+
+    // Handle SSID parsing
+    // Expecting the separator to be followed by a digit, ex: CALL-1
+    if ((sep_position + 1) < address_text.size() && is_digit(address_text[sep_position + 1]))
+    {
+        std::array<char, 3> ssid_chars = {};
+        size_t ssid_chars_size = 0;
+        array_assign(ssid_chars, ssid_chars_size, address_text.data() + sep_position + 1, address_text.data() + address_text.size());
+
+        // Check for a single digit or two digits, ex: CALL-1 or CALL-12
+        if (ssid_chars_size == 1 || (ssid_chars_size == 2 && is_digit(ssid_chars[1])))
+        {
+            int ssid = 0;
+            if (!try_parse_int({ssid_chars.data(), ssid_chars_size}, ssid))
             {
-                // Generic fallback: any slot type constructible from (const char*, size_t).
-                *routed_packet_path_out++ = value_type(routed_address.data(), routed_address_size);
+                return true;
             }
 
-            *routed_packet_path_address_sizes_out++ = routed_address_size;
+            if (ssid >= 0 && ssid <= 15)
+            {
+                address.ssid = static_cast<int8_t>(ssid);
+                array_assign(address.text, address.text_size, address_text.data(), address_text.data() + sep_position);
+            }
         }
     }
 
-    return { routed_packet_path_out, routed_packet_path_address_sizes_out, routing_actions_out, true };
+    return true;
 }
 
-APRS_ROUTER_INLINE bool create_routed_routing(route_state& state, bool enable_diagnostics, std::array<std::array<char, 15>, 8>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, 8>& routed_packet_path_address_sizes, internal_vector_t<routing_diagnostic>& routing_actions)
+APRS_ROUTER_INLINE constexpr bool try_parse_n_N_address(std::string_view address_string, std::array<char, address_text_max>& address_text, size_t& address_text_size, int& n, int& N, bool& mark, size_t& length, address_kind& kind)
 {
-    auto [path_end, sizes_end, actions_end, result] = create_routed_routing(state, enable_diagnostics, routed_packet_path.begin(), routed_packet_path_address_sizes.begin(), std::back_inserter(routing_actions));
-    (void)path_end;
-    (void)actions_end;
-    routed_packet_path_size = static_cast<size_t>(std::distance(routed_packet_path_address_sizes.begin(), sizes_end));
-    return result;
-}
+    if (address_string.size() > address_text_max)
+    {
+        return false;
+    }
 
-APRS_ROUTER_INLINE bool create_routed_routing(route_state& state, bool enable_diagnostics, std::array<std::array<char, 15>, 8>& routed_packet_path, size_t& routed_packet_path_size, std::array<size_t, 8>& routed_packet_path_address_sizes)
-{
-    internal_vector_t<routing_diagnostic> routing_actions;
-    return create_routed_routing(state, enable_diagnostics, routed_packet_path, routed_packet_path_size, routed_packet_path_address_sizes, routing_actions);
-}
+    std::string_view text = address_string;
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// ROUTING DIAGNOSTICS                                              //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
+    array_assign(address_text, address_text_size, text.begin(), text.end());
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_routing_ended_diagnostic(const address& address, bool enable_diagnostics, OutputIterator routing_actions_out)
-{
-    if (enable_diagnostics)
-    {
-        routing_diagnostic diag;
+    mark = false;
+    length = text.size();
+    n = 0;
+    N = 0;
+    kind = address_kind::other;
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::warn;
-        diag.message_type = message_type::routing_ended;
-        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
-        diag.start = address.offset;
-        diag.end = diag.start + address.length;
-        diag.index = address.index;
+    // Check to see if the address is used (ending with *)
+    if (!text.empty() && text.back() == '*')
+    {
+        mark = true;
+        text.remove_suffix(1); // remove the *
 
-        *routing_actions_out++ = diag;
+        array_assign(address_text, address_text_size, text.begin(), text.end()); // set the text to the address without the *
     }
-    return routing_actions_out;
-}
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_routed_by_us_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
-{
-    if (enable_diagnostics && maybe_last_used_address_index)
+    auto sep_position = text.find("-");
+
+    // No separator found
+    if (sep_position == std::string_view::npos)
     {
-        routing_diagnostic diag;
+        if (!text.empty() && is_digit(text.back()))
+        {
+            n = text.back() - '0'; // get the last character as a number
 
-        const address& address = packet_addresses[maybe_last_used_address_index.value()];
+            text.remove_suffix(1); // remove the digit from the address text
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::warn;
-        diag.message_type = message_type::already_routed;
-        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
-        diag.start = address.offset;
-        diag.end = diag.start + address.length;
-        diag.index = address.index;
+            // Validate the n is in the range 1-7
+            if (n > 0 && n <= 7)
+            {
+                array_assign(address_text, address_text_size, text.begin(), text.end());
+                kind = parse_address_kind({address_text.data(), address_text_size});
+            }
+            else
+            {
+                n = 0;
+            }
+        }
+        else
+        {
+            kind = parse_address_kind({address_text.data(), address_text_size});
+        }
 
-        *routing_actions_out++ = diag;
+        return true;
     }
-    return routing_actions_out;
-}
-
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_set_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
-{
-    assert(set_address_index < packet_addresses_size); (void)packet_addresses_size;
 
-    if (enable_diagnostics)
+    // Separator found, check if we have exactly one digit on both sides of the separator, ex WIDE1-1
+    // If the address does not match the n-N format, we will treat it as a regular address ex address with SSID
+    if (sep_position != std::string_view::npos && sep_position > 0 &&
+        is_digit(text[sep_position - 1]) &&
+        (sep_position + 1) < text.size() && is_digit(text[sep_position + 1]) &&
+        (sep_position + 2 == text.size()))
     {
-        routing_diagnostic diag;
-
-        const address& address = packet_addresses[set_address_index];
-
-        diag.target = applies_to::path;
-        diag.type = routing_action::set;
-        diag.message_type = message_type::address_set;
-        to_string(address, diag.address, diag.address_size);
-        diag.start = address.offset;
-        diag.end = diag.start + address.length;
-        diag.index = set_address_index;
+        n = text[sep_position - 1] - '0';
+        N = text[sep_position + 1] - '0';
 
-        if (address.mark && diag.address_size > 0)
+        if (N >= 0 && N <= 7 && n > 0 && n <= 7)
         {
-            // Remove the '*' marker
-            diag.address_size--;
-            diag.end--;
+            array_assign(address_text, address_text_size, text.data(), text.data() + sep_position - 1); // remove the separator and both digits from the address text
+            kind = parse_address_kind({address_text.data(), address_text_size});
+        }
+        else
+        {
+            n = 0;
+            N = 0;
         }
 
-        *routing_actions_out++ = diag;
+        return true;
     }
-    return routing_actions_out;
+
+    return false;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_unset_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_set_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE constexpr bool try_parse_n_N_address(std::string_view address_string, struct address& address)
 {
-    // Called before unsetting addresses, before calling 'set_address_as_used'
-
-    size_t set_address_index = maybe_set_address_index.value_or(packet_addresses_size); // intentionally out of bounds if not set
+    // The narrow address fields are written through locals
 
-    assert(!maybe_set_address_index || set_address_index < packet_addresses_size);
-    assert(packet_addresses_size > 0);
+    int n = address.n;
+    int N = address.N;
+    size_t length = address.length;
 
-    if (enable_diagnostics)
-    {
-        size_t i = 0;
-        size_t offset = packet_addresses[0].offset;
-        for (size_t address_index = 0; address_index < packet_addresses_size; address_index++)
-        {
-            const auto& address = packet_addresses[address_index];
-            size_t length = address.length;
+    bool result = try_parse_n_N_address(address_string, address.text, address.text_size, n, N, address.mark, length, address.kind);
 
-            if (address.mark && address.index != set_address_index)
-            {
-                routing_diagnostic diag;
+    address.n = static_cast<int8_t>(n);
+    address.N = static_cast<int8_t>(N);
+    address.length = static_cast<uint16_t>(length);
 
-                diag.target = applies_to::path;
-                diag.type = routing_action::unset;
-                diag.message_type = message_type::address_unset;
-                to_string(address, diag.address, diag.address_size);
-                diag.start = offset;
-                diag.end = diag.start + length;
-                diag.index = i;
+    return result;
+}
 
-                if (address.mark && diag.address_size > 0)
-                {
-                    // Remove the '*' marker
-                    diag.address_size--;
-                }
+APRS_ROUTER_INLINE constexpr bool try_parse_address_with_ssid(std::string_view address_string, struct address& address)
+{
+    // This function is a wrapper around try_parse_address
+    // it will parse the address and ssid from the address_string
+    // and create an address type.
 
-                *routing_actions_out++ = diag;
-            }
+    std::array<char, address_text_max> address_no_ssid = {};
+    size_t address_no_ssid_size = 0;
+    int ssid = 0;
+    bool mark = false;
 
-            if (address.mark)
-            {
-                length--;
-            }
+    if (!try_parse_address_with_used_flag(address_string, address_no_ssid, address_no_ssid_size, ssid, mark))
+    {
+        return false;
+    }
 
-            offset += length + 1;
+    address.text = address_no_ssid;
+    address.text_size = address_no_ssid_size;
+    address.ssid = static_cast<int8_t>(ssid);
+    address.length = static_cast<uint16_t>(address_string.size());
+    address.mark = mark;
 
-            i++;
-        }
-    }
-    return routing_actions_out;
+    return true;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_replaced_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t set_address_index, std::string_view new_address, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE constexpr bool try_parse_address(std::string_view address, std::array<char, address_text_max>& address_no_ssid, size_t& address_no_ssid_size, int& ssid)
 {
-    assert(set_address_index < packet_addresses_size); (void)packet_addresses_size;
-
-    if (enable_diagnostics)
-    {
-        routing_diagnostic diag;
-
-        const address& address = packet_addresses[set_address_index];
+    // Try parse an address like: ADDRESS[-SSID]
+    //
+    // Example:
+    //
+    // CALL1-10
+    // ~~~~~ ~~
+    // ^     ssid = 10
+    // |
+    // address_no_ssid = CALL1
+    // 
+    // This functions expects a valid AX.25 address,
+    // and will return false if the address is not valid.
+    // An address with a non numeric ssid will be rejected, ex: CALL-AB
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::replace;
-        diag.message_type = message_type::address_replaced;
-        array_assign(diag.address, diag.address_size, new_address.begin(), new_address.end());
-        diag.start = address.offset;
-        diag.end = diag.start + address.length;
-        diag.index = set_address_index;
+    ssid = 0;
 
-        *routing_actions_out++ = diag;
+    if (address.empty() || address.size() > 9)
+    {
+        return false;
     }
-    return routing_actions_out;
-}
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_decremented_diagnostic(address& address, bool enable_diagnostics, OutputIterator routing_actions_out)
-{
-    if (enable_diagnostics)
+    auto sep_position = address.find("-");
+
+    if (sep_position != std::string_view::npos)
     {
-        routing_diagnostic diag;
+        // Check few error conditions
+        // If packet ends with a separator but no ssid, ex: "CALL-"
+        // If there are more than 2 character after the separator, ex: CALL-123
+        if ((sep_position == (address.size() - 1)) || ((sep_position + 3) < address.size()))
+        {
+            return false;
+        }
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::decrement;
-        diag.message_type = message_type::address_decremented;
-        to_string(address, diag.address, diag.address_size);
-        diag.start = address.offset;
-        diag.end = diag.start + address.length;
-        diag.index = address.index;
+        array_assign(address_no_ssid, address_no_ssid_size, address.data(), address.data() + sep_position);
+
+        std::array<char, 3> ssid_chars = {};
+        size_t ssid_chars_size = 0;
+        array_assign(ssid_chars, ssid_chars_size, address.data() + sep_position + 1, address.data() + address.size());
 
-        // +2 as push_address_decremented_diagnostic is called after the address was decremented
-        // with the length decremented by 2 if N is 0
-        if (address.N == 0)
+        if (ssid_chars[0] == '0')
         {
-            diag.end += 2;
+            return false;
         }
 
-        *routing_actions_out++ = diag;
-    }
-    return routing_actions_out;
-}
+        // Ensure the ssid is a number
+        if (!is_digit(ssid_chars[0]) ||
+            (ssid_chars_size > 1 && !is_digit(ssid_chars[1])))
+        {
+            return false;
+        }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_inserted_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t insert_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
-{
-    assert(insert_address_index < packet_addresses_size); (void)packet_addresses_size;
+        if (!try_parse_int({ssid_chars.data(), ssid_chars_size}, ssid))
+        {
+            return false;
+        }
 
-    if (enable_diagnostics)
+        // SSIDs are 4-bit values and must be in the [0, 15] range
+        if (ssid < 0 || ssid > 15)
+        {
+            ssid = 0;
+            return false;
+        }
+    }
+    else
     {
-        routing_diagnostic diag;
+        array_assign(address_no_ssid, address_no_ssid_size, address.begin(), address.end());
+        ssid = 0;
+    }
 
-        const address& address = packet_addresses[insert_address_index];
+    // The address text (without SSID) is at most 6 characters
+    if (address_no_ssid_size > 6)
+    {
+        return false;
+    }
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::insert;
-        diag.message_type = message_type::address_inserted;
-        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
-        diag.start = address.offset;
-        diag.end = diag.start + address.text_size;
-        diag.index = insert_address_index;
+    for (size_t i = 0; i < address_no_ssid_size; i++)
+    {
+        char c = address_no_ssid[i];
 
-        *routing_actions_out++ = diag;
+        // The address has to be alphanumeric and uppercase, or a digit
+        if (!is_digit(c) && !is_upper(c))
+        {
+            return false;
+        }
     }
-    return routing_actions_out;
+
+    return true;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator push_address_removed_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t remove_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+APRS_ROUTER_INLINE constexpr bool try_parse_address_with_used_flag(std::string_view address, std::array<char, address_text_max>& address_no_ssid, size_t& address_no_ssid_size, int& ssid)
 {
-    assert(remove_address_index < packet_addresses_size); (void)packet_addresses_size;
-
-    if (enable_diagnostics)
-    {
-        routing_diagnostic diag;
+    bool mark = false;
+    return try_parse_address_with_used_flag(address, address_no_ssid, address_no_ssid_size, ssid, mark);
+}
 
-        const address& address = packet_addresses[remove_address_index];
+APRS_ROUTER_INLINE constexpr bool try_parse_address_with_used_flag(std::string_view address, std::array<char, address_text_max>& address_no_ssid, size_t& address_no_ssid_size, int& ssid, bool& mark)
+{
+    ssid = 0;
+    mark = false;
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::remove;
-        diag.message_type = message_type::address_removed;
-        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
-        diag.start = address.offset;
-        diag.end = diag.start + address.text_size;
-        diag.index = remove_address_index;
+    if (address.empty())
+    {
+        return false;
+    }
 
-        *routing_actions_out++ = diag;
+    if (address.back() == '*')
+    {
+        mark = true;
+        address.remove_suffix(1);
     }
-    return routing_actions_out;
+
+    return try_parse_address(address, address_no_ssid, address_no_ssid_size, ssid);
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator create_address_move_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end)
+APRS_ROUTER_INLINE bool try_parse_address(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid)
 {
-    assert(from_index < packet_addresses_size);
-    assert(to_index < packet_addresses_size); (void)packet_addresses_size;
-
-    OutputIterator routing_actions_out = routing_actions_out_begin;
-
-    if (enable_diagnostics)
-    {
-        routing_diagnostic remove_diag;
+    std::array<char, address_text_max> address_no_ssid_result = {};
+    size_t address_no_ssid_result_size = 0;
 
-        const address& removed_address = packet_addresses[from_index];
+    bool result = try_parse_address(address, address_no_ssid_result, address_no_ssid_result_size, ssid);
 
-        remove_diag.target = applies_to::path;
-        remove_diag.type = routing_action::remove;
-        remove_diag.message_type = message_type::address_removed;
-        to_string(removed_address, remove_diag.address, remove_diag.address_size);
-        remove_diag.start = removed_address.offset;
-        remove_diag.end = remove_diag.start + removed_address.length;
-        remove_diag.index = from_index;
+    address_no_ssid.assign(address_no_ssid_result.data(), address_no_ssid_result_size);
 
-        assert(routing_actions_out != routing_actions_out_end);
-        if (routing_actions_out == routing_actions_out_end)
-        {
-            return routing_actions_out;
-        }
+    return result;
+}
 
-        *routing_actions_out++ = remove_diag;
+APRS_ROUTER_INLINE bool try_parse_address_with_used_flag(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid)
+{
+    std::array<char, address_text_max> address_no_ssid_result = {};
+    size_t address_no_ssid_result_size = 0;
 
-        routing_diagnostic insert_diag;
+    bool result = try_parse_address_with_used_flag(address, address_no_ssid_result, address_no_ssid_result_size, ssid);
 
-        const address& inserted_address = packet_addresses[to_index];
+    address_no_ssid.assign(address_no_ssid_result.data(), address_no_ssid_result_size);
 
-        insert_diag.target = applies_to::path;
-        insert_diag.type = routing_action::insert;
-        insert_diag.message_type = message_type::address_inserted;
-        to_string(removed_address, insert_diag.address, insert_diag.address_size);
-        insert_diag.start = inserted_address.offset;
-        insert_diag.end = insert_diag.start + removed_address.length;
-        insert_diag.index = to_index;
+    return result;
+}
 
-        assert(routing_actions_out != routing_actions_out_end);
-        if (routing_actions_out == routing_actions_out_end)
-        {
-            return routing_actions_out;
-        }
+APRS_ROUTER_INLINE bool try_parse_address_with_used_flag(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid, bool& mark)
+{
+    std::array<char, address_text_max> address_no_ssid_result = {};
+    size_t address_no_ssid_result_size = 0;
 
-        *routing_actions_out++ = insert_diag;
-    }
+    bool result = try_parse_address_with_used_flag(address, address_no_ssid_result, address_no_ssid_result_size, ssid, mark);
 
-    (void)routing_actions_out_end;
+    address_no_ssid.assign(address_no_ssid_result.data(), address_no_ssid_result_size);
 
-    return routing_actions_out;
+    return result;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE OutputIterator create_truncate_address_range_diagnostic(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index, bool enable_diagnostics, OutputIterator routing_actions_out_begin, OutputIterator routing_actions_out_end)
+APRS_ROUTER_INLINE constexpr bool try_parse_int(std::string_view str, int& value)
 {
-    assert(from_index < packet_addresses_size);
-    assert(to_index < packet_addresses_size);
-    (void)packet_addresses_size;
+    // Attempt to parse an integer from the given string_view.
+    // Returns true if parsing is successful, false otherwise.
+    // If parsing fails, the value is set to 0.
+    //
+    // Accepts the same input as std::from_chars: an optional minus sign followed by digits,
+    // the entire string must be consumed and the value must fit in an int.
+    // Implemented by hand as std::from_chars is not constexpr in C++17.
 
-    OutputIterator routing_actions_out = routing_actions_out_begin;
+    value = 0;
 
-    if (!enable_diagnostics)
+    size_t i = 0;
+    bool negative = false;
+
+    if (!str.empty() && str[0] == '-')
     {
-        (void)routing_actions_out_end;
-        return routing_actions_out;
+        negative = true;
+        i++;
     }
 
-    assert(from_index < packet_addresses_size);
+    if (i == str.size())
+    {
+        return false;
+    }
 
-    size_t initial_offset = packet_addresses[from_index].offset;
+    // Accumulate as a negative number, the negative range of int is larger than the positive range
 
-    for (size_t i = from_index; i < packet_addresses_size && i < to_index; i++)
-    {
-        routing_diagnostic diag;
+    int result = 0;
 
-        const address& address = packet_addresses[i];
+    for (; i < str.size(); i++)
+    {
+        if (!is_digit(str[i]))
+        {
+            return false;
+        }
 
-        diag.target = applies_to::path;
-        diag.type = routing_action::remove;
-        diag.message_type = message_type::address_removed;
-        array_assign(diag.address, diag.address_size, address.text.begin(), address.text.begin() + address.text_size);
-        diag.start = initial_offset;
-        diag.end = diag.start + address.length;
-        diag.index = from_index;
+        int digit = str[i] - '0';
 
-        assert(routing_actions_out != routing_actions_out_end);
-        if (routing_actions_out == routing_actions_out_end)
+        if (result < (std::numeric_limits<int>::min() + digit) / 10)
         {
-            return routing_actions_out;
+            return false;
         }
 
-        *routing_actions_out++ = diag;
+        result = result * 10 - digit;
     }
 
-    (void)routing_actions_out_end;
+    if (!negative)
+    {
+        if (result == std::numeric_limits<int>::min())
+        {
+            return false;
+        }
+        result = -result;
+    }
 
-    return routing_actions_out;
+    value = result;
+
+    return true;
+}
+
+APRS_ROUTER_INLINE constexpr bool is_digit(char c)
+{
+    // Locale independent, constexpr replacement for std::isdigit
+    return c >= '0' && c <= '9';
+}
+
+APRS_ROUTER_INLINE constexpr bool is_upper(char c)
+{
+    // Locale independent, constexpr replacement for std::isupper
+    return c >= 'A' && c <= 'Z';
 }
 
 // **************************************************************** //
 //                                                                  //
 //                                                                  //
-// ROUTING DIAGNOSTICS FORMAT                                       //
+// ADDRESSES                                                        //
 //                                                                  //
 //                                                                  //
 // **************************************************************** //
 
-APRS_ROUTER_INLINE std::string create_display_name_diagnostic(const routing_diagnostic_display_entry& line)
+template <class InputIterator1, class InputIterator2>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void init_router_addresses(InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, router_config& config)
 {
-    // Creates a diagnostic message.
-    //
-    // Beginning of example:
-    //
-    // Packet address removed:
+    // Parse the router's address, explicit address list, and n-N address list once,
+    // and cache the results in `state` so subsequent calls reuse them.
     //
-    // N0CALL>APRS,CALLA,CALLB,CALLC,CALLD:data
-    //                               ~~~~~
+    // Iterator value types only need to be convertible to std::string_view (e.g. std::string, std::string_view, const char*).
     //
-    // End of example
+    // Router address:            DIGI                               config.router_address_string   config.router_address
+    // Router explicit addresses: CALLA,CALLB                                                      config.router_explicit_addresses
+    // Router n-N addresses:      WIDE1-1,WIDE2-2                                                  config.router_n_N_addresses
 
-    std::string diag_string;
+    // Do not redo parsing of router addresses if already initialized
+    // These parsed addresses can be reused to speed up routing
 
-    diag_string.append(line.message);
-    diag_string.append(":");
-    diag_string.append("\n");
-    diag_string.append("\n");
-    diag_string.append(line.packet_string);
-    diag_string.append("\n");
-    diag_string.append(line.highlight_string);
-    diag_string.append("\n");
-    diag_string.append("\n");
+    if (config.initialized)
+    {
+        return;
+    }
 
-    return diag_string;
-}
+    try_parse_address_with_ssid(config.router_address_string, config.router_address);
 
-APRS_ROUTER_INLINE routing_diagnostic_display_entry create_diagnostic_print_line(const routing_diagnostic& diag, const APRS_ROUTER_PACKET_NAMESPACE_REFERENCE packet& routed_packet)
-{
-    // Creates a diagnostic entry.
-    //
-    // Packet string    - entry.packet_string:     "N0CALL>APRS,CALLA,CALLB,CALLC,CALLD:data"
-    // Highlight string - entry.highlight_string:  "                              ~~~~~"
-    // Message          - entry.message:           "Packet address removed"
+    config.router_address_key = get_address_key(config.router_address);
 
-    routing_diagnostic_display_entry entry;
+    // The prefilter is only usable if the router address could be parsed
+
+    clear_address_prefilter(config.router_prefilter);
+    add_address_prefilter(config.router_prefilter, config.router_address);
+    config.router_prefilter.enabled = config.router_address.text_size > 0;
+
+    // Parse explicit addresses, ex: CALLA,CALLB,CALLC
+    // Use try_parse_address_with_ssid to parse the address as we expect it to be in the format ADDRESS[-SSID]
+
+    config.router_explicit_addresses_size = 0;
+    clear_address_keys(config.router_explicit_address_keys);
+    size_t explicit_index = 0;
+    for (auto it = router_explicit_addresses_begin; it != router_explicit_addresses_end; it++, explicit_index++)
+    {
+        address explicit_address;
+        if (try_parse_address_with_ssid(std::string_view(*it), explicit_address))
+        {
+            explicit_address.index = static_cast<uint16_t>(explicit_index);
+            if (config.router_explicit_addresses_size < config.router_explicit_addresses.size())
+            {
+                set_address_key(config.router_explicit_address_keys, config.router_explicit_addresses_size, get_address_key(explicit_address));
+                add_address_prefilter(config.router_prefilter, explicit_address);
+                config.router_explicit_addresses[config.router_explicit_addresses_size++] = explicit_address;
+            }
+        }
+    }
 
-    entry.message = to_string(diag.message_type);
-    entry.packet_string = to_string(routed_packet);
-    entry.highlight_string.append(std::string(diag.start, ' '));
-    entry.highlight_string.append(std::string(diag.end - diag.start, '~'));
+    // Parse n-N addresses, ex: WIDE1-1,WIDE2-2,WIDE3
+    // Use try_parse_n_N_address to parse the address as we expect it to be in the format ADDRESSn[-N]
 
-    if (diag.type == routing_action::set)
+    config.router_n_N_addresses_size = 0;
+    clear_address_keys(config.router_n_N_address_keys);
+    size_t n_N_index = 0;
+    for (auto it = router_n_N_addresses_begin; it != router_n_N_addresses_end; it++, n_N_index++)
     {
-        entry.highlight_string.append("~");
+        address n_N_address;
+        if (try_parse_n_N_address(std::string_view(*it), n_N_address))
+        {
+            n_N_address.index = static_cast<uint16_t>(n_N_index);
+            if (config.router_n_N_addresses_size < config.router_n_N_addresses.size())
+            {
+                set_address_key(config.router_n_N_address_keys, config.router_n_N_addresses_size, get_n_N_address_key(n_N_address));
+                add_address_prefilter(config.router_prefilter, n_N_address);
+                config.router_n_N_addresses[config.router_n_N_addresses_size++] = n_N_address;
+            }
+        }
     }
 
-    return entry;
+    config.initialized = true;
 }
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// ADDRESS                                                          //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
-
-APRS_ROUTER_INLINE bool operator==(const address& lhs, const address& rhs)
+APRS_ROUTER_INLINE constexpr void clear_address_prefilter(address_prefilter& prefilter)
 {
-    return lhs.text_size == rhs.text_size &&
-           std::equal(lhs.text.begin(), lhs.text.begin() + lhs.text_size, rhs.text.begin()) &&
-           lhs.n == rhs.n &&
-           lhs.N == rhs.N &&
-           lhs.ssid == rhs.ssid &&
-           lhs.mark == rhs.mark;
+    prefilter.first_chars = {};
+    prefilter.prefixes = {};
+    prefilter.enabled = false;
 }
 
-APRS_ROUTER_INLINE bool operator!=(const address& lhs, const address& rhs)
+APRS_ROUTER_INLINE constexpr size_t get_address_prefilter_prefix_index(unsigned char c0, unsigned char c1)
 {
-    return !(lhs == rhs);
+    return (static_cast<size_t>(c0) * 37 + c1) & 511;
 }
 
-APRS_ROUTER_INLINE void to_string(const struct address& address, std::array<char, 15>& result, size_t& result_size)
+APRS_ROUTER_INLINE constexpr void add_address_prefilter(address_prefilter& prefilter, const address& address)
 {
-    result_size = 0;
+    // Record the first two characters of the canonical form of the address,
+    // the canonical form of an n-N address includes the n number: WIDE2-1 -> WIDE2
+    //
+    // Every packet address matching this address, in any representation, starts with the same characters:
+    //
+    // Router address:   WIDE1-1   WIDE2    A
+    // Canonical:        WIDE1     WIDE2    A
+    // Recorded:         WI        WI       A
+    // Packet addresses: WIDE1-1   WIDE2-2  A*
+    //                   ~~        ~~       ~
 
     if (address.text_size == 0)
     {
         return;
     }
 
-    array_assign(result, result_size, address.text.data(), address.text.data() + address.text_size);
+    unsigned char c0 = static_cast<unsigned char>(address.text[0]);
 
-    if (address.n > 0)
+    if (address.text_size == 1 && address.n == 0)
     {
-        result[result_size++] = char('0' + address.n);
+        prefilter.first_chars[c0 / 64] |= uint64_t(1) << (c0 % 64);
+        return;
     }
 
-    if (address.N > 0)
+    unsigned char c1 = static_cast<unsigned char>(address.text_size > 1 ? address.text[1] : '0' + address.n);
+
+    size_t index = get_address_prefilter_prefix_index(c0, c1);
+    prefilter.prefixes[index / 64] |= uint64_t(1) << (index % 64);
+}
+
+APRS_ROUTER_INLINE bool test_address_prefilter(const address_prefilter& prefilter, std::string_view address)
+{
+    // Check if the raw packet address could match one of the router addresses
+    // False positives are possible, false negatives are not
+
+    if (address.empty())
     {
-        result[result_size++] = '-';
-        result[result_size++] = char('0' + address.N);
+        return false;
     }
 
-    if (address.ssid > 0)
+    unsigned char c0 = static_cast<unsigned char>(address[0]);
+
+    if ((prefilter.first_chars[c0 / 64] >> (c0 % 64)) & 1)
     {
-        result[result_size++] = '-';
-        if (address.ssid < 10)
-        {
-            result[result_size++] = char('0' + address.ssid);
-        }
-        else
-        {
-            // 10 .. 15 => "1" + '0'..'5'
-            result[result_size++] = '1';
-            result[result_size++] = char('0' + (address.ssid - 10));
-        }
+        return true;
     }
 
-    if (address.mark)
+    if (address.size() < 2)
     {
-        result[result_size++] = '*';
+        return false;
     }
-}
 
-APRS_ROUTER_INLINE internal_string_t<char> to_string(const struct address& address)
-{
-    std::array<char, 15> result = {};
-    size_t result_size = 0;
-    to_string(address, result, result_size);
-    return internal_string_t<char>(result.data(), result_size);
-}
+    size_t index = get_address_prefilter_prefix_index(c0, static_cast<unsigned char>(address[1]));
 
-APRS_ROUTER_INLINE bool equal_address_text(const struct address& lhs, const struct address& rhs)
-{
-    return lhs.text_size == rhs.text_size &&
-        std::equal(lhs.text.begin(), lhs.text.begin() + lhs.text_size, rhs.text.begin());
+    return (prefilter.prefixes[index / 64] >> (index % 64)) & 1;
 }
 
-APRS_ROUTER_INLINE bool equal_addresses_ignore_mark(const struct address& lhs, const struct address& rhs)
+template <class InputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE bool might_route_packet(const router_config& config, std::string_view packet_from_address, std::string_view packet_to_address, InputIterator packet_path_begin, InputIterator packet_path_end)
 {
-    // Normally we simply use to_string(lhs) == to_string(rhs) to compare addresses.
-    // But "to_string" requires us to make a copy of an address to unset the "mark" fields (we typically ignore '*' in address comparisons).
-    // Additionally, to_string allocates heap memory in debug builds.
+    // Decide if a packet could possibly be routed, already routed, or rejected as sent by us,
+    // by looking at the first characters of every path address.
     //
-    // This implementation is a fast address comparison function. This function makes no heap memory allocations, nor requires object copies.
-    // It trades a bit of speed speed for memory usage.
-    // As part of the comparison, it ignores the "mark" field of the address.
-
-    // Ensure the addresses are valid.
-    // An address cannot have both the n and N fields and ssid set.
-    // If the N number is set, the n number must also be set.
-
-    assert(lhs.n >= 0 && lhs.n <= 7 && lhs.N >= 0 && lhs.N <= 7);
-    assert(rhs.n >= 0 && rhs.n <= 7 && rhs.N >= 0 && rhs.N <= 7);
-    assert(lhs.ssid >= 0 && lhs.ssid <= 15);
-    assert(rhs.ssid >= 0 && rhs.ssid <= 15);
-    assert(lhs.n == 0 || lhs.ssid == 0);
-    assert(rhs.n == 0 || rhs.ssid == 0);
-    assert(lhs.N == 0 || (lhs.N > 0 && lhs.n > 0));
-    assert(rhs.N == 0 || (rhs.N > 0 && rhs.n > 0));
-
-    // Various combinations of n, N numbers and ssid can make addresses be equal to each other.
-    // 
-    //      address      address text     n     -    N   ssid
-    //  --------------------------------------------------------
-    //      WIDE1-2          WIDE         1     -    2    0
-    //      WIDE1-2          WIDE1        0     -    0    2
-    //      WIDE1            WIDE         1     -    0    0
-    //      WIDE1            WIDE1        0     -    0    0
-    //      WIDE1            WIDE         1     -    0    0
-    //      WIDE2            WIDE         2     -    0    0
-    //      WIDE1-1          WIDE         1     -    1    0
-    //      WIDE2-2          WIDE         1     -    2    0
-    //      WIDE1-1          WIDE         1     -    1    0
-    //      WIDE1-1          WIDE1        0     -    0    1
-    //      WIDE11-1         WIDE1        1     -    1    0
-    //      WIDE11-1         WIDE11       0     -    0    1
-    //      WIDE1            WIDE         1     -    0    0
-    //      WIDE1            WIDE1        0     -    0    0
-
-    bool equal_text = equal_address_text(lhs, rhs);
-
-    // If all address fields are equal, then we can immediately return true.
+    // Router address: DIGI
+    // Router n-N addresses: WIDE1,WIDE2
+    //
+    // Packet: N0CALL>APRS,K7ABC-3*,TCPIP,qAR,W7XYZ:data
+    //                     ~~       ~~    ~~  ~~
+    //                     no address starts with DI or WI, the packet cannot be routed
+    //
+    // Packets sent by us or to us are never rejected, as they are reported
+    // with the cannot_route_self and already_routed routing states.
 
-    if (equal_text && lhs.n == rhs.n &&
-        lhs.N == rhs.N && lhs.ssid == rhs.ssid)
+    if (!config.router_prefilter.enabled ||
+        packet_from_address == config.router_address_string ||
+        packet_to_address == config.router_address_string)
     {
         return true;
     }
 
-    // If all the address fields are equal, except for the the address text,
-    // we can immediately return false, as there is no way for the addresses to be equal.
-
-    if (lhs.n == rhs.n && lhs.N == rhs.N &&
-        lhs.ssid == rhs.ssid && !equal_text)
+    for (auto it = packet_path_begin; it != packet_path_end; ++it)
     {
-        return false;
+        using value_type = typename std::iterator_traits<InputIterator>::value_type;
+        if constexpr (has_data_and_size<value_type>::value)
+        {
+            if (test_address_prefilter(config.router_prefilter, std::string_view(it->data(), it->size())))
+            {
+                return true;
+            }
+        }
+        else
+        {
+            if (test_address_prefilter(config.router_prefilter, std::string_view(*it)))
+            {
+                return true;
+            }
+        }
     }
 
-    // If both addresses have an n, N number or ssid, and they are not equal,
-    // then we can immediately return false, as the addresses cannot be equal.
+    return false;
+}
+
+APRS_ROUTER_INLINE void init_addresses(const router_config& config, route_scratch& state)
+{
+    // Initialize addresses
     //
-    // Example:
+    // Addresses: N0CALL>APRS,CALLA,CALLB,WIDE1-1,WIDE2-2:data
+    //                        ~~~~~ ~~~~~ ~~~~~~~ ~~~~~~~
     //
-    // WIDE1   !=  WIDE2
-    // WIDE1-1 !=  WIDE1-2
-    // CALL-1  !=  CALL-2
+    // n-N addresses: N0CALL>APRS,CALLA,CALLB,WIDE1-1,WIDE2-2:data
+    //                                        ~~~~~~~ ~~~~~~~
+    //
+    // Explicit addresses: N0CALL>APRS,CALLA,CALLB,WIDE1-1,WIDE2-2:data
+    //                                 ~~~~~ ~~~~~
+    //
+    // The router's address and path have already been parsed by init_router_addresses
+    //
+    // Router address:            DIGI                               config.router_address_string   config.router_address
+    // Router n-N addresses:      WIDE1-1,WIDE2-2                                                  config.router_n_N_addresses
+    // Router explicit addresses: CALLA,CALLB                                                      config.router_explicit_addresses
+    // Packet:                    N0CALL>APRS,WIDE1,WIDE2-2:data                                   state.packet_from_address, state.packet_to_address, state.packet_path
+    // Packet addresses:          WIDE1,WIDE2-2                                                    state.packet_addresses
 
-    if ((lhs.n > 0 && rhs.n > 0 && lhs.n != rhs.n) ||
-        (lhs.N > 0 && rhs.N > 0 && lhs.N != rhs.N) ||
-        (lhs.ssid > 0 && rhs.ssid > 0 && lhs.ssid != rhs.ssid))
-    {
-        return false;
-    }
+    const std::string_view packet_from_address = state.packet_from_address;
+    const std::string_view packet_to_address = state.packet_to_address;
+    const std::array<std::array<char, address_text_max>, path_addresses_max>& packet_path = state.packet_path;
+    const std::array<size_t, path_addresses_max>& packet_path_address_sizes = state.packet_path_address_sizes;
+    const size_t packet_path_size = state.packet_path_size;
+    std::array<struct address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
 
-    // If the address text is equal, but the n, N numbers or ssid are different,
-    // we can return false, as the addresses cannot be equal.
+    // Clear previous packet addresses by resetting the size to zero
+    packet_addresses_size = 0;
 
-    if (equal_text && (lhs.n != rhs.n || lhs.N != rhs.N || lhs.ssid != rhs.ssid))
+    size_t index = 0;
+
+    // Parse the packet addresses with try_parse_packet_address
+
+    index = 0;
+
+    for (size_t path_index = 0; path_index < packet_path_size && packet_addresses_size < path_addresses_max; path_index++)
     {
-        return false;
+        const std::string_view packet_address_text { packet_path[path_index].data(), packet_path_address_sizes[path_index] };
+
+        // Parse the address in place, the packet addresses size is only incremented if it succeeds
+        struct address& packet_address = packet_addresses[packet_addresses_size];
+
+        if (try_parse_packet_address(config, packet_address_text, packet_address))
+        {
+            packet_address.index = static_cast<uint16_t>(index);
+            packet_addresses_size++;
+        }
+
+        index++;
     }
 
-    // Compare ADDRESSn-N with ADDRESS-SSID
+    set_addresses_offset(packet_from_address, packet_to_address, packet_addresses, packet_addresses_size);
+}
+
+APRS_ROUTER_INLINE bool try_parse_packet_address(const router_config& config, std::string_view packet_address_text, struct address& address)
+{
+    // Parse a packet address
+    // Based on whether an address appears in the router's explicit or n-N addresses list
+    // decide whether we use try_parse_address_with_ssid or try_parse_n_N_address to parse the packed address
     //
-    // Example: "WIDE1-1" can be represented as either n-N (WIDE1-1) or SSID (WIDE1-1)
-    // 
-    // Check if the base text part is the same ("WIDE" == "WIDE") and the numeric parts match, numerically and by text comparison
+    // Router address: DIGI
+    //                 ~~~~
+    // Router explicit addresses: CALLA,CALLB,CALLC
+    //                            ~~~~~ ~~~~~ ~~~~~
+    // Router n-N addresses: WIDE2,WIDE3
+    //                       ----- -----
+    // Packet: N0CALL>APRS,CALLA,CALLB*,WIDE2-1,WIDE3-2,DIGI,CALLC:data
+    //                     ~~~~~ ~~~~~  ------- ------- ~~~~ ~~~~~
+    // Addresses parsed with try_parse_address_with_ssid: CALLA,CALLB,DIGI,CALLC
+    //                                                    ~~~~~ ~~~~~ ~~~~ ~~~~~
+    // Addresses parsed with try_parse_n_N_address: WIDE2-1,WIDE3-2
+    //                                              ------- -------  
 
-    if (!equal_text && std::abs(static_cast<int>(lhs.text_size) - static_cast<int>(rhs.text_size)) == 1)
+    const struct address& router_address = config.router_address;
+    auto& router_explicit_addresses = config.router_explicit_addresses;
+    const size_t router_explicit_addresses_size = config.router_explicit_addresses_size;
+    auto& router_n_N_addresses = config.router_n_N_addresses;
+    const size_t router_n_N_addresses_size = config.router_n_N_addresses_size;
+
+    // The address might hold a previous parse, every parser is given a cleared address
+    address = {};
+
+    if (router_explicit_addresses_size > 0 && try_parse_address_with_ssid(packet_address_text, address))
     {
-        if (lhs.n > 0)
+        for (size_t router_explicit_index = 0; router_explicit_index < router_explicit_addresses_size; router_explicit_index++)
         {
-            if (lhs.text_size >= rhs.text_size)
-            {
-                return false;
-            }
-
-            if (!std::equal(lhs.text.begin(), lhs.text.begin() + lhs.text_size, rhs.text.begin()))
-            {
-                return false;
-            }
+            const auto& router_explicit_address = router_explicit_addresses[router_explicit_index];
 
-            if ((rhs.text[rhs.text_size - 1] - '0') == lhs.n)
+            if ((address.ssid == router_explicit_address.ssid && equal_address_text(address, router_explicit_address)) ||
+                (router_address.ssid == router_explicit_address.ssid && equal_address_text(router_address, router_explicit_address)))
             {
-                if (rhs.ssid > 0)
-                {
-                    return lhs.N == rhs.ssid;
-                }
-                return lhs.N == 0;
+                return true;
             }
         }
-        else if (rhs.n > 0)
-        {
-            if (rhs.text_size >= lhs.text_size)
-            {
-                return false;
-            }
+    }
 
-            if (!std::equal(rhs.text.begin(), rhs.text.begin() + rhs.text_size, lhs.text.begin()))
-            {
-                return false;
-            }
+    if (router_n_N_addresses_size > 0)
+    {
+        address = {};
 
-            if ((lhs.text[lhs.text_size - 1] - '0') == rhs.n)
+        if (try_parse_n_N_address(packet_address_text, address))
+        {
+            for (size_t router_n_N_index = 0; router_n_N_index < router_n_N_addresses_size; router_n_N_index++)
             {
-                if (lhs.ssid > 0)
+                const auto& router_n_N_address = router_n_N_addresses[router_n_N_index];
+
+                if (address.n == router_n_N_address.n && equal_address_text(address, router_n_N_address))
                 {
-                    return rhs.N == lhs.ssid;
+                    return true;
                 }
-                return rhs.N == 0;
             }
         }
     }
 
-    return false;
+    address = {};
+
+    return try_parse_address(packet_address_text, address);
 }
 
-APRS_ROUTER_INLINE address canonicalize(const struct address& address)
+template <class Options>
+APRS_ROUTER_INLINE_NO_DISABLE bool try_init_last_used_address(const router_config& config, route_scratch& state)
 {
-    // Canonicalize an address by removing n-N information and preserving only the ssid.
+    // Initialize only the last used address, for packets whose routing is decided by it
+    //
+    // Packet routing ended: N0CALL>APRS,CALLA,CALLB,CALLC*:data
+    //                                               ~~~~~~
+    //
+    // Packet routed by us: N0CALL>APRS,CALLA,DIGI*,CALLC,WIDE2-2:data
+    //                                        ~~~~~
+    //
+    // The path text is scanned backwards for the used flag '*', as the used address is most commonly
+    // at the end of the path. Only the used address is parsed, the rest of the path is not parsed.
+    // The other packet addresses are left uninitialized, only the last used address can be used.
+    //
+    // Addresses longer than address_text_max are rejected by try_init_packet_path, every path address
+    // is then parsed by init_addresses, and the index and offset of the used address are known from the path text.
+    //
+    // Returns false if the routing of the packet is not decided by the last used address,
+    // the packet should then be initialized by init_addresses and find_used_addresses.
 
-    assert(address.n == 0 || address.ssid == 0);
-    assert(address.N == 0 || address.ssid == 0);
+    const std::array<std::array<char, address_text_max>, path_addresses_max>& packet_path = state.packet_path;
+    const std::array<size_t, path_addresses_max>& packet_path_address_sizes = state.packet_path_address_sizes;
+    const size_t packet_path_size = state.packet_path_size;
 
-    struct address result = address;
+    size_t last_used_index = packet_path_size;
 
-    if ((result.n == 0 && result.N == 0) ||
-        result.ssid > 0)
+    for (size_t i = packet_path_size; i > 0; i--)
     {
-        // Already canonical
-        return result;
-    }
+        const size_t size = packet_path_address_sizes[i - 1];
 
-    if (result.n > 0)
-    {
-        if (result.mark)
+        if (size > 0 && packet_path[i - 1][size - 1] == '*')
         {
-            array_insert(result.text, result.text_size, result.text_size - 1, char('0' + result.n));
+            last_used_index = i - 1;
+            break;
         }
-        else
+    }
+
+    if (last_used_index == packet_path_size)
+    {
+        return false;
+    }
+
+    const bool routing_ended = (last_used_index == packet_path_size - 1);
+
+    // Complete n-N addresses after the used address are also considered used
+    // with skip_complete_n_N_address, see find_last_used_address_index
+    if constexpr (may_have_routing_option(Options{}, routing_option::skip_complete_n_N_address))
+    {
+        if (!routing_ended && enum_has_flag(get_routing_options(Options{}, config), routing_option::skip_complete_n_N_address))
         {
-            result.text[result.text_size++] = char('0' + result.n);
+            return false;
         }
-        result.n = 0;
     }
 
-    if (result.N > 0)
+    const std::string_view last_used_address_text { packet_path[last_used_index].data(), packet_path_address_sizes[last_used_index] };
+
+    // The parsed address text is always a prefix of the path text: DIGI-1* or DIGI*
+    //                                                                ~~~~        ~~~~
+    // Packets not routed by us are rejected before parsing the address
+    if (!routing_ended && last_used_address_text.substr(0, config.router_address.text_size) != std::string_view(config.router_address.text.data(), config.router_address.text_size))
     {
-        result.ssid = result.N;
-        result.N = 0;
+        return false;
     }
 
-    return result;
-}
+    struct address& last_used_address = state.packet_addresses[last_used_index];
 
-APRS_ROUTER_INLINE q_construct parse_q_construct(std::string_view text)
-{
-    if (text.size() != 3 || text[0] != 'q' || text[1] != 'A')
+    if (!try_parse_packet_address(config, last_used_address_text, last_used_address) ||
+        !last_used_address.mark)
     {
-        return q_construct::none;
+        return false;
     }
 
-    switch (text[2])
+    if (!routing_ended && !(equal_address_text(last_used_address, config.router_address) && last_used_address.ssid == config.router_address.ssid))
     {
-        case 'C': return q_construct::qAC;
-        case 'I': return q_construct::qAI;
-        case 'O': return q_construct::qAO;
-        case 'R': return q_construct::qAR;
-        case 'S': return q_construct::qAS;
-        case 'U': return q_construct::qAU;
-        case 'X': return q_construct::qAX;
-        case 'Z': return q_construct::qAZ;
-        case 'o': return q_construct::qAo;
-        case 'r': return q_construct::qAr;
+        return false;
+    }
 
-        default:
-            return q_construct::none;
+    // +1 to account for the path separator ',', +1 to account for '>' separator, see set_addresses_offset
+
+    size_t offset = state.packet_from_address.size() + state.packet_to_address.size() + 2;
+
+    for (size_t i = 0; i < last_used_index; i++)
+    {
+        offset += packet_path_address_sizes[i] + 1;
     }
+
+    last_used_address.index = static_cast<uint16_t>(last_used_index);
+    last_used_address.offset = static_cast<uint32_t>(offset);
+
+    state.packet_addresses_size = packet_path_size;
+    state.maybe_last_used_address_index = last_used_index;
+
+    return true;
 }
 
-APRS_ROUTER_INLINE address_kind parse_address_kind(std::string_view text)
+APRS_ROUTER_INLINE void parse_packet_addresses(const route_scratch& state, packet_address_parses& parses)
 {
-    if (text.size() < 4 || text.size() > 9)
+    // Parse every packet path address with all the address parsers used by init_addresses
+    //
+    // Packet: N0CALL>APRS,CALLA,WIDE2-1:data
+    //
+    // Explicit parses: CALLA   (failed)
+    // n-N parses:      (failed) WIDE2-1
+    // Parses:          CALLA   WIDE2-1
+
+    parses.size = 0;
+
+    for (size_t path_index = 0; path_index < state.packet_path_size && path_index < path_addresses_max; path_index++)
     {
-        return address_kind::other;
+        const std::string_view packet_address_text { state.packet_path[path_index].data(), state.packet_path_address_sizes[path_index] };
+
+        parses.explicit_addresses[path_index] = {};
+        parses.n_N_addresses[path_index] = {};
+        parses.addresses[path_index] = {};
+
+        parses.explicit_address_results[path_index] = try_parse_address_with_ssid(packet_address_text, parses.explicit_addresses[path_index]);
+        parses.n_N_address_results[path_index] = try_parse_n_N_address(packet_address_text, parses.n_N_addresses[path_index]);
+        parses.address_results[path_index] = try_parse_address(packet_address_text, parses.addresses[path_index]);
+
+        parses.size++;
     }
+}
+
+APRS_ROUTER_INLINE void init_addresses(const router_config& config, const packet_address_parses& parses, route_scratch& state)
+{
+    // Initialize the packet addresses like init_addresses, from addresses which have already been parsed
+    //
+    // Every address is taken from the parse init_addresses would have used for this router:
+    // the explicit parse if it matches one of the explicit addresses, the n-N parse
+    // if it matches one of the n-N addresses, and the generic parse otherwise.
+
+    const struct address& router_address = config.router_address;
+    std::array<struct address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
+
+    packet_addresses_size = 0;
+
+    size_t index = 0;
 
-    switch (text[0])
+    for (size_t path_index = 0; path_index < parses.size && packet_addresses_size < path_addresses_max; path_index++)
     {
-        case 'E':
-            if (text == "ECHO")
-            {
-                return address_kind::echo;
-            }
-            break;
+        bool matched_router_address = false;
 
-        case 'G':
-            if (text == "GATE")
-            {
-                return address_kind::gate;
-            }
-            break;
+        if (config.router_explicit_addresses_size > 0 && parses.explicit_address_results[path_index])
+        {
+            const struct address& packet_explicit_address = parses.explicit_addresses[path_index];
 
-        case 'I':
-            if (text == "IGATECALL")
+            for (size_t router_explicit_index = 0; router_explicit_index < config.router_explicit_addresses_size; router_explicit_index++)
             {
-                return address_kind::igatecall;
-            }
-            break;
+                const auto& router_explicit_address = config.router_explicit_addresses[router_explicit_index];
 
-        case 'N':
-            if (text == "NOGATE")
-            {
-                return address_kind::nogate;
+                if ((packet_explicit_address.ssid == router_explicit_address.ssid && equal_address_text(packet_explicit_address, router_explicit_address)) ||
+                    (router_address.ssid == router_explicit_address.ssid && equal_address_text(router_address, router_explicit_address)))
+                {
+                    array_push_back(packet_addresses, packet_addresses_size, packet_explicit_address);
+                    packet_addresses[packet_addresses_size - 1].index = static_cast<uint16_t>(index);
+                    matched_router_address = true;
+                    break;
+                }
             }
-            break;
+        }
 
-        case 'O':
-            if (text == "OPNTRC")
-            {
-                return address_kind::opntrc;
-            }
-            if (text == "OPNTRK")
-            {
-                return address_kind::opntrk;
-            }
-            break;
+        if (!matched_router_address && config.router_n_N_addresses_size > 0 && parses.n_N_address_results[path_index])
+        {
+            const struct address& packet_n_N_address = parses.n_N_addresses[path_index];
 
-        case 'R':
-            if (text == "RELAY")
-            {
-                return address_kind::relay;
-            }
-            if (text == "RFONLY")
+            for (size_t router_n_N_index = 0; router_n_N_index < config.router_n_N_addresses_size; router_n_N_index++)
             {
-                return address_kind::rfonly;
-            }
-            break;
+                const auto& router_n_N_address = config.router_n_N_addresses[router_n_N_index];
 
-        case 'T':
-            if (text == "TEMP")
-            {
-                return address_kind::temp;
-            }
-            if (text == "TRACE")
-            {
-                return address_kind::trace;
-            }
-            if (text == "TCPIP")
-            {
-                return address_kind::tcpip;
-            }
-            if (text == "TCPXX")
-            {
-                return address_kind::tcpxx;
+                if (packet_n_N_address.n == router_n_N_address.n && equal_address_text(packet_n_N_address, router_n_N_address))
+                {
+                    array_push_back(packet_addresses, packet_addresses_size, packet_n_N_address);
+                    packet_addresses[packet_addresses_size - 1].index = static_cast<uint16_t>(index);
+                    matched_router_address = true;
+                    break;
+                }
             }
-            break;
+        }
 
-        case 'W':
-            if (text == "WIDE")
-            {
-                return address_kind::wide;
-            }
-            break;
+        if (!matched_router_address && parses.address_results[path_index])
+        {
+            array_push_back(packet_addresses, packet_addresses_size, parses.addresses[path_index]);
+            packet_addresses[packet_addresses_size - 1].index = static_cast<uint16_t>(index);
+        }
+
+        index++;
     }
 
-    return address_kind::other;
+    set_addresses_offset(state.packet_from_address, state.packet_to_address, packet_addresses, packet_addresses_size);
 }
 
-APRS_ROUTER_INLINE bool try_parse_address(std::string_view address_string, struct address& address)
+APRS_ROUTER_INLINE bool try_init_canonical_addresses(const router_config& config, route_scratch& state)
 {
-    if (address_string.size() > 10)
-    {
-        return false;
-    }
-
-    std::string_view address_text = address_string;
+    // Initialize the addresses of a packet with a canonical n-N path
+    //
+    // Canonical paths: N0CALL>APRS,WIDE1-1,WIDE2-1:data
+    //                              ~~~~~~~ ~~~~~~~
+    //
+    //                  N0CALL>APRS,CALL*,WIDE2-1:data
+    //                              ~~~~~ ~~~~~~~
+    //
+    // Most packets use one of these paths, an optional used address followed by only n-N addresses.
+    // The shape is recognized directly from the path text, and for these packets the checks done by
+    // init_addresses and find_used_addresses have a known outcome:
+    //
+    //   - none of the addresses match the router's address, or the router's explicit addresses
+    //   - the used address is the last used address, and the routing has not ended
+    //   - all the n-N addresses have N > 0, and are not skipped as complete n-N addresses
+    //
+    // Routers with explicit addresses are supported, as long as the router's address is not one of the
+    // explicit addresses, which changes how init_addresses parses n-N addresses, see try_parse_packet_address.
+    //
+    // Returns false if the path is not canonical, or if any of these does not hold,
+    // the packet should then be initialized by init_addresses and find_used_addresses.
 
-    array_assign(address.text, address.text_size, address_text.begin(), address_text.end());
+    const std::array<std::array<char, address_text_max>, path_addresses_max>& packet_path = state.packet_path;
+    const std::array<size_t, path_addresses_max>& packet_path_address_sizes = state.packet_path_address_sizes;
+    const size_t packet_path_size = state.packet_path_size;
+    const struct address& router_address = config.router_address;
+    std::array<struct address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
 
-    address.mark = false;
-    address.ssid = 0;
-    address.length = address_text.size();
-    address.n = 0;
-    address.N = 0;
-    address.q = parse_q_construct({address.text.data(), address.text_size});
-    address.kind = address_kind::other;
+    const auto& router_explicit_addresses = config.router_explicit_addresses;
+    const size_t router_explicit_addresses_size = config.router_explicit_addresses_size;
 
-    // Parse Q construct first
-    if (address.q != q_construct::none)
+    if (config.router_n_N_addresses_size == 0 || config.router_address_string.empty())
     {
-        address.kind = address_kind::q;
-        return true; // Early return for Q constructs as there is nothing else to parse
+        return false;
     }
 
-    // Check to see if the address is used (ending with *)
-    if (!address_text.empty() && address_text.back() == '*')
+    for (size_t i = 0; i < router_explicit_addresses_size; i++)
     {
-        address.mark = true;
-        address_text.remove_suffix(1); // remove the *
+        if (router_address.ssid == router_explicit_addresses[i].ssid && equal_address_text(router_address, router_explicit_addresses[i]))
+        {
+            return false;
+        }
+    }
 
-        array_assign(address.text, address.text_size, address_text.begin(), address_text.end()); // set the text to the address without the *
+    // Packets sent to us or sent by us are routed differently
+    if (packet_path_size == 0 || state.original_packet_path_size != packet_path_size ||
+        is_packet_from_us(config, state) || is_packet_sent_to_us(config, state))
+    {
+        return false;
     }
 
-    auto sep_position = address_text.find("-");
+    // Check the shape of the path text first, before parsing any address
+    //
+    // Used address: CALL*
+    //                   ~
+    // n-N address: WIDE2-1
+    //                   ~~~
 
-    // No separator found
-    if (sep_position == std::string_view::npos)
+    const bool has_used_address = packet_path_address_sizes[0] > 0 && packet_path[0][packet_path_address_sizes[0] - 1] == '*';
+
+    for (size_t i = has_used_address ? 1 : 0; i < packet_path_size; i++)
     {
-        if (!address_text.empty() && isdigit(address_text.back()))
-        {
-            address.n = address_text.back() - '0'; // get the last character as a number
-            address_text.remove_suffix(1); // remove the digit from the address text
+        const char* text = packet_path[i].data();
+        const size_t size = packet_path_address_sizes[i];
 
-            // Validate the n is in the range 1-7
-            if (address.n > 0 && address.n <= 7)
-            {
-                array_assign(address.text, address.text_size, address_text.begin(), address_text.end());
-                address.kind = parse_address_kind({address.text.data(), address.text_size});
-            }
-            else
-            {
-                address.n = 0;
-            }
-        }
-        else
+        if (size < 4 || text[size - 2] != '-' ||
+            text[size - 3] < '1' || text[size - 3] > '7' ||
+            text[size - 1] < '1' || text[size - 1] > '7')
         {
-            address.kind = parse_address_kind({address.text.data(), address.text_size});
+            return false;
         }
+    }
 
-        return true;
+    if (has_used_address && packet_path_size == 1)
+    {
+        return false;
     }
 
-    // Separator found, check if we have exactly one digit on both sides of the separator, ex WIDE1-1
-    // If the address does not match the n-N format, we will treat it as a regular address ex address with SSID
-    if (sep_position != std::string_view::npos &&
-        std::isdigit(static_cast<int>(address_text[sep_position - 1])) &&
-        (sep_position + 1) < address_text.size() && std::isdigit(static_cast<int>(address_text[sep_position + 1])) &&
-        (sep_position + 2 == address_text.size()))
+    packet_addresses_size = 0;
+
+    for (size_t i = 0; i < packet_path_size; i++)
     {
-        address.n = address_text[sep_position - 1] - '0';
-        address.N = address_text[sep_position + 1] - '0';
+        const std::string_view packet_address_text { packet_path[i].data(), packet_path_address_sizes[i] };
+        struct address packet_address;
 
-        if (address.N >= 0 && address.N <= 7 && address.n > 0 && address.n <= 7)
+        if (i == 0 && has_used_address)
         {
-            array_assign(address.text, address.text_size, address_text.data(), address_text.data() + sep_position - 1); // remove the separator and both digits from the address text
-            address.kind = parse_address_kind({address.text.data(), address.text_size});
+            // The used address, ex: CALL*, should not be an n-N address, or a complete n-N address of the router
+            if (!try_parse_address(packet_address_text, packet_address) ||
+                packet_address.n != 0 || packet_address.N != 0 || packet_address.q != q_construct::none ||
+                find_next_matching_n_N_address(packet_address, get_n_N_address_key(packet_address), config.router_n_N_addresses, config.router_n_N_address_keys, config.router_n_N_addresses_size, 0) < config.router_n_N_addresses_size)
+            {
+                return false;
+            }
         }
-        else
+        else if (!try_parse_n_N_address(packet_address_text, packet_address) || packet_address.n == 0 || packet_address.N == 0)
         {
-            address.n = 0;
-            address.N = 0;
+            return false;
         }
 
-        return true;
-    }
-
-    // Handle SSID parsing
-    // Expecting the separator to be followed by a digit, ex: CALL-1
-    if ((sep_position + 1) < address_text.size() && std::isdigit(static_cast<int>(address_text[sep_position + 1])))
-    {
-        std::array<char, 3> ssid_chars = {};
-        size_t ssid_chars_size = 0;
-        array_assign(ssid_chars, ssid_chars_size, address_text.data() + sep_position + 1, address_text.data() + address_text.size());
+        // The router's address might itself look like an n-N address, ex: DIGI2-1
+        if (equal_address_text(packet_address, router_address) || equal_addresses_ignore_mark(packet_address, router_address) ||
+            packet_address_text.substr(0, packet_address_text.size() - (packet_address.mark ? 1 : 0)) == config.router_address_string)
+        {
+            return false;
+        }
 
-        // Check for a single digit or two digits, ex: CALL-1 or CALL-12
-        if (ssid_chars_size == 1 || (ssid_chars_size == 2 && std::isdigit(static_cast<int>(ssid_chars[1]))))
+        // Addresses matching an explicit address are routed explicitly, ex: WIDE2-1 in the router's explicit addresses
+        if (router_explicit_addresses_size > 0)
         {
-            int ssid;
-            if (!try_parse_int({ssid_chars.data(), ssid_chars_size}, ssid))
+            struct address explicit_address;
+
+            if (try_parse_address_with_ssid(packet_address_text, explicit_address))
             {
-                return true;
+                for (size_t j = 0; j < router_explicit_addresses_size; j++)
+                {
+                    if (explicit_address.ssid == router_explicit_addresses[j].ssid && equal_address_text(explicit_address, router_explicit_addresses[j]))
+                    {
+                        return false;
+                    }
+                }
             }
 
-            if (ssid >= 0 && ssid <= 15)
+            if (has_matching_address(packet_address, get_address_key(packet_address), router_explicit_addresses, config.router_explicit_address_keys, router_explicit_addresses_size))
             {
-                address.ssid = ssid;
-                array_assign(address.text, address.text_size, address_text.data(), address_text.data() + sep_position);
+                return false;
             }
         }
+
+        packet_address.index = static_cast<uint16_t>(i);
+        array_push_back(packet_addresses, packet_addresses_size, packet_address);
+    }
+
+    set_addresses_offset(state.packet_from_address, state.packet_to_address, packet_addresses, packet_addresses_size);
+
+    if (has_used_address)
+    {
+        state.maybe_last_used_address_index = 0;
+    }
+    else
+    {
+        state.maybe_last_used_address_index.reset();
     }
+    state.maybe_router_address_index.reset();
+    state.unused_address_index = has_used_address ? 1 : 0;
+
+    return true;
+}
+
+APRS_ROUTER_INLINE void unset_all_used_addresses(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count)
+{
+    unset_all_used_addresses(packet_addresses, packet_addresses_size, offset, count, std::nullopt);
+}
+
+APRS_ROUTER_INLINE void unset_all_used_addresses(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count, std::optional<size_t> maybe_ignore_index)
+{
+    // Unset all addresses marked as used inside a packet path
+    //
+    // Packet: N0CALL>APRS,CALLA*,CALLB,CALLC*,CALLD,WIDE1-2:data
+    //                     ~~~~~~       ~~~~~~
+    // Will be updated to: N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,WIDE1-2:data
+
+    assert(offset < packet_addresses_size);
+    assert(count <= packet_addresses_size);
+
+    size_t ignore_index = maybe_ignore_index.value_or(packet_addresses_size); // intentionally outside bounds if not set
 
-    return true;
-}
+    size_t address_offset = packet_addresses[offset].offset;
 
-APRS_ROUTER_INLINE bool try_parse_n_N_address(std::string_view address_string, std::array<char, 10>& address_text, size_t& address_text_size, int& n, int& N, bool& mark, size_t& length, address_kind& kind)
-{
-    if (address_string.size() > 10)
+    for (size_t i = offset, n = 0; i < packet_addresses_size && n < count; i++, n++)
     {
-        return false;
+        if (packet_addresses[i].mark && i != ignore_index)
+        {
+            packet_addresses[i].mark = false;
+            packet_addresses[i].length--;
+        }
+        packet_addresses[i].offset = static_cast<uint32_t>(address_offset);
+        address_offset += packet_addresses[i].length + 1; // +1 for the comma address separator ','
     }
+}
 
-    std::string_view text = address_string;
+APRS_ROUTER_INLINE void set_address_as_used(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t index)
+{
+    // Mark an address at "index" as used: N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,WIDE1-2:data
+    //
+    // If index is "2" packet will be updated to: N0CALL>APRS,CALLA,CALLB,CALLC*,CALLD,WIDE1-2:data
+    //                                                                    ~~~~~~
 
-    array_assign(address_text, address_text_size, text.begin(), text.end());
+    assert(index < packet_addresses_size);
+    set_address_as_used(packet_addresses, packet_addresses_size, packet_addresses[index]);
+}
 
-    mark = false;
-    length = text.size();
-    n = 0;
-    N = 0;
-    kind = address_kind::other;
+APRS_ROUTER_INLINE void set_address_as_used(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, address& packet_address)
+{
+    unset_all_used_addresses(packet_addresses, packet_addresses_size, 0, packet_addresses_size);
 
-    // Check to see if the address is used (ending with *)
-    if (!text.empty() && text.back() == '*')
+    if (packet_address.mark)
     {
-        mark = true;
-        text.remove_suffix(1); // remove the *
-
-        array_assign(address_text, address_text_size, text.begin(), text.end()); // set the text to the address without the *
+        return;
     }
 
-    auto sep_position = text.find("-");
+    packet_address.mark = true;
+    packet_address.length++;
 
-    // No separator found
-    if (sep_position == std::string_view::npos)
+    if (packet_addresses_size > 1)
     {
-        if (!text.empty() && isdigit(text.back()))
-        {
-            n = text.back() - '0'; // get the last character as a number
-
-            text.remove_suffix(1); // remove the digit from the address text
-
-            // Validate the n is in the range 1-7
-            if (n > 0 && n <= 7)
-            {
-                array_assign(address_text, address_text_size, text.begin(), text.end());
-                kind = parse_address_kind({address_text.data(), address_text_size});
-            }
-            else
-            {
-                n = 0;
-            }
-        }
-        else
+        for (size_t i = packet_address.index, address_offset = packet_address.offset; i < packet_addresses_size; i++)
         {
-            kind = parse_address_kind({address_text.data(), address_text_size});
+            packet_addresses[i].offset = static_cast<uint32_t>(address_offset);
+            address_offset += packet_addresses[i].length + 1; // +1 for the comma address separator ','
         }
-
-        return true;
     }
+}
 
-    // Separator found, check if we have exactly one digit on both sides of the separator, ex WIDE1-1
-    // If the address does not match the n-N format, we will treat it as a regular address ex address with SSID
-    if (sep_position != std::string_view::npos &&
-        std::isdigit(static_cast<int>(text[sep_position - 1])) &&
-        (sep_position + 1) < text.size() && std::isdigit(static_cast<int>(text[sep_position + 1])) &&
-        (sep_position + 2 == text.size()))
+APRS_ROUTER_INLINE void update_addresses_index(std::array<address, path_addresses_max>& addresses, size_t addresses_size)
+{
+    for (size_t i = 0; i < addresses_size; i++)
     {
-        n = text[sep_position - 1] - '0';
-        N = text[sep_position + 1] - '0';
+        addresses[i].index = static_cast<uint16_t>(i);
+    }
+}
 
-        if (N >= 0 && N <= 7 && n > 0 && n <= 7)
-        {
-            array_assign(address_text, address_text_size, text.data(), text.data() + sep_position - 1); // remove the separator and both digits from the address text
-            kind = parse_address_kind({address_text.data(), address_text_size});
-        }
-        else
-        {
-            n = 0;
-            N = 0;
-        }
+APRS_ROUTER_INLINE void set_addresses_offset(std::string_view packet_from_address, std::string_view packet_to_address, std::array<address, path_addresses_max>& addresses, size_t addresses_size)
+{
+    // +1 to account for the path separator ',', +1 to account for '>' separator
+    //
+    // Example:
+    //
+    // N0CALL>APRS,WIDE2-1:data
+    //       ~    ~
+    //      +1   +1
+    // ~~~~~~~~~~~~ - offset
 
-        return true;
-    }
+    size_t offset = packet_from_address.size() + packet_to_address.size() + 2;
+    update_addresses_offset(addresses, addresses_size, offset);
+}
 
-    return false;
+APRS_ROUTER_INLINE void update_addresses_offset(std::array<address, path_addresses_max>& addresses, size_t addresses_size, size_t initial_offset)
+{
+    // Updates addresses offsets, useful after an address was inserted, replaced or removed
+    // This function does not update the length of addresses, and assumes they are up to date
+    // This function should not be used if an address is updated in a way that will change the length ex: marked as set
+    // because the length will be innacurate and the offsets will not be correctly calculated
+    //
+    // Before:
+    //
+    // N0CALL>APRS,AB,ABC,ABCD:data
+    // ~~~~~~~~~~~~
+    // 0         12 - initial_offset
+    //
+    // N0CALL>APRS,AB,ABC,ABCD:data
+    //             ~~ ~~~ ~~~~
+    //             12 15  19  - Offsets
+    //
+    // After:
+    //
+    // N0CALL>APRS,ABCDE,AB,ABC,ABCD:data
+    //             ~~~~~ ~~ ~~~ ~~~~
+    //             12    18 21  25  - Offsets
+    //               ^
+    //             Packet address inserted
+    //
+    // Offsets updated for addresses: "AB", "ABC", and "ABCD"
+    // due to the inserted address "ABCDE"
+
+    for (size_t i = 0, offset = initial_offset; i < addresses_size; i++)
+    {
+        address& address = addresses[i];
+        address.offset = static_cast<uint32_t>(offset);
+        offset += address.length + 1; // +1 for the comma address separator ','
+    }
 }
 
-APRS_ROUTER_INLINE bool try_parse_n_N_address(std::string_view address_string, struct address& address)
+APRS_ROUTER_INLINE void update_addresses_offset(std::array<address, path_addresses_max>& addresses, size_t addresses_size)
 {
-    return try_parse_n_N_address(address_string, address.text, address.text_size, address.n, address.N, address.mark, address.length, address.kind);
+    assert(addresses_size > 0);
+    size_t initial_offset = addresses[0].offset;
+    update_addresses_offset(addresses, addresses_size, initial_offset);
 }
 
-APRS_ROUTER_INLINE bool try_parse_address_with_ssid(std::string_view address_string, struct address& address)
+APRS_ROUTER_INLINE bool try_insert_address(std::array<address, path_addresses_max>& packet_addresses, size_t& packet_addresses_size, size_t index, std::string_view inserted_address_string)
 {
-    // This function is a wrapper around try_parse_address
-    // it will parse the address and ssid from the address_string
-    // and create an address type.
+    // Insert an address at "index" in the packet path
+    //
+    // Packet: N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE:data
+    //                                 ^
+    //                                 |
+    //                                 index = 2
+    // 
+    // inserted_address_string: "DIGI"
+    //
+    // Updated packet: N0CALL>APRS,CALLA,CALLB,DIGI,CALLC,CALLD,CALLE:data
+    //                                         ~~~~
 
-    std::array<char, 10> address_no_ssid = {};
-    size_t address_no_ssid_size = 0;
-    int ssid = 0;
-    bool mark = false;
+    assert(index <= packet_addresses_size);
+    assert(packet_addresses_size > 0);
 
-    if (!try_parse_address_with_used_flag(address_string, address_no_ssid, address_no_ssid_size, ssid, mark))
+    if (packet_addresses_size >= path_addresses_max)
     {
         return false;
     }
 
-    address.text = address_no_ssid;
-    address.text_size = address_no_ssid_size;
-    address.ssid = ssid;
-    address.length = address_string.size();
-    address.mark = mark;
+    address new_address;
+    array_assign(new_address.text, new_address.text_size, inserted_address_string.begin(), inserted_address_string.end());
+    new_address.length = static_cast<uint16_t>(inserted_address_string.size());
+
+    size_t initial_offset = packet_addresses[0].offset;
+
+    array_insert(packet_addresses, packet_addresses_size, index, new_address);
+
+    update_addresses_index(packet_addresses, packet_addresses_size);
+    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
 
     return true;
 }
 
-APRS_ROUTER_INLINE bool try_parse_address(std::string_view address, std::array<char, 10>& address_no_ssid, size_t& address_no_ssid_size, int& ssid)
+APRS_ROUTER_INLINE void replace_address_with_router_address(struct address& address, const struct address& router_address)
 {
-    // Try parse an address like: ADDRESS[-SSID]
+    // Replace an address with the router's address
     //
-    // Example:
+    // If the router's address is "DIGI", and the address is "WIDE2", the address will be updated to "DIGI"
     //
-    // CALL1-10
-    // ~~~~~ ~~
-    // ^     ssid = 10
-    // |
-    // address_no_ssid = CALL1
+    // A packet "N0CALL>APRS,CALLA*,CALLB,CALLC,WIDE2:data"
+    //                                          ~~~~~
     // 
-    // This functions expects a valid AX.25 address,
-    // and will return false if the address is not valid.
-    // An address with a non numeric ssid will be rejected, ex: CALL-AB
+    // will be updated to "N0CALL>APRS,CALLA*,CALLB,CALLC,DIGI:data"
+    //                                                    ~~~~
 
-    ssid = 0;
+    address.text = router_address.text;
+    address.text_size = router_address.text_size;
+    address.length = router_address.length;
+    address.ssid = router_address.ssid;
+    address.n = 0;
+    address.N = 0;
+}
 
-    if (address.empty() || address.size() > 9)
+APRS_ROUTER_INLINE bool try_move_address_to_position(std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index)
+{
+    // Shift and re-insert and address into the packet path, typically used for "preempt_front"
+    //
+    // If the router's address is "CALLD", a packet "N0CALL>APRS,CALLA*,CALLB,CALLC,CALLD,CALLE:data"
+    //                                                                  ~~~~~~~~~~~~~~~~~
+    // will be updated to move the "CALLD" addresses in the front of the path and become
+    // "N0CALL>APRS,CALLA,CALLD*,CALLB,CALLC,CALLE:data"
+    //                    ~~~~~~
+    // The digipeated marker isn't done by this function
+
+    assert(from_index < packet_addresses_size);
+    assert(to_index < packet_addresses_size);
+    assert(from_index != to_index);
+
+    if (from_index >= packet_addresses_size || to_index >= packet_addresses_size)
     {
         return false;
     }
 
-    auto sep_position = address.find("-");
-
-    if (sep_position != std::string_view::npos)
+    if (from_index == to_index)
     {
-        // Check few error conditions
-        // If packet ends with a separator but no ssid, ex: "CALL-"
-        // If there are more than 2 character after the separator, ex: CALL-123
-        if ((sep_position == (address.size() - 1)) || ((sep_position + 3) < address.size()))
-        {
-            return false;
-        }
-
-        array_assign(address_no_ssid, address_no_ssid_size, address.data(), address.data() + sep_position);
-
-        std::array<char, 3> ssid_chars = {};
-        size_t ssid_chars_size = 0;
-        array_assign(ssid_chars, ssid_chars_size, address.data() + sep_position + 1, address.data() + address.size());
-
-        if (ssid_chars[0] == '0')
-        {
-            return false;
-        }
+        return false;
+    }
 
-        // Ensure the ssid is a number
-        if (!std::isdigit(static_cast<unsigned char>(ssid_chars[0])) ||
-            (ssid_chars_size > 1 && !std::isdigit(static_cast<unsigned char>(ssid_chars[1]))))
-        {
-            return false;
-        }
+    struct address address = packet_addresses[from_index];
 
-        if (!try_parse_int({ssid_chars.data(), ssid_chars_size}, ssid))
-        {
-            return false;
-        }
+    size_t initial_offset = packet_addresses[0].offset;
 
-        // SSIDs are 4-bit values and must be in the [0, 15] range
-        if (ssid < 0 || ssid > 15)
-        {
-            ssid = 0;
-            return false;
-        }
-    }
-    else
-    {
-        array_assign(address_no_ssid, address_no_ssid_size, address.begin(), address.end());
-        ssid = 0;
-    }
+    array_erase(packet_addresses, packet_addresses_size, from_index);
 
-    // The address text (without SSID) is at most 6 characters
-    if (address_no_ssid_size > 6)
-    {
-        return false;
-    }
+    assert(packet_addresses_size < path_addresses_max);
 
-    for (size_t i = 0; i < address_no_ssid_size; i++)
-    {
-        char c = address_no_ssid[i];
+    array_insert(packet_addresses, packet_addresses_size, to_index, address);
 
-        // The address has to be alphanumeric and uppercase, or a digit
-        if ((!std::isalnum(static_cast<unsigned char>(c)) || !std::isdigit(static_cast<unsigned char>(c))) &&
-            !std::isupper(static_cast<unsigned char>(c)))
-        {
-            return false;
-        }
-    }
+    update_addresses_index(packet_addresses, packet_addresses_size);
+    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
 
     return true;
 }
 
-APRS_ROUTER_INLINE bool try_parse_address_with_used_flag(std::string_view address, std::array<char, 10>& address_no_ssid, size_t& address_no_ssid_size, int& ssid)
+APRS_ROUTER_INLINE bool try_truncate_address_range(std::array<address, path_addresses_max>& packet_addresses, size_t& packet_addresses_size, size_t start_index, size_t end_index)
 {
-    bool mark = false;
-    return try_parse_address_with_used_flag(address, address_no_ssid, address_no_ssid_size, ssid, mark);
-}
+    // Truncate a range of addresses, typically used for "preempt_truncate"
+    //
+    // If the router's address is "CALLD", a packet "N0CALL>APRS,CALLA*,CALLB,CALLC,CALLD,CALLE:data"
+    //                                                                  ~~~~~~~~~~~~~~~~~
+    //
+    // will be truncated of the "CALLB,CALLC,CALLD" addresses in the path and become:
+    //
+    // "N0CALL>APRS,CALLA,CALLD*,CALLE:data"
+    //                    ~~~~~~
+    //
+    // The digipeated marker and re-insertion of "CALLD" isn't done by this function
 
-APRS_ROUTER_INLINE bool try_parse_address_with_used_flag(std::string_view address, std::array<char, 10>& address_no_ssid, size_t& address_no_ssid_size, int& ssid, bool& mark)
-{
-    ssid = 0;
-    mark = false;
+    assert(start_index < packet_addresses_size);
+    assert(end_index < packet_addresses_size);
 
-    if (address.empty())
+    if (start_index >= packet_addresses_size || end_index >= packet_addresses_size ||
+        start_index >= end_index)
     {
         return false;
     }
 
-    if (address.back() == '*')
-    {
-        mark = true;
-        address.remove_suffix(1);
-    }
+    struct address address = packet_addresses[end_index];
 
-    return try_parse_address(address, address_no_ssid, address_no_ssid_size, ssid);
-}
+    size_t initial_offset = packet_addresses[0].offset;
 
-APRS_ROUTER_INLINE bool try_parse_address(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid)
-{
-    std::array<char, 10> address_no_ssid_result = {};
-    size_t address_no_ssid_result_size = 0;
+    // Calculate how many elements to remove (from start_index to end_index inclusive)
+    size_t remove_count = end_index - start_index + 1;
 
-    bool result = try_parse_address(address, address_no_ssid_result, address_no_ssid_result_size, ssid);
+    array_erase_n(packet_addresses, packet_addresses_size, start_index, remove_count);
 
-    address_no_ssid.assign(address_no_ssid_result.data(), address_no_ssid_result_size);
+    assert(packet_addresses_size < path_addresses_max);
 
-    return result;
+    array_insert(packet_addresses, packet_addresses_size, start_index, address);
+
+    update_addresses_index(packet_addresses, packet_addresses_size);
+    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+
+    return true;
 }
 
-APRS_ROUTER_INLINE bool try_parse_address_with_used_flag(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid)
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_truncate_empty_addresses(route_scratch& state, bool enable_diagnostics, OutputIterator routing_actions_out)
 {
-    std::array<char, 10> address_no_ssid_result = {};
-    size_t address_no_ssid_result_size = 0;
+    // Truncate all empty addresses in the packet path
+    //
+    // Packet: N0CALL>APRS,,CALLA*,CALLB,,CALLD,CALLE:data
+    //                     ~             ~
+    // Will be updated to: N0CALL>APRS,CALLA*,CALLB,CALLD,CALLE:data
 
-    bool result = try_parse_address_with_used_flag(address, address_no_ssid_result, address_no_ssid_result_size, ssid);
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    size_t& packet_addresses_size = state.packet_addresses_size;
 
-    address_no_ssid.assign(address_no_ssid_result.data(), address_no_ssid_result_size);
+    auto begin = packet_addresses.begin();
 
-    return result;
+    for (size_t i = 0; i < packet_addresses_size; )
+    {
+        if (packet_addresses[i].text_size == 0)
+        {
+            routing_actions_out = push_address_removed_diagnostic(packet_addresses, packet_addresses_size, i, enable_diagnostics, routing_actions_out);
+            array_erase(packet_addresses, packet_addresses_size, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    update_addresses_index(packet_addresses, packet_addresses_size);
+    update_addresses_offset(packet_addresses, packet_addresses_size);
+
+    return { routing_actions_out, true };
 }
 
-APRS_ROUTER_INLINE bool try_parse_address_with_used_flag(std::string_view address, internal_string_t<char>& address_no_ssid, int& ssid, bool& mark)
+template <class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_substitute_complete_n_N_address(const router_config& config, route_scratch& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
 {
-    std::array<char, 10> address_no_ssid_result = {};
-    size_t address_no_ssid_result_size = 0;
+    // If the last n-N hop has been exhausted, replace the hop with the router's address
+    //
+    // Example:
+    //
+    // Input:  FROM>TO,WIDE1-1,WIDE2-1:data
+    // Output: FROM>TO,DIGI*,WIDE2-1:data - replace WIDE1 (after decrementing) with DIGI
 
-    bool result = try_parse_address_with_used_flag(address, address_no_ssid_result, address_no_ssid_result_size, ssid, mark);
+    std::array<address, path_addresses_max>& packet_addresses = state.packet_addresses;
+    const size_t packet_addresses_size = state.packet_addresses_size;
+    const std::string_view router_address = config.router_address_string;
 
-    address_no_ssid.assign(address_no_ssid_result.data(), address_no_ssid_result_size);
+    assert(packet_n_N_address_index < packet_addresses_size);
 
-    return result;
+    address& address = packet_addresses[packet_n_N_address_index];
+
+    if (address.N == 0)
+    {
+        routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, address.index, router_address, enable_diagnostics, routing_actions_out);
+        array_assign(address.text, address.text_size, router_address.begin(), router_address.end());
+        address.length = static_cast<uint16_t>(router_address.size());
+        address.N = 0;
+        address.n = 0;
+        address.kind = address_kind::other;
+
+        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, address.index, enable_diagnostics, routing_actions_out);
+        set_address_as_used(packet_addresses, packet_addresses_size, address);
+        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, address.index, enable_diagnostics, routing_actions_out);
+        return { routing_actions_out, true };
+    }
+
+    return { routing_actions_out, false };
 }
 
-APRS_ROUTER_INLINE bool try_parse_int(std::string_view str, int& value)
+APRS_ROUTER_INLINE bool try_decrement_n_N_address(address& n_N_address)
 {
-    // Attempt to parse an integer from the given string_view.
-    // Returns true if parsing is successful, false otherwise.
-    // If parsing fails, the value is set to 0.
-
-    auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+    // Decrements an n-N address
+    //
+    // Example: WIDE2-2 becomes WIDE2-1
+    //              ~~~             ~~~
 
-    // Check if the parsing was successful and if the entire string was consumed
-    // The result.ec should be std::errc() and result.ptr should point to the end of the string    
-    bool success = (result.ec == std::errc()) && (result.ptr == (str.data() + str.size()));
+    assert(n_N_address.N > 0);
 
-    // If parsing fails, set value to 0
-    if (!success)
+    if (n_N_address.N > 0)
     {
-        value = 0;
+        n_N_address.N--;
+        if (n_N_address.N == 0)
+        {
+            n_N_address.length -= 2; // as '-N' is absent
+        }
+        return true;
     }
 
-    return success;
+    return false;
+}
+
+APRS_ROUTER_INLINE bool try_decrement_n_N_address(route_scratch& state, struct address& address)
+{
+    // Decrements an n-N address, while updating the offsets of the addresses
+
+    bool result = try_decrement_n_N_address(address);
+    if (result)
+    {
+        update_addresses_offset(state.packet_addresses, state.packet_addresses_size);
+    }
+    return result;
 }
 
 // **************************************************************** //
 //                                                                  //
 //                                                                  //
-// ADDRESSES                                                        //
+// ADDRESS SEARCH                                                   //
 //                                                                  //
 //                                                                  //
 // **************************************************************** //
 
-template <class InputIterator1, class InputIterator2>
-APRS_ROUTER_INLINE_NO_DISABLE void init_router_addresses(InputIterator1 router_explicit_addresses_begin, InputIterator1 router_explicit_addresses_end, InputIterator2 router_n_N_addresses_begin, InputIterator2 router_n_N_addresses_end, route_state& state)
+APRS_ROUTER_INLINE size_t count_trailing_zeros(uint64_t value)
 {
-    // Parse the router's address, explicit address list, and n-N address list once,
-    // and cache the results in `state` so subsequent calls reuse them.
+    // Index of the lowest set bit, value must not be zero
+
+    assert(value != 0);
+
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctzll(value));
+#else
+    size_t count = 0;
+    while ((value & 1) == 0)
+    {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+APRS_ROUTER_INLINE void find_packet_separators(const char* text, size_t text_size, uint64_t& from_ends, uint64_t& commas, uint64_t& colons)
+{
+    // Find the packet separators in the first 64 characters of a line, one bit per character
     //
-    // Iterator value types only need to be convertible to std::string_view (e.g. std::string, std::string_view, const char*).
+    // Text:      N0CALL>APRS,WIDE1-1:data
+    // From ends: 000000100000000000000000
+    // Commas:    000000000001000000000000
+    // Colons:    000000000000000000010000
     //
-    // Router address:            DIGI                               state.router_address_string   state.router_address
-    // Router explicit addresses: CALLA,CALLB                                                      state.router_explicit_addresses
-    // Router n-N addresses:      WIDE1-1,WIDE2-2                                                  state.router_n_N_addresses
+    // The 64 characters are compared 16 at a time with SSE2 or NEON if available, and must all be readable,
+    // bits past 'text_size' are not meaningful. Without SIMD only the first 'text_size' characters are compared.
 
-    // Do not redo parsing of router addresses if already initialized
-    // These parsed addresses can be reused to speed up routing
+    from_ends = 0;
+    commas = 0;
+    colons = 0;
+
+#if defined(APRS_ROUTER_SIMD_SSE2)
+    (void)text_size;
 
-    if (state.initialized)
+    const __m128i from_end = _mm_set1_epi8('>');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i colon = _mm_set1_epi8(':');
+
+    for (size_t i = 0; i < 64; i += 16)
     {
-        return;
+        const __m128i characters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        from_ends |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(characters, from_end)))) << i;
+        commas |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(characters, comma)))) << i;
+        colons |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(characters, colon)))) << i;
     }
+#elif defined(APRS_ROUTER_SIMD_NEON)
+    // NEON has no movemask, every compared byte is masked with its bit in the half of the vector, and the halves are summed
 
-    try_parse_address_with_ssid(state.router_address_string, state.router_address);
+    (void)text_size;
 
-    // Parse explicit addresses, ex: CALLA,CALLB,CALLC
-    // Use try_parse_address_with_ssid to parse the address as we expect it to be in the format ADDRESS[-SSID]
+    static constexpr uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
 
-    state.router_explicit_addresses_size = 0;
-    size_t explicit_index = 0;
-    for (auto it = router_explicit_addresses_begin; it != router_explicit_addresses_end; it++, explicit_index++)
+    const uint8x16_t bit_vector = vld1q_u8(bits);
+
+    for (size_t i = 0; i < 64; i += 16)
     {
-        address explicit_address;
-        if (try_parse_address_with_ssid(std::string_view(*it), explicit_address))
-        {
-            explicit_address.index = explicit_index;
-            if (state.router_explicit_addresses_size < state.router_explicit_addresses.size())
-            {
-                state.router_explicit_addresses[state.router_explicit_addresses_size++] = explicit_address;
-            }
-        }
-    }
+        const uint8x16_t characters = vld1q_u8(reinterpret_cast<const uint8_t*>(text + i));
 
-    // Parse n-N addresses, ex: WIDE1-1,WIDE2-2,WIDE3
-    // Use try_parse_n_N_address to parse the address as we expect it to be in the format ADDRESSn[-N]
+        auto movemask = [&](char c)
+        {
+            const uint8x16_t equal = vandq_u8(vceqq_u8(characters, vdupq_n_u8(static_cast<uint8_t>(c))), bit_vector);
+            return (static_cast<uint64_t>(vaddv_u8(vget_low_u8(equal))) | (static_cast<uint64_t>(vaddv_u8(vget_high_u8(equal))) << 8)) << i;
+        };
 
-    state.router_n_N_addresses_size = 0;
-    size_t n_N_index = 0;
-    for (auto it = router_n_N_addresses_begin; it != router_n_N_addresses_end; it++, n_N_index++)
+        from_ends |= movemask('>');
+        commas |= movemask(',');
+        colons |= movemask(':');
+    }
+#else
+    for (size_t i = 0; i < (std::min)(text_size, size_t(64)); i++)
     {
-        address n_N_address;
-        if (try_parse_n_N_address(std::string_view(*it), n_N_address))
+        const uint64_t bit = uint64_t(1) << i;
+
+        switch (text[i])
         {
-            n_N_address.index = n_N_index;
-            if (state.router_n_N_addresses_size < state.router_n_N_addresses.size())
-            {
-                state.router_n_N_addresses[state.router_n_N_addresses_size++] = n_N_address;
-            }
+            case '>': from_ends |= bit; break;
+            case ',': commas |= bit; break;
+            case ':': colons |= bit; break;
+            default: break;
         }
     }
-
-    state.initialized = true;
+#endif
 }
 
-APRS_ROUTER_INLINE void init_addresses(route_state& state)
+APRS_ROUTER_INLINE bool try_decode_packet_line_from_separators(std::string_view buffer, size_t line_begin, size_t line_end, packet_table& table, size_t& packets_size, size_t& addresses_size)
 {
-    // Initialize addresses
-    //
-    // Addresses: N0CALL>APRS,CALLA,CALLB,WIDE1-1,WIDE2-2:data
-    //                        ~~~~~ ~~~~~ ~~~~~~~ ~~~~~~~
-    //
-    // n-N addresses: N0CALL>APRS,CALLA,CALLB,WIDE1-1,WIDE2-2:data
-    //                                        ~~~~~~~ ~~~~~~~
+    // Decode a line from the positions of its separators, and append its fields to the table
     //
-    // Explicit addresses: N0CALL>APRS,CALLA,CALLB,WIDE1-1,WIDE2-2:data
-    //                                 ~~~~~ ~~~~~
+    // N0CALL>APRS,CALL*,WIDE2-1:data\r\n
+    //       >    ,     ,       :
     //
-    // The router's address and path have already been parsed by init_router_addresses
+    // The separators are found in the first 64 characters of the line, see find_packet_separators.
+    // The header of the packet, up to the ':', must be in the first 64 characters.
     //
-    // Router address:            DIGI                               state.router_address_string   state.router_address
-    // Router n-N addresses:      WIDE1-1,WIDE2-2                                                  state.router_n_N_addresses
-    // Router explicit addresses: CALLA,CALLB                                                      state.router_explicit_addresses
-    // Packet:                    N0CALL>APRS,WIDE1,WIDE2-2:data                                   state.packet_from_address, state.packet_to_address, state.packet_path
-    // Packet addresses:          WIDE1,WIDE2-2                                                    state.packet_addresses
+    // Returns false if the line is not decoded, and must be decoded with try_decode_packet instead:
+    // the line is empty, has no header in the first 64 characters, or has too many path addresses.
 
-    const std::string_view packet_from_address = state.packet_from_address;
-    const std::string_view packet_to_address = state.packet_to_address;
-    const std::array<std::array<char, 10>, 8>& packet_path = state.packet_path;
-    const std::array<size_t, 8>& packet_path_address_sizes = state.packet_path_address_sizes;
-    const size_t packet_path_size = state.packet_path_size;
-    const struct address& router_address = state.router_address;
-    auto& router_explicit_addresses = state.router_explicit_addresses;
-    const size_t router_explicit_addresses_size = state.router_explicit_addresses_size;
-    auto& router_n_N_addresses = state.router_n_N_addresses;
-    const size_t router_n_N_addresses_size = state.router_n_N_addresses_size;
-    std::array<struct address, 8>& packet_addresses = state.packet_addresses;
-    size_t& packet_addresses_size = state.packet_addresses_size;
+    const char* text = buffer.data() + line_begin;
+    const size_t line_size = line_end - line_begin;
 
-    // Clear previous packet addresses by resetting the size to zero
-    packet_addresses_size = 0;
+    // The separators are found in 64 characters at once, the end of the buffer is copied and padded
 
-    size_t index = 0;
+    std::array<char, 64> padded_text;
 
-    // Parse the packet addresses
-    // Based on whether an address appears in the router's explicit or n-N addresses list
-    // decide whether we use try_parse_address_with_ssid or try_parse_n_N_address to parse the packed address
-    //
-    // Router address: DIGI
-    //                 ~~~~
-    // Router explicit addresses: CALLA,CALLB,CALLC
-    //                            ~~~~~ ~~~~~ ~~~~~
-    // Router n-N addresses: WIDE2,WIDE3
-    //                       ----- -----
-    // Packet: N0CALL>APRS,CALLA,CALLB*,WIDE2-1,WIDE3-2,DIGI,CALLC:data
-    //                     ~~~~~ ~~~~~  ------- ------- ~~~~ ~~~~~
-    // Addresses parsed with try_parse_address_with_ssid: CALLA,CALLB,DIGI,CALLC
-    //                                                    ~~~~~ ~~~~~ ~~~~ ~~~~~
-    // Addresses parsed with try_parse_n_N_address: WIDE2-1,WIDE3-2
-    //                                              ------- -------  
+    if (buffer.size() - line_begin < padded_text.size())
+    {
+        padded_text.fill('\0');
+        std::copy(text, buffer.data() + buffer.size(), padded_text.data());
+        text = padded_text.data();
+    }
 
-    index = 0;
+    uint64_t from_ends;
+    uint64_t commas;
+    uint64_t colons;
+
+    find_packet_separators(text, line_size, from_ends, commas, colons);
+
+    const uint64_t line_mask = (line_size >= 64) ? ~uint64_t(0) : ((uint64_t(1) << line_size) - 1);
 
-    for (size_t path_index = 0; path_index < packet_path_size && packet_addresses_size < 8; path_index++)
+    // The first '>' ends the from address, and the first ':' after it ends the path
+
+    from_ends &= line_mask;
+
+    if (from_ends == 0)
     {
-        const std::string_view packet_address_text { packet_path[path_index].data(), packet_path_address_sizes[path_index] };
-        bool matched_router_address = false;
+        return false;
+    }
 
-        struct address packet_explicit_address;
-        bool packet_explicit_address_result = false;
+    const size_t from_end = count_trailing_zeros(from_ends);
+    const uint64_t after_from_end = (from_end < 63) ? (~uint64_t(0) << (from_end + 1)) : 0;
 
-        if (router_explicit_addresses_size > 0)
-        {
-            packet_explicit_address_result = try_parse_address_with_ssid(packet_address_text, packet_explicit_address);
-        }
+    colons &= line_mask & after_from_end;
 
-        if (packet_explicit_address_result)
-        {
-            for (size_t router_explicit_index = 0; router_explicit_index < router_explicit_addresses_size; router_explicit_index++)
-            {
-                const auto& router_explicit_address = router_explicit_addresses[router_explicit_index];
+    if (colons == 0)
+    {
+        return false;
+    }
+
+    const size_t colon = count_trailing_zeros(colons);
+
+    commas &= after_from_end & ((uint64_t(1) << colon) - 1);
+
+    grow_packet_table(packets_size, addresses_size, table);
+
+    // The first ',' ends the to address, every next ',' and the ':' end a path address
+    // An empty address before the ':' is not part of the path, like with try_decode_packet
+    //
+    // N0CALL>APRS,CALL*,WIDE2-1:data
+    //            ~     ~       ~
+
+    const uint32_t offset = static_cast<uint32_t>(line_begin);
 
-                if ((packet_explicit_address.ssid == router_explicit_address.ssid && equal_address_text(packet_explicit_address, router_explicit_address)) ||
-                    (router_address.ssid == router_explicit_address.ssid && equal_address_text(router_address, router_explicit_address)))
-                {
-                    packet_explicit_address.index = index;
-                    array_push_back(packet_addresses, packet_addresses_size, packet_explicit_address);
-                    matched_router_address = true;
-                    break;
-                }
-            }
-        }
+    size_t to_end = colon;
+    size_t path_size = 0;
 
-        if (matched_router_address)
-        {
-            index++;
-            continue;
-        }
+    if (commas != 0)
+    {
+        to_end = count_trailing_zeros(commas);
 
-        struct address packet_n_N_address;
-        bool packet_n_N_address_result = false;
+        uint32_t* address_begins = table.address_begin.data() + addresses_size;
+        uint32_t* address_ends = table.address_end.data() + addresses_size;
+        uint8_t* addresses_used = table.address_used.data() + addresses_size;
 
-        if (router_n_N_addresses_size > 0)
-        {
-            packet_n_N_address_result = try_parse_n_N_address(packet_address_text, packet_n_N_address);
-        }
+        uint64_t separators = (commas & (commas - 1)) | (uint64_t(1) << colon);
+        size_t address_begin = to_end + 1;
 
-        if (packet_n_N_address_result)
+        while (separators != 0)
         {
-            for (size_t router_n_N_index = 0; router_n_N_index < router_n_N_addresses_size; router_n_N_index++)
-            {
-                const auto& router_n_N_address = router_n_N_addresses[router_n_N_index];
+            const size_t address_end = count_trailing_zeros(separators);
 
-                if (packet_n_N_address.n == router_n_N_address.n && equal_address_text(packet_n_N_address, router_n_N_address))
-                {
-                    packet_n_N_address.index = index;
-                    array_push_back(packet_addresses, packet_addresses_size, packet_n_N_address);
-                    matched_router_address = true;
-                    break;
-                }
+            separators &= separators - 1;
+
+            if (separators == 0 && address_end == address_begin)
+            {
+                break;
             }
-        }
 
-        if (matched_router_address)
-        {
-            index++;
-            continue;
-        }
+            if (path_size == path_addresses_max)
+            {
+                return false;
+            }
 
-        struct address packet_address;
+            address_begins[path_size] = offset + static_cast<uint32_t>(address_begin);
+            address_ends[path_size] = offset + static_cast<uint32_t>(address_end);
+            addresses_used[path_size] = (text[address_end - 1] == '*');
 
-        if (try_parse_address(packet_address_text, packet_address))
-        {
-            packet_address.index = index;
-            array_push_back(packet_addresses, packet_addresses_size, packet_address);
+            path_size++;
+            address_begin = address_end + 1;
         }
+    }
 
-        index++;
+    size_t data_end = line_size;
+
+    if (data_end > colon + 1 && buffer[line_begin + data_end - 1] == '\r')
+    {
+        data_end--;
     }
 
-    set_addresses_offset(packet_from_address, packet_to_address, packet_addresses, packet_addresses_size);
-}
+    table.from_begin[packets_size] = offset;
+    table.from_end[packets_size] = offset + static_cast<uint32_t>(from_end);
+    table.to_begin[packets_size] = offset + static_cast<uint32_t>(from_end + 1);
+    table.to_end[packets_size] = offset + static_cast<uint32_t>(to_end);
+    table.data_begin[packets_size] = offset + static_cast<uint32_t>(colon + 1);
+    table.data_end[packets_size] = offset + static_cast<uint32_t>(data_end);
+    table.path_begin[packets_size] = static_cast<uint32_t>(addresses_size);
+    table.path_size[packets_size] = static_cast<uint32_t>(path_size);
 
-APRS_ROUTER_INLINE void unset_all_used_addresses(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count)
-{
-    unset_all_used_addresses(packet_addresses, packet_addresses_size, offset, count, std::nullopt);
+    packets_size++;
+    addresses_size += path_size;
+
+    return true;
 }
 
-APRS_ROUTER_INLINE void unset_all_used_addresses(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t offset, size_t count, std::optional<size_t> maybe_ignore_index)
+APRS_ROUTER_INLINE bool try_decode_packet_line(std::string_view buffer, size_t line_begin, size_t line_end, packet_view& packet, packet_table& table, size_t& packets_size, size_t& addresses_size)
 {
-    // Unset all addresses marked as used inside a packet path
+    // Decode a line with try_decode_packet, and append its fields to the table
+    // The offsets are computed from the packet view fields, which reference the buffer
     //
-    // Packet: N0CALL>APRS,CALLA*,CALLB,CALLC*,CALLD,WIDE1-2:data
-    //                     ~~~~~~       ~~~~~~
-    // Will be updated to: N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,WIDE1-2:data
+    // N0CALL>APRS,CALL*,WIDE2-1:data\r\n
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // line, without the line ending
+    //
+    // Returns false if the line can not be decoded, an empty line is skipped.
 
-    assert(offset < packet_addresses_size);
-    assert(count <= packet_addresses_size);
+    std::string_view line = buffer.substr(line_begin, line_end - line_begin);
 
-    size_t ignore_index = maybe_ignore_index.value_or(packet_addresses_size); // intentionally outside bounds if not set
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
 
-    size_t address_offset = packet_addresses[offset].offset;
+    if (line.empty())
+    {
+        return true;
+    }
 
-    for (size_t i = offset, n = 0; i < packet_addresses_size && n < count; i++, n++)
+    if (!try_decode_packet(line, packet))
     {
-        if (packet_addresses[i].mark && i != ignore_index)
-        {
-            packet_addresses[i].mark = false;
-            packet_addresses[i].length--;
-        }
-        packet_addresses[i].offset = address_offset;
-        address_offset += packet_addresses[i].length + 1; // +1 for the comma address separator ','
+        return false;
     }
-}
 
-APRS_ROUTER_INLINE void set_address_as_used(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t index)
-{
-    // Mark an address at "index" as used: N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,WIDE1-2:data
-    //
-    // If index is "2" packet will be updated to: N0CALL>APRS,CALLA,CALLB,CALLC*,CALLD,WIDE1-2:data
-    //                                                                    ~~~~~~
+    auto offset = [&](const char* p) { return static_cast<uint32_t>(p - buffer.data()); };
 
-    assert(index < packet_addresses_size);
-    set_address_as_used(packet_addresses, packet_addresses_size, packet_addresses[index]);
-}
+    grow_packet_table(packets_size, addresses_size, table);
 
-APRS_ROUTER_INLINE void set_address_as_used(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, address& packet_address)
-{
-    unset_all_used_addresses(packet_addresses, packet_addresses_size, 0, packet_addresses_size);
+    table.from_begin[packets_size] = offset(packet.from.data());
+    table.from_end[packets_size] = offset(packet.from.data() + packet.from.size());
+    table.to_begin[packets_size] = offset(packet.to.data());
+    table.to_end[packets_size] = offset(packet.to.data() + packet.to.size());
+    table.data_begin[packets_size] = offset(packet.data.data());
+    table.data_end[packets_size] = offset(packet.data.data() + packet.data.size());
+    table.path_begin[packets_size] = static_cast<uint32_t>(addresses_size);
+    table.path_size[packets_size] = static_cast<uint32_t>(packet.path.size());
 
-    if (packet_address.mark)
+    for (std::string_view address : packet.path)
     {
-        return;
+        table.address_begin[addresses_size] = offset(address.data());
+        table.address_end[addresses_size] = offset(address.data() + address.size());
+        table.address_used[addresses_size] = (!address.empty() && address.back() == '*');
+        addresses_size++;
     }
 
-    packet_address.mark = true;
-    packet_address.length++;
+    packets_size++;
 
-    if (packet_addresses_size > 1)
-    {
-        for (size_t i = packet_address.index, address_offset = packet_address.offset; i < packet_addresses_size; i++)
-        {
-            packet_addresses[i].offset = address_offset;
-            address_offset += packet_addresses[i].length + 1; // +1 for the comma address separator ','
-        }
-    }
+    return true;
 }
 
-APRS_ROUTER_INLINE void update_addresses_index(std::array<address, 8>& addresses, size_t addresses_size)
+APRS_ROUTER_INLINE void grow_packet_table(size_t packets_size, size_t addresses_size, packet_table& table)
 {
-    for (size_t i = 0; i < addresses_size; i++)
+    // Make room for one more packet, with the most path addresses
+    // The arrays are grown for many packets at once, and written by index
+
+    if (packets_size == table.from_begin.size())
     {
-        addresses[i].index = i;
+        resize_packet_table((std::max)(packets_size * 2, size_t(64)), table);
     }
-}
-
-APRS_ROUTER_INLINE void set_addresses_offset(std::string_view packet_from_address, std::string_view packet_to_address, std::array<address, 8>& addresses, size_t addresses_size)
-{
-    // +1 to account for the path separator ',', +1 to account for '>' separator
-    //
-    // Example:
-    //
-    // N0CALL>APRS,WIDE2-1:data
-    //       ~    ~
-    //      +1   +1
-    // ~~~~~~~~~~~~ - offset
 
-    size_t offset = packet_from_address.size() + packet_to_address.size() + 2;
-    update_addresses_offset(addresses, addresses_size, offset);
+    if (addresses_size + path_addresses_max > table.address_begin.size())
+    {
+        resize_packet_table_addresses((std::max)(addresses_size * 2, size_t(64) + path_addresses_max), table);
+    }
 }
 
-APRS_ROUTER_INLINE void update_addresses_offset(std::array<address, 8>& addresses, size_t addresses_size, size_t initial_offset)
+APRS_ROUTER_INLINE void resize_packet_table(size_t size, packet_table& table)
 {
-    // Updates addresses offsets, useful after an address was inserted, replaced or removed
-    // This function does not update the length of addresses, and assumes they are up to date
-    // This function should not be used if an address is updated in a way that will change the length ex: marked as set
-    // because the length will be innacurate and the offsets will not be correctly calculated
-    //
-    // Before:
-    //
-    // N0CALL>APRS,AB,ABC,ABCD:data
-    // ~~~~~~~~~~~~
-    // 0         12 - initial_offset
-    //
-    // N0CALL>APRS,AB,ABC,ABCD:data
-    //             ~~ ~~~ ~~~~
-    //             12 15  19  - Offsets
-    //
-    // After:
-    //
-    // N0CALL>APRS,ABCDE,AB,ABC,ABCD:data
-    //             ~~~~~ ~~ ~~~ ~~~~
-    //             12    18 21  25  - Offsets
-    //               ^
-    //             Packet address inserted
-    //
-    // Offsets updated for addresses: "AB", "ABC", and "ABCD"
-    // due to the inserted address "ABCDE"
-
-    for (size_t i = 0, offset = initial_offset; i < addresses_size; i++)
-    {
-        address& address = addresses[i];
-        address.offset = offset;
-        offset += address.length + 1; // +1 for the comma address separator ','
-    }
+    table.from_begin.resize(size);
+    table.from_end.resize(size);
+    table.to_begin.resize(size);
+    table.to_end.resize(size);
+    table.data_begin.resize(size);
+    table.data_end.resize(size);
+    table.path_begin.resize(size);
+    table.path_size.resize(size);
 }
 
-APRS_ROUTER_INLINE void update_addresses_offset(std::array<address, 8>& addresses, size_t addresses_size)
+APRS_ROUTER_INLINE void resize_packet_table_addresses(size_t size, packet_table& table)
 {
-    assert(addresses_size > 0);
-    size_t initial_offset = addresses[0].offset;
-    update_addresses_offset(addresses, addresses_size, initial_offset);
+    table.address_begin.resize(size);
+    table.address_end.resize(size);
+    table.address_used.resize(size);
 }
 
-APRS_ROUTER_INLINE bool try_insert_address(std::array<address, 8>& packet_addresses, size_t& packet_addresses_size, size_t index, std::string_view inserted_address_string)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE uint64_t match_address_keys(uint64_t key, const std::array<uint64_t, Size>& keys, size_t keys_size)
 {
-    // Insert an address at "index" in the packet path
+    // Compare a key against the first 'keys_size' keys, and return a bitmask
+    // with bit i set if keys[i] is equal to the key.
     //
-    // Packet: N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE:data
-    //                                 ^
-    //                                 |
-    //                                 index = 2
-    // 
-    // inserted_address_string: "DIGI"
+    // Keys:   CALLA   CALLB   DIGI    CALLC
+    // Key:    DIGI
+    // Result: 0b0100
     //
-    // Updated packet: N0CALL>APRS,CALLA,CALLB,DIGI,CALLC,CALLD,CALLE:data
-    //                                         ~~~~
+    // Two keys are compared at a time with SSE2 or NEON if available,
+    // the remaining key if any is compared with a scalar compare.
 
-    assert(index <= packet_addresses_size);
-    assert(packet_addresses_size > 0);
+    static_assert(Size <= 64, "The match bitmask holds at most 64 keys");
 
-    if (packet_addresses_size >= 8)
-    {
-        return false;
-    }
+    assert(keys_size <= Size);
 
-    address new_address;
-    array_assign(new_address.text, new_address.text_size, inserted_address_string.begin(), inserted_address_string.end());
-    new_address.length = inserted_address_string.size();
+    uint64_t mask = 0;
+    size_t i = 0;
 
-    size_t initial_offset = packet_addresses[0].offset;
+#if defined(APRS_ROUTER_SIMD_SSE2)
+    // SSE2 has no 64 bit compare, compare the 32 bit halves and combine them
 
-    array_insert(packet_addresses, packet_addresses_size, index, new_address);
+    const __m128i key_vector = _mm_set1_epi64x(static_cast<long long>(key));
 
-    update_addresses_index(packet_addresses, packet_addresses_size);
-    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+    for (; i + 2 <= keys_size; i += 2)
+    {
+        __m128i keys_vector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys.data() + i));
+        __m128i equal_halves = _mm_cmpeq_epi32(keys_vector, key_vector);
+        __m128i equal = _mm_and_si128(equal_halves, _mm_shuffle_epi32(equal_halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        mask |= static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(equal))) << i;
+    }
+#elif defined(APRS_ROUTER_SIMD_NEON)
+    const uint64x2_t key_vector = vdupq_n_u64(key);
 
-    return true;
-}
+    for (; i + 2 <= keys_size; i += 2)
+    {
+        uint64x2_t equal = vceqq_u64(vld1q_u64(keys.data() + i), key_vector);
+        mask |= (vgetq_lane_u64(equal, 0) & 1) << i;
+        mask |= (vgetq_lane_u64(equal, 1) & 1) << (i + 1);
+    }
+#endif
 
-APRS_ROUTER_INLINE void replace_address_with_router_address(struct address& address, const struct address& router_address)
-{
-    // Replace an address with the router's address
-    //
-    // If the router's address is "DIGI", and the address is "WIDE2", the address will be updated to "DIGI"
-    //
-    // A packet "N0CALL>APRS,CALLA*,CALLB,CALLC,WIDE2:data"
-    //                                          ~~~~~
-    // 
-    // will be updated to "N0CALL>APRS,CALLA*,CALLB,CALLC,DIGI:data"
-    //                                                    ~~~~
+    for (; i < keys_size; i++)
+    {
+        mask |= static_cast<uint64_t>(keys[i] == key) << i;
+    }
 
-    address.text = router_address.text;
-    address.text_size = router_address.text_size;
-    address.length = router_address.length;
-    address.ssid = router_address.ssid;
-    address.n = 0;
-    address.N = 0;
+    return mask;
 }
 
-APRS_ROUTER_INLINE bool try_move_address_to_position(std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t from_index, size_t to_index)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE uint64_t find_matching_addresses(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_addresses, const std::array<uint64_t, Size>& router_address_keys, size_t router_addresses_size)
 {
-    // Shift and re-insert and address into the packet path, typically used for "preempt_front"
+    // Return a bitmask of the router addresses equal to 'address', ignoring the mark.
+    // Equivalent to calling equal_addresses_ignore_mark with every router address.
     //
-    // If the router's address is "CALLD", a packet "N0CALL>APRS,CALLA*,CALLB,CALLC,CALLD,CALLE:data"
-    //                                                                  ~~~~~~~~~~~~~~~~~
-    // will be updated to move the "CALLD" addresses in the front of the path and become
-    // "N0CALL>APRS,CALLA,CALLD*,CALLB,CALLC,CALLE:data"
-    //                    ~~~~~~
-    // The digipeated marker isn't done by this function
-
-    assert(from_index < packet_addresses_size);
-    assert(to_index < packet_addresses_size);
-    assert(from_index != to_index);
+    // The keys are compared all at once, addresses without a key (zero) are compared one by one.
+    // Usually all the addresses have keys, and the slow path is skipped.
 
-    if (from_index >= packet_addresses_size || to_index >= packet_addresses_size)
+    if (address_key == 0)
     {
-        return false;
+        uint64_t mask = 0;
+        for (size_t i = 0; i < router_addresses_size; i++)
+        {
+            mask |= static_cast<uint64_t>(equal_addresses_ignore_mark(address, router_addresses[i])) << i;
+        }
+        return mask;
     }
 
-    if (from_index == to_index)
+    uint64_t mask = match_address_keys(address_key, router_address_keys, router_addresses_size);
+
+    for (uint64_t unpacked = match_address_keys(0, router_address_keys, router_addresses_size); unpacked != 0; unpacked &= unpacked - 1)
     {
-        return false;
+        size_t i = count_trailing_zeros(unpacked);
+        mask |= static_cast<uint64_t>(equal_addresses_ignore_mark(address, router_addresses[i])) << i;
     }
 
-    struct address address = packet_addresses[from_index];
+    return mask;
+}
 
-    size_t initial_offset = packet_addresses[0].offset;
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE uint64_t find_matching_n_N_addresses(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_n_N_addresses, const std::array<uint64_t, Size>& router_n_N_address_keys, size_t router_n_N_addresses_size)
+{
+    // Return a bitmask of the router n-N addresses with the same text and n number as 'address',
+    // the N numbers are not compared:
+    //
+    // Router n-N addresses: WIDE1,WIDE2-2,TRACE2
+    // Address:              WIDE2-1
+    // Result:               0b010
+    //
+    // The keys are compared all at once, addresses without a key (zero) are compared one by one.
 
-    array_erase(packet_addresses, packet_addresses_size, from_index);
+    if (address_key == 0)
+    {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < router_n_N_addresses_size; i++)
+        {
+            const auto& p = router_n_N_addresses[i];
+            mask |= static_cast<uint64_t>(address.n == p.n && equal_address_text(address, p)) << i;
+        }
+        return mask;
+    }
 
-    assert(packet_addresses_size < 8);
+    uint64_t mask = match_address_keys(address_key, router_n_N_address_keys, router_n_N_addresses_size);
 
-    array_insert(packet_addresses, packet_addresses_size, to_index, address);
+    for (uint64_t unpacked = match_address_keys(0, router_n_N_address_keys, router_n_N_addresses_size); unpacked != 0; unpacked &= unpacked - 1)
+    {
+        size_t i = count_trailing_zeros(unpacked);
+        const auto& p = router_n_N_addresses[i];
+        mask |= static_cast<uint64_t>(address.n == p.n && equal_address_text(address, p)) << i;
+    }
 
-    update_addresses_index(packet_addresses, packet_addresses_size);
-    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+    return mask;
+}
 
-    return true;
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void clear_address_keys(std::array<uint64_t, Size>& keys)
+{
+    keys = {};
 }
 
-APRS_ROUTER_INLINE bool try_truncate_address_range(std::array<address, 8>& packet_addresses, size_t& packet_addresses_size, size_t start_index, size_t end_index)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void clear_address_keys(address_key_table<Size>& table)
 {
-    // Truncate a range of addresses, typically used for "preempt_truncate"
-    //
-    // If the router's address is "CALLD", a packet "N0CALL>APRS,CALLA*,CALLB,CALLC,CALLD,CALLE:data"
-    //                                                                  ~~~~~~~~~~~~~~~~~
-    //
-    // will be truncated of the "CALLB,CALLC,CALLD" addresses in the path and become:
-    //
-    // "N0CALL>APRS,CALLA,CALLD*,CALLE:data"
-    //                    ~~~~~~
-    //
-    // The digipeated marker and re-insertion of "CALLD" isn't done by this function
+    table.bucket_keys = {};
+    table.unpacked_size = 0;
+}
 
-    assert(start_index < packet_addresses_size);
-    assert(end_index < packet_addresses_size);
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void set_address_key(std::array<uint64_t, Size>& keys, size_t index, uint64_t key)
+{
+    assert(index < Size);
+    keys[index] = key;
+}
 
-    if (start_index >= packet_addresses_size || end_index >= packet_addresses_size ||
-        start_index >= end_index)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void set_address_key(address_key_table<Size>& table, size_t index, uint64_t key)
+{
+    // Add the key of the router address at 'index' to the table.
+    // Keys must be added in ascending index order, so that chained addresses stay ordered.
+
+    assert(index < Size);
+
+    table.next[index] = Size;
+
+    if (key == 0)
     {
-        return false;
+        table.unpacked[table.unpacked_size++] = index;
+        return;
     }
 
-    struct address address = packet_addresses[end_index];
+    constexpr size_t mask = address_key_table<Size>::buckets_size - 1;
 
-    size_t initial_offset = packet_addresses[0].offset;
+    // Linear probing, the table is never more than half full, an empty bucket is always found
 
-    // Calculate how many elements to remove (from start_index to end_index inclusive)
-    size_t remove_count = end_index - start_index + 1;
+    for (size_t bucket = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask; ; bucket = (bucket + 1) & mask)
+    {
+        if (table.bucket_keys[bucket] == 0)
+        {
+            table.bucket_keys[bucket] = key;
+            table.bucket_first[bucket] = index;
+            table.bucket_last[bucket] = index;
+            return;
+        }
 
-    array_erase_n(packet_addresses, packet_addresses_size, start_index, remove_count);
+        if (table.bucket_keys[bucket] == key)
+        {
+            assert(table.bucket_last[bucket] < index);
+            table.next[table.bucket_last[bucket]] = index;
+            table.bucket_last[bucket] = index;
+            return;
+        }
+    }
+}
 
-    assert(packet_addresses_size < 8);
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE size_t find_address_key(const address_key_table<Size>& table, uint64_t key)
+{
+    // Return the lowest router address index with the key, or Size if there is none.
+    // Follow table.next from the returned index to visit the other addresses with the same key.
 
-    array_insert(packet_addresses, packet_addresses_size, start_index, address);
+    assert(key != 0);
 
-    update_addresses_index(packet_addresses, packet_addresses_size);
-    update_addresses_offset(packet_addresses, packet_addresses_size, initial_offset);
+    constexpr size_t mask = address_key_table<Size>::buckets_size - 1;
 
-    return true;
+    for (size_t bucket = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask; table.bucket_keys[bucket] != 0; bucket = (bucket + 1) & mask)
+    {
+        if (table.bucket_keys[bucket] == key)
+        {
+            return table.bucket_first[bucket];
+        }
+    }
+
+    return Size;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_truncate_empty_addresses(route_state& state, bool enable_diagnostics, OutputIterator routing_actions_out)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE bool has_matching_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_addresses, const std::array<uint64_t, Size>& router_address_keys, size_t router_addresses_size)
 {
-    // Truncate all empty addresses in the packet path
-    //
-    // Packet: N0CALL>APRS,,CALLA*,CALLB,,CALLD,CALLE:data
-    //                     ~             ~
-    // Will be updated to: N0CALL>APRS,CALLA*,CALLB,CALLD,CALLE:data
-
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    size_t& packet_addresses_size = state.packet_addresses_size;
+    return find_matching_addresses(address, address_key, router_addresses, router_address_keys, router_addresses_size) != 0;
+}
 
-    auto begin = packet_addresses.begin();
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE bool has_matching_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_addresses, const address_key_table<Size>& router_address_keys, size_t router_addresses_size)
+{
+    // Check if any router address is equal to 'address', ignoring the mark.
+    // Equivalent to calling equal_addresses_ignore_mark with every router address.
 
-    for (size_t i = 0; i < packet_addresses_size; )
+    if (address_key == 0)
     {
-        if (packet_addresses[i].text_size == 0)
+        for (size_t i = 0; i < router_addresses_size; i++)
         {
-            routing_actions_out = push_address_removed_diagnostic(packet_addresses, packet_addresses_size, i, enable_diagnostics, routing_actions_out);
-            array_erase(packet_addresses, packet_addresses_size, i);
+            if (equal_addresses_ignore_mark(address, router_addresses[i]))
+            {
+                return true;
+            }
         }
-        else
+        return false;
+    }
+
+    if (find_address_key(router_address_keys, address_key) < router_addresses_size)
+    {
+        return true;
+    }
+
+    for (size_t u = 0; u < router_address_keys.unpacked_size; u++)
+    {
+        if (equal_addresses_ignore_mark(address, router_addresses[router_address_keys.unpacked[u]]))
         {
-            i++;
+            return true;
         }
     }
 
-    update_addresses_index(packet_addresses, packet_addresses_size);
-    update_addresses_offset(packet_addresses, packet_addresses_size);
-
-    return { routing_actions_out, true };
+    return false;
 }
 
-template <class OutputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE std::pair<OutputIterator, bool> try_substitute_complete_n_N_address(route_state& state, size_t packet_n_N_address_index, bool enable_diagnostics, OutputIterator routing_actions_out)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE size_t find_next_matching_n_N_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_n_N_addresses, const std::array<uint64_t, Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, size_t offset)
 {
-    // If the last n-N hop has been exhausted, replace the hop with the router's address
-    //
-    // Example:
-    //
-    // Input:  FROM>TO,WIDE1-1,WIDE2-1:data
-    // Output: FROM>TO,DIGI*,WIDE2-1:data - replace WIDE1 (after decrementing) with DIGI
-
-    std::array<address, 8>& packet_addresses = state.packet_addresses;
-    const size_t packet_addresses_size = state.packet_addresses_size;
-    const std::string_view router_address = state.router_address_string;
+    // Return the index of the first router n-N address at or after 'offset' with the same text and n number as 'address',
+    // or router_n_N_addresses_size if there is none.
 
-    assert(packet_n_N_address_index < packet_addresses_size);
+    if (offset >= router_n_N_addresses_size)
+    {
+        return router_n_N_addresses_size;
+    }
 
-    address& address = packet_addresses[packet_n_N_address_index];
+    uint64_t matches = find_matching_n_N_addresses(address, address_key, router_n_N_addresses, router_n_N_address_keys, router_n_N_addresses_size) >> offset;
 
-    if (address.N == 0)
+    if (matches == 0)
     {
-        routing_actions_out = push_address_replaced_diagnostic(packet_addresses, packet_addresses_size, address.index, router_address, enable_diagnostics, routing_actions_out);
-        array_assign(address.text, address.text_size, router_address.begin(), router_address.end());
-        address.length = router_address.size();
-        address.N = 0;
-        address.n = 0;
-        address.kind = address_kind::other;
-
-        routing_actions_out = push_address_unset_diagnostic(packet_addresses, packet_addresses_size, address.index, enable_diagnostics, routing_actions_out);
-        set_address_as_used(packet_addresses, packet_addresses_size, address);
-        routing_actions_out = push_address_set_diagnostic(packet_addresses, packet_addresses_size, address.index, enable_diagnostics, routing_actions_out);
-        return { routing_actions_out, true };
+        return router_n_N_addresses_size;
     }
 
-    return { routing_actions_out, false };
+    return offset + count_trailing_zeros(matches);
 }
 
-APRS_ROUTER_INLINE bool try_decrement_n_N_address(address& n_N_address)
+template <size_t Size>
+APRS_ROUTER_INLINE_NO_DISABLE size_t find_next_matching_n_N_address(const address& address, uint64_t address_key, const std::array<struct address, Size>& router_n_N_addresses, const address_key_table<Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, size_t offset)
 {
-    // Decrements an n-N address
+    // Return the index of the first router n-N address at or after 'offset' with the same text and n number as 'address',
+    // or router_n_N_addresses_size if there is none.
     //
-    // Example: WIDE2-2 becomes WIDE2-1
-    //              ~~~             ~~~
-
-    assert(n_N_address.N > 0);
+    // The addresses with the same key are chained in ascending order,
+    // the first chained address at or after 'offset' is the candidate,
+    // unless an address without a key, in front of the candidate, also matches.
 
-    if (n_N_address.N > 0)
+    if (address_key == 0)
     {
-        n_N_address.N--;
-        if (n_N_address.N == 0)
+        for (size_t i = offset; i < router_n_N_addresses_size; i++)
         {
-            n_N_address.length -= 2; // as '-N' is absent
+            const auto& p = router_n_N_addresses[i];
+            if (address.n == p.n && equal_address_text(address, p))
+            {
+                return i;
+            }
         }
-        return true;
+        return router_n_N_addresses_size;
     }
 
-    return false;
-}
+    size_t result = router_n_N_addresses_size;
 
-APRS_ROUTER_INLINE bool try_decrement_n_N_address(route_state& state, struct address& address)
-{
-    // Decrements an n-N address, while updating the offsets of the addresses
+    for (size_t i = find_address_key(router_n_N_address_keys, address_key); i < router_n_N_addresses_size; i = router_n_N_address_keys.next[i])
+    {
+        if (i >= offset)
+        {
+            result = i;
+            break;
+        }
+    }
 
-    bool result = try_decrement_n_N_address(address);
-    if (result)
+    for (size_t u = 0; u < router_n_N_address_keys.unpacked_size && router_n_N_address_keys.unpacked[u] < result; u++)
     {
-        update_addresses_offset(state.packet_addresses, state.packet_addresses_size);
+        size_t i = router_n_N_address_keys.unpacked[u];
+        const auto& p = router_n_N_addresses[i];
+        if (i >= offset && address.n == p.n && equal_address_text(address, p))
+        {
+            return i;
+        }
     }
+
     return result;
 }
 
-// **************************************************************** //
-//                                                                  //
-//                                                                  //
-// ADDRESS SEARCH                                                   //
-//                                                                  //
-//                                                                  //
-// **************************************************************** //
-
 template <size_t Size>
-APRS_ROUTER_INLINE_NO_DISABLE std::optional<std::pair<size_t, size_t>> find_first_unused_n_N_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, size_t router_n_N_addresses_size, routing_option options)
+APRS_ROUTER_INLINE_NO_DISABLE std::optional<std::pair<size_t, size_t>> find_first_unused_n_N_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, const address_keys<Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, routing_option options)
 {
     // Find the first unused n-N address inside the packet
     // using the router's matching addresses
@@ -4213,20 +8101,26 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<std::pair<size_t, size_t>> find_firs
     for (size_t i = 0; i < packet_addresses_size; i++)
     {
         const auto& address = packet_addresses[i];
-        size_t j = 0;
-        for (size_t router_n_N_index = 0; router_n_N_index < router_n_N_addresses_size; router_n_N_index++)
+
+        if (address.N == 0)
+        {
+            continue;
+        }
+
+        uint64_t address_key = get_n_N_address_key(address);
+
+        // Visit the matching router addresses in order, lowest index first
+
+        for (size_t j = find_next_matching_n_N_address(address, address_key, router_n_N_addresses, router_n_N_address_keys, router_n_N_addresses_size, 0);
+             j < router_n_N_addresses_size;
+             j = find_next_matching_n_N_address(address, address_key, router_n_N_addresses, router_n_N_address_keys, router_n_N_addresses_size, j + 1))
         {
-            const auto& p = router_n_N_addresses[router_n_N_index];
-            if (address.n == p.n && address.N > 0 && equal_address_text(address, p))
+            const auto& p = router_n_N_addresses[j];
+            if (reject_limit_exceeding_n_N_address && p.N > 0 && address.N > p.N)
             {
-                if (reject_limit_exceeding_n_N_address && p.N > 0 && address.N > p.N)
-                {
-                    j++;
-                    continue;
-                }
-                return std::make_pair(i, j);
+                continue;
             }
-            j++;
+            return std::make_pair(i, j);
         }
     }
 
@@ -4234,7 +8128,7 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<std::pair<size_t, size_t>> find_firs
 }
 
 template <size_t Size>
-APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_last_used_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, size_t router_n_N_addresses_size, routing_option options)
+APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_last_used_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, const std::array<address, Size>& router_n_N_addresses, const address_keys<Size>& router_n_N_address_keys, size_t router_n_N_addresses_size, routing_option options)
 {
     // Find the last address that has been marked as "used" in the packet path.
     // For example, if the packet is: FROM>TO,CALL*,TEST,ADDRESS*,WIDE1-2:data
@@ -4278,14 +8172,9 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_last_used_address_index
         {
             const auto& address = packet_addresses[i];
 
-            for (size_t router_n_N_index = 0; router_n_N_index < router_n_N_addresses_size; router_n_N_index++)
+            if (address.N == 0 && find_next_matching_n_N_address(address, get_n_N_address_key(address), router_n_N_addresses, router_n_N_address_keys, router_n_N_addresses_size, 0) < router_n_N_addresses_size)
             {
-                const auto& p = router_n_N_addresses[router_n_N_index];
-                if (address.n == p.n && address.N == 0 && equal_address_text(address, p))
-                {
-                    last_used_address_index = i;
-                    break;
-                }
+                last_used_address_index = i;
             }
         }
     }
@@ -4294,7 +8183,7 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_last_used_address_index
 }
 
 template <size_t Size>
-APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_router_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, size_t offset, const address& router_address, const std::array<address, Size>& router_explicit_addresses, size_t router_explicit_addresses_size)
+APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_router_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, size_t offset, const address& router_address, uint64_t router_address_key, const std::array<address, Size>& router_explicit_addresses, const address_keys<Size>& router_explicit_address_keys, size_t router_explicit_addresses_size)
 {
     // Find an address in the packet, matching the router's address or an address in the router's path.
     //
@@ -4313,22 +8202,25 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_router_address_index(co
     //
     // Because we are comparing the addresses in the packet with the router's address and the router's path,
     // the packet addresses cannot be an n-N address (n > 0).
+    //
+    // The router's addresses are packed into keys once by init_router_addresses,
+    // the key of every packet address is computed once, and compared to all the router keys at once.
 
     assert(offset < packet_addresses_size);
 
     for (size_t i = offset; i < packet_addresses_size; i++)
     {
-        if (equal_addresses_ignore_mark(packet_addresses[i], router_address))
+        const address& packet_address = packet_addresses[i];
+        uint64_t packet_address_key = get_address_key(packet_address);
+
+        if (equal_addresses_ignore_mark(packet_address, packet_address_key, router_address, router_address_key))
         {
             return i;
         }
 
-        for (size_t j = 0; j < router_explicit_addresses_size; j++)
+        if (has_matching_address(packet_address, packet_address_key, router_explicit_addresses, router_explicit_address_keys, router_explicit_addresses_size))
         {
-            if (equal_addresses_ignore_mark(packet_addresses[i], router_explicit_addresses[j]))
-            {
-                return i;
-            }
+            return i;
         }
     }
 
@@ -4336,7 +8228,7 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_router_address_index(co
 }
 
 template <size_t Size>
-APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_unused_router_address_index(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address, const std::array<address, Size>& router_explicit_addresses, size_t router_explicit_addresses_size)
+APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_unused_router_address_index(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address, uint64_t router_address_key, const std::array<address, Size>& router_explicit_addresses, const address_keys<Size>& router_explicit_address_keys, size_t router_explicit_addresses_size)
 {
     // Find unused address mathing router's address or an address in the router's path.
     // Start the search from the last used address.
@@ -4359,7 +8251,9 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_unused_router_address_i
         packet_addresses_size,
         start_search_address_index,
         router_address,
+        router_address_key,
         router_explicit_addresses,
+        router_explicit_address_keys,
         router_explicit_addresses_size);
 
     if (!maybe_address_index)
@@ -4379,7 +8273,8 @@ APRS_ROUTER_INLINE_NO_DISABLE std::optional<size_t> find_unused_router_address_i
     return {};
 }
 
-APRS_ROUTER_INLINE void find_used_addresses(route_state& state)
+template <class Options>
+APRS_ROUTER_INLINE_NO_DISABLE void find_used_addresses(const router_config& config, route_scratch& state)
 {
     // Router addresses: DIGI,WIDE1
     //
@@ -4392,18 +8287,19 @@ APRS_ROUTER_INLINE void find_used_addresses(route_state& state)
     // Unused address: N0CALL>APRS,CALL*,DIGI,WIDE1,ROUTE,WIDE2-2:data
     //                                   ~~~~
 
-    state.maybe_last_used_address_index = find_last_used_address_index(state.packet_addresses, state.packet_addresses_size, state.router_n_N_addresses, state.router_n_N_addresses_size, state.options);
-    state.maybe_router_address_index = find_unused_router_address_index(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, state.router_address, state.router_explicit_addresses, state.router_explicit_addresses_size);
+    state.maybe_last_used_address_index = find_last_used_address_index(state.packet_addresses, state.packet_addresses_size, config.router_n_N_addresses, config.router_n_N_address_keys, config.router_n_N_addresses_size, get_routing_options(Options{}, config));
+    state.maybe_router_address_index = find_unused_router_address_index(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, config.router_address, config.router_address_key, config.router_explicit_addresses, config.router_explicit_address_keys, config.router_explicit_addresses_size);
     state.unused_address_index = state.maybe_last_used_address_index.value_or(-1) + 1;
 
     if (state.maybe_router_address_index)
     {
         // Compare the two addresses to determine if the packet is being routed by the router's address
-        state.is_path_based_routing = !equal_addresses_ignore_mark(state.packet_addresses[state.maybe_router_address_index.value()], state.router_address);
+        const address& router_address = state.packet_addresses[state.maybe_router_address_index.value()];
+        state.is_path_based_routing = !equal_addresses_ignore_mark(router_address, get_address_key(router_address), config.router_address, config.router_address_key);
     }
 }
 
-APRS_ROUTER_INLINE bool has_address(const std::array<address, 8>& addresses, size_t addresses_size, size_t offset, struct address address)
+APRS_ROUTER_INLINE bool has_address(const std::array<address, path_addresses_max>& addresses, size_t addresses_size, size_t offset, struct address address)
 {
     // Check if the address is present in the list of 'addresses'
     // starting from the 'offset'
@@ -4419,6 +8315,95 @@ APRS_ROUTER_INLINE bool has_address(const std::array<address, 8>& addresses, siz
     return false;
 }
 
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// PACKET FORMAT                                                    //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+APRS_ROUTER_INLINE void format_routed_path(const route_scratch& state, std::array<std::array<char, routed_address_text_max>, path_addresses_max>& path, std::array<std::string_view, path_addresses_max>& path_views, size_t& path_size)
+{
+    // Formats the routed path addresses from the route_state
+    // Removed addresses are empty, and are skipped
+
+    path_size = 0;
+
+    for (size_t i = 0; i < state.packet_addresses_size; i++)
+    {
+        const auto& address = state.packet_addresses[i];
+        if (address.text_size != 0)
+        {
+            size_t address_size = 0;
+            to_string(address, path[path_size], address_size);
+            path_views[path_size] = std::string_view(path[path_size].data(), address_size);
+            path_size++;
+        }
+    }
+}
+
+template <class InputIterator, class Data>
+APRS_ROUTER_INLINE_NO_DISABLE size_t get_packet_string_size(std::string_view from, std::string_view to, InputIterator path_begin, InputIterator path_end, const Data& data)
+{
+    // Computes the exact size of a packet string: N0CALL>APRS,CALLA,CALLB*:data
+    //                                             ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //
+    // The size of the 'from', 'to', 'path' and 'data', plus the '>' and ':' separators,
+    // and a ',' separator in front of every path address
+
+    size_t size = from.size() + 1 + to.size() + 1 + std::size(data);
+
+    for (auto it = path_begin; it != path_end; ++it)
+    {
+        size += 1 + std::string_view(*it).size();
+    }
+
+    return size;
+}
+
+template <class InputIterator, class Data, class OutputIterator>
+APRS_ROUTER_INLINE_NO_DISABLE OutputIterator format_packet(std::string_view from, std::string_view to, InputIterator path_begin, InputIterator path_end, const Data& data, OutputIterator out)
+{
+    // Formats a packet string in one pass: N0CALL>APRS,CALLA,CALLB*:data
+    //
+    // Does not guarantee formatting a correct packet string
+    // if the input packet is invalid ex: missing path
+
+    out = std::copy(from.begin(), from.end(), out);
+    *out++ = '>';
+    out = std::copy(to.begin(), to.end(), out);
+
+    for (auto it = path_begin; it != path_end; ++it)
+    {
+        std::string_view address = *it;
+        *out++ = ',';
+        out = std::copy(address.begin(), address.end(), out);
+    }
+
+    *out++ = ':';
+    out = std::copy(std::begin(data), std::end(data), out);
+
+    return out;
+}
+
+template <class InputIterator, class Data>
+APRS_ROUTER_INLINE_NO_DISABLE size_t format_packet(std::string_view from, std::string_view to, InputIterator path_begin, InputIterator path_end, const Data& data, char* out, size_t capacity)
+{
+    // Formats a packet string into a buffer, only if the buffer is large enough
+    //
+    // Returns the size of the packet string, which is also the required capacity
+
+    size_t size = get_packet_string_size(from, to, path_begin, path_end, data);
+
+    if (size <= capacity && out != nullptr)
+    {
+        format_packet(from, to, path_begin, path_end, data, out);
+    }
+
+    return size;
+}
+
 // **************************************************************** //
 //                                                                  //
 //                                                                  //
@@ -4427,7 +8412,138 @@ APRS_ROUTER_INLINE bool has_address(const std::array<address, 8>& addresses, siz
 //                                                                  //
 // **************************************************************** //
 
-APRS_ROUTER_INLINE bool is_packet_valid(std::string_view packet_from_address, std::string_view packet_to_address, const std::array<std::array<char, 10>, 8>& packet_path, size_t packet_path_size, const std::array<size_t, 8>& packet_path_address_sizes, size_t original_packet_path_size, routing_option options)
+APRS_ROUTER_INLINE void find_address_characters(const std::array<char, 16>& text, uint32_t& alphanumerics, uint32_t& digits, uint32_t& separators)
+{
+    // Classify the characters of an address, one bit per character
+    //
+    // Text:          N0CALL-15
+    // Alphanumerics: 111111011
+    // Digits:        010000011
+    // Separators:    000000100
+    //
+    // The 16 characters are classified at once with SSE2 or NEON if available.
+
+#if defined(APRS_ROUTER_SIMD_SSE2)
+    // The compares are signed, characters above 127 are negative and are neither digits nor uppercase
+
+    const __m128i characters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data()));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(characters, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(characters, _mm_set1_epi8('9' + 1)));
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(characters, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(characters, _mm_set1_epi8('Z' + 1)));
+
+    digits = static_cast<uint32_t>(_mm_movemask_epi8(digit));
+    alphanumerics = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(digit, upper)));
+    separators = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(characters, _mm_set1_epi8('-'))));
+#elif defined(APRS_ROUTER_SIMD_NEON)
+    // NEON has no movemask, every compared byte is masked with its bit in the half of the vector, and the halves are summed
+
+    static constexpr uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+
+    const uint8x16_t bit_vector = vld1q_u8(bits);
+    const uint8x16_t characters = vld1q_u8(reinterpret_cast<const uint8_t*>(text.data()));
+
+    auto movemask = [&](uint8x16_t compared)
+    {
+        const uint8x16_t masked = vandq_u8(compared, bit_vector);
+        return static_cast<uint32_t>(vaddv_u8(vget_low_u8(masked))) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(masked))) << 8);
+    };
+
+    const uint8x16_t digit = vandq_u8(vcgeq_u8(characters, vdupq_n_u8('0')), vcleq_u8(characters, vdupq_n_u8('9')));
+    const uint8x16_t upper = vandq_u8(vcgeq_u8(characters, vdupq_n_u8('A')), vcleq_u8(characters, vdupq_n_u8('Z')));
+
+    digits = movemask(digit);
+    alphanumerics = movemask(vorrq_u8(digit, upper));
+    separators = movemask(vceqq_u8(characters, vdupq_n_u8('-')));
+#else
+    alphanumerics = 0;
+    digits = 0;
+    separators = 0;
+
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        const uint32_t bit = uint32_t(1) << i;
+        const char c = text[i];
+
+        if (is_digit(c))
+        {
+            digits |= bit;
+            alphanumerics |= bit;
+        }
+        else if (is_upper(c))
+        {
+            alphanumerics |= bit;
+        }
+        else if (c == '-')
+        {
+            separators |= bit;
+        }
+    }
+#endif
+}
+
+APRS_ROUTER_INLINE bool is_address_valid(std::string_view address)
+{
+    // Validate an address like: ADDRESS[-SSID][*]
+    //
+    // Equivalent to try_parse_address_with_used_flag, without parsing the address.
+    // The characters are classified all at once, and the rules are checked on the bitmasks:
+    //
+    // N0CALL-15
+    // ~~~~~~ ~~
+    // ^      ssid digits, the first digit is not 0, and two digits are at most 15
+    // |
+    // address text, alphanumeric and at most 6 characters
+
+    if (!address.empty() && address.back() == '*')
+    {
+        address.remove_suffix(1);
+    }
+
+    if (address.empty() || address.size() > 9)
+    {
+        return false;
+    }
+
+    std::array<char, 16> text = {};
+    std::memcpy(text.data(), address.data(), address.size());
+
+    uint32_t alphanumerics;
+    uint32_t digits;
+    uint32_t separators;
+
+    find_address_characters(text, alphanumerics, digits, separators);
+
+    const uint32_t address_mask = (uint32_t(1) << address.size()) - 1;
+
+    separators &= address_mask;
+
+    if (separators == 0)
+    {
+        return address.size() <= 6 && (alphanumerics & address_mask) == address_mask;
+    }
+
+    // Only the first separator separates the ssid, any other separator fails the digit check
+
+    const size_t separator_position = count_trailing_zeros(separators);
+    const size_t ssid_size = address.size() - separator_position - 1;
+    const uint32_t text_mask = (uint32_t(1) << separator_position) - 1;
+    const uint32_t ssid_mask = ((uint32_t(1) << ssid_size) - 1) << (separator_position + 1);
+
+    if (separator_position > 6 || (alphanumerics & text_mask) != text_mask)
+    {
+        return false;
+    }
+
+    if (ssid_size == 0 || ssid_size > 2 || (digits & ssid_mask) != ssid_mask || address[separator_position + 1] == '0')
+    {
+        return false;
+    }
+
+    // Two digit ssids are in the [10, 15] range
+
+    return ssid_size == 1 || (address[separator_position + 1] == '1' && address[separator_position + 2] <= '5');
+}
+
+APRS_ROUTER_INLINE bool is_packet_valid(std::string_view packet_from_address, std::string_view packet_to_address, const std::array<std::array<char, address_text_max>, path_addresses_max>& packet_path, size_t packet_path_size, const std::array<size_t, path_addresses_max>& packet_path_address_sizes, size_t original_packet_path_size, routing_option options)
 {
     // Performs various checks on the packet.
     //
@@ -4435,7 +8551,7 @@ APRS_ROUTER_INLINE bool is_packet_valid(std::string_view packet_from_address, st
     //
     //   - the 'from' address is not empty
     //   - the 'to' address is not empty
-    //   - the 'path' is not empty and has less than 8 addresses
+    //   - the 'path' is not empty and has at most 8 addresses, see APRS_ROUTER_MAX_PATH_ADDRESSES
     //   - each address ('from', 'to', 'path') is valid if:
     //     - the address is alphanumeric
     //     - the address is uppercase
@@ -4452,7 +8568,7 @@ APRS_ROUTER_INLINE bool is_packet_valid(std::string_view packet_from_address, st
         return false;
     }
 
-    if (original_packet_path_size == 0 || original_packet_path_size > 8)
+    if (original_packet_path_size == 0 || original_packet_path_size > path_addresses_max)
     {
         return false;
     }
@@ -4462,20 +8578,14 @@ APRS_ROUTER_INLINE bool is_packet_valid(std::string_view packet_from_address, st
         return true;
     }
 
-    std::array<char, 10> callsign = {};
-    size_t callsign_size = 0;
-    int ssid;
-
-    if (!try_parse_address_with_used_flag(packet_from_address, callsign, callsign_size, ssid) ||
-        !try_parse_address_with_used_flag(packet_to_address, callsign, callsign_size, ssid))
+    if (!is_address_valid(packet_from_address) || !is_address_valid(packet_to_address))
     {
         return false;
     }
 
     for (size_t i = 0; i < packet_path_size; i++)
     {
-        const auto& p = packet_path[i];
-        if (!try_parse_address_with_used_flag({p.data(), packet_path_address_sizes[i]}, callsign, callsign_size, ssid))
+        if (!is_address_valid({ packet_path[i].data(), packet_path_address_sizes[i] }))
         {
             return false;
         }
@@ -4484,14 +8594,16 @@ APRS_ROUTER_INLINE bool is_packet_valid(std::string_view packet_from_address, st
     return true;
 }
 
-APRS_ROUTER_INLINE bool is_packet_valid(const route_state& state)
+template <class Options>
+APRS_ROUTER_INLINE_NO_DISABLE bool is_packet_valid(const router_config& config, const route_scratch& state)
 {
-    return is_packet_valid(state.packet_from_address, state.packet_to_address, state.packet_path, state.packet_path_size, state.packet_path_address_sizes, state.original_packet_path_size, state.options);
+    return is_packet_valid(state.packet_from_address, state.packet_to_address, state.packet_path, state.packet_path_size, state.packet_path_address_sizes, state.original_packet_path_size, get_routing_options(Options{}, config));
 }
 
-APRS_ROUTER_INLINE bool is_valid_router_address_and_packet(const route_state& state)
+template <class Options>
+APRS_ROUTER_INLINE_NO_DISABLE bool is_valid_router_address_and_packet(const router_config& config, const route_scratch& state)
 {
-    return state.router_address_string.empty() || !is_packet_valid(state);
+    return config.router_address_string.empty() || !is_packet_valid<Options>(config, state);
 }
 
 APRS_ROUTER_INLINE bool is_packet_from_us(std::string_view packet_from_address, std::string_view router_address)
@@ -4503,13 +8615,13 @@ APRS_ROUTER_INLINE bool is_packet_from_us(std::string_view packet_from_address,
     return packet_from_address == router_address;
 }
 
-APRS_ROUTER_INLINE bool is_packet_from_us(const route_state& state)
+APRS_ROUTER_INLINE bool is_packet_from_us(const router_config& config, const route_scratch& state)
 {
     // Router address: DIGI
     //
     // Packet has ben sent by us: DIGI>APRS,CALL,WIDE1-1,WIDE2-2:data
     //                            ~~~~
-    return is_packet_from_us(state.packet_from_address, state.router_address_string);
+    return is_packet_from_us(state.packet_from_address, config.router_address_string);
 }
 
 APRS_ROUTER_INLINE bool is_packet_sent_to_us(std::string_view packet_to_address, std::string_view router_address)
@@ -4521,16 +8633,16 @@ APRS_ROUTER_INLINE bool is_packet_sent_to_us(std::string_view packet_to_address,
     return packet_to_address == router_address;
 }
 
-APRS_ROUTER_INLINE bool is_packet_sent_to_us(const route_state& state)
+APRS_ROUTER_INLINE bool is_packet_sent_to_us(const router_config& config, const route_scratch& state)
 {
     // Router address: DIGI
     //
     // Packet: N0CALL>DIGI,CALL,WIDE1-1,WIDE2-2:data
     //                ~~~~
-    return is_packet_sent_to_us(state.packet_to_address, state.router_address_string);
+    return is_packet_sent_to_us(state.packet_to_address, config.router_address_string);
 }
 
-APRS_ROUTER_INLINE bool has_packet_routing_ended(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index)
+APRS_ROUTER_INLINE bool has_packet_routing_ended(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index)
 {
     // Packet routing ended: N0CALL>APRS,A,B,C,D,E,F,G,CALL*:data
     //                                                 ~~~~~
@@ -4551,14 +8663,14 @@ APRS_ROUTER_INLINE bool has_packet_routing_ended(const std::array<address, 8>& p
     return false;
 }
 
-APRS_ROUTER_INLINE bool has_packet_routing_ended(const route_state& state)
+APRS_ROUTER_INLINE bool has_packet_routing_ended(const route_scratch& state)
 {
     // Packet has finished routing: N0CALL>APRS,CALL,WIDE1,DIGI*:data
     //                                                     ~~~~~
     return has_packet_routing_ended(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index);
 }
 
-APRS_ROUTER_INLINE bool has_packet_been_routed_by_us(const std::array<address, 8>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address)
+APRS_ROUTER_INLINE bool has_packet_been_routed_by_us(const std::array<address, path_addresses_max>& packet_addresses, size_t packet_addresses_size, std::optional<size_t> maybe_last_used_address_index, const address& router_address)
 {
     // Packet was routed by us: N0CALL>APRS,A,B,C,D,DIGI*,F,G,CALL:data
     //                                              ~~~~~
@@ -4585,11 +8697,11 @@ APRS_ROUTER_INLINE bool has_packet_been_routed_by_us(const std::array<address, 8
             last_used_address.mark);
 }
 
-APRS_ROUTER_INLINE bool has_packet_been_routed_by_us(route_state& state)
+APRS_ROUTER_INLINE bool has_packet_been_routed_by_us(const router_config& config, route_scratch& state)
 {
     // Packet has already been routing by us: N0CALL>APRS,CALL,DIGI*,WIDE1-1,WIDE2-2:data
     //                                                         ~~~~~
-    return has_packet_been_routed_by_us(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, state.router_address);
+    return has_packet_been_routed_by_us(state.packet_addresses, state.packet_addresses_size, state.maybe_last_used_address_index, config.router_address);
 }
 
 template<typename T, size_t Size>
@@ -4659,13 +8771,16 @@ APRS_ROUTER_INLINE_NO_DISABLE void array_push_back(std::array<std::array<char, E
 }
 
 template<size_t Size, class InputIterator>
-APRS_ROUTER_INLINE_NO_DISABLE void array_assign(std::array<char, Size>& array, size_t& size, InputIterator first, InputIterator last)
+APRS_ROUTER_INLINE_NO_DISABLE constexpr void array_assign(std::array<char, Size>& array, size_t& size, InputIterator first, InputIterator last)
 {
     size = static_cast<size_t>(std::distance(first, last));
 
     assert(size <= Size);
 
-    std::copy(first, last, array.begin());
+    for (size_t i = 0; first != last; ++first, ++i)
+    {
+        array[i] = *first;
+    }
 }
 
 #endif // APRS_ROUTER_PUBLIC_FORWARD_DECLARATIONS_ONLY
@@ -63,11 +63,17 @@ void digipeater::initialize(digipeater_settings settings)
 {
     settings_ = settings;
 
+    aprs::router::router_settings router_settings;
+
     router_settings.address = settings.address;
     router_settings.n_N_addresses = settings.n_N_addresses;
     router_settings.explicit_addresses = settings.explicit_addresses;
     router_settings.options = settings.options;
     router_settings.enable_diagnostics = true;
+
+    // Compile the router settings once, and reuse them for every routed packet
+
+    aprs::router::init_router(router_settings, router_);
 }
 
 void digipeater::add_event_handler(digipeater_events& handler)
@@ -96,13 +102,13 @@ void digipeater::route_packet(const aprs::router::packet& p)
     on_start_router(p);
 
     aprs::router::routing_result result;
-    aprs::router::try_route_packet(p, router_settings, result);
+    aprs::router::try_route_packet(p, router_, result);
 
     on_end_router(result);
 
-    packet_entry entry = create_packet_entry(p, result);
+    // The routing result is moved into the queue, without copying the packets and diagnostics
 
-    queue_packet(entry);
+    packet_entry& entry = queue_packet(create_packet_entry(p, std::move(result)));
 
     log(log_type::message, log_verbosity::verbose, "digipeater::route_packet", "Packet added to queue", p, false, entry);
 
@@ -233,6 +239,9 @@ std::vector<aprs::router::routing_result> digipeater::routed_packets(bool remove
     // If remove_routed_packets is true, the routed packets are marked as removed from the queue.
     // We don't remove them from the queue, because we need to keep track of the packets that have been routed,
     // for deduplication purposes.
+    //
+    // The routed packet and the routing actions of removed packets are moved out of the queue,
+    // the original packet is kept in the entry for deduplication and logging.
 
     std::vector<aprs::router::routing_result> routed_packets;
 
@@ -246,12 +255,22 @@ std::vector<aprs::router::routing_result> digipeater::routed_packets(bool remove
                 continue;
             }
 
-            routed_packets.push_back(entry.routing_result);
-
             if (remove_routed_packets)
             {
+                aprs::router::routing_result result;
+                result.routed = entry.routing_result.routed;
+                result.success = entry.routing_result.success;
+                result.original_packet = entry.routing_result.original_packet;
+                result.routed_packet = std::move(entry.routing_result.routed_packet);
+                result.state = entry.routing_result.state;
+                result.actions = std::move(entry.routing_result.actions);
+                routed_packets.push_back(std::move(result));
                 entry.removed = true;
             }
+            else
+            {
+                routed_packets.push_back(entry.routing_result);
+            }
         }
     }
 
@@ -448,14 +467,16 @@ bool digipeater::has_used_addresses(const std::vector<aprs::router::detail::addr
 //                                                                  //
 // **************************************************************** //
 
-packet_entry digipeater::create_packet_entry(const aprs::router::packet& p, const aprs::router::routing_result& result)
+packet_entry digipeater::create_packet_entry(const aprs::router::packet& p, aprs::router::routing_result result)
 {
+    // The entry takes ownership of the routing result, pass an rvalue to avoid copying it
+
     packet_entry entry;
 
     std::vector<aprs::router::detail::address> addresses = packet_addresses(p);
 
-    entry.routing_result = result;
     entry.successful = result.routed;
+    entry.routing_result = std::move(result);
     entry.has_used_addresses = this->has_used_addresses(addresses);
     entry.date_time = get_local_time();
     entry.hash = aprs::router::hash(p);
@@ -467,9 +488,9 @@ packet_entry digipeater::create_packet_entry(const aprs::router::packet& p, cons
     return entry;
 }
 
-packet_entry& digipeater::queue_packet(packet_entry& entry)
+packet_entry& digipeater::queue_packet(packet_entry entry)
 {
-    packet_queue.push_back(entry); // push_front
+    packet_queue.push_back(std::move(entry)); // push_front
     return packet_queue.back();
 }
 
@@ -530,7 +551,7 @@ void digipeater::reject_packet(packet_entry& entry, const std::string& message,
     entry.pending = false;
     entry.reject_reason = reason;
 
-    log(log_type::warning, log_verbosity::verbose, function_name, message, entry.routing_result.original_packet, false, entry, duplicate_packet);
+    log(log_type::warning, log_verbosity::verbose, function_name, message, entry.routing_result.original_packet, false, entry, std::move(duplicate_packet));
 
     on_rejected_packet(entry.routing_result.original_packet, is_duplicate, entry.elapsed_ms);
 }
@@ -571,7 +592,7 @@ bool digipeater::handle_duplicate_packet(packet_entry& entry)
         on_accept_duplicate_packet(entry.routing_result.original_packet, accept_duplicate_entry);
         if (!accept_duplicate_entry)
         {
-            reject_packet(entry, "Packet is a duplicate", true, digipeater_reject_reason::duplicate, duplicate_entry, "digipeater::handle_duplicate_packet");
+            reject_packet(entry, "Packet is a duplicate", true, digipeater_reject_reason::duplicate, std::move(duplicate_entry), "digipeater::handle_duplicate_packet");
             return true;
         }
     }
@@ -634,11 +655,11 @@ bool digipeater::handle_transcode_packet(packet_entry& entry)
         // We do this to block a packet like the transcoded packet from being routed again, due to the duplicate check.
 
         packet_entry transcoded_entry = create_packet_entry(transcoded_packet, entry.routing_result);
-        transcoded_entry.routing_result.original_packet = entry.routing_result.routed_packet;
+        transcoded_entry.routing_result.original_packet = std::move(transcoded_packet);
         transcoded_entry.accepted = true;
         transcoded_entry.pending = false;
 
-        packet_queue.push_back(transcoded_entry);
+        queue_packet(std::move(transcoded_entry));
 
         return true;
     }
@@ -862,11 +883,11 @@ void digipeater::log(log_type type, log_verbosity verbosity, const std::string&
     log_entry.diagnostics = diagnostics;
     if (entry)
     {
-        log_entry.entry = std::make_unique<packet_entry>(entry.value());
+        log_entry.entry = std::make_unique<packet_entry>(std::move(*entry));
     }
     if (duplicate_entry)
     {
-        log_entry.duplicate_entry = std::make_unique<packet_entry>(*duplicate_entry);
+        log_entry.duplicate_entry = std::make_unique<packet_entry>(std::move(*duplicate_entry));
     }
     log(log_entry);
 }
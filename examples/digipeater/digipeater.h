@@ -170,8 +170,8 @@ private:
     std::vector<aprs::router::detail::address> packet_addresses(const aprs::router::packet& p);
     bool validate_packet(const aprs::router::packet& p);
     bool has_used_addresses(const std::vector<aprs::router::detail::address>& addresses);
-    packet_entry create_packet_entry(const aprs::router::packet& p, const aprs::router::routing_result& result);
-    packet_entry& queue_packet(packet_entry& entry);
+    packet_entry create_packet_entry(const aprs::router::packet& p, aprs::router::routing_result result);
+    packet_entry& queue_packet(packet_entry entry);
     void remove_old_entries();
     bool try_find_duplicate(const packet_entry& entry, struct packet_entry& result);
     void reject_packet(packet_entry& entry, const std::string& message, bool is_duplicate, digipeater_reject_reason reason, std::optional<packet_entry> duplicate_packet, std::string function_name);
@@ -204,7 +204,7 @@ private:
 
     unsigned long long count_ = 0;
     std::vector<packet_entry> packet_queue;
-    aprs::router::router_settings router_settings;
+    aprs::router::router router_;
     digipeater_settings settings_;
     std::vector<std::reference_wrapper<logger_base>> loggers_;
     bool simulated_time_ = false;
@@ -79,8 +79,10 @@ void basic_stdout_logger::log(const log_entry& entry)
 
         if (entry.duplicate_entry)
         {
+            // The routed packet of a removed entry has been moved out by routed_packets
+            const packet_entry& duplicate_entry = *entry.duplicate_entry;
             fmt::print(fg(fmt::color::rosy_brown) | fmt::emphasis::italic, "{:>18}: ", "duplicate packet");
-            fmt::print(fg(fmt::color::gray) | fmt::emphasis::italic, "{}\n", to_string(entry.duplicate_entry->routing_result.routed_packet));
+            fmt::print(fg(fmt::color::gray) | fmt::emphasis::italic, "{}\n", to_string(duplicate_entry.removed ? duplicate_entry.routing_result.original_packet : duplicate_entry.routing_result.routed_packet));
         }
 
         if (entry.entry->reject_reason != digipeater_reject_reason::none)
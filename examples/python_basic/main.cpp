@@ -33,16 +33,23 @@ extern "C" __attribute__((visibility("default"))) bool try_route_packet(const ch
     routing_result result;
     try_route_packet(packet, settings, result);
 
-    std::string routed_packet_string = to_string(result.routed_packet);
+    // Format the routed packet straight into the caller's buffer
+    //
+    // The last byte is reserved for the null terminator, the buffer is not written if the packet does not fit
 
-    if (routed_packet_string.size() >= *buffer_size)
+    if (*buffer_size == 0)
     {
         return false;
     }
 
-    *buffer_size = routed_packet_string.size();
+    size_t routed_packet_size = format_packet_to(result, router_packet_string, *buffer_size - 1);
 
-    std::copy(routed_packet_string.begin(), routed_packet_string.end(), router_packet_string);
+    if (routed_packet_size >= *buffer_size)
+    {
+        return false;
+    }
+
+    *buffer_size = routed_packet_size;
 
     return result.routed;
 }
@@ -77,6 +77,29 @@ void test_diagnostics_reconstruct_packet_by_start_end(const route_test& test, co
     }
 }
 
+void test_diagnostics_replay_routing_actions(const route_test& test, const routing_result& result)
+{
+    if (result.state != routing_state::routed)
+    {
+        return;
+    }
+
+    std::array<char, 512> buffer;
+    size_t size = 0;
+
+    EXPECT_TRUE(try_replay_routing_actions(result, buffer.data(), buffer.size(), size));
+
+    bool result_bool = std::string_view(buffer.data(), size) == to_string(result.routed_packet);
+
+    EXPECT_TRUE(result_bool);
+
+    if (!result_bool)
+    {
+        // handy breakpoint location
+        printf("test %s failed\n", test.id.c_str());
+    }
+}
+
 bool run_test(const route_test& test, const packet& p, const router_settings& settings)
 {
     bool routed_packet_result = false;
@@ -154,6 +177,124 @@ bool run_test(const route_test& test, const packet& p, const router_settings& se
 
     test_diagnostics_reconstruct_packet_by_index(test, result);
     test_diagnostics_reconstruct_packet_by_start_end(test, result);
+    test_diagnostics_replay_routing_actions(test, result);
+
+    // Route the packet again using a compiled router, the result should be identical
+
+    aprs::router::router router(settings);
+    routing_result router_result;
+
+    EXPECT_TRUE(try_route_packet(p, router, router_result) == result_bool);
+    EXPECT_TRUE(router_result.state == result.state);
+    EXPECT_TRUE(router_result.routed_packet == result.routed_packet);
+    EXPECT_TRUE(router_result.actions.size() == result.actions.size());
+    EXPECT_TRUE(aprs::router::to_string(router_result) == diag_string);
+
+    // Route the packet again with diagnostics disabled, packets can then be rejected early by the prefilter
+    // The routing state and the routed packet should be identical
+
+    router_settings no_diagnostics_settings = settings;
+    no_diagnostics_settings.enable_diagnostics = false;
+    routing_result no_diagnostics_result;
+
+    EXPECT_TRUE(try_route_packet(p, no_diagnostics_settings, no_diagnostics_result) == result_bool);
+    EXPECT_TRUE(no_diagnostics_result.state == result.state);
+    EXPECT_TRUE(no_diagnostics_result.routed_packet == result.routed_packet);
+
+    // Route the packet twice with a routing cache, the second time the routing decision comes from the cache
+    // The routing state and the routed packet should be identical
+
+    router_settings cache_settings = no_diagnostics_settings;
+    cache_settings.cache_size = 16;
+    aprs::router::router cache_router(cache_settings);
+
+    for (int i = 0; i < 2; i++)
+    {
+        routing_result cache_result;
+
+        EXPECT_TRUE(try_route_packet(p, cache_router, cache_result) == result_bool);
+        EXPECT_TRUE(cache_result.state == result.state);
+        EXPECT_TRUE(cache_result.routed_packet == result.routed_packet);
+    }
+
+    EXPECT_TRUE(cache_router.cache.hits == 1);
+
+    // Route the packet with a router set, alongside routers with other addresses
+    // The routing result of the test's router should be identical
+
+    for (const router_settings& set_settings : { settings, no_diagnostics_settings })
+    {
+        router_set set({ router_settings{ "OTHER", { "CALLX" }, { "WIDE3" } }, set_settings, router_settings{ "N0CALL-7", {}, { "WIDE1", "WIDE2" } } });
+        std::vector<routing_result> set_results;
+
+        try_route_packet(p, set, set_results);
+
+        EXPECT_TRUE(set_results.size() == 3);
+        EXPECT_TRUE(set_results[1].routed == result_bool);
+        EXPECT_TRUE(set_results[1].state == result.state);
+        EXPECT_TRUE(set_results[1].routed_packet == result.routed_packet);
+
+        if (set_settings.enable_diagnostics)
+        {
+            EXPECT_TRUE(aprs::router::to_string(set_results[1]) == diag_string);
+        }
+    }
+
+    // Route the packet again as a fixed capacity packet, if the packet fits
+    // The routing state and the routed packet should be identical
+
+    fixed_packet fixed_p;
+
+    if (try_decode_packet(to_string(p), fixed_p))
+    {
+        aprs::router::router fixed_router(no_diagnostics_settings);
+        fixed_routing_result fixed_result;
+
+        EXPECT_TRUE(try_route_packet(fixed_p, fixed_router, fixed_result) == result_bool);
+        EXPECT_TRUE(fixed_result.state == result.state);
+        EXPECT_TRUE(fixed_result.original_packet == fixed_p);
+        EXPECT_TRUE(to_string(fixed_result.routed_packet) == to_string(result.routed_packet));
+    }
+
+#if APRS_ROUTER_USE_PMR
+
+    // Route the packet again into a routing result allocated from a memory resource
+    // The upstream resource is the null memory resource, every allocation must come from the buffer
+    // The routing result should be identical
+
+    std::array<std::byte, 16384> pmr_buffer;
+    std::pmr::monotonic_buffer_resource pmr_resource(pmr_buffer.data(), pmr_buffer.size(), std::pmr::null_memory_resource());
+    routing_result pmr_result(&pmr_resource);
+
+    EXPECT_TRUE(try_route_packet(p, router, pmr_result) == result_bool);
+    EXPECT_TRUE(pmr_result.state == result.state);
+    EXPECT_TRUE(pmr_result.routed_packet == result.routed_packet);
+    EXPECT_TRUE(pmr_result.routed_packet.path.get_allocator().resource() == &pmr_resource);
+    EXPECT_TRUE(pmr_result.actions.get_allocator().resource() == &pmr_resource);
+    EXPECT_TRUE(aprs::router::to_string(pmr_result) == diag_string);
+
+#endif
+
+    // Route the packet again as a packet view into routed packet segments
+    // The header and the data segments should form the routed packet
+
+    std::string packet_string = to_string(p);
+    packet_view pv;
+
+    if (try_decode_packet(packet_string, pv))
+    {
+        aprs::router::router segments_router(no_diagnostics_settings);
+        routed_packet_segments segments;
+        enum routing_state segments_state;
+
+        EXPECT_TRUE(try_route_packet(pv, segments, segments_state, segments_router.state) == result_bool);
+        EXPECT_TRUE(segments_state == result.state);
+
+        if (result_bool)
+        {
+            EXPECT_TRUE(std::string(segments.header_view()) + std::string(segments.data) == to_string(result.routed_packet));
+        }
+    }
 
     return routed_packet_result;
 }
@@ -0,0 +1,205 @@
+// **************************************************************** //
+// libaprsroute - APRS header only routing library                  // 
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/libaprsroute                       //
+// Copyright (c) 2024 - 2025 Ion Todirel                            //
+// **************************************************************** //
+//
+// capacity_test.cpp
+//
+// MIT License
+//
+// Copyright (c) 2025 Ion Todirel
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <gtest/gtest.h>
+
+#include "../aprsroute.hpp"
+
+#include <string>
+#include <vector>
+
+// This test is compiled with several path and address capacities,
+// see APRS_ROUTER_MAX_PATH_ADDRESSES and APRS_ROUTER_MAX_ADDRESS_LENGTH
+
+using namespace aprs::router;
+
+constexpr size_t path_capacity = APRS_ROUTER_MAX_PATH_ADDRESSES;
+constexpr size_t address_capacity = APRS_ROUTER_MAX_ADDRESS_LENGTH;
+
+std::vector<std::string> make_path(size_t size)
+{
+    // WIDE2-2,CALL1,CALL2,CALL3...
+
+    std::vector<std::string> path = { "WIDE2-2" };
+
+    for (size_t i = 1; i < size; i++)
+    {
+        path.push_back("CALL" + std::to_string(i));
+    }
+
+    return path;
+}
+
+TEST(capacity, route_state_size)
+{
+    // The route_state buffers scale with the configured capacities
+
+    route_state state;
+
+    static_assert(std::tuple_size<decltype(state.packet_path)>::value == path_capacity);
+    static_assert(std::tuple_size<decltype(state.packet_path)::value_type>::value == address_capacity);
+    static_assert(std::tuple_size<decltype(state.packet_path_address_sizes)>::value == path_capacity);
+    static_assert(std::tuple_size<decltype(state.packet_addresses)>::value == path_capacity);
+    static_assert(packet_path_view::max_size == path_capacity);
+
+    EXPECT_TRUE(state.packet_path_size == 0);
+}
+
+TEST(capacity, route_packet_with_full_path)
+{
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE2" }, routing_option::none, false });
+    routing_result result;
+
+    // The path is full, the router's address cannot be inserted, the n-N address is only decremented
+
+    packet p = { "N0CALL", "APRS", make_path(path_capacity), "data" };
+
+    EXPECT_TRUE(try_route_packet(p, digi, result));
+
+    std::vector<std::string> expected_path = make_path(path_capacity);
+    expected_path[0] = "WIDE2-1";
+
+    EXPECT_TRUE(result.routed_packet.path == expected_path);
+
+    // One address less, the router's address is inserted in front of the n-N address
+
+    if (path_capacity > 1)
+    {
+        p.path = make_path(path_capacity - 1);
+
+        EXPECT_TRUE(try_route_packet(p, digi, result));
+
+        expected_path = make_path(path_capacity - 1);
+        expected_path[0] = "WIDE2-1";
+        expected_path.insert(expected_path.begin(), "DIGI*");
+
+        EXPECT_TRUE(result.routed_packet.path == expected_path);
+    }
+
+    // A path longer than the capacity is not routed
+
+    p.path = make_path(path_capacity + 1);
+
+    EXPECT_FALSE(try_route_packet(p, digi, result));
+    EXPECT_TRUE(result.routed_packet.path == p.path);
+}
+
+TEST(capacity, route_packet_with_long_address)
+{
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE2" }, routing_option::none, false });
+    routing_result result;
+
+    // An 11 character address, longer than any AX.25 address, only fits a larger address capacity
+
+    packet p = { "N0CALL", "APRS", { "WIDE2-2", "ABCDEFGHIJK" }, "data" };
+
+    EXPECT_TRUE(try_route_packet(p, digi, result) == (address_capacity >= 11 && path_capacity >= 2));
+
+    if (result.routed && path_capacity > 2)
+    {
+        EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE2-1,ABCDEFGHIJK:data");
+    }
+    else if (result.routed)
+    {
+        EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,WIDE2-1,ABCDEFGHIJK:data");
+    }
+}
+
+TEST(capacity, decode_packet_view)
+{
+    // A packet view holds at most path_capacity addresses
+
+    std::string packet_string = "N0CALL>APRS";
+
+    for (const auto& address : make_path(path_capacity))
+    {
+        packet_string += "," + address;
+    }
+
+    std::string data_string = packet_string + ":data";
+
+    packet_view p;
+
+    EXPECT_TRUE(try_decode_packet(data_string, p));
+    EXPECT_TRUE(p.path.size() == path_capacity);
+
+    std::string long_string = packet_string + ",CALLX:data";
+
+    EXPECT_FALSE(try_decode_packet(long_string, p));
+}
+
+TEST(capacity, route_packet_segments_with_long_addresses)
+{
+    // The header of the segments fits the 'from' and 'to' addresses, and a full path of the longest routed addresses
+
+    if (path_capacity < 3)
+    {
+        return;
+    }
+
+    aprs::router::router digi(router_settings{ "DIGIXX-15", {}, { "WIDE2" }, routing_option::none, false });
+
+    // N0CALL-15>APRSXX-15,CALLAA-15*,WIDE2-2,CALLAB-15,CALLAC-15...
+
+    std::string packet_string = "N0CALL-15>APRSXX-15,CALLAA-15*,WIDE2-2";
+
+    for (size_t i = 2; i < path_capacity - 1; i++)
+    {
+        packet_string += ",CALL" + std::string(1, static_cast<char>('A' + (i / 26) % 26)) + std::string(1, static_cast<char>('A' + i % 26)) + "-15";
+    }
+
+    packet_string += ":data";
+
+    packet_view pv;
+    EXPECT_TRUE(try_decode_packet(packet_string, pv));
+
+    routed_packet_segments segments;
+    enum routing_state routing_state;
+
+    EXPECT_TRUE(try_route_packet(pv, segments, routing_state, digi.state));
+    EXPECT_TRUE(routing_state == routing_state::routed);
+
+    routing_result result;
+    EXPECT_TRUE(try_route_packet(packet(packet_string), digi, result));
+    EXPECT_TRUE(result.routed_packet.path.size() == path_capacity);
+
+    std::string routed_packet_string = std::string(segments.header_view()) + std::string(segments.data);
+
+    EXPECT_TRUE(routed_packet_string == to_string(result.routed_packet));
+    EXPECT_TRUE(segments.header_size <= routed_packet_segments::header_max_size);
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -33,6 +33,8 @@
 #include <cstdlib>
 #include <new>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -238,6 +240,298 @@ TEST(no_heap, with_diagnostics_one_million_packets)
     }
 }
 
+TEST(no_heap, try_route_packets_one_million_packets)
+{
+    constexpr size_t batch_count = 15'625;
+    constexpr size_t batch_size = 64;
+
+    struct packet_view
+    {
+        std::string_view from;
+        std::string_view to;
+        std::array<std::string_view, 5> path;
+    };
+
+    const std::string_view router_address = "DIGI";
+
+    const std::array<std::string_view, 6> expected_routed_path{ "CALLA-10", "CALLB-5", "CALLC-15", "WIDE1", "DIGI", "WIDE2*" };
+    const std::array<std::string_view, 0> explicit_addresses{};
+    const std::array<std::string_view, 2> n_N_addresses{ "WIDE1-1", "WIDE2-1" };
+
+    std::array<packet_view, batch_size> packets;
+    packets.fill({ "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" } });
+
+    std::array<std::array<std::array<char, 10>, 8>, batch_size> routed_packet_paths{};
+    std::array<std::array<size_t, 8>, batch_size> routed_packet_paths_address_sizes{};
+    std::array<size_t, batch_size> routed_packet_path_sizes{};
+    std::array<aprs::router::routing_state, batch_size> routing_states{};
+
+    allocation_count = 0;
+    allocation_bytes = 0;
+    tracking_enabled = true;
+
+    aprs::router::route_state route_state;
+
+    aprs::router::init_router(router_address, explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), aprs::router::routing_option::none, route_state);
+
+    size_t routed_count = 0;
+
+    for (size_t iteration = 0; iteration < batch_count; ++iteration)
+    {
+        auto [paths_end, sizes_end, path_sizes_end, states_end, batch_routed_count] = aprs::router::try_route_packets(
+            packets.begin(), packets.end(),
+            routed_packet_paths.begin(),
+            routed_packet_paths_address_sizes.begin(),
+            routed_packet_path_sizes.begin(),
+            routing_states.begin(),
+            route_state);
+
+        (void)paths_end;
+        (void)sizes_end;
+        (void)path_sizes_end;
+        (void)states_end;
+
+        routed_count += batch_routed_count;
+    }
+
+    tracking_enabled = false;
+
+    EXPECT_EQ(allocation_count, 0u)
+        << "try_route_packets performed " << allocation_count
+        << " heap allocation(s) totaling " << allocation_bytes << " bytes across "
+        << batch_count * batch_size << " routed packets";
+
+    EXPECT_EQ(routed_count, batch_count * batch_size);
+
+    ASSERT_EQ(routed_packet_path_sizes[batch_size - 1], expected_routed_path.size());
+
+    for (size_t address_index = 0; address_index < expected_routed_path.size(); ++address_index)
+    {
+        EXPECT_EQ(std::string_view(routed_packet_paths[batch_size - 1][address_index].data(), routed_packet_paths_address_sizes[batch_size - 1][address_index]),
+                  expected_routed_path[address_index]);
+    }
+}
+
+TEST(no_heap, decode_route_and_format_packet_view_one_million_packets)
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const std::string_view packet_string = "N0CALL-10>CALL-5,CALLA-10*,CALLB-5*,CALLC-15*,WIDE1*,WIDE2-1:data";
+    const std::string_view router_address = "DIGI";
+
+    const std::array<std::string_view, 6> expected_routed_path{ "CALLA-10", "CALLB-5", "CALLC-15", "WIDE1", "DIGI", "WIDE2*" };
+    const std::array<std::string_view, 0> explicit_addresses{};
+    const std::array<std::string_view, 2> n_N_addresses{ "WIDE1-1", "WIDE2-1" };
+
+    std::array<std::array<char, 10>, 8> routed_packet_path{};
+    std::array<size_t, 8> routed_packet_path_address_sizes{};
+
+    allocation_count = 0;
+    allocation_bytes = 0;
+    tracking_enabled = true;
+
+    aprs::router::routing_state routing_state;
+    aprs::router::route_state route_state;
+    aprs::router::packet_view packet;
+    std::array<char, 256> routed_packet_string{};
+    size_t routed_packet_string_size = 0;
+
+    aprs::router::init_router(router_address, explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), aprs::router::routing_option::none, route_state);
+
+    size_t routed_count = 0;
+
+    for (size_t iteration = 0; iteration < packet_count; ++iteration)
+    {
+        if (!aprs::router::try_decode_packet(packet_string, packet))
+        {
+            continue;
+        }
+
+        auto [routed_packet_path_end, routed_packet_path_address_sizes_end, routing_succeeded] = aprs::router::try_route_packet(
+            packet,
+            routed_packet_path.begin(),
+            routed_packet_path_address_sizes.begin(),
+            routing_state, route_state);
+
+        (void)routed_packet_path_end;
+        (void)routed_packet_path_address_sizes_end;
+
+        if (routing_succeeded)
+        {
+            routed_count++;
+        }
+
+        routed_packet_string_size = aprs::router::format_packet_to(route_state, packet.data, routed_packet_string.data(), routed_packet_string.size());
+    }
+
+    tracking_enabled = false;
+
+    EXPECT_EQ(allocation_count, 0u)
+        << "try_decode_packet + try_route_packet + format_packet_to performed " << allocation_count
+        << " heap allocation(s) totaling " << allocation_bytes << " bytes across "
+        << packet_count << " routing calls";
+
+    EXPECT_EQ(routed_count, packet_count);
+
+    EXPECT_EQ(std::string_view(routed_packet_string.data(), routed_packet_string_size), "N0CALL-10>CALL-5,CALLA-10,CALLB-5,CALLC-15,WIDE1,DIGI,WIDE2*:data");
+
+    for (size_t address_index = 0; address_index < expected_routed_path.size(); ++address_index)
+    {
+        EXPECT_EQ(std::string_view(routed_packet_path[address_index].data(), routed_packet_path_address_sizes[address_index]),
+                  expected_routed_path[address_index]);
+    }
+}
+
+TEST(no_heap, route_packet_view_segments_one_million_packets)
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const std::string_view packet_string = "N0CALL-10>CALL-5,CALLA-10*,CALLB-5*,CALLC-15*,WIDE1*,WIDE2-1:data";
+    const std::string_view router_address = "DIGI";
+
+    const std::array<std::string_view, 0> explicit_addresses{};
+    const std::array<std::string_view, 2> n_N_addresses{ "WIDE1-1", "WIDE2-1" };
+
+    allocation_count = 0;
+    allocation_bytes = 0;
+    tracking_enabled = true;
+
+    aprs::router::routing_state routing_state;
+    aprs::router::route_state route_state;
+    aprs::router::packet_view packet;
+    aprs::router::routed_packet_segments segments;
+
+    aprs::router::init_router(router_address, explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), aprs::router::routing_option::none, route_state);
+
+    EXPECT_TRUE(aprs::router::try_decode_packet(packet_string, packet));
+
+    size_t routed_count = 0;
+
+    for (size_t iteration = 0; iteration < packet_count; ++iteration)
+    {
+        if (aprs::router::try_route_packet(packet, segments, routing_state, route_state))
+        {
+            routed_count++;
+        }
+    }
+
+    tracking_enabled = false;
+
+    EXPECT_EQ(allocation_count, 0u)
+        << "packet_view try_route_packet with segments performed " << allocation_count
+        << " heap allocation(s) totaling " << allocation_bytes << " bytes across "
+        << packet_count << " routing calls";
+
+    EXPECT_EQ(routed_count, packet_count);
+
+    EXPECT_EQ(segments.header_view(), "N0CALL-10>CALL-5,CALLA-10,CALLB-5,CALLC-15,WIDE1,DIGI,WIDE2*:");
+    EXPECT_EQ(segments.data.data(), packet_string.data() + packet_string.size() - 4);
+}
+
+TEST(no_heap, decode_and_route_fixed_packet_one_million_packets)
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const std::string_view packet_string = "N0CALL-10>CALL-5,CALLA-10*,CALLB-5*,CALLC-15*,WIDE1*,WIDE2-1:!4903.50N/07201.75W-Test 001/000, data longer than a small string";
+
+    // The router is compiled before tracking, routing with the high-level API should not allocate from the first packet
+
+    aprs::router::router router(aprs::router::router_settings{ "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, true });
+
+    allocation_count = 0;
+    allocation_bytes = 0;
+    tracking_enabled = true;
+
+    aprs::router::fixed_packet packet;
+    aprs::router::fixed_routing_result result;
+    std::array<char, 512> routed_packet_string{};
+    size_t routed_packet_string_size = 0;
+
+    size_t routed_count = 0;
+
+    for (size_t iteration = 0; iteration < packet_count; ++iteration)
+    {
+        if (!aprs::router::try_decode_packet(packet_string, packet))
+        {
+            continue;
+        }
+
+        if (aprs::router::try_route_packet(packet, router, result))
+        {
+            routed_count++;
+        }
+
+        routed_packet_string_size = aprs::router::format_packet_to(result.routed_packet, routed_packet_string.data(), routed_packet_string.size());
+    }
+
+    tracking_enabled = false;
+
+    EXPECT_EQ(allocation_count, 0u)
+        << "fixed_packet try_decode_packet + try_route_packet performed " << allocation_count
+        << " heap allocation(s) totaling " << allocation_bytes << " bytes across "
+        << packet_count << " routing calls";
+
+    EXPECT_EQ(routed_count, packet_count);
+
+    EXPECT_EQ(std::string_view(routed_packet_string.data(), routed_packet_string_size), "N0CALL-10>CALL-5,CALLA-10,CALLB-5,CALLC-15,WIDE1,DIGI,WIDE2*:!4903.50N/07201.75W-Test 001/000, data longer than a small string");
+}
+
+TEST(no_heap, move_packet_and_routing_result)
+{
+    static_assert(std::is_nothrow_move_constructible_v<aprs::router::packet>);
+    static_assert(std::is_nothrow_move_assignable_v<aprs::router::packet>);
+    static_assert(std::is_nothrow_move_constructible_v<aprs::router::routing_result>);
+    static_assert(std::is_nothrow_move_assignable_v<aprs::router::routing_result>);
+
+    // Data longer than a small string, so copies of the packet allocate
+
+    aprs::router::router router(aprs::router::router_settings{ "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, true });
+    aprs::router::packet packet = "N0CALL-10>CALL-5,CALLA-10*,CALLB-5*,CALLC-15*,WIDE1*,WIDE2-1:!4903.50N/07201.75W-Test 001/000, data longer than a small string";
+    aprs::router::routing_result result;
+
+    EXPECT_TRUE(aprs::router::try_route_packet(packet, router, result));
+
+    const std::string expected_routed_packet = to_string(result.routed_packet);
+
+    std::vector<aprs::router::routing_result> queue;
+    queue.reserve(4);
+
+    // Copying a routing result copies its packets and diagnostics
+
+    allocation_count = 0;
+    allocation_bytes = 0;
+    tracking_enabled = true;
+
+    queue.push_back(result);
+
+    tracking_enabled = false;
+
+    EXPECT_GT(allocation_count, 0u);
+
+    // Moving a routing result transfers them, ex: into a queue and back out
+
+    allocation_count = 0;
+    allocation_bytes = 0;
+    tracking_enabled = true;
+
+    queue.push_back(std::move(result));
+    aprs::router::routing_result routed = std::move(queue.back());
+    queue.pop_back();
+    aprs::router::packet routed_packet = std::move(routed.routed_packet);
+    aprs::router::packet original_packet;
+    original_packet = std::move(routed.original_packet);
+
+    tracking_enabled = false;
+
+    EXPECT_EQ(allocation_count, 0u)
+        << "moving a routing_result performed " << allocation_count
+        << " heap allocation(s) totaling " << allocation_bytes << " bytes";
+
+    EXPECT_EQ(to_string(routed_packet), expected_routed_packet);
+    EXPECT_TRUE(original_packet == packet);
+    EXPECT_FALSE(routed.actions.empty());
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
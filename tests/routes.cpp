@@ -211,12 +211,12 @@ void init_router_addresses(const packet& p, const std::vector<std::string>& path
     for (size_t i = 0; i < p.path.size() && state.packet_path_size < 8; i++)
     {
         const auto& path_address = p.path[i];
-        array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, path_address.data(), path_address.data() + std::min(path_address.size(), size_t(10)));
+        array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, path_address.data(), path_address.data() + std::min(path_address.size(), address_text_max));
     }
 
     state.router_address_string = settings.address;
     state.options = settings.options;
-    init_addresses(state);
+    init_addresses(state, state);
 
     settings.explicit_addresses = to_vector_of_string(state.router_explicit_addresses, state.router_explicit_addresses_size);
     settings.n_N_addresses = to_vector_of_string(state.router_n_N_addresses, state.router_n_N_addresses_size);
@@ -77,29 +77,29 @@ std::vector<std::string> split_comma_separated_values(const std::string& str);
 void debugger_break();
 
 template <class Allocator>
-inline std::vector<std::string> to_vector_of_string(const std::vector<address, Allocator>& addresses)
+inline public_vector_t<public_string_t> to_vector_of_string(const std::vector<address, Allocator>& addresses)
 {
-    std::vector<std::string> result;
+    public_vector_t<public_string_t> result;
     for (const auto& address : addresses)
     {
-        std::array<char, 15> address_string = {};
+        std::array<char, routed_address_text_max> address_string = {};
         size_t address_string_size = 0;
         to_string(address, address_string, address_string_size);
-        result.push_back(std::string(address_string.data(), address_string_size));
+        result.emplace_back(address_string.data(), address_string_size);
     }
     return result;
 }
 
 template <size_t N>
-inline std::vector<std::string> to_vector_of_string(const std::array<address, N>& addresses, size_t addresses_size)
+inline public_vector_t<public_string_t> to_vector_of_string(const std::array<address, N>& addresses, size_t addresses_size)
 {
-    std::vector<std::string> result;
+    public_vector_t<public_string_t> result;
     for (size_t i = 0; i < addresses_size; i++)
     {
-        std::array<char, 15> address_string = {};
+        std::array<char, routed_address_text_max> address_string = {};
         size_t address_string_size = 0;
         to_string(addresses[i], address_string, address_string_size);
-        result.push_back(std::string(address_string.data(), address_string_size));
+        result.emplace_back(address_string.data(), address_string_size);
     }
     return result;
 }
@@ -29,16 +29,22 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <new>
+#include <random>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 bool tracking_enabled = false;
 size_t allocation_count = 0;
@@ -250,8 +256,841 @@ static void run_throughput_test()
               << "| " << std::setw(27) << memory_text.str() << "|" << std::endl;
 }
 
+static void run_router_throughput_test()
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const aprs::router::packet packet = { "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" }, "data" };
+    const aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, false };
+
+    aprs::router::router router(settings);
+    aprs::router::routing_result result;
+
+    std::cout << std::endl;
+    std::cout << "--- Begin packet routing loop ---" << std::endl;
+
+    // Compare routing with a compiled router against routing with router_settings,
+    // which parses the router settings for every packet
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet(packet, router, result);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(result);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet(packet, settings, result);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(result);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End packet routing loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double router_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double settings_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << std::endl;
+    std::cout << "router:          " << format_throughput(static_cast<double>(packet_count) / (router_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(router_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "router_settings: " << format_throughput(static_cast<double>(packet_count) / (settings_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(settings_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+static void run_batch_throughput_test()
+{
+    constexpr size_t packet_set_size = 65'536;
+    constexpr size_t batch_size = 64;
+    constexpr size_t batch_count = 156'250;
+    constexpr size_t packet_count = batch_count * batch_size;
+    constexpr size_t address_text_max = aprs::router::detail::address_text_max;
+    constexpr size_t path_addresses_max = aprs::router::detail::path_addresses_max;
+
+    struct packet_view
+    {
+        std::string_view from;
+        std::string_view to;
+        std::array<std::string_view, 5> path;
+    };
+
+    const std::string_view router_address = "DIGI";
+    const std::array<std::string_view, 0> explicit_addresses{};
+    const std::array<std::string_view, 2> n_N_addresses{ "WIDE1-1", "WIDE2-1" };
+
+    // A mix of packets heard by a digipeater, most of which are not routed by us
+
+    const std::array<std::array<std::string_view, 7>, 4> packet_kinds = { {
+        { "N0CALL-10", "CALL-5", "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" },
+        { "N0CALL-10", "CALL-5", "K7ABC-3*", "TCPIP*", "qAR", "W7XYZ", "CALLD" },
+        { "N0CALL-10", "CALL-5", "CALLA-10*", "CALLB-5*", "CALLC-15*", "RELAY*", "CALLD" },
+        { "N0CALL-10", "CALL-5", "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2*" },
+    } };
+
+    // The address text of every packet is stored apart from the packet, and the packets
+    // are shuffled, so that the address text is not in the cache when a packet is routed,
+    // as with packets decoded from many receive buffers
+
+    std::mt19937 random(1);
+
+    std::vector<std::string> address_texts;
+    address_texts.reserve(packet_set_size * 7);
+
+    std::vector<size_t> packet_order(packet_set_size);
+    for (size_t i = 0; i < packet_set_size; ++i)
+    {
+        packet_order[i] = i;
+    }
+    std::shuffle(packet_order.begin(), packet_order.end(), random);
+
+    std::vector<packet_view> packets(packet_set_size);
+    for (size_t i = 0; i < packet_set_size; ++i)
+    {
+        const auto& kind = packet_kinds[random() % packet_kinds.size()];
+        for (std::string_view address : kind)
+        {
+            address_texts.emplace_back(address);
+        }
+        packet_view& packet = packets[packet_order[i]];
+        packet.from = address_texts[i * 7];
+        packet.to = address_texts[i * 7 + 1];
+        for (size_t j = 0; j < packet.path.size(); ++j)
+        {
+            packet.path[j] = address_texts[i * 7 + 2 + j];
+        }
+    }
+
+    std::array<std::array<std::array<char, address_text_max>, path_addresses_max>, batch_size> routed_packet_paths{};
+    std::array<std::array<size_t, path_addresses_max>, batch_size> routed_packet_paths_address_sizes{};
+    std::array<size_t, batch_size> routed_packet_path_sizes{};
+    std::array<aprs::router::routing_state, batch_size> routing_states{};
+
+    aprs::router::route_state route_state;
+
+    aprs::router::init_router(router_address, explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), aprs::router::routing_option::none, route_state);
+
+    std::cout << std::endl;
+    std::cout << "--- Begin batch routing loop ---" << std::endl;
+
+    // Route the same batches with try_route_packets, and one packet at a time
+    // with try_route_packet, using the same router and output arrays
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+        auto batch_begin = packets.begin() + static_cast<std::ptrdiff_t>((i * batch_size) % packet_set_size);
+
+        auto [paths_end, sizes_end, path_sizes_end, states_end, routed_count] = aprs::router::try_route_packets(
+            batch_begin, batch_begin + batch_size,
+            routed_packet_paths.begin(),
+            routed_packet_paths_address_sizes.begin(),
+            routed_packet_path_sizes.begin(),
+            routing_states.begin(),
+            route_state);
+
+        do_not_optimize(paths_end);
+        do_not_optimize(sizes_end);
+        do_not_optimize(path_sizes_end);
+        do_not_optimize(states_end);
+        do_not_optimize(routed_count);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+        const size_t batch_begin = (i * batch_size) % packet_set_size;
+        size_t routed_count = 0;
+
+        for (size_t j = 0; j < batch_size; ++j)
+        {
+            const packet_view& packet = packets[batch_begin + j];
+
+            auto [routed_path_end, routed_sizes_end, routed] = aprs::router::try_route_packet(
+                packet.from, packet.to,
+                packet.path.begin(), packet.path.end(),
+                routed_packet_paths[j].begin(), routed_packet_paths_address_sizes[j].begin(),
+                routing_states[j], route_state);
+
+            do_not_optimize(routed_sizes_end);
+
+            routed_packet_path_sizes[j] = routed ? static_cast<size_t>(std::distance(routed_packet_paths[j].begin(), routed_path_end)) : 0;
+            routed_count += routed ? 1 : 0;
+        }
+
+        do_not_optimize(routed_count);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    do_not_optimize(routed_packet_paths);
+    do_not_optimize(routed_packet_paths_address_sizes);
+    do_not_optimize(routed_packet_path_sizes);
+    do_not_optimize(routing_states);
+
+    std::cout << "--- End batch routing loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double batch_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double single_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << " (" << batch_count << " batches of " << batch_size << ")" << std::endl;
+    std::cout << "Batch:           " << format_throughput(static_cast<double>(packet_count) / (batch_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(batch_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "Per packet:      " << format_throughput(static_cast<double>(packet_count) / (single_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(single_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+template <aprs::router::routing_option options>
+static void run_static_options_throughput_test(std::string_view options_name)
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const aprs::router::packet packet = { "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" }, "data" };
+    const aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, options, false };
+
+    aprs::router::router router(settings);
+    aprs::router::routing_result result;
+
+    std::cout << std::endl;
+    std::cout << "--- Begin static options routing loop ---" << std::endl;
+
+    // Compare routing with the options read from the router for every check,
+    // against routing with the options fixed at compile time
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet(packet, router, result);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(result);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet<options>(packet, router, result);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(result);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End static options routing loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double runtime_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double static_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Options:         " << options_name << std::endl;
+    std::cout << "Iterations:      " << packet_count << std::endl;
+    std::cout << "Runtime options: " << format_throughput(static_cast<double>(packet_count) / (runtime_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(runtime_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "Static options:  " << format_throughput(static_cast<double>(packet_count) / (static_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(static_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+static void run_canonical_path_throughput_test()
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const aprs::router::packet packet = { "N0CALL-10", "CALL-5", { "CALLA-10*", "WIDE2-2" }, "data" };
+    const aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, false };
+
+    aprs::router::router router(settings);
+    aprs::router::route_state& state = router.state;
+    aprs::router::routing_state routing_state;
+    std::array<char, 512> buffer;
+
+    // Route the same canonical n-N packet with the fast path, and without the fast path through the general path
+    // Both routes start from the same initialized route_scratch, and format the routed packet from it
+
+    using aprs::router::detail::discard_output_iterator;
+    using aprs::router::detail::runtime_routing_options;
+
+    auto route_canonical = [&]() -> size_t
+    {
+        aprs::router::detail::try_init_packet_path(packet.from, packet.to, packet.path.begin(), packet.path.end(), state);
+        bool routed = std::get<3>(aprs::router::detail::try_route_packet_path_with_options<runtime_routing_options>(false, discard_output_iterator{}, discard_output_iterator{}, discard_output_iterator{}, routing_state, state, state, nullptr));
+        return routed ? aprs::router::format_packet_to(state, packet.data, buffer.data(), buffer.size()) : 0;
+    };
+
+    auto route_general = [&]() -> size_t
+    {
+        aprs::router::detail::try_init_packet_path(packet.from, packet.to, packet.path.begin(), packet.path.end(), state);
+        bool routed = std::get<3>(aprs::router::detail::try_route_general_packet_path_with_options<runtime_routing_options>(false, discard_output_iterator{}, discard_output_iterator{}, discard_output_iterator{}, routing_state, state, state, nullptr));
+        return routed ? aprs::router::format_packet_to(state, packet.data, buffer.data(), buffer.size()) : 0;
+    };
+
+    const std::string canonical_packet_string(buffer.data(), route_canonical());
+    const std::string general_packet_string(buffer.data(), route_general());
+
+    if (canonical_packet_string.empty() || canonical_packet_string != general_packet_string)
+    {
+        std::cout << "Canonical path mismatch: " << canonical_packet_string << " " << general_packet_string << std::endl;
+        return;
+    }
+
+    std::cout << std::endl;
+    std::cout << "--- Begin canonical path routing loop ---" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        size_t size = route_canonical();
+        do_not_optimize(size);
+        do_not_optimize(buffer);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        size_t size = route_general();
+        do_not_optimize(size);
+        do_not_optimize(buffer);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End canonical path routing loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double canonical_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double general_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << std::endl;
+    std::cout << "Routed packet:   " << canonical_packet_string << std::endl;
+    std::cout << "Fast path:       " << format_throughput(static_cast<double>(packet_count) / (canonical_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(canonical_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "General path:    " << format_throughput(static_cast<double>(packet_count) / (general_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(general_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+static void run_routing_cache_throughput_test()
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const std::array<aprs::router::packet, 4> packets = {{
+        { "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" }, "data" },
+        { "N0CALL-11", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL-12", "APRS", { "CALLA*", "WIDE2-1" }, "data" },
+        { "N0CALL-13", "APRS", { "TCPIP*", "qAC", "T2TEST" }, "data" },
+    }};
+
+    aprs::router::router router(aprs::router::router_settings{ "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, false });
+    aprs::router::router cache_router(aprs::router::router_settings{ "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, false, 64 });
+    aprs::router::routing_result result;
+
+    std::cout << std::endl;
+    std::cout << "--- Begin routing cache loop ---" << std::endl;
+
+    // Compare routing a small set of repeated packet headers without a cache,
+    // against routing them with a routing cache, where every packet after the first few is a cache hit
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet(packets[i % packets.size()], router, result);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(result);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet(packets[i % packets.size()], cache_router, result);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(result);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End routing cache loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double uncached_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double cached_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << std::endl;
+    std::cout << "Cache hits:      " << cache_router.cache.hits << ", misses: " << cache_router.cache.misses << std::endl;
+    std::cout << "No cache:        " << format_throughput(static_cast<double>(packet_count) / (uncached_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(uncached_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "Routing cache:   " << format_throughput(static_cast<double>(packet_count) / (cached_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(cached_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+static void run_shared_router_throughput_test()
+{
+    constexpr size_t packet_count = 1'000'000;
+
+    const std::array<aprs::router::packet, 4> packets = {{
+        { "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" }, "data" },
+        { "N0CALL-11", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL-12", "APRS", { "CALLA*", "WIDE2-1" }, "data" },
+        { "N0CALL-13", "APRS", { "TCPIP*", "qAC", "T2TEST" }, "data" },
+    }};
+
+    const aprs::router::router router(aprs::router::router_settings{ "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, false });
+
+    const size_t thread_count = std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency()));
+
+    // Route the same number of packets on one thread, and split between several threads sharing the router
+    // Every thread routes packets with its own route_scratch
+
+    auto route_packets = [&](size_t count)
+    {
+        aprs::router::route_scratch scratch;
+        aprs::router::routing_result result;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bool routing_succeeded = aprs::router::try_route_packet(packets[i % packets.size()], router, scratch, result);
+            do_not_optimize(routing_succeeded);
+            do_not_optimize(result);
+        }
+    };
+
+    std::cout << std::endl;
+    std::cout << "--- Begin shared router loop ---" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    route_packets(packet_count);
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back(route_packets, packet_count / thread_count);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End shared router loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double single_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double shared_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << std::endl;
+    std::cout << "Threads:         " << thread_count << std::endl;
+    std::cout << "Single thread:   " << format_throughput(static_cast<double>(packet_count) / (single_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(single_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "Shared router:   " << format_throughput(static_cast<double>(packet_count) / (shared_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(shared_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+static void run_router_set_throughput_test()
+{
+    constexpr size_t packet_count = 100'000;
+    constexpr size_t router_count = 32;
+
+    const std::array<aprs::router::packet, 4> packets = {{
+        { "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" }, "data" },
+        { "N0CALL-11", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL-12", "APRS", { "CALLA*", "WIDE2-1" }, "data" },
+        { "N0CALL-13", "APRS", { "TCPIP*", "qAC", "T2TEST" }, "data" },
+    }};
+
+    // Virtual digipeaters with distinct addresses, half of them also using the WIDE aliases
+
+    std::vector<aprs::router::router_settings> settings;
+    for (size_t i = 0; i < router_count; i++)
+    {
+        aprs::router::router_settings router_settings;
+        router_settings.address = std::string(1, static_cast<char>('A' + i % 26)) + std::string(1, static_cast<char>('A' + i / 26)) + "DIGI";
+        if (i % 2 == 0)
+        {
+            router_settings.n_N_addresses = { "WIDE1", "WIDE2" };
+        }
+        settings.push_back(router_settings);
+    }
+
+    std::vector<aprs::router::router> routers(settings.begin(), settings.end());
+    aprs::router::router_set set(settings);
+    aprs::router::routing_result result;
+    std::vector<aprs::router::routing_result> results;
+
+    std::cout << std::endl;
+    std::cout << "--- Begin router set loop ---" << std::endl;
+
+    // Compare routing every packet with each router separately,
+    // against routing every packet once with a router set
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        for (auto& router : routers)
+        {
+            bool routing_succeeded = aprs::router::try_route_packet(packets[i % packets.size()], router, result);
+            do_not_optimize(routing_succeeded);
+            do_not_optimize(result);
+        }
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < packet_count; ++i)
+    {
+        bool routing_succeeded = aprs::router::try_route_packet(packets[i % packets.size()], set, results);
+        do_not_optimize(routing_succeeded);
+        do_not_optimize(results);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End router set loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double separate_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double set_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << std::endl;
+    std::cout << "Routers:         " << router_count << std::endl;
+    std::cout << "Each router:     " << format_throughput(static_cast<double>(packet_count) / (separate_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(separate_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "Router set:      " << format_throughput(static_cast<double>(packet_count) / (set_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(set_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+static void run_packet_table_throughput_test()
+{
+    constexpr size_t line_count = 100'000;
+    constexpr size_t iteration_count = 50;
+
+    // An APRS-IS like feed of newline delimited packets, with separators in the packet data
+
+    const std::array<std::string_view, 4> lines = {
+        "N0CALL-10>APRS,CALLA-10*,CALLB-5*,WIDE1*,WIDE2-1,qAR,K7ABC-3:!4903.50N/07201.75W-Test, 001/000>\r\n",
+        "N0CALL-11>APRS,WIDE1-1,WIDE2-2:@092345z4903.50N/07201.75W_090/000g000t066r000p000P000h50b10270\n",
+        "N0CALL-12>APDR16,TCPIP*,qAC,T2TEST:=4903.50N/07201.75W$ comment: with, separators > here\n",
+        "N0CALL-13>APRS,CALLA*,WIDE2-1:>status text\n",
+    };
+
+    std::string buffer;
+    for (size_t i = 0; i < line_count; i++)
+    {
+        buffer += lines[i % lines.size()];
+    }
+
+    aprs::router::packet_table packets;
+    aprs::router::packet_view p;
+    std::vector<aprs::router::packet_view> views;
+
+    std::cout << std::endl;
+    std::cout << "--- Begin packet table loop ---" << std::endl;
+
+    // Compare decoding every line with try_decode_packet, without and with keeping the packet views,
+    // against decoding the whole buffer into a packet table, which keeps the fields as offsets
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        std::string_view remaining = buffer;
+        while (!remaining.empty())
+        {
+            size_t line_end = remaining.find('\n');
+            std::string_view line = remaining.substr(0, line_end);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            bool decode_succeeded = aprs::router::try_decode_packet(line, p);
+            do_not_optimize(decode_succeeded);
+            do_not_optimize(p);
+            remaining.remove_prefix(line_end == std::string_view::npos ? remaining.size() : line_end + 1);
+        }
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        views.clear();
+        std::string_view remaining = buffer;
+        while (!remaining.empty())
+        {
+            size_t line_end = remaining.find('\n');
+            std::string_view line = remaining.substr(0, line_end);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if (aprs::router::try_decode_packet(line, p))
+            {
+                views.push_back(p);
+            }
+            remaining.remove_prefix(line_end == std::string_view::npos ? remaining.size() : line_end + 1);
+        }
+        do_not_optimize(views);
+    }
+
+    auto table_start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        bool decode_succeeded = aprs::router::try_decode_packets(buffer, packets);
+        do_not_optimize(decode_succeeded);
+        do_not_optimize(packets);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End packet table loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double megabytes = static_cast<double>(buffer.size() * iteration_count) / (1024.0 * 1024.0);
+    const double line_elapsed_s = std::chrono::duration<double>(middle - start).count();
+    const double views_elapsed_s = std::chrono::duration<double>(table_start - middle).count();
+    const double table_elapsed_s = std::chrono::duration<double>(end - table_start).count();
+
+    std::cout << "Packets:         " << packets.size() << std::endl;
+    std::cout << "Buffer size:     " << buffer.size() << " bytes" << std::endl;
+    std::cout << "Each line:       " << std::fixed << std::setprecision(0) << (megabytes / line_elapsed_s) << " MB/s" << std::endl;
+    std::cout << "Packet views:    " << std::fixed << std::setprecision(0) << (megabytes / views_elapsed_s) << " MB/s" << std::endl;
+    std::cout << "Packet table:    " << std::fixed << std::setprecision(0) << (megabytes / table_elapsed_s) << " MB/s" << std::endl;
+}
+
+static void run_address_classification_test()
+{
+    constexpr size_t iteration_count = 1'000'000;
+
+    // A realistic mix of path addresses, as seen on RF and APRS-IS
+    // Path addresses are classified when parsed, both as keywords (WIDE, TRACE, RELAY...) and as q constructs
+
+    const std::array<std::string_view, 16> addresses = {
+        "WIDE1-1", "WIDE2-2", "WIDE2*", "N0CALL-10*", "qAR", "K7ABC-3", "TCPIP*", "qAC",
+        "RELAY", "TRACE3-3", "W7XYZ-15*", "qAO", "T2TEXAS", "WIDE3-1", "NOGATE", "RFONLY"
+    };
+
+    std::cout << std::endl;
+    std::cout << "--- Begin address classification loop ---" << std::endl;
+
+    size_t keyword_count = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        for (std::string_view address : addresses)
+        {
+            do_not_optimize(address);
+            aprs::router::detail::q_construct q = aprs::router::detail::parse_q_construct(address);
+            aprs::router::detail::address_kind kind = aprs::router::detail::parse_address_kind(address);
+            do_not_optimize(q);
+            do_not_optimize(kind);
+            keyword_count += (q != aprs::router::detail::q_construct::none || kind != aprs::router::detail::address_kind::other);
+        }
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        for (std::string_view address : addresses)
+        {
+            do_not_optimize(address);
+            aprs::router::detail::address parsed_address;
+            bool result = aprs::router::detail::try_parse_address(address, parsed_address);
+            do_not_optimize(result);
+            do_not_optimize(parsed_address);
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    do_not_optimize(keyword_count);
+
+    std::cout << "--- End address classification loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const size_t address_count = iteration_count * addresses.size();
+    const double classify_elapsed_ns = std::chrono::duration<double, std::nano>(middle - start).count();
+    const double parse_elapsed_ns = std::chrono::duration<double, std::nano>(end - middle).count();
+
+    std::cout << "Addresses:       " << address_count << std::endl;
+    std::cout << "Classify:        " << std::fixed << std::setprecision(2) << (classify_elapsed_ns / static_cast<double>(address_count)) << " ns/address" << std::endl;
+    std::cout << "Parse:           " << std::fixed << std::setprecision(2) << (parse_elapsed_ns / static_cast<double>(address_count)) << " ns/address" << std::endl;
+}
+
+static void run_strict_validation_test()
+{
+    constexpr size_t iteration_count = 1'000'000;
+
+    // The header addresses of a packet routed with routing_option::strict, every address is validated
+
+    const std::array<std::string_view, 8> addresses = {
+        "N0CALL-10", "APRS", "CALLA-10*", "CALLB-5*", "WIDE1*", "WIDE2-1", "K7ABC-3", "W7XYZ-15"
+    };
+
+    std::array<char, aprs::router::detail::address_text_max> callsign = {};
+    size_t callsign_size = 0;
+    int ssid = 0;
+
+    std::cout << std::endl;
+    std::cout << "--- Begin strict validation loop ---" << std::endl;
+
+    // Compare validating the addresses by parsing them, against classifying their characters all at once
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        for (std::string_view address : addresses)
+        {
+            do_not_optimize(address);
+            bool result = aprs::router::detail::try_parse_address_with_used_flag(address, callsign, callsign_size, ssid);
+            do_not_optimize(result);
+        }
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iteration_count; ++i)
+    {
+        for (std::string_view address : addresses)
+        {
+            do_not_optimize(address);
+            bool result = aprs::router::detail::is_address_valid(address);
+            do_not_optimize(result);
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End strict validation loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const size_t address_count = iteration_count * addresses.size();
+    const double parse_elapsed_ns = std::chrono::duration<double, std::nano>(middle - start).count();
+    const double validate_elapsed_ns = std::chrono::duration<double, std::nano>(end - middle).count();
+
+    std::cout << "Addresses:       " << address_count << std::endl;
+    std::cout << "Parse:           " << std::fixed << std::setprecision(2) << (parse_elapsed_ns / static_cast<double>(address_count)) << " ns/address" << std::endl;
+    std::cout << "Validate:        " << std::fixed << std::setprecision(2) << (validate_elapsed_ns / static_cast<double>(address_count)) << " ns/address" << std::endl;
+}
+
+#if APRS_ROUTER_USE_PMR
+
+static void run_memory_resource_throughput_test()
+{
+    constexpr size_t batch_count = 1'000;
+    constexpr size_t batch_size = 1'000;
+    constexpr size_t packet_count = batch_count * batch_size;
+
+    const std::array<aprs::router::packet, 4> packets = {{
+        { "N0CALL-10", "CALL-5", { "CALLA-10*", "CALLB-5*", "CALLC-15*", "WIDE1*", "WIDE2-1" }, "data" },
+        { "N0CALL-11", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL-12", "APRS", { "CALLA*", "WIDE2-1" }, "data" },
+        { "N0CALL-13", "APRS", { "TCPIP*", "qAC", "T2TEST" }, "data with a comment longer than the small string buffer" },
+    }};
+
+    aprs::router::router router(aprs::router::router_settings{ "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, aprs::router::routing_option::none, true });
+
+    // The results of a batch are allocated from a buffer, which is reused by every batch
+
+    std::vector<std::byte> buffer(4 * 1024 * 1024);
+
+    std::cout << std::endl;
+    std::cout << "--- Begin memory resource loop ---" << std::endl;
+
+    // Compare routing batches of packets into routing results using the default allocator,
+    // against routing them into routing results allocated from a monotonic buffer resource,
+    // which is released all at once after every batch
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+        std::vector<aprs::router::routing_result> results;
+        results.reserve(batch_size);
+
+        for (size_t j = 0; j < batch_size; ++j)
+        {
+            aprs::router::routing_result& result = results.emplace_back();
+            bool routing_succeeded = aprs::router::try_route_packet(packets[j % packets.size()], router, result);
+            do_not_optimize(routing_succeeded);
+        }
+
+        do_not_optimize(results);
+    }
+
+    auto middle = std::chrono::high_resolution_clock::now();
+
+    std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size());
+
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+        {
+            std::pmr::vector<aprs::router::routing_result> results(&resource);
+            results.reserve(batch_size);
+
+            for (size_t j = 0; j < batch_size; ++j)
+            {
+                aprs::router::routing_result& result = results.emplace_back(&resource);
+                bool routing_succeeded = aprs::router::try_route_packet(packets[j % packets.size()], router, result);
+                do_not_optimize(routing_succeeded);
+            }
+
+            do_not_optimize(results);
+        }
+
+        resource.release();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "--- End memory resource loop ---" << std::endl;
+    std::cout << std::endl;
+
+    const double default_elapsed_us = std::chrono::duration<double, std::micro>(middle - start).count();
+    const double resource_elapsed_us = std::chrono::duration<double, std::micro>(end - middle).count();
+
+    std::cout << "Iterations:      " << packet_count << " (" << batch_count << " batches of " << batch_size << ")" << std::endl;
+    std::cout << "Default:         " << format_throughput(static_cast<double>(packet_count) / (default_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(default_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+    std::cout << "Memory resource: " << format_throughput(static_cast<double>(packet_count) / (resource_elapsed_us / 1'000'000.0))
+              << ", " << format_route_time(resource_elapsed_us / static_cast<double>(packet_count)) << std::endl;
+}
+
+#endif // APRS_ROUTER_USE_PMR
+
 int main()
 {
     run_throughput_test();
+    run_router_throughput_test();
+    run_batch_throughput_test();
+    run_static_options_throughput_test<aprs::router::routing_option::none>("none");
+    run_static_options_throughput_test<aprs::router::routing_option::recommended>("recommended");
+    run_canonical_path_throughput_test();
+    run_routing_cache_throughput_test();
+    run_shared_router_throughput_test();
+    run_router_set_throughput_test();
+    run_packet_table_throughput_test();
+    run_address_classification_test();
+    run_strict_validation_test();
+#if APRS_ROUTER_USE_PMR
+    run_memory_resource_throughput_test();
+#endif
     return 0;
 }
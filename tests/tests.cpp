@@ -41,6 +41,8 @@
 #include <locale>
 #include <limits>
 #include <memory_resource>
+#include <thread>
+#include <atomic>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -282,6 +284,30 @@ TEST(address, parse_address_kind)
     EXPECT_TRUE(parse_address_kind("N0CALL") == address_kind::other);
     EXPECT_TRUE(parse_address_kind("echo") == address_kind::other);
     EXPECT_TRUE(parse_address_kind("WIDE1") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("WIDEX") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("ECH0") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("TCPI") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("IGATECALLS") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("qAR") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("qACX") == address_kind::other);
+    EXPECT_TRUE(parse_address_kind(std::string_view("WIDE\0", 5)) == address_kind::other);
+    EXPECT_TRUE(parse_address_kind("WID\xC5") == address_kind::other);
+
+    // every keyword is found in the perfect hash table, and only the keyword itself matches
+
+    for (const auto& keyword : address_keywords)
+    {
+        std::string text(keyword.text);
+
+        address_keyword found = find_address_keyword(text);
+
+        EXPECT_TRUE(found.text == keyword.text);
+        EXPECT_TRUE(found.kind == keyword.kind);
+        EXPECT_TRUE(found.q == keyword.q);
+        EXPECT_TRUE(find_address_keyword(text + "X").text.empty());
+        EXPECT_TRUE(find_address_keyword(text.substr(1)).text.empty());
+        EXPECT_TRUE(find_address_keyword(text.substr(0, 1) + "_" + text.substr(2)).text.empty());
+    }
 #else 
     EXPECT_TRUE(true);
 #endif
@@ -307,6 +333,9 @@ TEST(address, parse_q_construct)
     EXPECT_TRUE(parse_q_construct("qACx") == q_construct::none);
     EXPECT_TRUE(parse_q_construct("QAC") == q_construct::none);
     EXPECT_TRUE(parse_q_construct("abc") == q_construct::none);
+    EXPECT_TRUE(parse_q_construct("qAA") == q_construct::none);
+    EXPECT_TRUE(parse_q_construct("qAc") == q_construct::none);
+    EXPECT_TRUE(parse_q_construct("TEMP") == q_construct::none);
 #else 
     EXPECT_TRUE(true);
 #endif
@@ -745,6 +774,69 @@ TEST(address, try_parse_address_with_ssid_array)
 #endif
 }
 
+TEST(address, is_address_valid)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    std::array<char, 10> callsign = {};
+    size_t callsign_size = 0;
+    int ssid = 0;
+
+    EXPECT_TRUE(is_address_valid("N0CALL"));
+    EXPECT_TRUE(is_address_valid("N0CALL-15*"));
+    EXPECT_TRUE(is_address_valid("WIDE1-1"));
+    EXPECT_TRUE(is_address_valid("-1"));
+    EXPECT_FALSE(is_address_valid(""));
+    EXPECT_FALSE(is_address_valid("*"));
+    EXPECT_FALSE(is_address_valid("N0CALL**"));
+    EXPECT_FALSE(is_address_valid("N0CALL-16"));
+    EXPECT_FALSE(is_address_valid("N0CALL-01"));
+    EXPECT_FALSE(is_address_valid("N0CALL-"));
+    EXPECT_FALSE(is_address_valid("N0CALL7"));
+    EXPECT_FALSE(is_address_valid("N0CALL-1-"));
+    EXPECT_FALSE(is_address_valid("n0call"));
+    EXPECT_FALSE(is_address_valid("N0CALL-15**"));
+    EXPECT_FALSE(is_address_valid(std::string_view("N0\0CALL", 7)));
+    EXPECT_FALSE(is_address_valid("N0\xC3\x89" "ALL"));
+
+    // Every address made of these characters should be validated like try_parse_address_with_used_flag
+
+    const std::string_view characters = "A0159-*a \x80";
+
+    std::vector<std::string> addresses = { "" };
+
+    for (size_t length = 1; length <= 5; length++)
+    {
+        std::vector<std::string> next;
+        for (const std::string& a : addresses)
+        {
+            if (a.size() == length - 1)
+            {
+                for (char c : characters)
+                {
+                    next.push_back(a + c);
+                }
+            }
+        }
+        addresses.insert(addresses.end(), next.begin(), next.end());
+    }
+
+    for (std::string_view prefix : { "", "N", "N0CA", "N0CAL", "N0CALL", "N0CALLS" })
+    {
+        for (std::string_view suffix : { "", "-1", "-10", "-15", "-16", "-1*", "-15*", "*", "**" })
+        {
+            addresses.push_back(std::string(prefix) + std::string(suffix));
+        }
+    }
+
+    for (const std::string& address : addresses)
+    {
+        EXPECT_TRUE(is_address_valid(address) == try_parse_address_with_used_flag(address, callsign, callsign_size, ssid));
+    }
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
 TEST(address, equal_addresses_ignore_mark)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
@@ -1054,6 +1146,257 @@ TEST(address, equal_addresses_ignore_mark)
 #endif
 }
 
+TEST(address, get_address_key)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Cross-representation addresses pack to the same key
+    {
+        address a1 = address { {'W', 'I', 'D', 'E'}, 4, 1, 2 }; // WIDE1-2
+        address a2 = address { {'W', 'I', 'D', 'E', '1'}, 5, 0, 0, 2 }; // WIDE1-2
+        EXPECT_TRUE(get_address_key(a1) != 0);
+        EXPECT_TRUE(get_address_key(a1) == get_address_key(a2));
+    }
+
+    // The mark is ignored
+    {
+        address a1 = address { {'C', 'A', 'L', 'L'}, 4, 0, 0, 5, true }; // CALL-5*
+        address a2 = address { {'C', 'A', 'L', 'L'}, 4, 0, 0, 5 }; // CALL-5
+        EXPECT_TRUE(get_address_key(a1) == get_address_key(a2));
+    }
+
+    // Prefixes and ssids produce different keys
+    {
+        address a1 = address { {'C', 'A', 'L', 'L'}, 4 }; // CALL
+        address a2 = address { {'C', 'A', 'L', 'L', 'A'}, 5 }; // CALLA
+        address a3 = address { {'C', 'A', 'L', 'L'}, 4, 0, 0, 1 }; // CALL-1
+        EXPECT_TRUE(get_address_key(a1) != get_address_key(a2));
+        EXPECT_TRUE(get_address_key(a1) != get_address_key(a3));
+    }
+
+    // Addresses which cannot be packed have no key
+    {
+        address a1 = address { {'c', 'a', 'l', 'l'}, 4 }; // call
+        address a2 = address { {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I'}, 9, 1, 1 }; // ABCDEFGHI1-1
+        address a3 = address { {}, 0 };
+        EXPECT_TRUE(get_address_key(a1) == 0);
+        EXPECT_TRUE(get_address_key(a2) == 0);
+        EXPECT_TRUE(get_address_key(a3) == 0);
+    }
+
+    // Keys agree with equal_addresses_ignore_mark, as long as at most one address is an n-N address
+
+    std::vector<std::string> strings = { "WIDE", "WIDE1", "WIDE1-1", "WIDE1-2", "WIDE2-1", "WIDE11", "WIDE11-1", "WIDE-1", "WIDE*", "WIDE1-1*",
+        "CALL", "CALL-1", "CALL-15", "CALL1", "CALL1-1", "CALLA", "TRACE3-3", "RELAY", "A", "A1", "ABCDEFGH", "ABCDEFGH1-1", "N0CALL-10" };
+
+    std::vector<address> addresses;
+
+    for (const auto& s : strings)
+    {
+        address a;
+        if (try_parse_address_with_ssid(s, a))
+        {
+            addresses.push_back(a);
+        }
+        address b;
+        if (try_parse_n_N_address(s, b))
+        {
+            addresses.push_back(b);
+        }
+    }
+
+    for (const auto& lhs : addresses)
+    {
+        for (const auto& rhs : addresses)
+        {
+            if (lhs.n > 0 && rhs.n > 0)
+            {
+                continue;
+            }
+            EXPECT_TRUE((get_address_key(lhs) == get_address_key(rhs)) == equal_addresses_ignore_mark(lhs, rhs));
+            EXPECT_TRUE(equal_addresses_ignore_mark(lhs, get_address_key(lhs), rhs, get_address_key(rhs)) == equal_addresses_ignore_mark(lhs, rhs));
+        }
+    }
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(address, match_address_keys)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    std::array<uint64_t, 16> keys = {};
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        keys[i] = 100 + (i % 5);
+    }
+
+    // Every size, including odd sizes handled partly by the scalar tail
+    for (size_t size = 0; size <= keys.size(); size++)
+    {
+        uint64_t expected = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            if (keys[i] == 102)
+            {
+                expected |= uint64_t(1) << i;
+            }
+        }
+        EXPECT_TRUE(match_address_keys(102, keys, size) == expected);
+        EXPECT_TRUE(match_address_keys(7, keys, size) == 0);
+    }
+
+    // Keys differing only in the upper or lower 32 bits do not match
+    {
+        std::array<uint64_t, 4> k = { 0x0000000100000002, 0x0000000200000002, 0x0000000100000001, 0x0000000100000002 };
+        EXPECT_TRUE(match_address_keys(0x0000000100000002, k, k.size()) == 0b1001);
+    }
+
+    // Router addresses which could not be packed are still matched
+    {
+        std::array<address, 4> router_addresses = {};
+        std::array<uint64_t, 4> router_address_keys = {};
+        try_parse_address_with_ssid("CALLA", router_addresses[0]);
+        router_addresses[1] = address { {'c', 'a', 'l', 'l'}, 4 }; // call
+        try_parse_address_with_ssid("CALLB-1", router_addresses[2]);
+        try_parse_address_with_ssid("CALLA", router_addresses[3]);
+        for (size_t i = 0; i < router_addresses.size(); i++)
+        {
+            router_address_keys[i] = get_address_key(router_addresses[i]);
+        }
+        EXPECT_TRUE(router_address_keys[1] == 0);
+
+        address a;
+        try_parse_address_with_ssid("CALLA*", a);
+        EXPECT_TRUE(find_matching_addresses(a, get_address_key(a), router_addresses, router_address_keys, 4) == 0b1001);
+        EXPECT_TRUE(find_matching_addresses(a, get_address_key(a), router_addresses, router_address_keys, 3) == 0b0001);
+
+        address b = address { {'c', 'a', 'l', 'l'}, 4 }; // call
+        EXPECT_TRUE(find_matching_addresses(b, get_address_key(b), router_addresses, router_address_keys, 4) == 0b0010);
+    }
+
+    // n-N addresses are matched by text and n, ignoring N
+    {
+        std::array<address, 3> router_n_N_addresses = {};
+        std::array<uint64_t, 3> router_n_N_address_keys = {};
+        try_parse_n_N_address("WIDE1", router_n_N_addresses[0]);
+        try_parse_n_N_address("WIDE2-2", router_n_N_addresses[1]);
+        try_parse_n_N_address("TRACE2", router_n_N_addresses[2]);
+        for (size_t i = 0; i < router_n_N_addresses.size(); i++)
+        {
+            router_n_N_address_keys[i] = get_n_N_address_key(router_n_N_addresses[i]);
+        }
+
+        address a;
+        try_parse_n_N_address("WIDE2-1", a);
+        EXPECT_TRUE(find_matching_n_N_addresses(a, get_n_N_address_key(a), router_n_N_addresses, router_n_N_address_keys, 3) == 0b010);
+
+        address b;
+        try_parse_n_N_address("WIDE3-1", b);
+        EXPECT_TRUE(find_matching_n_N_addresses(b, get_n_N_address_key(b), router_n_N_addresses, router_n_N_address_keys, 3) == 0);
+    }
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(address, address_key_table)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Hundreds of aliases, including duplicates and addresses which cannot be packed
+
+    std::array<address, 256> router_addresses = {};
+    address_key_table<256> table;
+    size_t router_addresses_size = 0;
+
+    clear_address_keys(table);
+
+    for (size_t i = 0; i < 200; i++)
+    {
+        address a;
+        EXPECT_TRUE(try_parse_address_with_ssid("AL" + std::to_string(i % 150), a));
+        if (i % 50 == 0)
+        {
+            std::transform(a.text.begin(), a.text.begin() + a.text_size, a.text.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        }
+        set_address_key(table, router_addresses_size, get_address_key(a));
+        router_addresses[router_addresses_size++] = a;
+    }
+
+    EXPECT_TRUE(table.unpacked_size == 4);
+
+    auto contains = [&](std::string_view s, bool lowercase = false)
+    {
+        address a;
+        EXPECT_TRUE(try_parse_address_with_ssid(s, a));
+        if (lowercase)
+        {
+            std::transform(a.text.begin(), a.text.begin() + a.text_size, a.text.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        }
+        bool expected = false;
+        for (size_t i = 0; i < router_addresses_size; i++)
+        {
+            expected = expected || equal_addresses_ignore_mark(a, router_addresses[i]);
+        }
+        bool result = has_matching_address(a, get_address_key(a), router_addresses, table, router_addresses_size);
+        EXPECT_TRUE(result == expected);
+        return result;
+    };
+
+    EXPECT_TRUE(contains("AL1"));
+    EXPECT_TRUE(contains("AL149*"));
+    EXPECT_TRUE(contains("AL100", true));
+    EXPECT_TRUE(!contains("AL150"));
+    EXPECT_TRUE(!contains("AL1-1"));
+    EXPECT_TRUE(!contains("AL1", true));
+
+    // Duplicate keys are visited in ascending order
+
+    address a;
+    try_parse_address_with_ssid("AL10", a);
+    uint64_t key = get_address_key(a);
+    size_t first = find_address_key(table, key);
+    EXPECT_TRUE(first == 10);
+    EXPECT_TRUE(table.next[first] == 160);
+    EXPECT_TRUE(table.next[table.next[first]] == 256);
+
+    // Clearing the table removes all the keys
+
+    clear_address_keys(table);
+    EXPECT_TRUE(find_address_key(table, key) == 256);
+    EXPECT_TRUE(table.unpacked_size == 0);
+
+    // n-N addresses, the first matching address at or after the offset is returned
+
+    std::array<address, 256> router_n_N_addresses = {};
+    address_key_table<256> n_N_table;
+    clear_address_keys(n_N_table);
+
+    std::vector<std::string> n_N_strings = { "WIDE1", "WIDE2-1", "TRACE2", "WIDE2-2", "TRACE2", "WIDE2" };
+    for (size_t i = 0; i < n_N_strings.size(); i++)
+    {
+        EXPECT_TRUE(try_parse_n_N_address(n_N_strings[i], router_n_N_addresses[i]));
+    }
+    router_n_N_addresses[2] = address { {'t', 'r', 'a', 'c', 'e'}, 5, 2 }; // trace2
+    for (size_t i = 0; i < n_N_strings.size(); i++)
+    {
+        set_address_key(n_N_table, i, get_n_N_address_key(router_n_N_addresses[i]));
+    }
+
+    address w;
+    try_parse_n_N_address("WIDE2-2", w);
+    uint64_t w_key = get_n_N_address_key(w);
+    EXPECT_TRUE(find_next_matching_n_N_address(w, w_key, router_n_N_addresses, n_N_table, n_N_strings.size(), 0) == 1);
+    EXPECT_TRUE(find_next_matching_n_N_address(w, w_key, router_n_N_addresses, n_N_table, n_N_strings.size(), 2) == 3);
+    EXPECT_TRUE(find_next_matching_n_N_address(w, w_key, router_n_N_addresses, n_N_table, n_N_strings.size(), 4) == 5);
+    EXPECT_TRUE(find_next_matching_n_N_address(w, w_key, router_n_N_addresses, n_N_table, n_N_strings.size(), 6) == 6);
+
+    address t = address { {'t', 'r', 'a', 'c', 'e'}, 5, 2, 1 }; // trace2-1
+    EXPECT_TRUE(find_next_matching_n_N_address(t, get_n_N_address_key(t), router_n_N_addresses, n_N_table, n_N_strings.size(), 0) == 2);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
 TEST(packet, try_decode_packet)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
@@ -1180,1073 +1523,2737 @@ TEST(packet, try_decode_packet)
 #endif
 }
 
-TEST(packet, try_decode_packet_ctor)
+TEST(packet_view, try_decode_packet)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    packet p = "N0CALL>APRS,WIDE2-2:data";
-
-    EXPECT_TRUE(p.from == "N0CALL");
-    EXPECT_TRUE(p.to == "APRS");
-    EXPECT_TRUE(p.data == "data");
-    EXPECT_TRUE(p.path.size() == 1);
-    EXPECT_TRUE(p.path[0] == "WIDE2-2");
-
-    EXPECT_TRUE(p == "N0CALL>APRS,WIDE2-2:data");
-
-    // Multiple path elements
-    packet p2 = "FROM>TO,A,B*,C:hello";
-    EXPECT_TRUE(p2.from == "FROM");
-    EXPECT_TRUE(p2.to == "TO");
-    EXPECT_TRUE(p2.path.size() == 3);
-    EXPECT_TRUE(p2.path[0] == "A");
-    EXPECT_TRUE(p2.path[1] == "B*");
-    EXPECT_TRUE(p2.path[2] == "C");
-    EXPECT_TRUE(p2.data == "hello");
-
-    // No path
-    packet p3 = "SRC>DST:payload";
-    EXPECT_TRUE(p3.from == "SRC");
-    EXPECT_TRUE(p3.to == "DST");
-    EXPECT_TRUE(p3.path.empty());
-    EXPECT_TRUE(p3.data == "payload");
-
-    // Construct from std::string
-    std::string pkt_str = "AA>BB,CC:dd";
-    packet p4(pkt_str);
-    EXPECT_TRUE(p4.from == "AA");
-    EXPECT_TRUE(p4.to == "BB");
-    EXPECT_TRUE(p4.path.size() == 1);
-    EXPECT_TRUE(p4.path[0] == "CC");
-    EXPECT_TRUE(p4.data == "dd");
+    // The packet view should decode packets the same way as packet
+
+    std::vector<std::string> packet_strings = {
+        "N0CALL>APRS,WIDE2-2:data",
+        "N0CALL>APRS,CALLA,CALLB,WIDE2*:data",
+        "N0CALL>APRS::data",
+        "N0CALL>APRS,WIDE2-2",
+        "N0CALL>APRS:data",
+        "N0CALL>APRS,INVALID_PATH_FORMAT:data",
+        "N0CALL>APRS,SPCL-@!,WIDE2*:data",
+        "N0CALL>APRS:",
+        "N0CALL:data",
+        "N0CALL>APRS",
+        "N0CALL>APRS,",
+        "N0CALL>",
+        "N0CALL",
+        "N0CALL>APRS,,CALLA,,CALLB:data",
+        "N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE,CALLF,CALLG,CALLH:data",
+    };
+
+    for (const auto& packet_string : packet_strings)
+    {
+        packet p;
+        packet_view pv;
 
-    // Round-trip: to_string matches original
-    std::string original = "N0CALL>APRS,WIDE1-1,WIDE2-2:test data";
-    packet p5 = original.c_str();
-    EXPECT_TRUE(to_string(p5) == original);
+        bool result = try_decode_packet(packet_string, p);
 
-    // Data with special characters (colons)
-    packet p6 = "SRC>DST:data:with:colons";
-    EXPECT_TRUE(p6.from == "SRC");
-    EXPECT_TRUE(p6.to == "DST");
-    EXPECT_TRUE(p6.data == "data:with:colons");
+        EXPECT_TRUE(try_decode_packet(packet_string, pv) == result);
 
-    // const char* and std::string ctors produce identical packets
-    const char* raw = "N0CALL>APRS,WIDE1-1,WIDE2-2:test";
-    std::string str_pkt(raw);
-    packet from_cstr(raw);
-    packet from_string(str_pkt);
-    EXPECT_TRUE(from_cstr == from_string);
+        if (result)
+        {
+            EXPECT_TRUE(pv.from == p.from);
+            EXPECT_TRUE(pv.to == p.to);
+            EXPECT_TRUE(pv.data == p.data);
+            ASSERT_TRUE(pv.path.size() == p.path.size());
+            for (size_t i = 0; i < p.path.size(); i++)
+            {
+                EXPECT_TRUE(pv.path[i] == p.path[i]);
+            }
+            EXPECT_TRUE(to_string(pv) == packet_string);
+        }
+    }
 
-    // const char* ctor: full path
-    packet p7("A>B,C,D*,E,F:payload");
-    EXPECT_TRUE(p7.from == "A");
-    EXPECT_TRUE(p7.to == "B");
-    EXPECT_TRUE(p7.path.size() == 4);
-    EXPECT_TRUE(p7.path[0] == "C");
-    EXPECT_TRUE(p7.path[1] == "D*");
-    EXPECT_TRUE(p7.path[2] == "E");
-    EXPECT_TRUE(p7.path[3] == "F");
-    EXPECT_TRUE(p7.data == "payload");
+    // The packet view fields are views into the packet string
 
-    // std::string ctor: no path
-    std::string no_path_str = "FROM>TO:data";
-    packet p8(no_path_str);
-    EXPECT_TRUE(p8.from == "FROM");
-    EXPECT_TRUE(p8.to == "TO");
-    EXPECT_TRUE(p8.path.empty());
-    EXPECT_TRUE(p8.data == "data");
+    std::string_view packet_string = "N0CALL>APRS,CALLA,WIDE2*:data";
+    packet_view pv;
 
-    // std::string ctor: empty data
-    std::string empty_data_str = "A>B,C:";
-    packet p9(empty_data_str);
-    EXPECT_TRUE(p9.from == "A");
-    EXPECT_TRUE(p9.to == "B");
-    EXPECT_TRUE(p9.path.size() == 1);
-    EXPECT_TRUE(p9.path[0] == "C");
-    EXPECT_TRUE(p9.data == "");
-    EXPECT_TRUE(to_string(p9) == empty_data_str);
+    EXPECT_TRUE(try_decode_packet(packet_string, pv));
+    EXPECT_TRUE(pv.from.data() == packet_string.data());
+    EXPECT_TRUE(pv.to.data() == packet_string.data() + 7);
+    EXPECT_TRUE(pv.path[0].data() == packet_string.data() + 12);
+    EXPECT_TRUE(pv.path[1].data() == packet_string.data() + 18);
+    EXPECT_TRUE(pv.data.data() == packet_string.data() + 25);
 
-    // operator std::string conversion
-    packet p10("X>Y,Z:msg");
-    std::string converted = static_cast<std::string>(p10);
-    EXPECT_TRUE(converted == "X>Y,Z:msg");
+    // Packets with more than 8 path addresses cannot be decoded into a packet view
 
-    // Invalid packet strings trigger assert (only in debug builds)
-#ifndef NDEBUG
-    // const char* ctor
-    EXPECT_DEATH(packet("invalid"), "");
+    EXPECT_FALSE(try_decode_packet("N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE,CALLF,CALLG,CALLH,CALLI:data", pv));
 
-    // std::string ctor
-    EXPECT_DEATH(packet(std::string("also_invalid")), "");
+    // Decoding a packet view resets the path
 
-    // Missing colon
-    EXPECT_DEATH(packet("N0CALL>APRS"), "");
-#endif
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS:data", pv));
+    EXPECT_TRUE(pv.path.empty());
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(packet, equality)
+TEST(packet_view, try_route_packet)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    // Test: Equal packets
-    packet p1{"N0CALL", "APRS", {"CALLA", "CALLB"}, "data"};
-    packet p2{"N0CALL", "APRS", {"CALLA", "CALLB"}, "data"};
-    EXPECT_TRUE(p1 == p2);
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false });
 
-    // Test: Different 'from' field
-    packet p3{"OTHER", "APRS", {"CALLA", "CALLB"}, "data"};
-    EXPECT_FALSE(p1 == p3);
+    packet_view pv;
 
-    // Test: Different 'to' field
-    packet p4{"N0CALL", "OTHER", {"CALLA", "CALLB"}, "data"};
-    EXPECT_FALSE(p1 == p4);
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,CALLA*,WIDE1-1,WIDE2-1:data", pv));
 
-    // Test: Different path size
-    packet p5{"N0CALL", "APRS", {"CALLA"}, "data"};
-    EXPECT_FALSE(p1 == p5);
+    std::array<std::array<char, 10>, 8> routed_packet_path = {};
+    std::array<size_t, 8> routed_packet_path_address_sizes = {};
+    enum routing_state routing_state;
 
-    // Test: Different path contents
-    packet p6{"N0CALL", "APRS", {"CALLA", "CALLC"}, "data"};
-    EXPECT_FALSE(p1 == p6);
+    auto [routed_path_end, routed_sizes_end, routed] = try_route_packet(pv, routed_packet_path.begin(), routed_packet_path_address_sizes.begin(), routing_state, digi.state);
 
-    // Test: Different data
-    packet p7{"N0CALL", "APRS", {"CALLA", "CALLB"}, "other_data"};
-    EXPECT_FALSE(p1 == p7);
+    (void)routed_sizes_end;
 
-    // Test: All fields empty
-    packet p8{"", "", {}, ""};
-    packet p9{"", "", {}, ""};
-    EXPECT_TRUE(p8 == p9);
+    EXPECT_TRUE(routed);
+    EXPECT_TRUE(routing_state == routing_state::routed);
+    ASSERT_TRUE(std::distance(routed_packet_path.begin(), routed_path_end) == 4);
+    EXPECT_TRUE(std::string_view(routed_packet_path[0].data(), routed_packet_path_address_sizes[0]) == "CALLA");
+    EXPECT_TRUE(std::string_view(routed_packet_path[1].data(), routed_packet_path_address_sizes[1]) == "DIGI");
+    EXPECT_TRUE(std::string_view(routed_packet_path[2].data(), routed_packet_path_address_sizes[2]) == "WIDE1*");
+    EXPECT_TRUE(std::string_view(routed_packet_path[3].data(), routed_packet_path_address_sizes[3]) == "WIDE2-1");
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, try_route_packet_no_packet)
-{
-    struct router_settings router_settings = { "DIGI", {}, { "WIDE1" }, routing_option::none, false };
-    std::vector<std::string> routed_path;
-    enum routing_state routing_state = routing_state::not_routed;
-    std::vector<routing_diagnostic> routing_options;
-    try_route_packet("CALL", "APRS", { "WIDE1-1" }, router_settings, routed_path, routing_state, routing_options);
-    EXPECT_TRUE(routing_state == routing_state::routed);
-    EXPECT_TRUE(routed_path.size() == 2);
-    EXPECT_TRUE(routed_path[0] == "DIGI");
-    EXPECT_TRUE(routed_path[1] == "WIDE1*");
-}
-
-TEST(router, try_route_packet_explicit_loop)
+TEST(packet_table, try_decode_packets)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    routing_result result;
-    router_settings digi;
-
-    // -------------------------------------------------------------
-    // Routing a packet through multiple routers
-    //
-    // Input:  N0CALL>APRS,DIGIA,DIGIB,DIGIC,DIGID,DIGIE,DIGIF,DIGIG,DIGIH:data
-    // Output: N0CALL>APRS,DIGIA,DIGIB,DIGIC,DIGID,DIGIE,DIGIF,DIGIG,DIGIH*:data
-    // -------------------------------------------------------------
+    // Every line should be decoded the same way as a packet view
+
+    std::vector<std::string> lines = {
+        "N0CALL>APRS,WIDE2-2:data",
+        "N0CALL>APRS,CALLA,CALLB,WIDE2*:data, with > separators: in the data",
+        "N0CALL>APRS::data",
+        "N0CALL>APRS:data",
+        "N0CALL>APRS:",
+        "N0CALL>APRS,:data",
+        "N0CALL>APRS,CALLA,:data",
+        "N0CALL>APRS,,CALLA,,CALLB:data",
+        "N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE,CALLF,CALLG,CALLH:data",
+        "N0CALL-10>APRS,CALLA-10*,CALLB-5*,WIDE1*,WIDE2-1,qAR,K7ABC-3:!4903.50N/07201.75W-Test 001/000",
+    };
+
+    std::string buffer;
+    for (size_t i = 0; i < 100; i++)
+    {
+        buffer += lines[i % lines.size()];
+        buffer += (i % 3 == 0) ? "\r\n" : "\n";
+    }
 
-    digi.explicit_addresses = {};
-    digi.n_N_addresses = {};
+    packet_table packets;
 
-    packet p = {"N0CALL", "APRS", {"DIGIA","DIGIB","DIGIC","DIGID","DIGIE","DIGIF","DIGIG","DIGIH"}, "data"};
-    result.routed_packet = p;
+    EXPECT_TRUE(try_decode_packets(buffer, packets));
+    ASSERT_TRUE(packets.size() == 100);
 
-    std::vector<size_t> digipeated_indices = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        packet_view pv;
 
-    result = test_packet_routing_iteration(p, digi, p.path, digipeated_indices, 8);
+        EXPECT_TRUE(try_decode_packet(lines[i % lines.size()], pv));
 
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGIA,DIGIB,DIGIC,DIGID,DIGIE,DIGIF,DIGIG,DIGIH*:data");
-#else
-    EXPECT_TRUE(true);
-#endif
-}
+        packet_view table_pv = packets[i];
 
-TEST(router, try_route_packet_n_N_loop)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    routing_result result;
-    router_settings digi;
+        EXPECT_TRUE(table_pv == pv);
 
-    // -------------------------------------------------------------
-    // Routing a packet through multiple N-hops and multiple routers
-    //
-    // Input:  N0CALL>APRS,WIDE1-2,CALL,WIDE2-2,ROUTE,WIDE3-2:data
-    // Output: N0CALL>APRS,DIGI1,DIGI2,CALL,DIGI3,DIGI4,ROUTE,DIGI5,DIGI6*:data
-    // -------------------------------------------------------------
+        for (size_t j = 0; j < table_pv.path.size(); j++)
+        {
+            bool used = !table_pv.path[j].empty() && table_pv.path[j].back() == '*';
+            EXPECT_TRUE((packets.address_used[packets.path_begin[i] + j] != 0) == used);
+        }
+    }
 
-    digi.n_N_addresses = {"WIDE1", "WIDE2", "WIDE3"};
-    digi.options = routing_option::substitute_complete_n_N_address;
+    // The fields are offsets into the buffer
 
-    packet p = {"N0CALL", "APRS", {"WIDE1-2", "WIDE2-2", "WIDE3-2"}, "data"};
-    result.routed_packet = p;
+    EXPECT_TRUE(try_decode_packets("N0CALL>APRS,CALLA,WIDE2*:data\nCALL>APRS:x", packets));
+    ASSERT_TRUE(packets.size() == 2);
+    EXPECT_TRUE(packets.from_begin[1] == 30);
+    EXPECT_TRUE(packets.to_begin[0] == 7);
+    EXPECT_TRUE(packets.address_begin[packets.path_begin[0] + 1] == 18);
+    EXPECT_TRUE(packets.address_used[packets.path_begin[0] + 1] == 1);
+    EXPECT_TRUE(packets.data_begin[0] == 25);
+    EXPECT_TRUE(packets.path_size[1] == 0);
+    EXPECT_TRUE(to_string(packets[1]) == "CALL>APRS:x");
 
-    std::vector<size_t> digipeated_indices = { 0, 1, 2, 3, 4, 5 };
-    std::vector<std::string> digipeater_addresses = {"DIGI1","DIGI2","DIGI3","DIGI4","DIGI5","DIGI6"};
+    // Lines which cannot be decoded are skipped, empty lines are ignored
 
-    result = test_packet_routing_iteration(p, digi, digipeater_addresses, digipeated_indices, 6);
+    EXPECT_FALSE(try_decode_packets("N0CALL>APRS:a\nN0CALL:data\n\nN0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE,CALLF,CALLG,CALLH,CALLI:data\nN0CALL>APRS:b\n", packets));
+    ASSERT_TRUE(packets.size() == 2);
+    EXPECT_TRUE(to_string(packets[0]) == "N0CALL>APRS:a");
+    EXPECT_TRUE(to_string(packets[1]) == "N0CALL>APRS:b");
 
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI1,DIGI2,DIGI3,DIGI4,DIGI5,DIGI6*:data");
+    EXPECT_TRUE(try_decode_packets("\r\n\n", packets));
+    EXPECT_TRUE(packets.empty());
 
-    // -------------------------------------------------------------
-    // Routing a packet through multiple N-hops and multiple routers
-    //
-    // Input:  N0CALL>APRS,WIDE1-1,WIDE2-7:data
-    // Output: N0CALL>APRS,DIGI1,DIGI2,CALL,DIGI3,DIGI4,ROUTE,DIGI5,DIGI6*:data
-    // -------------------------------------------------------------
+    // A long line, followed by many short lines
 
-    digi.n_N_addresses = {"WIDE1","WIDE2"};
-    digi.options = routing_option::substitute_complete_n_N_address;
+    std::string long_buffer = "N0CALL>APRS,WIDE1-1:" + std::string(10000, 'x') + "\n";
+    for (size_t i = 0; i < 1000; i++)
+    {
+        long_buffer += "N0CALL>APRS,CALL*,WIDE2-1:" + std::string(i % 37, 'y') + "\n";
+    }
 
-    p = {"N0CALL", "APRS", {"WIDE1-1", "WIDE2-7"}, "data"};
-    result.routed_packet = p;
+    EXPECT_TRUE(try_decode_packets(long_buffer, packets));
+    ASSERT_TRUE(packets.size() == 1001);
+    EXPECT_TRUE(packets[0].data.size() == 10000);
+    for (size_t i = 1; i < packets.size(); i++)
+    {
+        EXPECT_TRUE(packets[i].from == "N0CALL");
+        EXPECT_TRUE(packets[i].path.size() == 2);
+        EXPECT_TRUE(packets[i].data.size() == (i - 1) % 37);
+    }
 
-    digipeated_indices = { 0, 1, 2, 3, 4, 5, 6, 7 };
-    digipeater_addresses = {"DIGI1","DIGI2","DIGI3","DIGI4","DIGI5","DIGI6","DIGI7","DIGI8"};
+    // Packets are routed from the table
 
-    result = test_packet_routing_iteration(p, digi, digipeater_addresses, digipeated_indices, 8);
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false });
 
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI1,DIGI2,DIGI3,DIGI4,DIGI5,DIGI6,DIGI7,DIGI8*:data");
-#else
-    EXPECT_TRUE(true);
-#endif
-}
+    std::array<std::array<char, 10>, 8> routed_packet_path = {};
+    std::array<size_t, 8> routed_packet_path_address_sizes = {};
+    enum routing_state routing_state;
 
-TEST(routing_option, enum_has_flag)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    routing_option op = routing_option::preempt_front | routing_option::substitute_complete_n_N_address;
+    auto [routed_path_end, routed_sizes_end, routed] = try_route_packet(packets[1], routed_packet_path.begin(), routed_packet_path_address_sizes.begin(), routing_state, digi.state);
 
-    EXPECT_TRUE(enum_has_flag(op, routing_option::preempt_front));
-    EXPECT_TRUE(enum_has_flag(op, routing_option::substitute_complete_n_N_address));
-    EXPECT_TRUE(enum_has_flag(op, routing_option::route_self) == false);
-#else
-    EXPECT_TRUE(true);
-#endif
-}
+    (void)routed_sizes_end;
 
-TEST(router, simple_demo)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi { "DIGI", {}, { "WIDE1" }, routing_option::none, false };
-    routing_result result;
+    EXPECT_TRUE(routed);
+    EXPECT_TRUE(routing_state == routing_state::routed);
+    ASSERT_TRUE(std::distance(routed_packet_path.begin(), routed_path_end) == 3);
+    EXPECT_TRUE(std::string_view(routed_packet_path[0].data(), routed_packet_path_address_sizes[0]) == "CALL");
+    EXPECT_TRUE(std::string_view(routed_packet_path[1].data(), routed_packet_path_address_sizes[1]) == "DIGI");
+    EXPECT_TRUE(std::string_view(routed_packet_path[2].data(), routed_packet_path_address_sizes[2]) == "WIDE2*");
 
-    packet p = { "N0CALL", "APRS", { "WIDE1-3" }, "data" }; // N0CALL>APRS,WIDE1-3:data
+    // Separators in the first 64 characters of a line
 
-    try_route_packet(p, digi, result);
+    std::string text = "N0CALL>APRS,CALL*,WIDE2-1:data,>:" + std::string(31, 'x');
+    uint64_t from_ends = 0;
+    uint64_t commas = 0;
+    uint64_t colons = 0;
 
-    EXPECT_TRUE(result.state == routing_state::routed);
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE1-2:data"); // N0CALL>APRS,DIGI*,WIDE1-2:data
-#else
-    EXPECT_TRUE(true);
-#endif
-}
+    find_packet_separators(text.data(), text.size(), from_ends, commas, colons);
 
-TEST(router, preempt_front_with_explicit_ssid_diag)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI2-3", {}, {}, routing_option::preempt_front, true };
-    routing_result result;
+    EXPECT_TRUE(from_ends == ((uint64_t(1) << 6) | (uint64_t(1) << 31)));
+    EXPECT_TRUE(commas == ((uint64_t(1) << 11) | (uint64_t(1) << 17) | (uint64_t(1) << 30)));
+    EXPECT_TRUE(colons == ((uint64_t(1) << 25) | (uint64_t(1) << 32)));
 
-    packet p = "N0CALL>APRS,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data";
+    // Headers which end before, at and past the first 64 characters of a line,
+    // and lines at the end of the buffer, without a line ending
 
-    try_route_packet(p, digi, result);
+    std::vector<std::string> edge_lines;
+    for (size_t size = 0; size < 72; size++)
+    {
+        edge_lines.push_back(std::string(size, 'N') + ">APRS:data");
+        edge_lines.push_back("N0CALL>" + std::string(size, 'A') + ",WIDE1-1*:data>with,separators:");
+        edge_lines.push_back("N0CALL>APRS,CALLA*," + std::string(size, 'B') + ",:" + std::string(size, 'x'));
+        edge_lines.push_back("N0CALL>APRS," + std::string(size, ',') + "CALLA:data\r");
+        edge_lines.push_back(std::string(size, 'x') + ":N0CALL>APRS:data");
+    }
 
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI2-3*,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2:data");
+    auto decoded_like_packet_view = [&](const std::string& edge_buffer, size_t lines_begin, size_t lines_end)
+    {
+        bool decoded = try_decode_packets(edge_buffer, packets);
+        bool all_decoded = true;
+        size_t index = 0;
 
-    // N0CALL>APRS,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data
-    //                                                     ~~~~~~~
-    //                                                     52   59 - Packet address removed.
-    //
-    // N0CALL>APRS,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data
-    //             ~~~~~~~
-    //             12   29 - Packet address inserted.
-    //
-    // N0CALL>APRS,DIGI1-1*,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data
-    //             ~~~~~~~
-    //             12   29 - Packet address 'set'.
+        for (size_t i = lines_begin; i < lines_end; i++)
+        {
+            std::string_view line = edge_lines[i];
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
 
-    EXPECT_TRUE(result.actions.size() == 3);
+            packet_view pv;
+            if (!try_decode_packet(line, pv))
+            {
+                all_decoded = false;
+                continue;
+            }
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI2-3");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[0].start == 52);
-    EXPECT_TRUE(result.actions[0].end == 59);
-    EXPECT_TRUE(result.actions[0].index == 5);
+            if (index == packets.size() || !(packets[index] == pv))
+            {
+                return false;
+            }
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI2-3");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 19);
-    EXPECT_TRUE(result.actions[1].index == 0);
+            for (size_t j = 0; j < pv.path.size(); j++)
+            {
+                bool used = !pv.path[j].empty() && pv.path[j].back() == '*';
+                if ((packets.address_used[packets.path_begin[index] + j] != 0) != used)
+                {
+                    return false;
+                }
+            }
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI2-3");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::set);
-    EXPECT_TRUE(result.actions[2].start == 12);
-    EXPECT_TRUE(result.actions[2].end == 19);
-    EXPECT_TRUE(result.actions[2].index == 0);
-#else
-    EXPECT_TRUE(true);
-#endif
-}
+            index++;
+        }
 
-TEST(router, try_route_packet_n_N_address_as_explicit)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI", { "WIDE1" }, {}, routing_option::none, true };
-    routing_result result;
+        return decoded == all_decoded && index == packets.size();
+    };
 
-    packet p = { "N0CALL", "APRS", { "WIDE1-3" }, "data" }; // N0CALL>APRS,WIDE1-3:data
+    std::string edge_buffer;
+    for (size_t i = 0; i < edge_lines.size(); i++)
+    {
+        edge_buffer += edge_lines[i];
+        if (i + 1 < edge_lines.size())
+        {
+            edge_buffer += "\n";
+        }
 
-    try_route_packet(p, digi, result);
+        EXPECT_TRUE(decoded_like_packet_view(edge_lines[i], i, i + 1));
+    }
 
-    EXPECT_TRUE(result.state == routing_state::not_routed);
+    EXPECT_TRUE(decoded_like_packet_view(edge_buffer, 0, edge_lines.size()));
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, routing_n_N_with_addresses_in_front)
+TEST(fixed_packet, try_decode_packet)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI", {}, { "WIDE2-2" }, routing_option::none, true };
-    routing_result result;
-
-    packet p = "N0CALL>APRS,CALL,WIDE2-1:data";
-
-    try_route_packet(p, digi, result);
-
-    EXPECT_TRUE(result.state == routing_state::not_routed);
-#else
-    EXPECT_TRUE(true);
-#endif
-}
-
-TEST(router, placeholder_test)
-{
-    router_settings digi{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, true };
-    routing_result result;
-
-    packet p = "N0CALL>APRS,WIDE1,WIDE2-2:data";
-
-    try_route_packet(p, digi, result);
+    fixed_packet p;
 
-    EXPECT_TRUE(result.state == routing_state::routed);
-}
+    EXPECT_TRUE(try_decode_packet("N0CALL-10>APRS,CALLA*,WIDE1-1,,WIDE2-2:data:with>separators", p));
+    EXPECT_TRUE(std::string_view(p.from.data(), p.from_size) == "N0CALL-10");
+    EXPECT_TRUE(std::string_view(p.to.data(), p.to_size) == "APRS");
+    ASSERT_TRUE(p.path_size == 4);
+    EXPECT_TRUE(std::string_view(p.path[0].data(), p.path_address_sizes[0]) == "CALLA*");
+    EXPECT_TRUE(std::string_view(p.path[2].data(), p.path_address_sizes[2]) == "");
+    EXPECT_TRUE(std::string_view(p.data.data(), p.data_size) == "data:with>separators");
+    EXPECT_TRUE(to_string(p) == "N0CALL-10>APRS,CALLA*,WIDE1-1,,WIDE2-2:data:with>separators");
 
-TEST(router, router_address_and_path_dual_matching)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "ROUTER", { "DIGI" }, {}, routing_option::none, true };
-    routing_result result;
+    // Decoded the same as a packet view
 
-    packet p = "N0CALL>APRS,DIGI,ROUTER:data";
+    packet_view pv;
+    EXPECT_TRUE(try_decode_packet("N0CALL-10>APRS,CALLA*,WIDE1-1,,WIDE2-2:data:with>separators", pv));
+    EXPECT_TRUE(p.view() == pv);
 
-    try_route_packet(p, digi, result);
+    // Copies are independent of the packet string
 
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,ROUTER,DIGI*,ROUTER:data");
+    fixed_packet copy;
+    {
+        std::string packet_string = "N0CALL>APRS,WIDE1-1:data";
+        EXPECT_TRUE(try_decode_packet(packet_string, copy));
+    }
+    EXPECT_TRUE(to_string(copy) == "N0CALL>APRS,WIDE1-1:data");
+    EXPECT_TRUE(copy != p);
+    copy = p;
+    EXPECT_TRUE(copy == p);
+
+    // Packets which do not fit the capacities
+
+    EXPECT_FALSE(try_decode_packet("N0CALL>APRS", p));
+    EXPECT_TRUE(p.path_size == 0 && p.from_size == 0);
+    EXPECT_FALSE(try_decode_packet("N0CALL-1000>APRS,WIDE1-1:data", p));
+    EXPECT_FALSE(try_decode_packet("N0CALL>APRS,WIDE1-1,CALLSIGN-15*:data", p));
+    EXPECT_FALSE(try_decode_packet("N0CALL>APRS,CALLA,CALLB,CALLC,CALLD,CALLE,CALLF,CALLG,CALLH,CALLI:data", p));
+    EXPECT_FALSE(try_decode_packet("N0CALL>APRS,WIDE1-1:" + std::string(257, 'x'), p));
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,WIDE1-1:" + std::string(256, 'x'), p));
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,N0CALL-15*:", p));
+    EXPECT_TRUE(p.data_size == 0);
+
+    std::array<char, 32> buffer = {};
+    EXPECT_TRUE(format_packet_to(p, buffer.data(), buffer.size()) == 23);
+    EXPECT_TRUE(std::string_view(buffer.data(), 23) == "N0CALL>APRS,N0CALL-15*:");
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, substitute_explicit_address_with_ssid_diagnostic)
+TEST(fixed_packet, try_route_packet)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI-7", { "DIGI" }, {}, routing_option::substitute_explicit_address, true };
-    routing_result result;
-
-    packet p = "N0CALL>APRS,DIGI-7:data";
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, true });
 
-    try_route_packet(p, digi, result);
+    // Routed the same as a packet
 
-    // N0CALL>APRS,DIGI-7:data
-    //             ~~~~~~
-    //             12  18 - Packet has already been routed.
-    //
-    // N0CALL>APRS,DIGI-7*:data
-    //             ~~~~~~
-    //             12  18 - Packet address marked as 'set'
+    for (const char* packet_string : { "N0CALL>APRS,CALLA*,WIDE1-1,WIDE2-1:data", "N0CALL>APRS,WIDE2-2:data", "N0CALL>APRS,CALLA,CALLB:data", "DIGI>APRS,WIDE1-1:data" })
+    {
+        fixed_packet p;
+        fixed_routing_result result;
 
-    EXPECT_TRUE(result.actions.size() == 2);
+        EXPECT_TRUE(try_decode_packet(packet_string, p));
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI-7");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
-    EXPECT_TRUE(result.actions[0].start == 12);
-    EXPECT_TRUE(result.actions[0].end == 18);
-    EXPECT_TRUE(result.actions[0].index == 0);
+        routing_result expected_result;
+        bool expected_routed = try_route_packet(packet(packet_string), digi, expected_result);
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI-7");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::set);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 18);
-    EXPECT_TRUE(result.actions[1].index == 0);
+        EXPECT_TRUE(try_route_packet(p, digi, result) == expected_routed);
+        EXPECT_TRUE(result.routed == expected_routed);
+        EXPECT_TRUE(result.success);
+        EXPECT_TRUE(result.state == expected_result.state);
+        EXPECT_TRUE(result.original_packet == p);
+        EXPECT_TRUE(to_string(result.routed_packet) == to_string(expected_result.routed_packet));
+    }
 
-    EXPECT_TRUE(result.state == routing_state::routed);
-    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI-7*:data");
-#else
-    EXPECT_TRUE(true);
-#endif
-}
+    // A shared router, routed in the caller's scratch
 
-TEST(router, try_route_packet_long_path_with_substitute)
-{
-#ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI2", {},  { "WIDE1", "WIDE2", "WIDE3" }, routing_option::substitute_complete_n_N_address, false };
-    routing_result result;
+    const aprs::router::router& shared_digi = digi;
+    route_scratch scratch;
+    fixed_packet p;
+    fixed_routing_result result;
 
-    packet p = "N0CALL>APRS,DIGI1*,WIDE1-1,CALL,WIDE2-2,ROUTE,WIDE3-2:data";
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,WIDE1-2:data", p));
+    EXPECT_TRUE(try_route_packet(p, shared_digi, scratch, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE1-1:data");
 
-    try_route_packet(p, digi, result);
+    // The result is reused for the next packet
 
-    EXPECT_TRUE(result.state == routing_state::routed);
-    //EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE1-2:data"); // N0CALL>APRS,DIGI*,WIDE1-2:data
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,CALLA,CALLB,CALLC:data", p));
+    EXPECT_FALSE(try_route_packet(p, shared_digi, scratch, result));
+    EXPECT_TRUE(result.state == routing_state::not_routed);
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,CALLA,CALLB,CALLC:data");
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, try_route_packet_enable_diagnostics)
+TEST(packet, try_decode_packet_ctor)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI", {},  { "WIDE1" }, routing_option::none, true };
-    routing_result result;
+    packet p = "N0CALL>APRS,WIDE2-2:data";
 
-    // N0CALL>APRS,CALL,WIDE1,DIGI*:data
-    //                        ~~~~~
-    //                        23 28 - Packet has finished routing.
+    EXPECT_TRUE(p.from == "N0CALL");
+    EXPECT_TRUE(p.to == "APRS");
+    EXPECT_TRUE(p.data == "data");
+    EXPECT_TRUE(p.path.size() == 1);
+    EXPECT_TRUE(p.path[0] == "WIDE2-2");
 
-    packet p = { "N0CALL", "APRS", { "CALL", "WIDE1", "DIGI*" }, "data"};
-    std::string packet_string = to_string(p);
+    EXPECT_TRUE(p == "N0CALL>APRS,WIDE2-2:data");
 
-    try_route_packet(p, digi, result);
+    // Multiple path elements
+    packet p2 = "FROM>TO,A,B*,C:hello";
+    EXPECT_TRUE(p2.from == "FROM");
+    EXPECT_TRUE(p2.to == "TO");
+    EXPECT_TRUE(p2.path.size() == 3);
+    EXPECT_TRUE(p2.path[0] == "A");
+    EXPECT_TRUE(p2.path[1] == "B*");
+    EXPECT_TRUE(p2.path[2] == "C");
+    EXPECT_TRUE(p2.data == "hello");
 
-    EXPECT_TRUE(result.actions.size() == 1);
+    // No path
+    packet p3 = "SRC>DST:payload";
+    EXPECT_TRUE(p3.from == "SRC");
+    EXPECT_TRUE(p3.to == "DST");
+    EXPECT_TRUE(p3.path.empty());
+    EXPECT_TRUE(p3.data == "payload");
 
-    const routing_diagnostic& diag = result.actions[0];
+    // Construct from std::string
+    std::string pkt_str = "AA>BB,CC:dd";
+    packet p4(pkt_str);
+    EXPECT_TRUE(p4.from == "AA");
+    EXPECT_TRUE(p4.to == "BB");
+    EXPECT_TRUE(p4.path.size() == 1);
+    EXPECT_TRUE(p4.path[0] == "CC");
+    EXPECT_TRUE(p4.data == "dd");
 
-    EXPECT_TRUE(std::string_view(diag.address.data(), diag.address_size) == "DIGI");
-    EXPECT_TRUE(diag.target == applies_to::path);
-    EXPECT_TRUE(diag.type == routing_action::warn);
-    EXPECT_TRUE(diag.start == 23);
-    EXPECT_TRUE(diag.end == 28);
-    EXPECT_TRUE(diag.index == 2);
+    // Round-trip: to_string matches original
+    std::string original = "N0CALL>APRS,WIDE1-1,WIDE2-2:test data";
+    packet p5 = original.c_str();
+    EXPECT_TRUE(to_string(p5) == original);
 
-    std::string action_address_str = packet_string.substr(result.actions[0].start, result.actions[0].end - result.actions[0].start);
+    // Data with special characters (colons)
+    packet p6 = "SRC>DST:data:with:colons";
+    EXPECT_TRUE(p6.from == "SRC");
+    EXPECT_TRUE(p6.to == "DST");
+    EXPECT_TRUE(p6.data == "data:with:colons");
 
-    EXPECT_TRUE(action_address_str == "DIGI*");
+    // const char* and std::string ctors produce identical packets
+    const char* raw = "N0CALL>APRS,WIDE1-1,WIDE2-2:test";
+    std::string str_pkt(raw);
+    packet from_cstr(raw);
+    packet from_string(str_pkt);
+    EXPECT_TRUE(from_cstr == from_string);
 
-    // N0CALL>APRS,CALL,DIGI*,WIDE1-1:data
-    //                  ~~~~~
-    //                  17 22 - Packet has already been routed.
+    // const char* ctor: full path
+    packet p7("A>B,C,D*,E,F:payload");
+    EXPECT_TRUE(p7.from == "A");
+    EXPECT_TRUE(p7.to == "B");
+    EXPECT_TRUE(p7.path.size() == 4);
+    EXPECT_TRUE(p7.path[0] == "C");
+    EXPECT_TRUE(p7.path[1] == "D*");
+    EXPECT_TRUE(p7.path[2] == "E");
+    EXPECT_TRUE(p7.path[3] == "F");
+    EXPECT_TRUE(p7.data == "payload");
 
-    p = { "N0CALL", "APRS", { "CALL", "DIGI*", "WIDE1-1" }, "data"};
-    packet_string = to_string(p);
+    // std::string ctor: no path
+    std::string no_path_str = "FROM>TO:data";
+    packet p8(no_path_str);
+    EXPECT_TRUE(p8.from == "FROM");
+    EXPECT_TRUE(p8.to == "TO");
+    EXPECT_TRUE(p8.path.empty());
+    EXPECT_TRUE(p8.data == "data");
 
-    try_route_packet(p, digi, result);
+    // std::string ctor: empty data
+    std::string empty_data_str = "A>B,C:";
+    packet p9(empty_data_str);
+    EXPECT_TRUE(p9.from == "A");
+    EXPECT_TRUE(p9.to == "B");
+    EXPECT_TRUE(p9.path.size() == 1);
+    EXPECT_TRUE(p9.path[0] == "C");
+    EXPECT_TRUE(p9.data == "");
+    EXPECT_TRUE(to_string(p9) == empty_data_str);
 
-    EXPECT_TRUE(result.actions.size() == 1);
+    // operator std::string conversion
+    packet p10("X>Y,Z:msg");
+    std::string converted = static_cast<std::string>(p10);
+    EXPECT_TRUE(converted == "X>Y,Z:msg");
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::warn);
-    EXPECT_TRUE(result.actions[0].start == 17);
-    EXPECT_TRUE(result.actions[0].end == 22);
-    EXPECT_TRUE(result.actions[0].index == 1);
+    // Invalid packet strings trigger assert (only in debug builds)
+#ifndef NDEBUG
+    // const char* ctor
+    EXPECT_DEATH(packet("invalid"), "");
 
-    action_address_str = packet_string.substr(result.actions[0].start, result.actions[0].end - result.actions[0].start);
+    // std::string ctor
+    EXPECT_DEATH(packet(std::string("also_invalid")), "");
 
-    EXPECT_TRUE(action_address_str == "DIGI*");
+    // Missing colon
+    EXPECT_DEATH(packet("N0CALL>APRS"), "");
+#endif
+#else
+    EXPECT_TRUE(true);
+#endif
+}
 
-    // N0CALL>APRS,A,B,C,D,E,F,G:data
-    //             ~
-    //           12 13 - Packet address replaced
-    //                   address = DIGI
-    //
-    // N0CALL>APRS,DIGI*,B,C,D,E,F,G:data
-    //             ~~~~
-    //             12 16 - Packet address marked as 'set'
+TEST(packet, format_packet_to)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    std::array<char, 256> buffer = {};
 
-    digi.explicit_addresses = { "A" };
-    digi.options = routing_option::substitute_explicit_address;
-    p = { "N0CALL", "APRS", { "A", "B", "C", "D", "E", "F", "G" }, "data"};
-    packet_string = to_string(p);
+    // Format a packet
 
-    try_route_packet(p, digi, result);
+    packet p = "N0CALL>APRS,CALLA,CALLB*,WIDE2-1:data";
 
-    EXPECT_TRUE(result.actions.size() == 2);
+    size_t size = format_packet_to(p, buffer.data(), buffer.size());
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
-    EXPECT_TRUE(result.actions[0].start == 12);
-    EXPECT_TRUE(result.actions[0].end == 13);
-    EXPECT_TRUE(result.actions[0].index == 0);
+    EXPECT_TRUE(size == to_string(p).size());
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,CALLA,CALLB*,WIDE2-1:data");
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::set);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 16);
-    EXPECT_TRUE(result.actions[1].index == 0);
+    // Buffer too small, nothing is written, and the required capacity is returned
 
-    // N0CALL>APRS,A,B,C*,D,E,F,G:data
-    //                    ~
-    //                    19 20 - Packet address 'D' replaced with address 'DIGI'
-    //
-    // N0CALL>APRS,A,B,C*,DIGI,E,F,G:data
-    //                 ~~
-    //                 16 18 - Packet address marked as 'unset'
-    //
-    // N0CALL>APRS,A,B,C,DIGI,E,F,G:data
-    //                   ~~~~
-    //                   18 22 - Packet address marked as 'set'
+    buffer.fill('X');
 
-    digi.explicit_addresses = { "D" };
-    digi.options = routing_option::substitute_explicit_address;
-    p = { "N0CALL", "APRS", { "A", "B", "C*", "D", "E", "F", "G" }, "data"};
-    packet_string = to_string(p);
+    EXPECT_TRUE(format_packet_to(p, buffer.data(), 10) == size);
+    EXPECT_TRUE(buffer[0] == 'X');
 
-    try_route_packet(p, digi, result);
+    EXPECT_TRUE(format_packet_to(p, nullptr, 0) == size);
 
-    EXPECT_TRUE(result.actions.size() == 3);
+    // Exact capacity
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
-    EXPECT_TRUE(result.actions[0].start == 19);
-    EXPECT_TRUE(result.actions[0].end == 20);
-    EXPECT_TRUE(result.actions[0].index == 3);
+    EXPECT_TRUE(format_packet_to(p, buffer.data(), size) == size);
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,CALLA,CALLB*,WIDE2-1:data");
+    EXPECT_TRUE(buffer[size] == 'X');
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "C");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::unset);
-    EXPECT_TRUE(result.actions[1].start == 16);
-    EXPECT_TRUE(result.actions[1].end == 18);
-    EXPECT_TRUE(result.actions[1].index == 2);
+    // Packet with no path
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::set);
-    EXPECT_TRUE(result.actions[2].start == 18);
-    EXPECT_TRUE(result.actions[2].end == 22);
-    EXPECT_TRUE(result.actions[2].index == 3);
+    p = "N0CALL>APRS:data";
 
-    // N0CALL>APRS,A,B,C,D,E,F,G:data
-    //             ~
-    //            12 13 - Packet address marked as 'set'
+    size = format_packet_to(p, buffer.data(), buffer.size());
 
-    digi.address = "A";
-    digi.explicit_addresses = {};
-    digi.options = routing_option::none;
-    p = { "N0CALL", "APRS", { "A", "B", "C", "D", "E", "F", "G" }, "data"};
-    packet_string = to_string(p);
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS:data");
 
-    try_route_packet(p, digi, result);
+    // Packet view
 
-    EXPECT_TRUE(result.actions.size() == 1);
+    packet_view pv;
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,WIDE1-1,WIDE2-2:data", pv));
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "A");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::set);
-    EXPECT_TRUE(result.actions[0].start == 12);
-    EXPECT_TRUE(result.actions[0].end == 13);
-    EXPECT_TRUE(result.actions[0].index == 0);
+    size = format_packet_to(pv, buffer.data(), buffer.size());
 
-    // N0CALL>APRS,AB,ABC,ABCD,ABCDE:data
-    //                         ~~~~~
-    //                         24 29 - Packet address removed
-    //
-    // N0CALL>APRS,ABCDE,AB,ABC,ABCD:data
-    //             ~~~~~
-    //             12 17 - Packet address inserted
-    //
-    // N0CALL>APRS,ABCDE,AB,ABC,ABCD:data
-    //             ~~~~~
-    //             12 17 - Packet address marked as 'set'
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,WIDE1-1,WIDE2-2:data");
 
-    digi.address = "ABCDE";
-    digi.explicit_addresses = {};
-    digi.options = routing_option::preempt_front;
-    p = { "N0CALL", "APRS", { "AB", "ABC", "ABCD", "ABCDE" }, "data"};
-    packet_string = to_string(p);
+    std::string packet_string;
+    format_packet_to(pv, std::back_inserter(packet_string));
 
-    try_route_packet(p, digi, result);
+    EXPECT_TRUE(packet_string == "N0CALL>APRS,WIDE1-1,WIDE2-2:data");
 
-    EXPECT_TRUE(result.actions.size() == 3);
+    // Routing result
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "ABCDE");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[0].start == 24);
-    EXPECT_TRUE(result.actions[0].end == 29);
-    EXPECT_TRUE(result.actions[0].index == 3);
+    router_settings settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false };
+    routing_result result;
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "ABCDE");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 17);
-    EXPECT_TRUE(result.actions[1].index == 0);
+    p = "N0CALL>APRS,WIDE1-1,WIDE2-2:data";
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "ABCDE");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::set);
-    EXPECT_TRUE(result.actions[2].start == 12);
-    EXPECT_TRUE(result.actions[2].end == 17);
-    EXPECT_TRUE(result.actions[2].index == 0);
+    EXPECT_TRUE(try_route_packet(p, settings, result));
 
-    // N0CALL>APRS,CALLA,CALLB:data
-    //                   ~~~~~
-    //                   18 23 - Packet address removed
-    //
-    // N0CALL>APRS,CALLB,CALLA:data
-    //             ~~~~~
-    //             12 17 - Packet address inserted
-    //
-    // N0CALL>APRS,DIGI,CALLB,CALLA:data
-    //             ~~~~
-    //             12 16 - Packet address inserted
-    //
-    // N0CALL>APRS,DIGI,CALLB*,CALLA:data
-    //                  ~~~~~
-    //                  17 22 - Packet address marked as 'set'
+    size = format_packet_to(result, buffer.data(), buffer.size());
 
-    digi.address = "DIGI";
-    digi.explicit_addresses = { "CALLB" };
-    digi.options = routing_option::preempt_front; // todo + substitute_explicit_address
-    p = { "N0CALL", "APRS", { "CALLA", "CALLB" }, "data"};
-    packet_string = to_string(p);
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,DIGI,WIDE1*,WIDE2-2:data");
 
-    try_route_packet(p, digi, result);
+    packet_string.clear();
+    format_packet_to(result, std::back_inserter(packet_string));
 
-    EXPECT_TRUE(result.actions.size() == 4);
+    EXPECT_TRUE(packet_string == to_string(result.routed_packet));
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "CALLB");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[0].start == 18);
-    EXPECT_TRUE(result.actions[0].end == 23);
-    EXPECT_TRUE(result.actions[0].index == 1);
+    // Route state
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "CALLB");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 17);
-    EXPECT_TRUE(result.actions[1].index == 0);
+    aprs::router::router digi(settings);
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[2].start == 12);
-    EXPECT_TRUE(result.actions[2].end == 16);
-    EXPECT_TRUE(result.actions[2].index == 0);
+    std::array<std::array<char, 10>, 8> routed_packet_path = {};
+    std::array<size_t, 8> routed_packet_path_address_sizes = {};
+    enum routing_state routing_state;
 
-    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "CALLB");
-    EXPECT_TRUE(result.actions[3].target == applies_to::path);
-    EXPECT_TRUE(result.actions[3].type == routing_action::set);
-    EXPECT_TRUE(result.actions[3].start == 17);
-    EXPECT_TRUE(result.actions[3].end == 22);
-    EXPECT_TRUE(result.actions[3].index == 1);
+    auto [routed_path_end, routed_sizes_end, routed] = try_route_packet(pv, routed_packet_path.begin(), routed_packet_path_address_sizes.begin(), routing_state, digi.state);
 
-    // N0CALL>APRS,CITYA*,CITYB,CITYC,CITYD,CITYE:data
-    //             ~~~~~~
-    //             12 18 - Packet address removed
-    //
-    // N0CALL>APRS,CITYB,CITYC,CITYD,CITYE:data
-    //             ~~~~~
-    //             12 17 - Packet address removed
-    //
-    // N0CALL>APRS,CITYC,CITYD,CITYE:data
-    //             ~~~~~
-    //             12 17 - Packet address removed
-    //
-    // N0CALL>APRS,CITYD,CITYE:data
-    //             ~~~~~
-    //             12 17 - Packet address marked as 'set'
+    (void)routed_path_end;
+    (void)routed_sizes_end;
 
-    digi.address = "CITYD";
-    digi.explicit_addresses = {};
-    digi.options = routing_option::preempt_drop;
-    p = { "N0CALL", "APRS", { "CITYA*", "CITYB", "CITYC", "CITYD", "CITYE" }, "data"};
-    packet_string = to_string(p);
+    EXPECT_TRUE(routed);
 
-    try_route_packet(p, digi, result);
+    size = format_packet_to(digi.state, pv.data, buffer.data(), buffer.size());
 
-    EXPECT_TRUE(result.actions.size() == 4);
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,DIGI,WIDE1*,WIDE2-2:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "CITYA");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[0].start == 12);
-    EXPECT_TRUE(result.actions[0].end == 18);
-    EXPECT_TRUE(result.actions[0].index == 0);
+TEST(packet_view, try_route_packet_segments)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false });
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "CITYB");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 17);
-    EXPECT_TRUE(result.actions[1].index == 0);
+    std::string packet_string = "N0CALL>APRS,WIDE1-1,WIDE2-2:data with some payload";
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "CITYC");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[2].start == 12);
-    EXPECT_TRUE(result.actions[2].end == 17);
-    EXPECT_TRUE(result.actions[2].index == 0);
+    packet_view pv;
+    EXPECT_TRUE(try_decode_packet(packet_string, pv));
 
-    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "CITYD");
-    EXPECT_TRUE(result.actions[3].target == applies_to::path);
-    EXPECT_TRUE(result.actions[3].type == routing_action::set);
-    EXPECT_TRUE(result.actions[3].start == 12);
-    EXPECT_TRUE(result.actions[3].end == 17);
-    EXPECT_TRUE(result.actions[3].index == 0);
+    routed_packet_segments segments;
+    enum routing_state routing_state;
 
-    // N0CALL>APRS,CALLA*,CALLB*,WIDE2-3:data
-    //                           ~~~~~~~
-    //                           26 33 - Packet address replaced
-    //
-    // N0CALL>APRS,CALLA*,CALLB*,WIDE2-3:data
-    //             ~~~~~~
-    //             12 18 - Packet address marked as 'unset'
-    //
-    // N0CALL>APRS,CALLA,CALLB*,WIDE2-3:data
-    //                   ~~~~~~
-    //                   18 24 - Packet address marked as 'unset'
-    //
-    // N0CALL>APRS,CALLA,CALLB,DIGI:data
-    //                         ~~~~
-    //                         24 28 - Packet address marked as 'set'
+    EXPECT_TRUE(try_route_packet(pv, segments, routing_state, digi.state));
+    EXPECT_TRUE(routing_state == routing_state::routed);
 
-    digi.address = "DIGI";
-    digi.n_N_addresses = { "WIDE2-2" };
-    digi.options = routing_option::trap_limit_exceeding_n_N_address;
-    p = { "N0CALL", "APRS", { "CALLA*", "CALLB*", "WIDE2-3" }, "data"};
-    packet_string = to_string(p);
+    EXPECT_TRUE(segments.header_view() == "N0CALL>APRS,DIGI,WIDE1*,WIDE2-2:");
+    EXPECT_TRUE(segments.data == "data with some payload");
 
-    try_route_packet(p, digi, result);
+    // The data segment is a view into the original packet string
 
-    EXPECT_TRUE(result.actions.size() == 4);
+    EXPECT_TRUE(segments.data.data() == packet_string.data() + packet_string.find(':') + 1);
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
-    EXPECT_TRUE(result.actions[0].start == 26);
-    EXPECT_TRUE(result.actions[0].end == 33);
-    EXPECT_TRUE(result.actions[0].index == 2);
+    // The segments form the routed packet
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "CALLA");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::unset);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 18);
-    EXPECT_TRUE(result.actions[1].index == 0);
+    std::string routed_packet_string;
+    for (const auto& segment : segments.segments())
+    {
+        routed_packet_string.append(segment);
+    }
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "CALLB");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::unset);
-    EXPECT_TRUE(result.actions[2].start == 18);
-    EXPECT_TRUE(result.actions[2].end == 24);
-    EXPECT_TRUE(result.actions[2].index == 1);
+    EXPECT_TRUE(routed_packet_string == "N0CALL>APRS,DIGI,WIDE1*,WIDE2-2:data with some payload");
+    EXPECT_TRUE(segments.size() == routed_packet_string.size());
 
-    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[3].target == applies_to::path);
-    EXPECT_TRUE(result.actions[3].type == routing_action::set);
-    EXPECT_TRUE(result.actions[3].start == 24);
-    EXPECT_TRUE(result.actions[3].end == 28);
-    EXPECT_TRUE(result.actions[3].index == 2);
+    routing_result result;
+    EXPECT_TRUE(try_route_packet(packet(packet_string), digi, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == routed_packet_string);
 
-    // N0CALL>APRS,WIDE1-2:data
-    //             ~~~~~~~
-    //             12 19 - Packet address decremented
-    //
-    // N0CALL>APRS,DIGI,WIDE1-1:data
-    //             ~~~~
-    //             12 16 - Packet address inserted
-    //
-    // N0CALL>APRS,DIGI,WIDE1-1:data
-    //             ~~~~
-    //             12 16 - Packet address marked as 'set'
+    // Packets that are not routed do not produce segments
 
-    digi.address = "DIGI";
-    digi.n_N_addresses = { "WIDE1", "WIDE2" };
-    digi.options = routing_option::none;
-    p = { "N0CALL", "APRS", { "WIDE1-2" }, "data"};
-    packet_string = to_string(p);
+    EXPECT_TRUE(try_decode_packet("N0CALL>APRS,CALLA,CALLB:data", pv));
+    EXPECT_FALSE(try_route_packet(pv, segments, routing_state, digi.state));
+    EXPECT_TRUE(routing_state == routing_state::not_routed);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
 
-    try_route_packet(p, digi, result);
+TEST(packet, equality)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Test: Equal packets
+    packet p1{"N0CALL", "APRS", {"CALLA", "CALLB"}, "data"};
+    packet p2{"N0CALL", "APRS", {"CALLA", "CALLB"}, "data"};
+    EXPECT_TRUE(p1 == p2);
 
-    EXPECT_TRUE(result.actions.size() == 3);
+    // Test: Different 'from' field
+    packet p3{"OTHER", "APRS", {"CALLA", "CALLB"}, "data"};
+    EXPECT_FALSE(p1 == p3);
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE1-1");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
-    EXPECT_TRUE(result.actions[0].start == 12);
-    EXPECT_TRUE(result.actions[0].end == 19);
-    EXPECT_TRUE(result.actions[0].index == 0);
+    // Test: Different 'to' field
+    packet p4{"N0CALL", "OTHER", {"CALLA", "CALLB"}, "data"};
+    EXPECT_FALSE(p1 == p4);
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[1].start == 12);
-    EXPECT_TRUE(result.actions[1].end == 16);
-    EXPECT_TRUE(result.actions[1].index == 0);
+    // Test: Different path size
+    packet p5{"N0CALL", "APRS", {"CALLA"}, "data"};
+    EXPECT_FALSE(p1 == p5);
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::set);
-    EXPECT_TRUE(result.actions[2].start == 12);
-    EXPECT_TRUE(result.actions[2].end == 16);
-    EXPECT_TRUE(result.actions[2].index == 0);
+    // Test: Different path contents
+    packet p6{"N0CALL", "APRS", {"CALLA", "CALLC"}, "data"};
+    EXPECT_FALSE(p1 == p6);
 
-    // N0CALL>APRS,CALL,WIDE1*,WIDE2-2:data
-    //                         ~~~~~~~
-    //                         24 31 - Packet address decremented
-    //
-    // N0CALL>APRS,CALL,WIDE1,DIGI,WIDE2-2:data
-    //                        ~~~~
-    //                        24 28 - Packet address inserted
-    //
-    // N0CALL>APRS,CALL,WIDE1*,WIDE2-2:data
-    //                  ~~~~~~
-    //                  17 23 - Packet address marked as 'unset'
+    // Test: Different data
+    packet p7{"N0CALL", "APRS", {"CALLA", "CALLB"}, "other_data"};
+    EXPECT_FALSE(p1 == p7);
+
+    // Test: All fields empty
+    packet p8{"", "", {}, ""};
+    packet p9{"", "", {}, ""};
+    EXPECT_TRUE(p8 == p9);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_no_packet)
+{
+    struct router_settings router_settings = { "DIGI", {}, { "WIDE1" }, routing_option::none, false };
+    std::vector<std::string> routed_path;
+    enum routing_state routing_state = routing_state::not_routed;
+    std::vector<routing_diagnostic> routing_options;
+    try_route_packet("CALL", "APRS", { "WIDE1-1" }, router_settings, routed_path, routing_state, routing_options);
+    EXPECT_TRUE(routing_state == routing_state::routed);
+    EXPECT_TRUE(routed_path.size() == 2);
+    EXPECT_TRUE(routed_path[0] == "DIGI");
+    EXPECT_TRUE(routed_path[1] == "WIDE1*");
+}
+
+TEST(router, try_route_packet_explicit_loop)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    routing_result result;
+    router_settings digi;
+
+    // -------------------------------------------------------------
+    // Routing a packet through multiple routers
     //
-    // N0CALL>APRS,CALL,WIDE1,DIGI,WIDE2-2:data
-    //                        ~~~~
-    //                        23 27 - Packet address marked as 'set'
+    // Input:  N0CALL>APRS,DIGIA,DIGIB,DIGIC,DIGID,DIGIE,DIGIF,DIGIG,DIGIH:data
+    // Output: N0CALL>APRS,DIGIA,DIGIB,DIGIC,DIGID,DIGIE,DIGIF,DIGIG,DIGIH*:data
+    // -------------------------------------------------------------
 
-    digi.address = "DIGI";
-    digi.n_N_addresses = { "WIDE2", "WIDE1" };
-    digi.options = routing_option::none;
-    p = { "N0CALL", "APRS", { "CALL", "WIDE1*", "WIDE2-2" }, "data"};
-    packet_string = to_string(p);
+    digi.explicit_addresses = {};
+    digi.n_N_addresses = {};
 
-    try_route_packet(p, digi, result);
+    packet p = {"N0CALL", "APRS", {"DIGIA","DIGIB","DIGIC","DIGID","DIGIE","DIGIF","DIGIG","DIGIH"}, "data"};
+    result.routed_packet = p;
 
-    EXPECT_TRUE(result.actions.size() == 4);
+    std::vector<size_t> digipeated_indices = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    result = test_packet_routing_iteration(p, digi, p.path, digipeated_indices, 8);
+
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGIA,DIGIB,DIGIC,DIGID,DIGIE,DIGIF,DIGIG,DIGIH*:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_n_N_loop)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    routing_result result;
+    router_settings digi;
+
+    // -------------------------------------------------------------
+    // Routing a packet through multiple N-hops and multiple routers
+    //
+    // Input:  N0CALL>APRS,WIDE1-2,CALL,WIDE2-2,ROUTE,WIDE3-2:data
+    // Output: N0CALL>APRS,DIGI1,DIGI2,CALL,DIGI3,DIGI4,ROUTE,DIGI5,DIGI6*:data
+    // -------------------------------------------------------------
+
+    digi.n_N_addresses = {"WIDE1", "WIDE2", "WIDE3"};
+    digi.options = routing_option::substitute_complete_n_N_address;
+
+    packet p = {"N0CALL", "APRS", {"WIDE1-2", "WIDE2-2", "WIDE3-2"}, "data"};
+    result.routed_packet = p;
+
+    std::vector<size_t> digipeated_indices = { 0, 1, 2, 3, 4, 5 };
+    std::vector<std::string> digipeater_addresses = {"DIGI1","DIGI2","DIGI3","DIGI4","DIGI5","DIGI6"};
+
+    result = test_packet_routing_iteration(p, digi, digipeater_addresses, digipeated_indices, 6);
+
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI1,DIGI2,DIGI3,DIGI4,DIGI5,DIGI6*:data");
+
+    // -------------------------------------------------------------
+    // Routing a packet through multiple N-hops and multiple routers
+    //
+    // Input:  N0CALL>APRS,WIDE1-1,WIDE2-7:data
+    // Output: N0CALL>APRS,DIGI1,DIGI2,CALL,DIGI3,DIGI4,ROUTE,DIGI5,DIGI6*:data
+    // -------------------------------------------------------------
+
+    digi.n_N_addresses = {"WIDE1","WIDE2"};
+    digi.options = routing_option::substitute_complete_n_N_address;
+
+    p = {"N0CALL", "APRS", {"WIDE1-1", "WIDE2-7"}, "data"};
+    result.routed_packet = p;
+
+    digipeated_indices = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    digipeater_addresses = {"DIGI1","DIGI2","DIGI3","DIGI4","DIGI5","DIGI6","DIGI7","DIGI8"};
+
+    result = test_packet_routing_iteration(p, digi, digipeater_addresses, digipeated_indices, 8);
+
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI1,DIGI2,DIGI3,DIGI4,DIGI5,DIGI6,DIGI7,DIGI8*:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(routing_option, enum_has_flag)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    routing_option op = routing_option::preempt_front | routing_option::substitute_complete_n_N_address;
+
+    EXPECT_TRUE(enum_has_flag(op, routing_option::preempt_front));
+    EXPECT_TRUE(enum_has_flag(op, routing_option::substitute_complete_n_N_address));
+    EXPECT_TRUE(enum_has_flag(op, routing_option::route_self) == false);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, simple_demo)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi { "DIGI", {}, { "WIDE1" }, routing_option::none, false };
+    routing_result result;
+
+    packet p = { "N0CALL", "APRS", { "WIDE1-3" }, "data" }; // N0CALL>APRS,WIDE1-3:data
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.state == routing_state::routed);
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE1-2:data"); // N0CALL>APRS,DIGI*,WIDE1-2:data
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, preempt_front_with_explicit_ssid_diag)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI2-3", {}, {}, routing_option::preempt_front, true };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data";
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI2-3*,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2:data");
+
+    // N0CALL>APRS,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data
+    //                                                     ~~~~~~~
+    //                                                     52   59 - Packet address removed.
+    //
+    // N0CALL>APRS,DIGI1-1,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data
+    //             ~~~~~~~
+    //             12   29 - Packet address inserted.
+    //
+    // N0CALL>APRS,DIGI1-1*,DIGI1-2,DIGI1-3,DIGI2-1,DIGI2-2,DIGI2-3:data
+    //             ~~~~~~~
+    //             12   29 - Packet address 'set'.
+
+    EXPECT_TRUE(result.actions.size() == 3);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI2-3");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[0].start == 52);
+    EXPECT_TRUE(result.actions[0].end == 59);
+    EXPECT_TRUE(result.actions[0].index == 5);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI2-3");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 19);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI2-3");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::set);
+    EXPECT_TRUE(result.actions[2].start == 12);
+    EXPECT_TRUE(result.actions[2].end == 19);
+    EXPECT_TRUE(result.actions[2].index == 0);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_n_N_address_as_explicit)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI", { "WIDE1" }, {}, routing_option::none, true };
+    routing_result result;
+
+    packet p = { "N0CALL", "APRS", { "WIDE1-3" }, "data" }; // N0CALL>APRS,WIDE1-3:data
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.state == routing_state::not_routed);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, routing_n_N_with_addresses_in_front)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI", {}, { "WIDE2-2" }, routing_option::none, true };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,CALL,WIDE2-1:data";
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.state == routing_state::not_routed);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, placeholder_test)
+{
+    router_settings digi{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, true };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,WIDE1,WIDE2-2:data";
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.state == routing_state::routed);
+}
+
+TEST(router, router_address_and_path_dual_matching)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "ROUTER", { "DIGI" }, {}, routing_option::none, true };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,DIGI,ROUTER:data";
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,ROUTER,DIGI*,ROUTER:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, substitute_explicit_address_with_ssid_diagnostic)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI-7", { "DIGI" }, {}, routing_option::substitute_explicit_address, true };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,DIGI-7:data";
+
+    try_route_packet(p, digi, result);
+
+    // N0CALL>APRS,DIGI-7:data
+    //             ~~~~~~
+    //             12  18 - Packet has already been routed.
+    //
+    // N0CALL>APRS,DIGI-7*:data
+    //             ~~~~~~
+    //             12  18 - Packet address marked as 'set'
+
+    EXPECT_TRUE(result.actions.size() == 2);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI-7");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
+    EXPECT_TRUE(result.actions[0].start == 12);
+    EXPECT_TRUE(result.actions[0].end == 18);
+    EXPECT_TRUE(result.actions[0].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI-7");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::set);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 18);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(result.state == routing_state::routed);
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI-7*:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_long_path_with_substitute)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI2", {},  { "WIDE1", "WIDE2", "WIDE3" }, routing_option::substitute_complete_n_N_address, false };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,DIGI1*,WIDE1-1,CALL,WIDE2-2,ROUTE,WIDE3-2:data";
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.state == routing_state::routed);
+    //EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE1-2:data"); // N0CALL>APRS,DIGI*,WIDE1-2:data
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_enable_diagnostics)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI", {},  { "WIDE1" }, routing_option::none, true };
+    routing_result result;
+
+    // N0CALL>APRS,CALL,WIDE1,DIGI*:data
+    //                        ~~~~~
+    //                        23 28 - Packet has finished routing.
+
+    packet p = { "N0CALL", "APRS", { "CALL", "WIDE1", "DIGI*" }, "data"};
+    std::string packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 1);
+
+    const routing_diagnostic& diag = result.actions[0];
+
+    EXPECT_TRUE(std::string_view(diag.address.data(), diag.address_size) == "DIGI");
+    EXPECT_TRUE(diag.target == applies_to::path);
+    EXPECT_TRUE(diag.type == routing_action::warn);
+    EXPECT_TRUE(diag.start == 23);
+    EXPECT_TRUE(diag.end == 28);
+    EXPECT_TRUE(diag.index == 2);
+
+    std::string action_address_str = packet_string.substr(result.actions[0].start, result.actions[0].end - result.actions[0].start);
+
+    EXPECT_TRUE(action_address_str == "DIGI*");
+
+    // N0CALL>APRS,CALL,DIGI*,WIDE1-1:data
+    //                  ~~~~~
+    //                  17 22 - Packet has already been routed.
+
+    p = { "N0CALL", "APRS", { "CALL", "DIGI*", "WIDE1-1" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::warn);
+    EXPECT_TRUE(result.actions[0].start == 17);
+    EXPECT_TRUE(result.actions[0].end == 22);
+    EXPECT_TRUE(result.actions[0].index == 1);
+
+    action_address_str = packet_string.substr(result.actions[0].start, result.actions[0].end - result.actions[0].start);
+
+    EXPECT_TRUE(action_address_str == "DIGI*");
+
+    // N0CALL>APRS,A,B,C,D,E,F,G:data
+    //             ~
+    //           12 13 - Packet address replaced
+    //                   address = DIGI
+    //
+    // N0CALL>APRS,DIGI*,B,C,D,E,F,G:data
+    //             ~~~~
+    //             12 16 - Packet address marked as 'set'
+
+    digi.explicit_addresses = { "A" };
+    digi.options = routing_option::substitute_explicit_address;
+    p = { "N0CALL", "APRS", { "A", "B", "C", "D", "E", "F", "G" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 2);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
+    EXPECT_TRUE(result.actions[0].start == 12);
+    EXPECT_TRUE(result.actions[0].end == 13);
+    EXPECT_TRUE(result.actions[0].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::set);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 16);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    // N0CALL>APRS,A,B,C*,D,E,F,G:data
+    //                    ~
+    //                    19 20 - Packet address 'D' replaced with address 'DIGI'
+    //
+    // N0CALL>APRS,A,B,C*,DIGI,E,F,G:data
+    //                 ~~
+    //                 16 18 - Packet address marked as 'unset'
+    //
+    // N0CALL>APRS,A,B,C,DIGI,E,F,G:data
+    //                   ~~~~
+    //                   18 22 - Packet address marked as 'set'
+
+    digi.explicit_addresses = { "D" };
+    digi.options = routing_option::substitute_explicit_address;
+    p = { "N0CALL", "APRS", { "A", "B", "C*", "D", "E", "F", "G" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 3);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
+    EXPECT_TRUE(result.actions[0].start == 19);
+    EXPECT_TRUE(result.actions[0].end == 20);
+    EXPECT_TRUE(result.actions[0].index == 3);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "C");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::unset);
+    EXPECT_TRUE(result.actions[1].start == 16);
+    EXPECT_TRUE(result.actions[1].end == 18);
+    EXPECT_TRUE(result.actions[1].index == 2);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::set);
+    EXPECT_TRUE(result.actions[2].start == 18);
+    EXPECT_TRUE(result.actions[2].end == 22);
+    EXPECT_TRUE(result.actions[2].index == 3);
+
+    // N0CALL>APRS,A,B,C,D,E,F,G:data
+    //             ~
+    //            12 13 - Packet address marked as 'set'
+
+    digi.address = "A";
+    digi.explicit_addresses = {};
+    digi.options = routing_option::none;
+    p = { "N0CALL", "APRS", { "A", "B", "C", "D", "E", "F", "G" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "A");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::set);
+    EXPECT_TRUE(result.actions[0].start == 12);
+    EXPECT_TRUE(result.actions[0].end == 13);
+    EXPECT_TRUE(result.actions[0].index == 0);
+
+    // N0CALL>APRS,AB,ABC,ABCD,ABCDE:data
+    //                         ~~~~~
+    //                         24 29 - Packet address removed
+    //
+    // N0CALL>APRS,ABCDE,AB,ABC,ABCD:data
+    //             ~~~~~
+    //             12 17 - Packet address inserted
+    //
+    // N0CALL>APRS,ABCDE,AB,ABC,ABCD:data
+    //             ~~~~~
+    //             12 17 - Packet address marked as 'set'
+
+    digi.address = "ABCDE";
+    digi.explicit_addresses = {};
+    digi.options = routing_option::preempt_front;
+    p = { "N0CALL", "APRS", { "AB", "ABC", "ABCD", "ABCDE" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 3);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "ABCDE");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[0].start == 24);
+    EXPECT_TRUE(result.actions[0].end == 29);
+    EXPECT_TRUE(result.actions[0].index == 3);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "ABCDE");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 17);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "ABCDE");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::set);
+    EXPECT_TRUE(result.actions[2].start == 12);
+    EXPECT_TRUE(result.actions[2].end == 17);
+    EXPECT_TRUE(result.actions[2].index == 0);
+
+    // N0CALL>APRS,CALLA,CALLB:data
+    //                   ~~~~~
+    //                   18 23 - Packet address removed
+    //
+    // N0CALL>APRS,CALLB,CALLA:data
+    //             ~~~~~
+    //             12 17 - Packet address inserted
+    //
+    // N0CALL>APRS,DIGI,CALLB,CALLA:data
+    //             ~~~~
+    //             12 16 - Packet address inserted
+    //
+    // N0CALL>APRS,DIGI,CALLB*,CALLA:data
+    //                  ~~~~~
+    //                  17 22 - Packet address marked as 'set'
+
+    digi.address = "DIGI";
+    digi.explicit_addresses = { "CALLB" };
+    digi.options = routing_option::preempt_front; // todo + substitute_explicit_address
+    p = { "N0CALL", "APRS", { "CALLA", "CALLB" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 4);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "CALLB");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[0].start == 18);
+    EXPECT_TRUE(result.actions[0].end == 23);
+    EXPECT_TRUE(result.actions[0].index == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "CALLB");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 17);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[2].start == 12);
+    EXPECT_TRUE(result.actions[2].end == 16);
+    EXPECT_TRUE(result.actions[2].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "CALLB");
+    EXPECT_TRUE(result.actions[3].target == applies_to::path);
+    EXPECT_TRUE(result.actions[3].type == routing_action::set);
+    EXPECT_TRUE(result.actions[3].start == 17);
+    EXPECT_TRUE(result.actions[3].end == 22);
+    EXPECT_TRUE(result.actions[3].index == 1);
+
+    // N0CALL>APRS,CITYA*,CITYB,CITYC,CITYD,CITYE:data
+    //             ~~~~~~
+    //             12 18 - Packet address removed
+    //
+    // N0CALL>APRS,CITYB,CITYC,CITYD,CITYE:data
+    //             ~~~~~
+    //             12 17 - Packet address removed
+    //
+    // N0CALL>APRS,CITYC,CITYD,CITYE:data
+    //             ~~~~~
+    //             12 17 - Packet address removed
+    //
+    // N0CALL>APRS,CITYD,CITYE:data
+    //             ~~~~~
+    //             12 17 - Packet address marked as 'set'
+
+    digi.address = "CITYD";
+    digi.explicit_addresses = {};
+    digi.options = routing_option::preempt_drop;
+    p = { "N0CALL", "APRS", { "CITYA*", "CITYB", "CITYC", "CITYD", "CITYE" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 4);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "CITYA");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[0].start == 12);
+    EXPECT_TRUE(result.actions[0].end == 18);
+    EXPECT_TRUE(result.actions[0].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "CITYB");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 17);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "CITYC");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[2].start == 12);
+    EXPECT_TRUE(result.actions[2].end == 17);
+    EXPECT_TRUE(result.actions[2].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "CITYD");
+    EXPECT_TRUE(result.actions[3].target == applies_to::path);
+    EXPECT_TRUE(result.actions[3].type == routing_action::set);
+    EXPECT_TRUE(result.actions[3].start == 12);
+    EXPECT_TRUE(result.actions[3].end == 17);
+    EXPECT_TRUE(result.actions[3].index == 0);
+
+    // N0CALL>APRS,CALLA*,CALLB*,WIDE2-3:data
+    //                           ~~~~~~~
+    //                           26 33 - Packet address replaced
+    //
+    // N0CALL>APRS,CALLA*,CALLB*,WIDE2-3:data
+    //             ~~~~~~
+    //             12 18 - Packet address marked as 'unset'
+    //
+    // N0CALL>APRS,CALLA,CALLB*,WIDE2-3:data
+    //                   ~~~~~~
+    //                   18 24 - Packet address marked as 'unset'
+    //
+    // N0CALL>APRS,CALLA,CALLB,DIGI:data
+    //                         ~~~~
+    //                         24 28 - Packet address marked as 'set'
+
+    digi.address = "DIGI";
+    digi.n_N_addresses = { "WIDE2-2" };
+    digi.options = routing_option::trap_limit_exceeding_n_N_address;
+    p = { "N0CALL", "APRS", { "CALLA*", "CALLB*", "WIDE2-3" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 4);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::replace);
+    EXPECT_TRUE(result.actions[0].start == 26);
+    EXPECT_TRUE(result.actions[0].end == 33);
+    EXPECT_TRUE(result.actions[0].index == 2);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "CALLA");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::unset);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 18);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "CALLB");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::unset);
+    EXPECT_TRUE(result.actions[2].start == 18);
+    EXPECT_TRUE(result.actions[2].end == 24);
+    EXPECT_TRUE(result.actions[2].index == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[3].target == applies_to::path);
+    EXPECT_TRUE(result.actions[3].type == routing_action::set);
+    EXPECT_TRUE(result.actions[3].start == 24);
+    EXPECT_TRUE(result.actions[3].end == 28);
+    EXPECT_TRUE(result.actions[3].index == 2);
+
+    // N0CALL>APRS,WIDE1-2:data
+    //             ~~~~~~~
+    //             12 19 - Packet address decremented
+    //
+    // N0CALL>APRS,DIGI,WIDE1-1:data
+    //             ~~~~
+    //             12 16 - Packet address inserted
+    //
+    // N0CALL>APRS,DIGI,WIDE1-1:data
+    //             ~~~~
+    //             12 16 - Packet address marked as 'set'
+
+    digi.address = "DIGI";
+    digi.n_N_addresses = { "WIDE1", "WIDE2" };
+    digi.options = routing_option::none;
+    p = { "N0CALL", "APRS", { "WIDE1-2" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 3);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE1-1");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
+    EXPECT_TRUE(result.actions[0].start == 12);
+    EXPECT_TRUE(result.actions[0].end == 19);
+    EXPECT_TRUE(result.actions[0].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[1].start == 12);
+    EXPECT_TRUE(result.actions[1].end == 16);
+    EXPECT_TRUE(result.actions[1].index == 0);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::set);
+    EXPECT_TRUE(result.actions[2].start == 12);
+    EXPECT_TRUE(result.actions[2].end == 16);
+    EXPECT_TRUE(result.actions[2].index == 0);
+
+    // N0CALL>APRS,CALL,WIDE1*,WIDE2-2:data
+    //                         ~~~~~~~
+    //                         24 31 - Packet address decremented
+    //
+    // N0CALL>APRS,CALL,WIDE1,DIGI,WIDE2-2:data
+    //                        ~~~~
+    //                        24 28 - Packet address inserted
+    //
+    // N0CALL>APRS,CALL,WIDE1*,WIDE2-2:data
+    //                  ~~~~~~
+    //                  17 23 - Packet address marked as 'unset'
+    //
+    // N0CALL>APRS,CALL,WIDE1,DIGI,WIDE2-2:data
+    //                        ~~~~
+    //                        23 27 - Packet address marked as 'set'
+
+    digi.address = "DIGI";
+    digi.n_N_addresses = { "WIDE2", "WIDE1" };
+    digi.options = routing_option::none;
+    p = { "N0CALL", "APRS", { "CALL", "WIDE1*", "WIDE2-2" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 4);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE2-1");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
+    EXPECT_TRUE(result.actions[0].start == 24);
+    EXPECT_TRUE(result.actions[0].end == 31);
+    EXPECT_TRUE(result.actions[0].index == 2);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[1].start == 24);
+    EXPECT_TRUE(result.actions[1].end == 28);
+    EXPECT_TRUE(result.actions[1].index == 2);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "WIDE1");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::unset);
+    EXPECT_TRUE(result.actions[2].start == 17);
+    EXPECT_TRUE(result.actions[2].end == 23);
+    EXPECT_TRUE(result.actions[2].index == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[3].target == applies_to::path);
+    EXPECT_TRUE(result.actions[3].type == routing_action::set);
+    EXPECT_TRUE(result.actions[3].start == 23);
+    EXPECT_TRUE(result.actions[3].end == 27);
+    EXPECT_TRUE(result.actions[3].index == 2);
+
+    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6*,WIDE3-3:data
+    //                                                  ~~~~~~~
+    //                                                  49 56 - Packet address decremented
+    //
+    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6,DIGI,WIDE3-3:data
+    //                                                 ~~~~
+    //                                                 49 53 - Packet address inserted
+    //
+    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6*,WIDE3-3:data
+    //                                           ~~~~~~
+    //                                           42 48 - Packet address marked as 'unset'
+    //
+    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6,DIGI,WIDE3-3:data
+    //                                                 ~~~~
+    //                                                 48 52 - Packet address marked as 'set'
+
+    digi.address = "DIGI";
+    digi.n_N_addresses = { "WIDE3" };
+    digi.options = routing_option::none;
+    p = { "N0CALL", "APRS", { "CALL1", "CALL2", "CALL3", "CALL4", "CALL5", "CALL6*", "WIDE3-3" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 4);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE3-2");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
+    EXPECT_TRUE(result.actions[0].start == 49);
+    EXPECT_TRUE(result.actions[0].end == 56);
+    EXPECT_TRUE(result.actions[0].index == 6);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
+    EXPECT_TRUE(result.actions[1].start == 49);
+    EXPECT_TRUE(result.actions[1].end == 53);
+    EXPECT_TRUE(result.actions[1].index == 6);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "CALL6");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::unset);
+    EXPECT_TRUE(result.actions[2].start == 42);
+    EXPECT_TRUE(result.actions[2].end == 48);
+    EXPECT_TRUE(result.actions[2].index == 5);
+
+    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[3].target == applies_to::path);
+    EXPECT_TRUE(result.actions[3].type == routing_action::set);
+    EXPECT_TRUE(result.actions[3].start == 48);
+    EXPECT_TRUE(result.actions[3].end == 52);
+    EXPECT_TRUE(result.actions[3].index == 6);
+
+    // N0CALL>APRS,,WIDE1-1:data
+    //              ~~~~~~~
+    //              13 20 - Packet address decremented
+    //
+    // N0CALL>APRS,,WIDE1:data
+    //              ~~~~~
+    //              13 18 - Packet address replaced
+    //
+    // N0CALL>APRS,,DIGI:data
+    //              ~~~~
+    //              13 17 - Packet address marked as 'set'
+    //
+    // N0CALL>APRS,,DIGI*:data
+    //             ~
+    //             12 12 - Packet address removed
+
+    digi.address = "DIGI";
+    digi.n_N_addresses = { "WIDE1" };
+    digi.options = routing_option::substitute_complete_n_N_address;
+    p = { "N0CALL", "APRS", { "", "WIDE1-1" }, "data"};
+    packet_string = to_string(p);
+
+    try_route_packet(p, digi, result);
+
+    EXPECT_TRUE(result.actions.size() == 4);
+
+    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE1");
+    EXPECT_TRUE(result.actions[0].target == applies_to::path);
+    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
+    EXPECT_TRUE(result.actions[0].start == 13);
+    EXPECT_TRUE(result.actions[0].end == 20);
+    EXPECT_TRUE(result.actions[0].index == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[1].target == applies_to::path);
+    EXPECT_TRUE(result.actions[1].type == routing_action::replace);
+    EXPECT_TRUE(result.actions[1].start == 13);
+    EXPECT_TRUE(result.actions[1].end == 18);
+    EXPECT_TRUE(result.actions[1].index == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
+    EXPECT_TRUE(result.actions[2].target == applies_to::path);
+    EXPECT_TRUE(result.actions[2].type == routing_action::set);
+    EXPECT_TRUE(result.actions[2].start == 13);
+    EXPECT_TRUE(result.actions[2].end == 17);
+    EXPECT_TRUE(result.actions[2].index == 1);
+
+    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "");
+    EXPECT_TRUE(result.actions[3].target == applies_to::path);
+    EXPECT_TRUE(result.actions[3].type == routing_action::remove);
+    EXPECT_TRUE(result.actions[3].start == 12);
+    EXPECT_TRUE(result.actions[3].end == 12);
+    EXPECT_TRUE(result.actions[3].index == 0);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_color_diagnostics)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings digi{ "DIGI", {},  { "WIDE1", "WIDE2" }, routing_option::none, true };
+    routing_result result;
+
+    packet p = { "N0CALL", "APRS", { "WIDE1-2" }, "data"};
+
+    try_route_packet(p, digi, result);
+
+    std::string diag_string = to_string(result);
+
+    std::cout << diag_string << std::endl;
+
+    routing_diagnostic_display diag_lines = format(result);
+
+    for (auto& l : diag_lines.entries)
+    {
+        l.message[0] = static_cast<char>(std::tolower(l.message[0]));
+
+        fmt::print(fg(fmt::color::blue_violet), "note: ");
+        fmt::print("{}\n", l.message);
+        fmt::print(fg(fmt::color::gray), "{:4}{}\n", "", l.packet_string);
+        fmt::print(fg(fmt::color::lime_green), "{:4}{}\n", "", l.highlight_string);
+    }
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_flat_api)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    std::vector<std::string> packet_path = { "WIDE1-1", "WIDE2-1" };
+    aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, true };
+
+    std::vector<std::string> routed_path;
+    aprs::router::routing_state routing_state;
+    std::vector<routing_diagnostic> routing_actions;
+
+    EXPECT_TRUE(aprs::router::try_route_packet("W7ION-5", "T7SVVQ", packet_path, settings, routed_path, routing_state, routing_actions));
+
+    EXPECT_TRUE(routed_path == (std::vector<std::string>{ "DIGI", "WIDE1*", "WIDE2-1" }));
+
+    EXPECT_TRUE(routing_state == aprs::router::routing_state::routed);
+
+    EXPECT_TRUE(routing_actions.size() == 3);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_flat_api_with_iterators)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    std::vector<std::string> packet_path = { "WIDE1-1", "WIDE2-1" };
+    aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, true };
+
+    std::vector<std::string> routed_path;
+    aprs::router::routing_state routing_state;
+    std::vector<routing_diagnostic> routing_actions;
+
+    auto [routed_packet_path_out, routing_actions_out, result] = aprs::router::try_route_packet("W7ION-5", "T7SVVQ", packet_path.begin(), packet_path.end(), settings, std::back_inserter(routed_path), routing_state, std::back_inserter(routing_actions));
+
+    EXPECT_TRUE(result);
+
+    EXPECT_TRUE(routed_path == (std::vector<std::string>{ "DIGI", "WIDE1*", "WIDE2-1" }));
+
+    EXPECT_TRUE(routing_state == aprs::router::routing_state::routed);
+
+    EXPECT_TRUE(routing_actions.size() == 3);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, router_object)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings settings{ "DIGI", { "CALLA" }, { "WIDE1", "WIDE2" }, routing_option::none, true };
+
+    aprs::router::router digi(settings);
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-3" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "WIDE1*", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "CALLB", "CALLC" }, "data" },
+        { "DIGI", "APRS", { "WIDE1-1" }, "data" },
+        { "N0CALL", "APRS", {}, "data" },
+    };
+
+    // Route the same packets multiple times to ensure the router can be reused
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (const auto& p : packets)
+        {
+            routing_result expected;
+            routing_result result;
+
+            EXPECT_TRUE(try_route_packet(p, settings, expected) == try_route_packet(p, digi, result));
+
+            EXPECT_TRUE(result.routed == expected.routed);
+            EXPECT_TRUE(result.state == expected.state);
+            EXPECT_TRUE(result.routed_packet == expected.routed_packet);
+            EXPECT_TRUE(result.original_packet == expected.original_packet);
+            EXPECT_TRUE(result.actions.size() == expected.actions.size());
+        }
+    }
+
+    routing_result result;
+
+    EXPECT_TRUE(try_route_packet(packets[0], digi, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE1-2:data");
+
+    EXPECT_TRUE(try_route_packet(packets[1], digi, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI,CALLA*,WIDE2-2:data");
+
+    EXPECT_FALSE(try_route_packet(packets[3], digi, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,CALLB,CALLC:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, router_object_copy_and_reinit)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    packet p = { "N0CALL", "APRS", { "WIDE1-1" }, "data" };
+
+    routing_result result;
+
+    aprs::router::router copy;
+
+    {
+        // The router keeps its own copy of the settings,
+        // the settings used to compile the router can go out of scope
+
+        router_settings settings{ "DIGI", {}, { "WIDE1" }, routing_option::none, false };
+        aprs::router::router digi(settings);
+
+        settings.address = "OTHER";
+
+        copy = digi;
+
+        aprs::router::router copy2(digi);
+
+        EXPECT_TRUE(try_route_packet(p, copy2, result));
+        EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI,WIDE1*:data");
+    }
+
+    EXPECT_TRUE(try_route_packet(p, copy, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI,WIDE1*:data");
+
+    // Recompile the router with new settings
+
+    init_router(router_settings{ "DIGI2", {}, { "WIDE2" }, routing_option::none, false }, copy);
+
+    EXPECT_FALSE(try_route_packet(p, copy, result));
+
+    p.path = { "WIDE2-1" };
+
+    EXPECT_TRUE(try_route_packet(p, copy, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI2,WIDE2*:data");
+
+    // Recompile the router using its own settings
+
+    copy.settings.address = "DIGI3";
+
+    init_router(copy.settings, copy);
+
+    EXPECT_TRUE(try_route_packet(p, copy, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI3,WIDE2*:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packets)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings settings{ "DIGI", { "CALLA" }, { "WIDE1", "WIDE2" }, routing_option::none, false };
+
+    aprs::router::router digi(settings);
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-3" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALLB", "CALLC" }, "data" },
+        { "N0CALL", "APRS", { "WIDE1*", "WIDE2-1" }, "data" },
+        { "DIGI", "APRS", { "WIDE1-1" }, "data" },
+        { "N0CALL", "APRS", {}, "data" },
+    };
+
+    std::vector<std::array<std::array<char, 10>, 8>> routed_packet_paths(packets.size());
+    std::vector<std::array<size_t, 8>> routed_packet_paths_address_sizes(packets.size());
+    std::vector<size_t> routed_packet_path_sizes(packets.size());
+    std::vector<enum routing_state> routing_states(packets.size());
+
+    auto [paths_end, sizes_end, path_sizes_end, states_end, routed_count] = try_route_packets(
+        packets.begin(), packets.end(),
+        routed_packet_paths.begin(),
+        routed_packet_paths_address_sizes.begin(),
+        routed_packet_path_sizes.begin(),
+        routing_states.begin(),
+        digi.state);
+
+    EXPECT_TRUE(paths_end == routed_packet_paths.end());
+    EXPECT_TRUE(sizes_end == routed_packet_paths_address_sizes.end());
+    EXPECT_TRUE(path_sizes_end == routed_packet_path_sizes.end());
+    EXPECT_TRUE(states_end == routing_states.end());
+
+    size_t expected_routed_count = 0;
+
+    // Every packet in the batch should be routed the same way as when routed individually
+
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        routing_result result;
+        bool routed = try_route_packet(packets[i], settings, result);
+
+        EXPECT_TRUE(routing_states[i] == result.state);
+
+        if (!routed)
+        {
+            EXPECT_TRUE(routed_packet_path_sizes[i] == 0);
+            continue;
+        }
+
+        expected_routed_count++;
+
+        ASSERT_TRUE(routed_packet_path_sizes[i] == result.routed_packet.path.size());
+
+        for (size_t j = 0; j < routed_packet_path_sizes[i]; j++)
+        {
+            EXPECT_TRUE(std::string_view(routed_packet_paths[i][j].data(), routed_packet_paths_address_sizes[i][j]) == result.routed_packet.path[j]);
+        }
+    }
+
+    EXPECT_TRUE(routed_count == expected_routed_count);
+    EXPECT_TRUE(routed_count == 3);
+
+    // Batch of user defined packet views
+
+    struct packet_view
+    {
+        std::string_view from;
+        std::string_view to;
+        std::array<std::string_view, 2> path;
+    };
+
+    std::array<packet_view, 2> packet_views = { {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-1" } },
+        { "N0CALL", "APRS", { "CALLB", "CALLC" } },
+    } };
+
+    std::array<std::array<std::array<char, 10>, 8>, 2> view_routed_packet_paths = {};
+    std::array<std::array<size_t, 8>, 2> view_routed_packet_paths_address_sizes = {};
+    std::array<size_t, 2> view_routed_packet_path_sizes = {};
+    std::array<enum routing_state, 2> view_routing_states = {};
+
+    auto [view_paths_end, view_sizes_end, view_path_sizes_end, view_states_end, view_routed_count] = try_route_packets(
+        packet_views.begin(), packet_views.end(),
+        view_routed_packet_paths.begin(),
+        view_routed_packet_paths_address_sizes.begin(),
+        view_routed_packet_path_sizes.begin(),
+        view_routing_states.begin(),
+        digi.state);
+
+    (void)view_paths_end;
+    (void)view_sizes_end;
+    (void)view_path_sizes_end;
+    (void)view_states_end;
+
+    EXPECT_TRUE(view_routed_count == 1);
+    EXPECT_TRUE(view_routing_states[0] == routing_state::routed);
+    EXPECT_TRUE(view_routing_states[1] == routing_state::not_routed);
+    EXPECT_TRUE(view_routed_packet_path_sizes[0] == 3);
+    EXPECT_TRUE(view_routed_packet_path_sizes[1] == 0);
+    EXPECT_TRUE(std::string_view(view_routed_packet_paths[0][0].data(), view_routed_packet_paths_address_sizes[0][0]) == "DIGI");
+    EXPECT_TRUE(std::string_view(view_routed_packet_paths[0][1].data(), view_routed_packet_paths_address_sizes[0][1]) == "WIDE1*");
+    EXPECT_TRUE(std::string_view(view_routed_packet_paths[0][2].data(), view_routed_packet_paths_address_sizes[0][2]) == "WIDE2-1");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, prefilter)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings settings{ "DIGI", { "CALLA", "B" }, { "WIDE1", "WIDE2" }, routing_option::recommended, false };
+
+    aprs::router::router digi(settings);
+
+    const route_state& state = digi.state;
+
+    EXPECT_TRUE(state.router_prefilter.enabled);
+
+    auto might_route = [&](const packet& p)
+    {
+        return might_route_packet(state, p.from, p.to, p.path.begin(), p.path.end());
+    };
+
+    // Packets which do not mention any of the router addresses are rejected
+
+    EXPECT_TRUE(!might_route(packet{ "N0CALL", "APRS", { "K7ABC-3*", "TCPIP", "qAR", "W7XYZ" }, "data" }));
+    EXPECT_TRUE(!might_route(packet{ "N0CALL", "APRS", {}, "data" }));
+    EXPECT_TRUE(!might_route(packet{ "N0CALL", "APRS", { "XB", "WX" }, "data" }));
+
+    // Packets mentioning a router address in any representation are not rejected
+
+    EXPECT_TRUE(might_route(packet{ "N0CALL", "APRS", { "WIDE1-1" }, "data" }));
+    EXPECT_TRUE(might_route(packet{ "N0CALL", "APRS", { "CALL*", "WIDE2-2" }, "data" }));
+    EXPECT_TRUE(might_route(packet{ "N0CALL", "APRS", { "CALLA" }, "data" }));
+    EXPECT_TRUE(might_route(packet{ "N0CALL", "APRS", { "B*" }, "data" }));
+    EXPECT_TRUE(might_route(packet{ "N0CALL", "APRS", { "DIGI*" }, "data" }));
+
+    // Packets sent by us or to us are not rejected
+
+    EXPECT_TRUE(might_route(packet{ "DIGI", "APRS", { "CALLB" }, "data" }));
+    EXPECT_TRUE(might_route(packet{ "N0CALL", "DIGI", { "CALLB" }, "data" }));
+
+    // The routing state is the same with and without diagnostics
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" },
+        { "DIGI", "APRS", { "CALLB" }, "data" },
+        { "N0CALL", "DIGI", { "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "CALL*", "DIGI*", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "CALL*", "B", "WIDE2-1" }, "data" },
+    };
+
+    for (const auto& p : packets)
+    {
+        router_settings diagnostics_settings = settings;
+        diagnostics_settings.enable_diagnostics = true;
+
+        routing_result result;
+        routing_result diagnostics_result;
+
+        EXPECT_TRUE(try_route_packet(p, settings, result) == try_route_packet(p, diagnostics_settings, diagnostics_result));
+        EXPECT_TRUE(result.state == diagnostics_result.state);
+        EXPECT_TRUE(result.routed_packet == diagnostics_result.routed_packet);
+    }
+
+    // An invalid router address disables the prefilter
+
+    aprs::router::router invalid(router_settings{ "", {}, { "WIDE1" }, routing_option::none, false });
+
+    EXPECT_TRUE(!invalid.state.router_prefilter.enabled);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_route_packet_static_options)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Routing with the options fixed at compile time should produce
+    // the same result as routing with the options read from the router
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALL*", "WIDE1", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "DIGI", "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "CALLA*", "CALLB", "DIGI", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "CALLB", "CALLC", "WIDE1-1" }, "data" },
+        { "N0CALL", "APRS", { "DIGI*", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "WIDE2-8" }, "data" },
+        { "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" },
+        { "DIGI", "APRS", { "WIDE1-1" }, "data" },
+    };
+
+    auto test = [&](auto options, bool enable_diagnostics)
+    {
+        constexpr routing_option static_options = decltype(options)::value;
+
+        aprs::router::router digi(router_settings{ "DIGI", { "CALLB" }, { "WIDE1", "WIDE2" }, static_options, enable_diagnostics });
+
+        for (const auto& p : packets)
+        {
+            routing_result result;
+            routing_result static_result;
+
+            EXPECT_TRUE(try_route_packet(p, digi, result) == try_route_packet<static_options>(p, digi, static_result));
+            EXPECT_TRUE(result.state == static_result.state);
+            EXPECT_TRUE(result.routed_packet == static_result.routed_packet);
+            EXPECT_TRUE(aprs::router::to_string(result) == aprs::router::to_string(static_result));
+        }
+    };
+
+    for (bool enable_diagnostics : { false, true })
+    {
+        test(std::integral_constant<routing_option, routing_option::none>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::recommended>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::route_self>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::preempt_front>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::preempt_drop>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::preempt_mark>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::reject_limit_exceeding_n_N_address>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::traceless_n_N_route>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::skip_complete_n_N_address>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::preempt_truncate>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::trap_limit_exceeding_n_N_address>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::substitute_complete_n_N_address>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::substitute_explicit_address>{}, enable_diagnostics);
+        test(std::integral_constant<routing_option, routing_option::strict>{}, enable_diagnostics);
+    }
+
+    // Only the branches for the static options are instantiated
+
+    using aprs::router::detail::may_have_routing_option;
+    using aprs::router::detail::runtime_routing_options;
+    using aprs::router::detail::static_routing_options;
+
+    static_assert(may_have_routing_option(runtime_routing_options{}, routing_option::preempt_front));
+    static_assert(!may_have_routing_option(static_routing_options<routing_option::none>{}, routing_option::preempt_front));
+    static_assert(may_have_routing_option(static_routing_options<routing_option::recommended>{}, routing_option::trap_limit_exceeding_n_N_address));
+    static_assert(!may_have_routing_option(static_routing_options<routing_option::recommended>{}, routing_option::preempt_drop));
+
+    // Routing with options which are different from the router's options
+    // uses the router's options, and does not store a wrong routing decision in the routing cache
+
+    aprs::router::router digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false, 16 });
+
+    packet p = { "N0CALL", "APRS", { "CALLA", "DIGI", "WIDE1-1" }, "data" };
+
+    routing_result static_result;
+    EXPECT_FALSE(try_route_packet<routing_option::preempt_front>(p, digi, static_result));
+    EXPECT_TRUE(static_result.state == routing_state::not_routed);
+    EXPECT_TRUE(static_result.routed_packet == p);
+
+    routing_result result;
+    EXPECT_FALSE(try_route_packet(p, digi, result));
+    EXPECT_TRUE(result.state == routing_state::not_routed);
+    EXPECT_TRUE(result.routed_packet == p);
+    EXPECT_TRUE(digi.cache.hits == 1);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_init_canonical_addresses)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Packets with a canonical n-N path are initialized without init_addresses and find_used_addresses
+    // The initialized addresses should be identical to the ones produced by the general path
+
+    std::vector<std::vector<std::string>> paths = {
+        { "WIDE1-1" },
+        { "WIDE1-1", "WIDE2-1" },
+        { "WIDE1-1", "WIDE2-2" },
+        { "WIDE2-2" },
+        { "WIDE7-7" },
+        { "WIDE3-3", "WIDE3-3", "WIDE3-3" },
+        { "CALL*", "WIDE2-1" },
+        { "K7ABC-3*", "WIDE2-2" },
+        { "CALL*", "WIDE1-1", "WIDE2-1" },
+        { "TRACE2-2", "WIDE2-1" },
+        { "CA1-1", "WI-DE2-1" },
+        { "N0CALL-1", "WIDE2-1" },
+        { "WIDE1*", "WIDE2-1" },
+        { "WIDE1-1*", "WIDE2-1" },
+        { "WIDE1", "WIDE2-1" },
+        { "WIDE8-1" },
+        { "WIDE1-8" },
+        { "WIDE1-0" },
+        { "CALL*" },
+        { "DIGI*", "WIDE2-1" },
+        { "DIGI1-1" },
+        { "DIGI1-1", "DIGI2-1", "DIGI2-2" },
+        { "CALLA", "WIDE2-1" },
+        { "qAR", "WIDE2-1" },
+        { "CALLA*", "WIDE2-1" },
+        { "CALLB*", "WIDE2-2" },
+        { "WIDE2-1", "WIDE1-1" },
+        { "WIDE1-1", "WIDE1-1", "WIDE1-1", "WIDE1-1", "WIDE1-1", "WIDE1-1", "WIDE1-1", "WIDE1-1" },
+        { "WIDE2-2", "WIDE2-2", "WIDE2-2", "WIDE2-2", "WIDE2-2", "WIDE2-2", "WIDE2-2", "WIDE2-2" },
+        { "CALL*", "WIDE1-1", "WIDE2-1", "WIDE2-1", "WIDE2-1", "WIDE2-1", "WIDE2-1", "WIDE2-1" },
+        { "" },
+    };
+
+    std::vector<router_settings> settings = {
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::recommended, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2", "WIDE3", "TRACE2" }, routing_option::skip_complete_n_N_address, false },
+        { "DIGI", {}, { "WIDE2", "CALL" }, routing_option::skip_complete_n_N_address, false },
+        { "DIGI-1", {}, { "WIDE1", "WIDE2", "DIGI1" }, routing_option::strict, false },
+        { "CALL", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI2-1", {}, { "DIGI1", "WIDE2" }, routing_option::none, false },
+        { "DIGI", { "CALLA" }, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI", { "CALLA" }, {}, routing_option::none, false },
+        { "DIGI", { "CALLB", "WIDE2-1" }, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI", { "DIGI", "CALLA" }, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI", { "WIDE2" }, { "WIDE1", "WIDE2" }, routing_option::preempt_front, false },
+        { "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, routing_option::trap_limit_exceeding_n_N_address, false },
+        { "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, routing_option::trap_limit_exceeding_n_N_address | routing_option::traceless_n_N_route, false },
+        { "DIGI", {}, { "WIDE2-1", "WIDE2-2" }, routing_option::reject_limit_exceeding_n_N_address, false },
+        { "DIGI", {}, { "WIDE1-1", "WIDE2-1" }, routing_option::reject_limit_exceeding_n_N_address | routing_option::trap_limit_exceeding_n_N_address, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::substitute_complete_n_N_address, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::substitute_complete_n_N_address | routing_option::traceless_n_N_route, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::traceless_n_N_route, false },
+        { "", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+    };
+
+    size_t canonical_count = 0;
+
+    for (const auto& s : settings)
+    {
+        aprs::router::router router(s);
+
+        for (const auto& path : paths)
+        {
+            for (std::string_view from : { "N0CALL", "DIGI", "CALL" })
+            {
+                route_state state = router.state;
+
+                state.packet_from_address = from;
+                state.packet_to_address = "APRS";
+                state.original_packet_path_size = path.size();
+                state.packet_path_size = 0;
+
+                for (const auto& address : path)
+                {
+                    array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, address.data(), address.data() + address.size());
+                }
+
+                route_state general_state = state;
+
+                if (!try_init_canonical_addresses(state, state))
+                {
+                    continue;
+                }
+
+                canonical_count++;
+
+                init_addresses(general_state, general_state);
+                find_used_addresses<runtime_routing_options>(general_state, general_state);
+
+                // None of the general checks are taken for a canonical path
+
+                EXPECT_FALSE(has_packet_routing_ended(general_state));
+                EXPECT_FALSE(has_packet_been_routed_by_us(general_state, general_state));
+                EXPECT_FALSE(is_packet_sent_to_us(general_state, general_state));
+                EXPECT_FALSE(is_packet_from_us(general_state, general_state));
+                EXPECT_FALSE(is_explicit_routing<runtime_routing_options>(false, general_state, general_state));
+
+                EXPECT_TRUE(state.packet_addresses_size == general_state.packet_addresses_size);
+                EXPECT_TRUE(state.maybe_last_used_address_index == general_state.maybe_last_used_address_index);
+                EXPECT_TRUE(state.maybe_router_address_index == general_state.maybe_router_address_index);
+                EXPECT_TRUE(state.unused_address_index == general_state.unused_address_index);
+
+                for (size_t i = 0; i < state.packet_addresses_size && i < general_state.packet_addresses_size; i++)
+                {
+                    const address& a = state.packet_addresses[i];
+                    const address& b = general_state.packet_addresses[i];
+                    EXPECT_TRUE(a == b);
+                    EXPECT_TRUE(a.kind == b.kind);
+                    EXPECT_TRUE(a.q == b.q);
+                    EXPECT_TRUE(a.index == b.index);
+                    EXPECT_TRUE(a.offset == b.offset);
+                    EXPECT_TRUE(a.length == b.length);
+                }
+
+                // The direct route of the fast path should match the n-N route of the general path
+
+                bool routed = try_canonical_n_N_route<runtime_routing_options>(state, state);
+                bool general_routed = try_n_N_route<runtime_routing_options>(general_state, general_state, false, discard_output_iterator{}).second;
+
+                EXPECT_TRUE(routed == general_routed);
+                EXPECT_TRUE(state.packet_addresses_size == general_state.packet_addresses_size);
+
+                for (size_t i = 0; i < state.packet_addresses_size && i < general_state.packet_addresses_size; i++)
+                {
+                    const address& a = state.packet_addresses[i];
+                    const address& b = general_state.packet_addresses[i];
+                    EXPECT_TRUE(a == b);
+                    EXPECT_TRUE(a.mark == b.mark);
+                    EXPECT_TRUE(a.index == b.index);
+                    EXPECT_TRUE(a.offset == b.offset);
+                    EXPECT_TRUE(a.length == b.length);
+                }
+            }
+        }
+    }
+
+    EXPECT_TRUE(canonical_count > 0);
+
+    // Packets matching an explicit address, or routers whose address is an explicit address, are left to the general path
+
+    for (const auto& [s, path] : std::vector<std::pair<router_settings, std::vector<std::string>>>{
+        { { "DIGI", { "CALLB", "WIDE2-1" }, { "WIDE1", "WIDE2" }, routing_option::none, false }, { "WIDE2-1" } },
+        { { "DIGI", { "CALLB", "WIDE2-1" }, { "WIDE1", "WIDE2" }, routing_option::none, false }, { "CALLB*", "WIDE2-2" } },
+        { { "DIGI", { "DIGI", "CALLA" }, { "WIDE1", "WIDE2" }, routing_option::none, false }, { "WIDE1-1", "WIDE2-1" } } })
+    {
+        aprs::router::router explicit_router(s);
+        route_state state = explicit_router.state;
+
+        state.packet_from_address = "N0CALL";
+        state.packet_to_address = "APRS";
+        state.original_packet_path_size = path.size();
+        state.packet_path_size = 0;
+
+        for (const auto& address : path)
+        {
+            array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, address.data(), address.data() + address.size());
+        }
+
+        EXPECT_FALSE(try_init_canonical_addresses(state, state));
+    }
+
+    // Paths which are not canonical are left to the general path
+
+    aprs::router::router router(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false });
+
+    for (const auto& path : std::vector<std::vector<std::string>>{ { "WIDE1", "WIDE2-1" }, { "CALL*" }, { "DIGI*", "WIDE2-1" }, { "WIDE1-1*", "WIDE2-1" }, { "WIDE2-8" } })
+    {
+        route_state state = router.state;
+
+        state.packet_from_address = "N0CALL";
+        state.packet_to_address = "APRS";
+        state.original_packet_path_size = path.size();
+        state.packet_path_size = 0;
+
+        for (const auto& address : path)
+        {
+            array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, address.data(), address.data() + address.size());
+        }
+
+        EXPECT_FALSE(try_init_canonical_addresses(state, state));
+    }
+
+    // Routing through the fast path
+
+    routing_result result;
+
+    EXPECT_TRUE(try_route_packet(packet{ "N0CALL", "APRS", { "WIDE1-1", "WIDE2-1" }, "data" }, router, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI,WIDE1*,WIDE2-1:data");
+
+    EXPECT_TRUE(try_route_packet(packet{ "N0CALL", "APRS", { "CALL*", "WIDE2-2" }, "data" }, router, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,CALL,DIGI*,WIDE2-1:data");
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, try_init_last_used_address)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Packets which have finished routing, or have already been routed by us,
+    // are initialized by parsing only the last used address
+    // The routing decision and the last used address should be identical to the ones produced by the general path
+
+    std::vector<std::vector<std::string>> paths = {
+        { "CALL*" },
+        { "CALLA", "CALLB", "CALLC*" },
+        { "CALLA*", "CALLB", "CALLC*" },
+        { "DIGI*", "WIDE2-1" },
+        { "CALLA", "DIGI*", "CALLB", "WIDE2-2" },
+        { "DIGI-1*", "WIDE2-1" },
+        { "DIGI-0*", "WIDE2-1" },
+        { "DIGIX*", "WIDE2-1" },
+        { "DIG*", "WIDE2-1" },
+        { "DIGI*", "WIDE1", "WIDE2-1" },
+        { "DIGI*", "WIDE1" },
+        { "CALL*", "WIDE1", "WIDE2-1" },
+        { "WIDE1-1*", "WIDE2-1" },
+        { "WIDE1*", "WIDE2-1" },
+        { "CALLA", "WIDE2-1*" },
+        { "qAR*" },
+        { "CALLA", "qAR*", "CALLB" },
+        { "CALLA", "WIDE2-1" },
+        { "*" },
+        { "" },
+    };
+
+    std::vector<router_settings> settings = {
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::recommended, false },
+        { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, false },
+        { "DIGI-1", { "CALLA" }, { "WIDE2" }, routing_option::none, false },
+        { "DIGI", { "DIGI", "CALLB" }, {}, routing_option::none, false },
+        { "WIDE", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+    };
+
+    size_t lazy_count = 0;
+
+    for (const auto& s : settings)
+    {
+        aprs::router::router router(s);
+
+        for (const auto& path : paths)
+        {
+            route_state state = router.state;
+
+            state.packet_from_address = "N0CALL";
+            state.packet_to_address = "APRS";
+            state.original_packet_path_size = path.size();
+            state.packet_path_size = 0;
+
+            for (const auto& address : path)
+            {
+                array_push_back(state.packet_path, state.packet_path_size, state.packet_path_address_sizes, address.data(), address.data() + address.size());
+            }
+
+            route_state general_state = state;
+
+            init_addresses(general_state, general_state);
+            find_used_addresses<runtime_routing_options>(general_state, general_state);
+
+            if (!try_init_last_used_address<runtime_routing_options>(state, state))
+            {
+                continue;
+            }
+
+            lazy_count++;
+
+            EXPECT_TRUE(has_packet_routing_ended(general_state) || has_packet_been_routed_by_us(general_state, general_state));
+
+            EXPECT_TRUE(has_packet_routing_ended(state) == has_packet_routing_ended(general_state));
+            EXPECT_TRUE(has_packet_been_routed_by_us(state, state) == has_packet_been_routed_by_us(general_state, general_state));
+            EXPECT_TRUE(state.packet_addresses_size == general_state.packet_addresses_size);
+            EXPECT_TRUE(state.maybe_last_used_address_index == general_state.maybe_last_used_address_index);
+
+            if (state.maybe_last_used_address_index && general_state.maybe_last_used_address_index)
+            {
+                const address& a = state.packet_addresses[state.maybe_last_used_address_index.value()];
+                const address& b = general_state.packet_addresses[general_state.maybe_last_used_address_index.value()];
+                EXPECT_TRUE(a == b);
+                EXPECT_TRUE(a.kind == b.kind);
+                EXPECT_TRUE(a.index == b.index);
+                EXPECT_TRUE(a.offset == b.offset);
+                EXPECT_TRUE(a.length == b.length);
+            }
+        }
+    }
+
+    EXPECT_TRUE(lazy_count > 0);
+
+    // Routing ended and routed by us, with diagnostics
+
+    aprs::router::router router(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, true });
+
+    routing_result result;
+
+    EXPECT_FALSE(try_route_packet(packet{ "N0CALL", "APRS", { "CALLA", "CALLB", "CALLC*" }, "data" }, router, result));
+    EXPECT_TRUE(result.state == routing_state::not_routed);
+    EXPECT_TRUE(result.actions.size() == 1);
+    EXPECT_TRUE(result.actions[0].message_type == message_type::routing_ended);
+    EXPECT_TRUE(result.actions[0].index == 2);
+    EXPECT_TRUE(result.actions[0].start == 24);
+    EXPECT_TRUE(result.actions[0].end == 30);
+
+    EXPECT_FALSE(try_route_packet(packet{ "N0CALL", "APRS", { "CALLA", "DIGI*", "WIDE2-2" }, "data" }, router, result));
+    EXPECT_TRUE(result.state == routing_state::already_routed);
+    EXPECT_TRUE(result.actions.size() == 1);
+    EXPECT_TRUE(result.actions[0].message_type == message_type::already_routed);
+    EXPECT_TRUE(result.actions[0].index == 1);
+    EXPECT_TRUE(result.actions[0].start == 18);
+    EXPECT_TRUE(result.actions[0].end == 23);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(router, routing_cache)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // Routing with the cache enabled should produce the same result as routing without the cache
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALL*", "WIDE1", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "DIGI", "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "CALLB", "CALLC", "WIDE1-1" }, "data" },
+        { "N0CALL", "APRS", { "DIGI*", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "WIDE2-8" }, "data" },
+        { "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" },
+        { "N0CAL", "LAPRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "other data" },
+        { "DIGI", "APRS", { "WIDE1-1" }, "data" },
+    };
+
+    aprs::router::router digi(router_settings{ "DIGI", { "CALLB" }, { "WIDE1", "WIDE2" }, routing_option::recommended, false });
+    aprs::router::router cached_digi(router_settings{ "DIGI", { "CALLB" }, { "WIDE1", "WIDE2" }, routing_option::recommended, false, 4 });
+
+    EXPECT_TRUE(digi.cache.entries.empty());
+    EXPECT_TRUE(cached_digi.cache.entries.size() == 4);
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (const auto& p : packets)
+        {
+            routing_result result;
+            routing_result cached_result;
+
+            EXPECT_TRUE(try_route_packet(p, digi, result) == try_route_packet(p, cached_digi, cached_result));
+            EXPECT_TRUE(result.state == cached_result.state);
+            EXPECT_TRUE(result.routed == cached_result.routed);
+            EXPECT_TRUE(result.original_packet == cached_result.original_packet);
+            EXPECT_TRUE(result.routed_packet == cached_result.routed_packet);
+        }
+    }
+
+    // The cache holds fewer entries than there are packets, some packets were routed from the cache
+
+    EXPECT_TRUE(cached_digi.cache.hits + cached_digi.cache.misses == 3 * packets.size());
+    EXPECT_TRUE(cached_digi.cache.misses >= packets.size() - 1);
+
+    // Repeated packets are routed from the cache
+
+    init_router(router_settings{ "DIGI", { "CALLB" }, { "WIDE1", "WIDE2" }, routing_option::recommended, false, 64 }, cached_digi);
+
+    EXPECT_TRUE(cached_digi.cache.hits == 0);
+    EXPECT_TRUE(cached_digi.cache.misses == 0);
+    EXPECT_TRUE(cached_digi.cache.entries.size() == 64);
+
+    routing_result result;
+
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_TRUE(try_route_packet(packets[0], cached_digi, result));
+        EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI*,WIDE2-2:data");
+        EXPECT_FALSE(try_route_packet(packets[6], cached_digi, result));
+        EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,K7ABC-3*,TCPIP:data");
+    }
+
+    EXPECT_TRUE(cached_digi.cache.hits == 18);
+    EXPECT_TRUE(cached_digi.cache.misses == 2);
+
+    // Recompiling the router clears the cache, the cached decisions were made with the previous settings
+
+    init_router(router_settings{ "DIGI2", {}, { "WIDE1" }, routing_option::none, false, 64 }, cached_digi);
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE2-1");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
-    EXPECT_TRUE(result.actions[0].start == 24);
-    EXPECT_TRUE(result.actions[0].end == 31);
-    EXPECT_TRUE(result.actions[0].index == 2);
+    EXPECT_TRUE(cached_digi.cache.hits == 0);
+    EXPECT_TRUE(try_route_packet(packets[0], cached_digi, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,DIGI2,WIDE1*,WIDE2-2:data");
+    EXPECT_TRUE(cached_digi.cache.misses == 1);
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[1].start == 24);
-    EXPECT_TRUE(result.actions[1].end == 28);
-    EXPECT_TRUE(result.actions[1].index == 2);
+    // The cache is not used if diagnostics are enabled
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "WIDE1");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::unset);
-    EXPECT_TRUE(result.actions[2].start == 17);
-    EXPECT_TRUE(result.actions[2].end == 23);
-    EXPECT_TRUE(result.actions[2].index == 1);
+    aprs::router::router diagnostics_digi(router_settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, true, 64 });
 
-    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[3].target == applies_to::path);
-    EXPECT_TRUE(result.actions[3].type == routing_action::set);
-    EXPECT_TRUE(result.actions[3].start == 23);
-    EXPECT_TRUE(result.actions[3].end == 27);
-    EXPECT_TRUE(result.actions[3].index == 2);
+    EXPECT_TRUE(try_route_packet(packets[0], diagnostics_digi, result));
+    EXPECT_TRUE(try_route_packet(packets[0], diagnostics_digi, result));
+    EXPECT_FALSE(result.actions.empty());
+    EXPECT_TRUE(diagnostics_digi.cache.hits == 0);
+    EXPECT_TRUE(diagnostics_digi.cache.misses == 0);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
 
-    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6*,WIDE3-3:data
-    //                                                  ~~~~~~~
-    //                                                  49 56 - Packet address decremented
-    //
-    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6,DIGI,WIDE3-3:data
-    //                                                 ~~~~
-    //                                                 49 53 - Packet address inserted
-    //
-    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6*,WIDE3-3:data
-    //                                           ~~~~~~
-    //                                           42 48 - Packet address marked as 'unset'
-    //
-    // N0CALL>APRS,CALL1,CALL2,CALL3,CALL4,CALL5,CALL6,DIGI,WIDE3-3:data
-    //                                                 ~~~~
-    //                                                 48 52 - Packet address marked as 'set'
+TEST(router, shared_router_config)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // A router can be shared between threads, every thread routes packets with its own route_scratch
+    // The results should be identical to routing the packets on a single thread
 
-    digi.address = "DIGI";
-    digi.n_N_addresses = { "WIDE3" };
-    digi.options = routing_option::none;
-    p = { "N0CALL", "APRS", { "CALL1", "CALL2", "CALL3", "CALL4", "CALL5", "CALL6*", "WIDE3-3" }, "data"};
-    packet_string = to_string(p);
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALL*", "WIDE1", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "DIGI", "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "CALLB", "CALLC", "WIDE1-1" }, "data" },
+        { "N0CALL", "APRS", { "DIGI*", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "WIDE2-8" }, "data" },
+        { "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" },
+        { "DIGI", "APRS", { "WIDE1-1" }, "data" },
+    };
 
-    try_route_packet(p, digi, result);
+    aprs::router::router digi(router_settings{ "DIGI", { "CALLB" }, { "WIDE1", "WIDE2" }, routing_option::recommended, false });
 
-    EXPECT_TRUE(result.actions.size() == 4);
+    std::vector<routing_result> expected(packets.size());
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE3-2");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
-    EXPECT_TRUE(result.actions[0].start == 49);
-    EXPECT_TRUE(result.actions[0].end == 56);
-    EXPECT_TRUE(result.actions[0].index == 6);
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        try_route_packet(packets[i], digi, expected[i]);
+    }
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::insert);
-    EXPECT_TRUE(result.actions[1].start == 49);
-    EXPECT_TRUE(result.actions[1].end == 53);
-    EXPECT_TRUE(result.actions[1].index == 6);
+    const aprs::router::router& shared_digi = digi;
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "CALL6");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::unset);
-    EXPECT_TRUE(result.actions[2].start == 42);
-    EXPECT_TRUE(result.actions[2].end == 48);
-    EXPECT_TRUE(result.actions[2].index == 5);
+    // The shared configuration and the scratch space do not share cache lines
 
-    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[3].target == applies_to::path);
-    EXPECT_TRUE(result.actions[3].type == routing_action::set);
-    EXPECT_TRUE(result.actions[3].start == 48);
-    EXPECT_TRUE(result.actions[3].end == 52);
-    EXPECT_TRUE(result.actions[3].index == 6);
+    EXPECT_TRUE(alignof(router_config) == 64);
+    EXPECT_TRUE(alignof(route_scratch) == 64);
 
-    // N0CALL>APRS,,WIDE1-1:data
-    //              ~~~~~~~
-    //              13 20 - Packet address decremented
-    //
-    // N0CALL>APRS,,WIDE1:data
-    //              ~~~~~
-    //              13 18 - Packet address replaced
-    //
-    // N0CALL>APRS,,DIGI:data
-    //              ~~~~
-    //              13 17 - Packet address marked as 'set'
-    //
-    // N0CALL>APRS,,DIGI*:data
-    //             ~
-    //             12 12 - Packet address removed
+    constexpr size_t thread_count = 4;
+    constexpr size_t iterations = 200;
 
-    digi.address = "DIGI";
-    digi.n_N_addresses = { "WIDE1" };
-    digi.options = routing_option::substitute_complete_n_N_address;
-    p = { "N0CALL", "APRS", { "", "WIDE1-1" }, "data"};
-    packet_string = to_string(p);
+    std::vector<size_t> mismatches(thread_count, 0);
+    std::vector<std::thread> threads;
 
-    try_route_packet(p, digi, result);
+    for (size_t t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([&, t]
+        {
+            route_scratch scratch;
 
-    EXPECT_TRUE(result.actions.size() == 4);
+            for (size_t n = 0; n < iterations; n++)
+            {
+                for (size_t i = 0; i < packets.size(); i++)
+                {
+                    routing_result result;
+                    bool routed = try_route_packet(packets[i], shared_digi, scratch, result);
+                    if (routed != expected[i].routed || result.state != expected[i].state || !(result.routed_packet == expected[i].routed_packet))
+                    {
+                        mismatches[t]++;
+                    }
+                }
+            }
+        });
+    }
 
-    EXPECT_TRUE(std::string_view(result.actions[0].address.data(), result.actions[0].address_size) == "WIDE1");
-    EXPECT_TRUE(result.actions[0].target == applies_to::path);
-    EXPECT_TRUE(result.actions[0].type == routing_action::decrement);
-    EXPECT_TRUE(result.actions[0].start == 13);
-    EXPECT_TRUE(result.actions[0].end == 20);
-    EXPECT_TRUE(result.actions[0].index == 1);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
 
-    EXPECT_TRUE(std::string_view(result.actions[1].address.data(), result.actions[1].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[1].target == applies_to::path);
-    EXPECT_TRUE(result.actions[1].type == routing_action::replace);
-    EXPECT_TRUE(result.actions[1].start == 13);
-    EXPECT_TRUE(result.actions[1].end == 18);
-    EXPECT_TRUE(result.actions[1].index == 1);
+    for (size_t t = 0; t < thread_count; t++)
+    {
+        EXPECT_TRUE(mismatches[t] == 0);
+    }
 
-    EXPECT_TRUE(std::string_view(result.actions[2].address.data(), result.actions[2].address_size) == "DIGI");
-    EXPECT_TRUE(result.actions[2].target == applies_to::path);
-    EXPECT_TRUE(result.actions[2].type == routing_action::set);
-    EXPECT_TRUE(result.actions[2].start == 13);
-    EXPECT_TRUE(result.actions[2].end == 17);
-    EXPECT_TRUE(result.actions[2].index == 1);
+    // The low level interface takes the router_config and the route_scratch separately
 
-    EXPECT_TRUE(std::string_view(result.actions[3].address.data(), result.actions[3].address_size) == "");
-    EXPECT_TRUE(result.actions[3].target == applies_to::path);
-    EXPECT_TRUE(result.actions[3].type == routing_action::remove);
-    EXPECT_TRUE(result.actions[3].start == 12);
-    EXPECT_TRUE(result.actions[3].end == 12);
-    EXPECT_TRUE(result.actions[3].index == 0);
+    route_scratch scratch;
+    std::vector<std::string> routed_path;
+    enum routing_state state;
+
+    auto [path_end, sizes_end, actions_end, routed] = try_route_packet(
+        packets[0].from, packets[0].to, packets[0].path.begin(), packets[0].path.end(), false,
+        std::back_inserter(routed_path), aprs::router::detail::discard_output_iterator{}, aprs::router::detail::discard_output_iterator{},
+        state, shared_digi.state, scratch);
+    (void)path_end;
+    (void)sizes_end;
+    (void)actions_end;
+
+    EXPECT_TRUE(routed);
+    EXPECT_TRUE(state == routing_state::routed);
+    EXPECT_TRUE(routed_path == expected[0].routed_packet.path);
+
+    std::array<char, 256> buffer = {};
+    size_t size = format_packet_to(scratch, packets[0].data, buffer.data(), buffer.size());
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,DIGI*,WIDE2-2:data");
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, try_route_packet_color_diagnostics)
+TEST(router, reloadable_router)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    router_settings digi{ "DIGI", {},  { "WIDE1", "WIDE2" }, routing_option::none, true };
-    routing_result result;
+    // Packets routed while the router is reloaded are routed with either the previous or the new settings
 
-    packet p = { "N0CALL", "APRS", { "WIDE1-2" }, "data"};
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "WIDE2-1" }, "data" },
+    };
 
-    try_route_packet(p, digi, result);
+    const router_settings settings_a{ "DIGI", {}, { "WIDE1" }, routing_option::none, false };
+    const router_settings settings_b{ "DIGI", { "CALLA" }, { "WIDE2" }, routing_option::none, false };
 
-    std::string diag_string = to_string(result);
+    std::vector<routing_result> expected_a(packets.size());
+    std::vector<routing_result> expected_b(packets.size());
 
-    std::cout << diag_string << std::endl;
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        try_route_packet(packets[i], settings_a, expected_a[i]);
+        try_route_packet(packets[i], settings_b, expected_b[i]);
+        EXPECT_FALSE(expected_a[i].routed_packet == expected_b[i].routed_packet);
+    }
 
-    routing_diagnostic_display diag_lines = format(result);
+    reloadable_router digi(settings_a);
 
-    for (auto& l : diag_lines.entries)
+    std::atomic<bool> stop = false;
+    std::atomic<size_t> mismatches = 0;
+    std::atomic<size_t> routed_count = 0;
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < 4; t++)
     {
-        l.message[0] = static_cast<char>(std::tolower(l.message[0]));
+        threads.emplace_back([&]
+        {
+            route_scratch scratch;
 
-        fmt::print(fg(fmt::color::blue_violet), "note: ");
-        fmt::print("{}\n", l.message);
-        fmt::print(fg(fmt::color::gray), "{:4}{}\n", "", l.packet_string);
-        fmt::print(fg(fmt::color::lime_green), "{:4}{}\n", "", l.highlight_string);
+            while (!stop.load())
+            {
+                for (size_t i = 0; i < packets.size(); i++)
+                {
+                    routing_result result;
+                    try_route_packet(packets[i], digi, scratch, result);
+                    if (!(result.routed_packet == expected_a[i].routed_packet) && !(result.routed_packet == expected_b[i].routed_packet))
+                    {
+                        mismatches++;
+                    }
+                    routed_count++;
+                }
+            }
+        });
+    }
+
+    while (routed_count.load() == 0)
+    {
+        std::this_thread::yield();
+    }
+
+    for (size_t i = 0; i < 200; i++)
+    {
+        reload_router(i % 2 == 0 ? settings_b : settings_a, digi);
+        std::this_thread::yield();
     }
+
+    stop = true;
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_TRUE(mismatches == 0);
+
+    // The last reload is used for all the packets routed after it
+
+    route_scratch scratch;
+
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        routing_result result;
+        try_route_packet(packets[i], digi, scratch, result);
+        EXPECT_TRUE(result.routed_packet == expected_a[i].routed_packet);
+        EXPECT_TRUE(result.state == expected_a[i].state);
+    }
+
+    reload_router(settings_b, digi);
+
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        routing_result result;
+        try_route_packet(packets[i], digi, scratch, result);
+        EXPECT_TRUE(result.routed_packet == expected_b[i].routed_packet);
+        EXPECT_TRUE(result.state == expected_b[i].state);
+    }
+
+    EXPECT_TRUE(digi.readers[0] == 0);
+    EXPECT_TRUE(digi.readers[1] == 0);
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, try_route_packet_flat_api)
+TEST(router, router_set)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    std::vector<std::string> packet_path = { "WIDE1-1", "WIDE2-1" };
-    aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, true };
+    // Routing a packet with a router set should produce the same results as routing it with each router
+
+    std::vector<router_settings> settings = {
+        { "DIGI1", {}, { "WIDE1", "WIDE2" }, routing_option::none, false },
+        { "DIGI2", { "CALLA" }, { "WIDE2" }, routing_option::recommended, false },
+        { "DIGI3", { "CALLB" }, {}, routing_option::none, false },
+        { "K", {}, { "TEST1" }, routing_option::none, false },
+        { "DIGI4", {}, { "WIDE1" }, routing_option::none, true },
+    };
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "CALLB", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "K*", "TEST1-1" }, "data" },
+        { "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" },
+        { "DIGI3", "APRS", { "CALLB" }, "data" },
+        { "N0CALL", "DIGI1", { "WIDE1-1" }, "data" },
+        { "N0CALL", "APRS", { "DIGI2*", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-12345678" }, "data" },
+        { "N0CALL", "APRS", {}, "data" },
+    };
+
+    router_set set(settings);
+
+    EXPECT_TRUE(set.routers.size() == settings.size());
+    EXPECT_TRUE(set.unindexed.size() == 1);
+
+    for (const auto& p : packets)
+    {
+        std::vector<routing_result> results;
 
-    std::vector<std::string> routed_path;
-    aprs::router::routing_state routing_state;
-    std::vector<routing_diagnostic> routing_actions;
+        bool routed = try_route_packet(p, set, results);
 
-    EXPECT_TRUE(aprs::router::try_route_packet("W7ION-5", "T7SVVQ", packet_path, settings, routed_path, routing_state, routing_actions));
+        EXPECT_TRUE(results.size() == settings.size());
 
-    EXPECT_TRUE(routed_path == (std::vector<std::string>{ "DIGI", "WIDE1*", "WIDE2-1" }));
+        bool expected_routed = false;
 
-    EXPECT_TRUE(routing_state == aprs::router::routing_state::routed);
+        for (size_t i = 0; i < settings.size(); i++)
+        {
+            routing_result expected;
+            expected_routed = try_route_packet(p, settings[i], expected) || expected_routed;
+
+            EXPECT_TRUE(results[i].routed == expected.routed);
+            EXPECT_TRUE(results[i].state == expected.state);
+            EXPECT_TRUE(results[i].original_packet == expected.original_packet);
+            EXPECT_TRUE(results[i].routed_packet == expected.routed_packet);
+            EXPECT_TRUE(to_string(results[i]) == to_string(expected));
+        }
 
-    EXPECT_TRUE(routing_actions.size() == 3);
+        EXPECT_TRUE(routed == expected_routed);
+    }
+
+    // Only the routers with an address starting like one of the packet's addresses are evaluated
+
+    std::vector<routing_result> results;
+
+    EXPECT_TRUE(try_route_packet(packet{ "N0CALL", "APRS", { "CALLB", "WIDE2-1" }, "data" }, set, results));
+    EXPECT_TRUE(set.candidates == std::vector<bool>({ true, true, true, false, true }));
+    EXPECT_TRUE(to_string(results[2].routed_packet) == "N0CALL>APRS,DIGI3,CALLB*,WIDE2-1:data");
+
+    EXPECT_FALSE(try_route_packet(packet{ "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" }, set, results));
+    EXPECT_TRUE(set.candidates == std::vector<bool>({ false, false, false, true, true }));
+
+    // An empty set routes nothing
+
+    router_set empty_set;
+    init_router_set({}, empty_set);
+    EXPECT_FALSE(try_route_packet(packets[0], empty_set, results));
+    EXPECT_TRUE(results.empty());
 #else
     EXPECT_TRUE(true);
 #endif
 }
 
-TEST(router, try_route_packet_flat_api_with_iterators)
+TEST(router, constexpr_init_router)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS
-    std::vector<std::string> packet_path = { "WIDE1-1", "WIDE2-1" };
-    aprs::router::router_settings settings = { "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::skip_complete_n_N_address, true };
+    // The address parsers can be evaluated at compile time
+
+    static_assert([] { address a; return try_parse_address("WIDE2-1*", a) && a.n == 2 && a.N == 1 && a.mark && a.kind == address_kind::wide; }());
+    static_assert([] { address a; return try_parse_n_N_address("WIDE7", a) && a.n == 7 && a.N == 0; }());
+    static_assert([] { address a; return try_parse_address_with_ssid("CALL-10", a) && a.ssid == 10 && a.text_size == 4; }());
+    static_assert([] { address a; return !try_parse_address_with_ssid("CALL-AB", a); }());
+    static_assert([] { address a; return !try_parse_address_with_ssid("call", a); }());
+    static_assert([] { int n = 0; return try_parse_int("-15", n) && n == -15; }());
+    static_assert([] { int n = 0; return !try_parse_int("2147483648", n) && n == 0; }());
+    static_assert(parse_address_kind("RFONLY") == address_kind::rfonly);
+    static_assert(parse_q_construct("qAR") == q_construct::qAR);
+
+    // A router configuration can be parsed and validated at compile time
+
+    static constexpr std::array<std::string_view, 1> explicit_addresses = { "CALLA" };
+    static constexpr std::array<std::string_view, 2> n_N_addresses = { "WIDE1", "WIDE2" };
+
+    static constexpr route_state digi = [] {
+        route_state state;
+        init_router("DIGI", explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), routing_option::recommended, state);
+        return state;
+    }();
+
+    static_assert(digi.initialized);
+    static_assert(digi.router_explicit_addresses_size == 1);
+    static_assert(digi.router_n_N_addresses_size == 2);
+    static_assert(digi.router_address_key == get_address_key(digi.router_address));
+    static_assert(digi.router_prefilter.enabled);
+
+    static_assert([] {
+        route_state state;
+        return try_init_router("DIGI", explicit_addresses.begin(), explicit_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), routing_option::none, state);
+    }());
+
+    static_assert([] {
+        constexpr std::array<std::string_view, 2> invalid_addresses = { "CALLA", "CALL-AB" };
+        route_state state;
+        return !try_init_router("DIGI", invalid_addresses.begin(), invalid_addresses.end(), n_N_addresses.begin(), n_N_addresses.end(), routing_option::none, state);
+    }());
+
+    // Routing with a copy of the compile time state is identical to routing with a router
+
+    aprs::router::router router(router_settings{ "DIGI", { "CALLA" }, { "WIDE1", "WIDE2" }, routing_option::recommended, false });
+
+    std::vector<packet> packets = {
+        { "N0CALL", "APRS", { "WIDE1-1", "WIDE2-2" }, "data" },
+        { "N0CALL", "APRS", { "CALLA", "CALLB" }, "data" },
+        { "N0CALL", "APRS", { "CALLB", "DIGI", "WIDE2-1" }, "data" },
+        { "N0CALL", "APRS", { "K7ABC-3*", "TCPIP" }, "data" },
+    };
+
+    for (const auto& p : packets)
+    {
+        route_state state = digi;
 
-    std::vector<std::string> routed_path;
-    aprs::router::routing_state routing_state;
-    std::vector<routing_diagnostic> routing_actions;
+        std::vector<std::string> routed_path;
+        routing_state routing_state;
 
-    auto [routed_packet_path_out, routing_actions_out, result] = aprs::router::try_route_packet("W7ION-5", "T7SVVQ", packet_path.begin(), packet_path.end(), settings, std::back_inserter(routed_path), routing_state, std::back_inserter(routing_actions));
+        routing_result result;
 
-    EXPECT_TRUE(result);
+        try_route_packet(p.from, p.to, p.path.begin(), p.path.end(), false, std::back_inserter(routed_path), discard_output_iterator{}, discard_output_iterator{}, routing_state, state);
 
-    EXPECT_TRUE(routed_path == (std::vector<std::string>{ "DIGI", "WIDE1*", "WIDE2-1" }));
+        try_route_packet(p, router, result);
 
-    EXPECT_TRUE(routing_state == aprs::router::routing_state::routed);
+        EXPECT_TRUE(routing_state == result.state);
 
-    EXPECT_TRUE(routing_actions.size() == 3);
+        if (result.routed)
+        {
+            EXPECT_TRUE(routed_path == result.routed_packet.path);
+        }
+    }
 #else
     EXPECT_TRUE(true);
 #endif
@@ -2288,6 +4295,95 @@ TEST(routing_result, to_string)
 #endif
 }
 
+TEST(routing_result, try_replay_routing_actions)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    router_settings settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::substitute_complete_n_N_address, true };
+    routing_result result;
+
+    packet p = "N0CALL>APRS,CALLA*,WIDE1-1,WIDE2-2:data";
+
+    EXPECT_TRUE(try_route_packet(p, settings, result));
+    EXPECT_TRUE(to_string(result.routed_packet) == "N0CALL>APRS,CALLA,DIGI*,WIDE2-2:data");
+
+    std::array<char, 256> buffer = {};
+    size_t size = 0;
+
+    EXPECT_TRUE(try_replay_routing_actions(result, buffer.data(), buffer.size(), size));
+    EXPECT_TRUE(std::string_view(buffer.data(), size) == "N0CALL>APRS,CALLA,DIGI*,WIDE2-2:data");
+
+    // Buffer too small, the required size is returned
+
+    EXPECT_FALSE(try_replay_routing_actions(result, buffer.data(), 10, size));
+    EXPECT_TRUE(size == 36);
+
+    // The routed packet is also rebuilt from the actions by index
+
+    packet routed_packet;
+    EXPECT_TRUE(try_route_packet_by_index(result, routed_packet));
+    EXPECT_TRUE(routed_packet == result.routed_packet);
+
+    // Invalid actions are rejected
+
+    routing_result invalid_result = result;
+    invalid_result.actions[0].index = 10;
+
+    EXPECT_FALSE(try_replay_routing_actions(invalid_result, buffer.data(), buffer.size(), size));
+    EXPECT_FALSE(try_route_packet_by_index(invalid_result, routed_packet));
+
+    // Packets that were not routed are not replayed
+
+    p = "N0CALL>APRS,CALLA,CALLB:data";
+
+    EXPECT_FALSE(try_route_packet(p, settings, result));
+    EXPECT_FALSE(try_replay_routing_actions(result, buffer.data(), buffer.size(), size));
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
+TEST(routing_result, long_from_address)
+{
+#ifndef APRS_ROUTE_DISABLE_TESTS
+    // The diagnostic offsets of a header longer than 65535 characters are not truncated
+
+    router_settings settings{ "DIGI", {}, { "WIDE1", "WIDE2" }, routing_option::none, true };
+    routing_result result;
+
+    packet p = { std::string(70000, 'A'), "APRS", { "CALLA*", "WIDE1-1" }, "data" };
+
+    EXPECT_TRUE(try_route_packet(p, settings, result));
+    EXPECT_TRUE(result.routed_packet.path == std::vector<std::string>({ "CALLA", "DIGI", "WIDE1*" }));
+
+    // N0CALL>APRS,CALLA*,WIDE1-1:data
+    //                    ~~~~~~~
+    //                    70013-70020
+
+    bool has_n_N_address_action = false;
+
+    for (const auto& action : result.actions)
+    {
+        if (action.start == 70013)
+        {
+            EXPECT_TRUE(action.end == 70020);
+            has_n_N_address_action = true;
+        }
+        EXPECT_TRUE(action.start <= action.end && action.end <= to_string(p).size());
+    }
+
+    EXPECT_TRUE(has_n_N_address_action);
+
+    packet routed_packet;
+    EXPECT_TRUE(try_route_packet_by_start_end(result, routed_packet));
+    EXPECT_TRUE(routed_packet == result.routed_packet);
+
+    EXPECT_TRUE(try_route_packet_by_index(result, routed_packet));
+    EXPECT_TRUE(routed_packet == result.routed_packet);
+#else
+    EXPECT_TRUE(true);
+#endif
+}
+
 TEST(addresses, set_address_as_used)
 {
 #ifndef APRS_ROUTE_DISABLE_TESTS